@@ -19,6 +19,8 @@
  */
 
 /* Includes ---------------------------------------------------------------- */
+//The static DSP workspace and the persistent model are set in the library's ei_project_config.h,
+//defines here would not reach the library's own .cpp files
 #include <ActivityRecognitionn_inferencing.h>
 #include <DFRobot_LIS2DW12.h>
 #include <BLEDevice.h>
@@ -29,6 +31,13 @@
 #include <string.h>
 #include "SPIFFS.h"
 #include "FS.h"
+//Wake the transport task often enough to stream a result backlog at the notification rate
+#define ACTIVITY_PIPELINE_IDLE_MS 50
+#include "src/activity_pipeline.h"
+#include "src/activity_decoder.h"
+#include "src/result_protocol.h"
+#include "src/result_log.h"
+#include "src/sample_log.h"
 
 
 #define SERVICE_UUID "020c6211-64f6-4e6d-82e8-c2c1391f75fa"
@@ -44,15 +53,151 @@
 DFRobot_LIS2DW12_I2C acce;
 unsigned long startTime;
 
+//Acquisition: the sensor runs at 50 Hz into its FIFO, INT1 fires on the FIFO watermark
+//and every 5th sample is kept so the impulse still sees EI_CLASSIFIER_FREQUENCY (10 Hz)
+#define ACC_INT1_PIN        D6
+#define ACC_ODR_PERIOD_US   20000
+#define ACC_DECIMATION      (1000000 / ACC_ODR_PERIOD_US / EI_CLASSIFIER_FREQUENCY)
+#define ACC_FIFO_WATERMARK  25
+//A new window is classified every half window (50% overlap)
+#define WINDOW_HOP_FRAMES   (EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2)
+//Acquisition, DSP, inference and BLE run as separate tasks (see src/activity_pipeline.h)
+ActivityPipeline pipeline(ACC_ODR_PERIOD_US, ACC_DECIMATION, WINDOW_HOP_FRAMES);
+#define PIPELINE_STATS_INTERVAL_MS 10000
+
+//Temporal decoder over the window results (see src/activity_decoder.h), runs in the BLE task.
+//A window where no label scores above 0.5 leans towards unknown; the reported activity is
+//decided ACTIVITY_DECODER_LAG windows late, on the best path through the newer windows
+ActivityDecoder decoder(0.5f);
+//transitions[from][to] between consecutive windows: run, stand, walk, unknown
+static const float activity_transitions[ACTIVITY_DECODER_STATES][ACTIVITY_DECODER_STATES] = {
+  { 0.90f, 0.01f, 0.07f, 0.02f },
+  { 0.01f, 0.90f, 0.07f, 0.02f },
+  { 0.04f, 0.04f, 0.90f, 0.02f },
+  { 0.05f, 0.05f, 0.05f, 0.85f },
+};
+
+void IRAM_ATTR onAccInterrupt() {
+  pipeline.fifo_interrupt();
+}
+
 //Bluetooth
 BLECharacteristic *pCharacteristic;
 bool deviceConnected = false;
 int txValue = 0;
 File dataFile;
-File dataFileAcc;
 BLEServer *ppServer;
 
+//Results are sent as binary packets (see src/result_protocol.h): one notification carries
+//as many results as fit the MTU, and goes out early on a class change or after the timeout
+#define BLE_RESULT_TIMEOUT_MS 10000
+void send_result_packet(const uint8_t *packet, size_t size, void *ctx);
+ResultBatcher<EI_CLASSIFIER_LABEL_COUNT> batcher(send_result_packet, NULL, RESULT_PROTOCOL_MIN_PAYLOAD, BLE_RESULT_TIMEOUT_MS);
+//Newest results by window, a decision refers to the one ACTIVITY_DECODER_LAG windows back
+typedef struct {
+  uint32_t timestamp_ms;
+  float scores[EI_CLASSIFIER_LABEL_COUNT];
+} recent_result_t;
+recent_result_t recent_results[ACTIVITY_DECODER_LAG + 1];
+uint32_t result_count = 0;
+
+//SPIFFS file behind the result log, created at its full size on first use
+class SpiffsLogStorage {
+public:
+  bool begin(const char *path, size_t size) {
+    File file = SPIFFS.open(path, "r");
+    const bool ready = file && file.size() == size;
+    file.close();
+    if (!ready) {
+      file = SPIFFS.open(path, "w");
+      if (!file) {
+        return false;
+      }
+      uint8_t zeros[64] = { 0 };
+      for (size_t written = 0; written < size; written += sizeof(zeros)) {
+        file.write(zeros, size - written < sizeof(zeros) ? size - written : sizeof(zeros));
+      }
+      file.close();
+    }
+    _file = SPIFFS.open(path, "r+");
+    return (bool)_file;
+  }
+
+  bool read(uint32_t offset, void *data, size_t size) {
+    return _file && _file.seek(offset) && _file.read((uint8_t *)data, size) == size;
+  }
+
+  bool write(uint32_t offset, const void *data, size_t size) {
+    if (!_file || !_file.seek(offset) || _file.write((const uint8_t *)data, size) != size) {
+      return false;
+    }
+    _file.flush();
+    return true;
+  }
+
+private:
+  File _file;
+};
+
+//Every result goes through a store-and-forward log in flash (see src/result_log.h): without
+//a phone it waits there, after the next connection the backlog is streamed in full packets
+#define RESULT_LOG_PATH "/results.log"
+//Packets per transport wakeup while a backlog is streamed
+#define RESULT_SYNC_PACKETS 4
+typedef ResultLog<SpiffsLogStorage, EI_CLASSIFIER_LABEL_COUNT, RESULT_LOG_BLOCKS> result_log_t;
+SpiffsLogStorage log_storage;
+result_log_t result_log(&log_storage);
+
+//Set to 1 to record the frames the classifier consumes to flash (see src/sample_log.h): delta
+//encoded 4 KB blocks, written by the transport task. Convert with host/sample_log_decode
+#define RAW_CAPTURE 0
+#define RAW_CAPTURE_PATH "/samples.log"
+#if RAW_CAPTURE
+typedef SampleLog<SpiffsLogStorage, SAMPLE_LOG_BLOCKS> sample_log_t;
+SpiffsLogStorage capture_storage;
+sample_log_t sample_log(&capture_storage, ACC_ODR_PERIOD_US * ACC_DECIMATION);
 
+/**
+ * @brief      Acquisition task: encode one decimated frame into the RAM block
+ */
+void capture_frame(const accel_frame_t *frame, void *ctx) {
+  sample_log.add(frame);
+}
+#define CAPTURE_FRAME_FN capture_frame
+#else
+#define CAPTURE_FRAME_FN NULL
+#endif
+
+
+
+//Packet being notified, acknowledged in the result log once the stack accepted it
+result_packet_info_t notified_packet;
+bool notifying = false;
+
+//The phone only receives notifications after it enabled them in the CCCD (BLE2902)
+bool notificationsEnabled() {
+  if (!deviceConnected) {
+    return false;
+  }
+  BLE2902 *cccd = (BLE2902 *)pCharacteristic->getDescriptorByUUID((uint16_t)0x2902);
+  return cccd && cccd->getNotifications();
+}
+
+//notify() reports here before it returns: SUCCESS_NOTIFY once the stack took the packet,
+//otherwise (notifications disabled, GATT error) the records are handed out again
+class ResultCharacteristicCallbacks : public BLECharacteristicCallbacks {
+  void onStatus(BLECharacteristic *pCharacteristic, Status s, uint32_t code) {
+    if (!notifying) {
+      return;
+    }
+    notifying = false;
+    if (s == Status::SUCCESS_NOTIFY) {
+      result_log.acknowledge(notified_packet.sequence, notified_packet.record_count);
+    } else {
+      result_log.rewind();
+    }
+  }
+};
 
 class MyServerCallbacks : public BLEServerCallbacks {
   void onConnect(BLEServer *pServer) {
@@ -66,29 +211,9 @@ class MyServerCallbacks : public BLEServerCallbacks {
 };
 
 
-float features[90] = {
-  //     // copy raw features here (for example from the 'Live classification' page)
-  //     // see https://docs.edgeimpulse.com/docs/running-your-impulse-arduino
-  //  -542.0,-757,499,-512.0,-466,320,-512.0,-466,320,-608.0,-462,422,-608.0,-462,422,-454.0,-871,462,-454.0,-871,462,-646.0,-1058,317,-451.0,-555,77,-451.0,-555,77,-546.0,-478,143,-1115.0,-1339,631,-1115.0,-1339,631,-932.0,-1315,646,-445.0,-818,416,-701.0,-518,192,-701.0,-518,192,-375.0,-536,82,-877.0,-665,451,-877.0,-776,542,-1243.0,-1352,662,-1243.0,-1352,683,-409.0,-769,347,-398.0,-553,182,-367.0,-593,108,-367.0,-593,108,-1035.0,-1246,515,-1035.0,-1246,515,-1377.0,-1215,635,-551.0,-930,626
-
-};
-
-/**
- * @brief      Copy raw feature data in out_ptr
- *             Function called by inference library
- *
- * @param[in]  offset   The offset
- * @param[in]  length   The length
- * @param      out_ptr  The out pointer
- *
- * @return     0
- */
-int raw_feature_get_data(size_t offset, size_t length, float *out_ptr) {
-  memcpy(out_ptr, features + offset, length * sizeof(float));
-  return 0;
-}
-
-void print_inference_result(ei_impulse_result_t result);
+size_t read_accel_fifo(int16_t *xyz, size_t max_frames, bool *overrun, void *ctx);
+void publish_result(const activity_result_t *result, void *ctx);
+void poll_results(void *ctx);
 
 /**
  * @brief      Arduino setup function
@@ -113,8 +238,20 @@ void setup() {
   acce.setFilterBandwidth(DFRobot_LIS2DW12::eRateDiv_4);
   acce.setPowerMode(DFRobot_LIS2DW12::eContLowPwrLowNoise2_14bit);
 
+  //Buffer samples in the sensor FIFO and raise INT1 once the watermark is reached
+  acce.setFifoWatermark(ACC_FIFO_WATERMARK);
+  acce.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+  acce.setInt1Event(DFRobot_LIS2DW12::eFifoTh);
+  pinMode(ACC_INT1_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(ACC_INT1_PIN), onAccInterrupt, RISING);
+
+  //Allocate the tensor arena and prepare the model once, before the first window
+  run_classifier_init();
+
   //Create the BLE Device
   BLEDevice::init("ESP32");
+  //Allow the phone to negotiate an MTU that fits a full result packet
+  BLEDevice::setMTU(RESULT_PROTOCOL_MAX_PAYLOAD + 3);
 
   //Create the BLE Server
   BLEServer *pServer = BLEDevice::createServer();
@@ -131,6 +268,7 @@ void setup() {
 
   //BLE2902 nedded to notify
   pCharacteristic->addDescriptor(new BLE2902());
+  pCharacteristic->setCallbacks(new ResultCharacteristicCallbacks());
 
 
   //Start the service
@@ -140,9 +278,26 @@ void setup() {
   pServer->getAdvertising()->start();
   Serial.println("Waiting for a client connection notify...");
 
+  //The result log has to be ready before the transport task runs
   if(!SPIFFS.begin(true)){
     Serial.println("Błąd inicjalizacji SPIFFS!");
-    return;
+  }
+  else if (!log_storage.begin(RESULT_LOG_PATH, result_log_t::STORAGE_SIZE)) {
+    Serial.println("Failed to open the result log");
+  }
+  result_log.begin();
+  Serial.println("Result backlog: " + String(result_log.unsynced()));
+#if RAW_CAPTURE
+  if (!capture_storage.begin(RAW_CAPTURE_PATH, sample_log_t::STORAGE_SIZE)) {
+    Serial.println("Failed to open the sample log");
+  }
+  sample_log.begin();
+#endif
+
+  //Start the acquisition / DSP / inference / transport tasks
+  decoder.set_transitions(activity_transitions);
+  if (!pipeline.start(&activity_pipeline_default_config, read_accel_fifo, publish_result, NULL, poll_results, CAPTURE_FRAME_FN)) {
+    Serial.println("Failed to start the pipeline tasks");
   }
 
 
@@ -162,11 +317,6 @@ void setup() {
   //   Serial.println("Plik 'dane.txt' został usunięty.");
   // }
 
-  // if (SPIFFS.exists("/daneAcc.txt")) {
-  //   SPIFFS.remove("/daneAcc.txt");
-  //   Serial.println("Plik 'daneAcc.txt' został usunięty.");
-  // }
-
   // // Otwarcie pliku w trybie dopisywania
   // dataFile = SPIFFS.open("/dane.txt", "a");
   // if(!dataFile){
@@ -174,170 +324,139 @@ void setup() {
   //   return;
   // }
 
-  //   // Otwarcie pliku w trybie dopisywania
-  // dataFileAcc = SPIFFS.open("/daneAcc.txt", "a");
-  // if(!dataFileAcc){
-  //   Serial.println("Błąd otwarcia pliku!");
-  //   return;
-  // }
   
 }
 /**
  * @brief      Arduino main function
  */
 void loop() {
-  // Zbieranie danych z czujnika
-  for (int i = 0; i < 90; i += 3) {
-    features[i] = acce.readAccX();
-    features[i + 1] = acce.readAccY();
-    features[i + 2] = acce.readAccZ();
-    delay(100);
-  }
-
-  // Sprawdzenie poprawności rozmiaru danych
-  if (sizeof(features) / sizeof(float) != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
-    ei_printf("The size of your 'features' array is not correct. Expected %lu items, but had %lu\n",
-              EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, sizeof(features) / sizeof(float));
-    delay(1000);
-    return;
-  }
-
-  ei_impulse_result_t result = { 0 };
+  // Cała praca odbywa się w zadaniach potoku, tutaj tylko statystyki
+  delay(PIPELINE_STATS_INTERVAL_MS);
+
+  activity_pipeline_stats_t stats;
+  pipeline.get_stats(&stats);
+  ei_printf("Pipeline: %u results, max latency %u us, %u errors\r\n",
+            (unsigned)stats.transport.items, (unsigned)stats.max_latency_us, (unsigned)stats.errors);
+  ei_printf("  windows: %u captured, %u dropped\r\n",
+            (unsigned)stats.capture.completed, (unsigned)stats.capture.dropped);
+  ei_printf("  dropped: %u frames, %u sensor FIFO overruns, %u feature windows, %u results\r\n",
+            (unsigned)stats.frames_dropped, (unsigned)stats.fifo_overruns,
+            (unsigned)stats.windows.dropped, (unsigned)stats.results.dropped);
+  ei_printf("  busy: acq %u us max, dsp %u us max, inference %u us max, BLE %u us max\r\n",
+            (unsigned)stats.acquisition.max_us, (unsigned)stats.features.max_us,
+            (unsigned)stats.inference.max_us, (unsigned)stats.transport.max_us);
+  ei_printf("  per window: dsp %u us, inference %u us mean\r\n",
+            (unsigned)(stats.features.items ? stats.features.busy_us / stats.features.items : 0),
+            (unsigned)(stats.inference.items ? stats.inference.busy_us / stats.inference.items : 0));
+  // raise EIDSP_STATIC_WORKSPACE_SIZE if the DSP falls back to the heap
+  ei_printf("  DSP workspace: %u of %u bytes peak, %u heap fallbacks\r\n",
+            (unsigned)ei::workspace::high_water(), (unsigned)EIDSP_STATIC_WORKSPACE_SIZE,
+            (unsigned)ei::workspace::heap_fallbacks());
+
+  //Read from another task, the numbers are only indicative
+  result_log_stats_t log_stats;
+  result_log.get_stats(&log_stats);
+  ei_printf("  result log: %u backlog, %u blocks written, %u overwritten, %u corrupt blocks, %u write errors\r\n",
+            (unsigned)result_log.unsynced(), (unsigned)log_stats.blocks_written, (unsigned)log_stats.overwritten,
+            (unsigned)log_stats.corrupt_blocks, (unsigned)log_stats.write_errors);
+#if RAW_CAPTURE
+  sample_log_stats_t capture_stats;
+  sample_log.get_stats(&capture_stats);
+  ei_printf("  sample log: %u frames, %u blocks written, %u frames dropped, %u write errors\r\n",
+            (unsigned)capture_stats.frames, (unsigned)capture_stats.blocks_written,
+            (unsigned)capture_stats.dropped_frames, (unsigned)capture_stats.write_errors);
+#endif
+}
 
-  // Przygotowanie sygnału do klasyfikacji
-  signal_t features_signal;
-  features_signal.total_length = sizeof(features) / sizeof(features[0]);
-  features_signal.get_data = &raw_feature_get_data;
+/**
+ * @brief      Acquisition task: drain the sensor FIFO
+ */
+size_t read_accel_fifo(int16_t *xyz, size_t max_frames, bool *overrun, void *ctx) {
+  // reading the FIFO clears the flag
+  *overrun = acce.fifoOverrun();
+  return acce.readFifo(xyz, max_frames);
+}
 
-  // Uruchomienie klasyfikatora
-  EI_IMPULSE_ERROR res = run_classifier(&features_signal, &result, false /* debug */);
-  if (res != EI_IMPULSE_OK) {
-    ei_printf("ERR: Failed to run classifier (%d)\n", res);
+/**
+ * @brief      Transport task: decode one classification, log it and send what is pending
+ */
+void publish_result(const activity_result_t *result, void *ctx) {
+  recent_result_t *recent = &recent_results[result_count % (ACTIVITY_DECODER_LAG + 1)];
+  recent->timestamp_ms = millis() - result->latency_us / 1000;
+  memcpy(recent->scores, result->scores, sizeof(recent->scores));
+
+  int state = decoder.update(result->scores);
+  result_count++;
+  if (state < 0) {
     return;
   }
 
-  // Przygotowanie wyników klasyfikacji
-  char txString[20]; // Zwiększ rozmiar, aby zmieścić "Unknown Activity"
-  char valueString[10]; // Zwiększ rozmiar na wypadek dłuższych wartości
-  char resultString[30]; // Zwiększ rozmiar, aby uwzględnić dodatkowy tekst
-  float runValue = result.classification[0].value;
-  float standValue = result.classification[1].value;
-  float walkValue = result.classification[2].value;
-
-
-  if(runValue< 0.5 && walkValue < 0.5 && standValue<0.5){
-  strcpy(txString, "Unknown Activity");
-  }
-  else if (runValue > walkValue && runValue > standValue) {
-    strcpy(txString, ei_classifier_inferencing_categories[0]);
-    dtostrf(result.classification[0].value, 1, 4, valueString);
+  //Use the MTU the phone negotiated, once the exchange is done
+  uint16_t mtu = deviceConnected ? ppServer->getPeerMTU(ppServer->getConnId()) : 0;
+  if (mtu > 3) {
+    batcher.set_payload_size(mtu - 3);
   }
-  else if (walkValue > runValue && walkValue > standValue) {
-    strcpy(txString, ei_classifier_inferencing_categories[2]);
-    dtostrf(result.classification[2].value, 1, 4, valueString);
+  const recent_result_t *decided = &recent_results[(result_count - 1 - ACTIVITY_DECODER_LAG) % (ACTIVITY_DECODER_LAG + 1)];
+  result_log.append(decided->timestamp_ms, (uint8_t)state, decided->scores);
+  if (notificationsEnabled()) {
+    result_log_sync(&result_log, &batcher, RESULT_SYNC_PACKETS);
   }
-  else {
-    strcpy(txString, ei_classifier_inferencing_categories[1]);
-    dtostrf(result.classification[1].value, 1, 4, valueString);
-  }
-
-// Przygotowanie ciągu wynikowego w zależności od klasyfikacji
-if (strcmp(txString, "Unknown Activity") == 0) {
-    strcpy(resultString, txString); // Bez "="
-} else {
-    strcpy(resultString, txString);
-    strcat(resultString, "=");
-    strcat(resultString, valueString);
-}
-
-
-
-
-  // Ustawienie wartości w charakterystyce
-  pCharacteristic->setValue(resultString);
+  Serial.println("Result " + String(ActivityDecoder::label(state)));
 
-  // Wysyłanie powiadomienia tylko jeśli urządzenie jest połączone
-  if (deviceConnected) {
-    pCharacteristic->notify();
-    Serial.println("Send value " + String(resultString) + "\n");
-  }
-  else {
-    Serial.println("Lack GATT Connetion");
-  }
-
-  memset(resultString, 0, sizeof(resultString));
-  Serial.println("Connected: " + String(deviceConnected));
-  
   // Opcjonalnie: zapis do pliku
   /*
   // dataFile.print(millis()-startTime);
   // dataFile.print(", ");
   // dataFile.println(String(resultString));
-
-  // dataFileAcc.print(millis()-startTime);
-  // dataFileAcc.print(", ");
-  // dataFileAcc.print(acce.readAccX());
-  // dataFileAcc.print(", ");
-  // dataFileAcc.print(acce.readAccY());
-  // dataFileAcc.print(", ");
-  // dataFileAcc.println(acce.readAccZ());
   */
 }
+
+/**
+ * @brief      Transport task: stream the backlog, send results that waited for the timeout
+ */
+void poll_results(void *ctx) {
+  if (notificationsEnabled() && result_log.pending() > 1) {
+    result_log_sync(&result_log, &batcher, RESULT_SYNC_PACKETS);
+    if (result_log.pending() == 0) {
+      //Backlog delivered, remember that across resets
+      result_log.commit();
+    }
+  }
+  batcher.poll(millis());
+#if RAW_CAPTURE
+  //A sample block fills in about a minute, write it outside the acquisition task
+  sample_log.write();
+#endif
+}
+
+/**
+ * @brief      Transport task: notify one result packet
+ */
+void send_result_packet(const uint8_t *packet, size_t size, void *ctx) {
+  // Wysyłanie powiadomienia tylko jeśli urządzenie jest połączone
+  if (!notificationsEnabled()) {
+    //Not delivered, the log hands these results out again once the phone subscribes
+    result_log.rewind();
+    return;
+  }
+  //Acknowledged or rewound by ResultCharacteristicCallbacks::onStatus
+  notifying = result_protocol_decode(packet, size, &notified_packet, NULL, 0) > 0;
+  pCharacteristic->setValue((uint8_t *)packet, size);
+  pCharacteristic->notify();
+  notifying = false;
+}
   
   // else {
   //   Serial.println("Measurement stopped after 10 seconds");
   //  Serial.println("Dane zapisane!");
   // listFiles("/");
   // dataFile.close();
-  // dataFileAcc.close();
   // // readDataFromFile("/dane.txt");
-  // // readDataFromFile("/daneAcc.txt");       
 
 
   // delay(100000000);
   // }
 
-
-void print_inference_result(ei_impulse_result_t result) {
-
-  // Print how long it took to perform inference
-  ei_printf("Timing: DSP %d ms, inference %d ms, anomaly %d ms\r\n",
-            result.timing.dsp,
-            result.timing.classification,
-            result.timing.anomaly);
-
-  // Print the prediction results (object detection)
-#if EI_CLASSIFIER_OBJECT_DETECTION == 1
-  ei_printf("Object detection bounding boxes:\r\n");
-  for (uint32_t i = 0; i < result.bounding_boxes_count; i++) {
-    ei_impulse_result_bounding_box_t bb = result.bounding_boxes[i];
-    if (bb.value == 0) {
-      continue;
-    }
-    ei_printf("  %s (%f) [ x: %u, y: %u, width: %u, height: %u ]\r\n",
-              bb.label,
-              bb.value,
-              bb.x,
-              bb.y,
-              bb.width,
-              bb.height);
-  }
-
-  // Print the prediction results (classification)
-#else
-  ei_printf("Predictions:\r\n");
-  for (uint16_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
-    ei_printf("  %s: ", ei_classifier_inferencing_categories[i]);
-    ei_printf("%.5f\r\n", result.classification[i].value);
-  }
-#endif
-
-  // Print anomaly result (if it exists)
-#if EI_CLASSIFIER_HAS_ANOMALY == 1
-  ei_printf("Anomaly prediction: %.3f\r\n", result.anomaly);
-#endif
-}
-
 void readDataFromFile(const char* filename) {
   // Otwarcie pliku w trybie odczytu
   File dataFile = SPIFFS.open(filename, "r");
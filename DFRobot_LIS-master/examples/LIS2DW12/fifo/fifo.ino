@@ -0,0 +1,91 @@
+/**！
+ * @file fifo.ino
+ * @brief Collect acceleration in FIFO continuous (stream) mode and drain it in bursts once the watermark is reached.
+ * @n Instead of three register reads per sample, the FIFO buffers up to 32 XYZ levels and readFifo() fetches
+ * @n them with a few auto-increment bursts, leaving the CPU idle between bursts.
+ * @n When using SPI, chip select pin can be modified by changing the value of LIS2DW12_CS
+ * @copyright  Copyright (c) 2010 DFRobot Co.Ltd (http://www.dfrobot.com)
+ * @license     The MIT License (MIT)
+ * @version  V1.0
+ * @url https://github.com/DFRobot/DFRobot_LIS
+ */
+#include <DFRobot_LIS2DW12.h>
+
+//When using I2C communication, use the following program to construct an object by DFRobot_LIS2DW12_I2C
+/*!
+ * @brief Constructor 
+ * @param pWire I2c controller
+ * @param addr  I2C address(0x18/0x19)
+ */
+//DFRobot_LIS2DW12_I2C acce(&Wire,0x18);
+DFRobot_LIS2DW12_I2C acce;
+
+//When using SPI communication, use the following program to construct an object by DFRobot_LIS2DW12_SPI
+#if defined(ESP32) || defined(ESP8266)
+#define LIS2DW12_CS  D3
+#elif defined(__AVR__) || defined(ARDUINO_SAM_ZERO)
+#define LIS2DW12_CS 3
+#elif (defined NRF5)
+#define LIS2DW12_CS 2  //The pin on the development board with the corresponding silkscreen printed as P2
+#endif
+/*!
+ * @brief Constructor 
+ * @param cs Chip selection pinChip selection pin
+ * @param spi SPI controller
+ */
+//DFRobot_LIS2DW12_SPI acce(/*cs = */LIS2DW12_CS,&SPI);
+
+#define FIFO_WATERMARK 30
+
+int16_t xyz[LIS2DW12_FIFO_DEPTH * 3];
+
+void setup(void){
+
+  Serial.begin(115200);
+  while(!acce.begin()){
+     Serial.println("Communication failed, check the connection and I2C address setting when using I2C communication.");
+     delay(1000);
+  }
+  Serial.print("chip id : ");
+  Serial.println(acce.getID(),HEX);
+  //Chip soft reset
+  acce.softReset();
+  //Set whether to collect data continuously
+  acce.continRefresh(true);
+  acce.setDataRate(DFRobot_LIS2DW12::eRate_50hz);
+  acce.setRange(DFRobot_LIS2DW12::e2_g);
+  acce.setFilterPath(DFRobot_LIS2DW12::eLPF);
+  acce.setFilterBandwidth(DFRobot_LIS2DW12::eRateDiv_4);
+  acce.setPowerMode(DFRobot_LIS2DW12::eContLowPwrLowNoise2_14bit);
+
+  /**！
+    Set the FIFO mode:
+       eFifoBypass        /<FIFO turned off>/
+       eFifoStopWhenFull  /<Collection stops when the FIFO is full>/
+       eFifoContToFifo    /<Continuous mode until trigger, then FIFO mode>/
+       eFifoBypassToCont  /<Bypass mode until trigger, then continuous mode>/
+       eFifoContinuous    /<Stream mode, the oldest level is overwritten when full>/
+  */
+  acce.setFifoWatermark(FIFO_WATERMARK);
+  acce.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+  //Route the watermark to int1 if the pin is wired, the example below polls the flag instead
+  //acce.setInt1Event(DFRobot_LIS2DW12::eFifoTh);
+}
+
+void loop(void){
+  if(!acce.fifoWatermarkReached()){
+    delay(50);
+    return;
+  }
+  if(acce.fifoOverrun()){
+    Serial.println("FIFO overrun, samples lost");
+  }
+  size_t n = acce.readFifo(xyz, LIS2DW12_FIFO_DEPTH);
+  for(size_t i = 0; i < n; i++){
+    Serial.print(xyz[i * 3]);
+    Serial.print(" ");
+    Serial.print(xyz[i * 3 + 1]);
+    Serial.print(" ");
+    Serial.println(xyz[i * 3 + 2]);
+  }
+}
@@ -561,6 +561,87 @@ DFRobot_LIS2DW12::eWakeUpDir_t DFRobot_LIS2DW12::getWakeUpDir()
   }
 }
 
+void DFRobot_LIS2DW12::setFifoMode(eFifoMode_t mode)
+{
+  uint8_t value;
+  readReg(REG_FIFO_CTRL,&value, 1);
+  value = value & (~0xE0);
+  value = value | ((mode << 5) & 0xE0);
+  DBG(value);
+  writeReg(REG_FIFO_CTRL,&value, 1);
+  return;
+}
+
+void DFRobot_LIS2DW12::setFifoWatermark(uint8_t th)
+{
+  uint8_t value;
+  readReg(REG_FIFO_CTRL,&value, 1);
+  value = value & (~0x1F);
+  value = value | (th & 0x1F);
+  DBG(value);
+  writeReg(REG_FIFO_CTRL,&value, 1);
+  return;
+}
+
+uint8_t DFRobot_LIS2DW12::getFifoLevel()
+{
+  uint8_t value = 0;
+  readReg(REG_FIFO_SAMPLES,&value,1);
+  return value & 0x3F;
+}
+
+bool DFRobot_LIS2DW12::fifoWatermarkReached()
+{
+  uint8_t value = 0;
+  readReg(REG_FIFO_SAMPLES,&value,1);
+  if((value & 0x80) > 0){
+     return true;
+  } else {
+     return false;
+  }
+}
+
+bool DFRobot_LIS2DW12::fifoOverrun()
+{
+  uint8_t value = 0;
+  readReg(REG_FIFO_SAMPLES,&value,1);
+  if((value & 0x40) > 0){
+     return true;
+  } else {
+     return false;
+  }
+}
+
+size_t DFRobot_LIS2DW12::readFifo(int16_t *xyz, size_t frames)
+{
+  uint8_t sensorData[LIS2DW12_FIFO_BURST_FRAMES * LIS2DW12_FIFO_FRAME_BYTES];
+  if(xyz == NULL){
+    DBG("xyz ERROR!! : null pointer");
+    return 0;
+  }
+  size_t level = getFifoLevel();
+  if(frames > level){
+    frames = level;
+  }
+  size_t done = 0;
+  while(done < frames){
+    size_t n = frames - done;
+    if(n > LIS2DW12_FIFO_BURST_FRAMES){
+      n = LIS2DW12_FIFO_BURST_FRAMES;
+    }
+    if(readReg(REG_OUT_X_L,sensorData,n * LIS2DW12_FIFO_FRAME_BYTES) != n * LIS2DW12_FIFO_FRAME_BYTES){
+      break;
+    }
+    for(size_t i = 0; i < n * 3; i++){
+      int16_t a = ((int16_t)sensorData[2 * i + 1])*256+(int16_t)sensorData[2 * i];
+      xyz[done * 3 + i] = a*_range;
+    }
+    done += n;
+  }
+  DBG(done);
+  return done;
+}
+
 DFRobot_IIS2DLPC_I2C::DFRobot_IIS2DLPC_I2C(TwoWire * pWire,uint8_t addr)
 {
   _deviceAddr = addr;
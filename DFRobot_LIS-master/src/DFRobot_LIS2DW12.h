@@ -30,6 +30,22 @@
 #define ERR_DATA_BUS       -1      ///<error in data bus
 #define ERR_IC_VERSION     -2      ///<chip version mismatch
 
+#define LIS2DW12_FIFO_DEPTH       32   ///<Number of XYZ levels in the FIFO
+#define LIS2DW12_FIFO_FRAME_BYTES 6    ///<Bytes per FIFO level (OUT_X_L..OUT_Z_H)
+
+/**
+ * @brief Maximum number of FIFO levels fetched in one register burst.
+ * @n Bounded by the Wire receive buffer on cores that define I2C_BUFFER_LENGTH (128 bytes on ESP32),
+ * @n otherwise the whole FIFO is drained in one burst.
+ */
+#ifndef LIS2DW12_FIFO_BURST_FRAMES
+#if defined(I2C_BUFFER_LENGTH) && (I2C_BUFFER_LENGTH / LIS2DW12_FIFO_FRAME_BYTES) < LIS2DW12_FIFO_DEPTH
+#define LIS2DW12_FIFO_BURST_FRAMES (I2C_BUFFER_LENGTH / LIS2DW12_FIFO_FRAME_BYTES)
+#else
+#define LIS2DW12_FIFO_BURST_FRAMES LIS2DW12_FIFO_DEPTH
+#endif
+#endif
+
 
 class DFRobot_LIS2DW12
 {
@@ -49,6 +65,8 @@ public:
   #define REG_OUT_Y_H      0x2B     ///<The high point of the Y-axis acceleration register
   #define REG_OUT_Z_L      0x2C     ///<The low order of the Z-axis acceleration register
   #define REG_OUT_Z_H      0x2D     ///<The high point of the Z-axis acceleration register
+  #define REG_FIFO_CTRL    0x2E     ///<FIFO mode and watermark threshold register
+  #define REG_FIFO_SAMPLES 0x2F     ///<FIFO watermark/overrun flags and number of unread levels
   #define REG_WAKE_UP_DUR  0x35     ///<Wakeup and sleep duration configuration register
   #define REG_FREE_FALL    0x36     ///<Free fall event register
   #define REG_STATUS_DUP   0x37     ///<Interrupt event status register
@@ -157,6 +175,9 @@ typedef enum {
  * @brief Interrupt source 1 trigger event setting
  */
 typedef enum{
+  eDataReady    = 0x01,/**<Data-ready event>*/
+  eFifoTh       = 0x02,/**<FIFO level reached the watermark set by setFifoWatermark()>*/
+  eFifoFull     = 0x04,/**<FIFO full (32 levels stored)>*/
   eDoubleTap    = 0x08,/**<Double tap event>*/
   eFreeFall     = 0x10,/**<Free fall event>*/
   eWakeUp       = 0x20,/**<Wake-up event>*/
@@ -173,6 +194,18 @@ typedef enum{
   eSleepState  = 0x80,/**<Enable routing of SLEEP_STATE on INT2 pad>*/
 }eInt2Event_t;
 
+/**
+ * @fn eFifoMode_t
+ * @brief FIFO operating mode
+ */
+typedef enum {
+  eFifoBypass         = 0,/**<FIFO turned off, only the output registers are updated>*/
+  eFifoStopWhenFull   = 1,/**<FIFO mode, collection stops when the FIFO is full>*/
+  eFifoContToFifo     = 3,/**<Continuous mode until an interrupt event, then FIFO mode>*/
+  eFifoBypassToCont   = 4,/**<Bypass mode until an interrupt event, then continuous mode>*/
+  eFifoContinuous     = 6,/**<Continuous (stream) mode, the oldest level is overwritten when full>*/
+} eFifoMode_t;
+
 /**
  * @fn eTapMode_t
  * @brief tap detection mode
@@ -589,6 +622,59 @@ public:
    * @brief In Single data conversion on demand mode
    */
   void demandData();
+
+  /**
+   * @fn setFifoMode
+   * @brief Select the FIFO operating mode (FIFO_CTRL.FMode)
+   * @param mode FIFO mode
+   * @n          eFifoBypass        /<FIFO turned off>/
+   * @n          eFifoStopWhenFull  /<Collection stops when the FIFO is full>/
+   * @n          eFifoContToFifo    /<Continuous mode until trigger, then FIFO mode>/
+   * @n          eFifoBypassToCont  /<Bypass mode until trigger, then continuous mode>/
+   * @n          eFifoContinuous    /<Stream mode, the oldest level is overwritten when full>/
+   */
+  void setFifoMode(eFifoMode_t mode);
+
+  /**
+   * @fn setFifoWatermark
+   * @brief Set the FIFO watermark (FIFO_CTRL.FTH). The eFifoTh event fires when the number of
+   * @n unread levels reaches this value.
+   * @param th threshold, range: 0~31
+   */
+  void setFifoWatermark(uint8_t th);
+
+  /**
+   * @fn getFifoLevel
+   * @brief Get the number of unread XYZ levels stored in the FIFO
+   * @return Unread levels, range: 0~32
+   */
+  uint8_t getFifoLevel();
+
+  /**
+   * @fn fifoWatermarkReached
+   * @brief Check whether the FIFO level is equal to or higher than the watermark
+   * @return true(Watermark reached)/false(Below watermark)
+   */
+  bool fifoWatermarkReached();
+
+  /**
+   * @fn fifoOverrun
+   * @brief Check whether the FIFO is full and at least one level has been overwritten
+   * @return true(Overrun)/false(No overrun)
+   */
+  bool fifoOverrun();
+
+  /**
+   * @fn readFifo
+   * @brief Drain up to frames levels from the FIFO using auto-increment register bursts.
+   * @n The output register pointer rolls back from OUT_Z_H to OUT_X_L while the FIFO is enabled,
+   * @n so each burst returns consecutive XYZ levels. At most LIS2DW12_FIFO_BURST_FRAMES levels
+   * @n are fetched per bus transaction.
+   * @param xyz   Buffer receiving interleaved x,y,z acceleration(mg), at least 3*frames elements
+   * @param frames Maximum number of levels to read
+   * @return Number of levels actually read (limited by the FIFO level)
+   */
+  size_t readFifo(int16_t *xyz, size_t frames);
 protected:
 
   /**
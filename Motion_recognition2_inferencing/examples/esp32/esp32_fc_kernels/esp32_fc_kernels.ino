@@ -0,0 +1,168 @@
+/* Edge Impulse Arduino examples
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Times the int8 fully connected layers of the model, in each shape, through
+ * FullyConnectedS8 and through the kernel TFLM uses on this target (ESP-NN,
+ * or the reference kernel if ESP-NN is disabled), and checks that both give
+ * the same output. Random weights and inputs, results in us per layer.
+ */
+
+/* Includes ---------------------------------------------------------------- */
+#include <Motion_recognition2_inferencing.h>
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_fc_s8.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#if ESP_NN
+#include "edge-impulse-sdk/porting/espressif/ESP-NN/include/esp_nn.h"
+#endif
+#include "esp_timer.h"
+
+/* Constant defines -------------------------------------------------------- */
+#define BENCH_ITERATIONS    2000
+#define BENCH_INPUTS        16
+
+/* Private functions ------------------------------------------------------- */
+
+/**
+ * @brief      One layer of the benchmark, weights and inputs are random
+ */
+template <size_t In, size_t Out>
+struct fc_layer_t {
+    int8_t filter[Out * In];
+    int32_t bias[Out];
+    int32_t folded_bias[Out];
+    int8_t inputs[BENCH_INPUTS][In];
+    int8_t output[Out];
+    tflite::OpDataFullyConnected op;
+};
+
+template <size_t In, size_t Out>
+static void run_tflm(fc_layer_t<In, Out> *layer, const int8_t *input) {
+#if ESP_NN
+    esp_nn_fully_connected_s8(input, -layer->op.input_zero_point, In,
+                              layer->filter, -layer->op.filter_zero_point,
+                              layer->bias, layer->output, Out,
+                              layer->op.output_zero_point,
+                              layer->op.output_shift, layer->op.output_multiplier,
+                              layer->op.output_activation_min,
+                              layer->op.output_activation_max);
+#else
+    static const int32_t input_dims[] = { 1, (int32_t)In };
+    static const int32_t filter_dims[] = { (int32_t)Out, (int32_t)In };
+    static const int32_t bias_dims[] = { (int32_t)Out };
+    static const int32_t output_dims[] = { 1, (int32_t)Out };
+    tflite::reference_integer_ops::FullyConnected(tflite::FullyConnectedParamsQuantized(layer->op),
+        tflite::RuntimeShape(2, input_dims), input,
+        tflite::RuntimeShape(2, filter_dims), layer->filter,
+        tflite::RuntimeShape(1, bias_dims), layer->bias,
+        tflite::RuntimeShape(2, output_dims), layer->output);
+#endif
+}
+
+/**
+ * @brief      Checks and times one layer shape, prints a line per kernel
+ */
+template <size_t In, size_t Out, TfLiteFusedActivation Act>
+static void bench_fc(const char *name) {
+    typedef fc_layer_t<In, Out> layer_t;
+    layer_t *layer = (layer_t *)ei_malloc(sizeof(layer_t));
+    if (!layer) {
+        ei_printf("%s: out of memory\n", name);
+        return;
+    }
+
+    randomSeed(In * 1000 + Out);
+    for (size_t ix = 0; ix < Out * In; ix++) {
+        layer->filter[ix] = (int8_t)random(-127, 128);
+    }
+    for (size_t ix = 0; ix < BENCH_INPUTS; ix++) {
+        for (size_t d = 0; d < In; d++) {
+            layer->inputs[ix][d] = (int8_t)random(-128, 128);
+        }
+    }
+    layer->op.input_zero_point = -128;
+    layer->op.filter_zero_point = 0;
+    layer->op.output_zero_point = Act == kTfLiteActNone ? 12 : -128;
+    layer->op.output_activation_min = -128;
+    layer->op.output_activation_max = 127;
+    tflite::QuantizeMultiplier(1.0 / (In * 160.0), &layer->op.output_multiplier, &layer->op.output_shift);
+    for (size_t out_c = 0; out_c < Out; out_c++) {
+        layer->bias[out_c] = random(-1000, 1001);
+        layer->folded_bias[out_c] = ei_fc_s8_fold_bias(&layer->filter[out_c * In], In, layer->bias[out_c], -layer->op.input_zero_point);
+    }
+
+    // both kernels have to agree before anything is timed
+    for (size_t ix = 0; ix < BENCH_INPUTS; ix++) {
+        int8_t expected[Out];
+        run_tflm(layer, layer->inputs[ix]);
+        memcpy(expected, layer->output, Out);
+        FullyConnectedS8<In, Out, Act>::Eval(layer->op, layer->inputs[ix], layer->filter, layer->folded_bias, layer->output);
+        if (memcmp(expected, layer->output, Out) != 0) {
+            ei_printf("%s: FullyConnectedS8 output differs on input %u\n", name, (unsigned)ix);
+            ei_free(layer);
+            return;
+        }
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (size_t it = 0; it < BENCH_ITERATIONS; it++) {
+        FullyConnectedS8<In, Out, Act>::Eval(layer->op, layer->inputs[it % BENCH_INPUTS], layer->filter, layer->folded_bias, layer->output);
+    }
+    const int64_t s8_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (size_t it = 0; it < BENCH_ITERATIONS; it++) {
+        run_tflm(layer, layer->inputs[it % BENCH_INPUTS]);
+    }
+    const int64_t tflm_us = esp_timer_get_time() - start;
+
+    ei_printf("%-12s fc_s8 %6.2f us   %s %6.2f us\n", name,
+        (float)s8_us / BENCH_ITERATIONS,
+#if ESP_NN
+        "esp-nn",
+#else
+        "reference",
+#endif
+        (float)tflm_us / BENCH_ITERATIONS);
+    ei_free(layer);
+}
+
+/**
+* @brief      Arduino setup function
+*/
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial);
+    ei_printf("Fully connected kernels, %d iterations\n", BENCH_ITERATIONS);
+}
+
+/**
+* @brief      Arduino main function. Runs the benchmark every 5 seconds.
+*/
+void loop()
+{
+    bench_fc<39, 20, kTfLiteActRelu>("39x20 relu");
+    bench_fc<20, 10, kTfLiteActRelu>("20x10 relu");
+    bench_fc<10, 3, kTfLiteActNone>("10x3 none");
+    ei_printf("\n");
+    delay(5000);
+}
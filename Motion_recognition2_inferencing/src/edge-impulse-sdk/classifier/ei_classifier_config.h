@@ -20,6 +20,13 @@
 
 // clang-format off
 
+// Project settings, ahead of the defaults below (see ei_project_config.h next to model-parameters)
+#ifdef __has_include
+    #if __has_include("ei_project_config.h")
+    #include "ei_project_config.h"
+    #endif
+#endif
+
 // This is a file that's only used in benchmarking to override HW optimized kernels
 #ifdef __has_include
     #if __has_include("source/benchmark.h")
@@ -86,6 +93,28 @@
     #define ESP_NN                                  1
 #endif
 
+// Keep EON compiled models initialized between inferences (arena and prepared op data stay alive),
+// instead of running init/prepare and reset around every window. Costs the arena for the lifetime
+// of the program, call run_classifier_deinit() to release it.
+#ifndef EI_CLASSIFIER_PERSISTENT_MODEL
+#if defined(EIDSP_STATIC_WORKSPACE) && EIDSP_STATIC_WORKSPACE == 1
+#define EI_CLASSIFIER_PERSISTENT_MODEL              1 // no arena allocation per window either
+#else
+#define EI_CLASSIFIER_PERSISTENT_MODEL              0
+#endif
+#endif // EI_CLASSIFIER_PERSISTENT_MODEL
+
+#ifndef EI_CLASSIFIER_MAX_PERSISTENT_MODELS
+#define EI_CLASSIFIER_MAX_PERSISTENT_MODELS         4
+#endif // EI_CLASSIFIER_MAX_PERSISTENT_MODELS
+
+// Let run_classifier quantize the features of a spectral analysis block straight into the
+// input tensor of an int8 EON model, instead of writing a float feature matrix that
+// fill_input_tensor_from_matrix quantizes in a second pass. Results are the same.
+#ifndef EI_CLASSIFIER_FUSED_DSP_INPUT
+#define EI_CLASSIFIER_FUSED_DSP_INPUT               0
+#endif // EI_CLASSIFIER_FUSED_DSP_INPUT
+
 // no include checks in the compiler? then just include metadata and then ops_define (optional if on EON model)
 #ifndef __has_include
     #include "model-parameters/model_metadata.h"
@@ -21,21 +21,35 @@
 #if EI_CLASSIFIER_OBJECT_DETECTION != 1
 
 #include <stdint.h>
+#include <string.h>
 
 typedef struct ei_classifier_smooth {
-    int *last_readings;
+    int *last_readings;             // ring buffer, the oldest reading is at last_readings_head
     size_t last_readings_size;
-    uint8_t min_readings_same;
+    size_t last_readings_head;
+    uint16_t min_readings_same;
     float classifier_confidence;
     float anomaly_confidence;
-    uint8_t count[EI_CLASSIFIER_LABEL_COUNT + 2] = { 0 };
+    uint16_t count[EI_CLASSIFIER_LABEL_COUNT + 2] = { 0 }; // readings per label, uncertain, anomaly
     size_t count_size = EI_CLASSIFIER_LABEL_COUNT + 2;
 } ei_classifier_smooth_t;
 
+/**
+ * Slot in the count array for a reading (label index, -1 uncertain, -2 anomaly)
+ */
+static inline size_t ei_classifier_smooth_count_ix(int reading) {
+    if (reading >= 0) {
+        return (size_t)reading;
+    }
+    return reading == -2 ? EI_CLASSIFIER_LABEL_COUNT + 1 : EI_CLASSIFIER_LABEL_COUNT;
+}
+
 /**
  * Initialize a smooth structure. This is useful if you don't want to trust
  * single readings, but rather want consensus
  * (e.g. 7 / 10 readings should be the same before I draw any ML conclusions).
+ * Updates take the same time whatever the number of readings, so long histories
+ * (e.g. 600 readings for a 10 minute consensus) are fine, up to 65535 readings.
  * This allocates memory on the heap!
  * @param smooth Pointer to an uninitialized ei_classifier_smooth_t struct
  * @param n_readings Number of readings you want to store
@@ -44,36 +58,34 @@ typedef struct ei_classifier_smooth {
  * @param anomaly_confidence Maximum error for anomalies (default 0.3)
  */
 void ei_classifier_smooth_init(ei_classifier_smooth_t *smooth, size_t n_readings,
-                               uint8_t min_readings_same, float classifier_confidence = 0.8,
+                               uint16_t min_readings_same, float classifier_confidence = 0.8,
                                float anomaly_confidence = 0.3) {
     smooth->last_readings = (int*)ei_malloc(n_readings * sizeof(int));
     for (size_t ix = 0; ix < n_readings; ix++) {
         smooth->last_readings[ix] = -1; // -1 == uncertain
     }
     smooth->last_readings_size = n_readings;
+    smooth->last_readings_head = 0;
     smooth->min_readings_same = min_readings_same;
     smooth->classifier_confidence = classifier_confidence;
     smooth->anomaly_confidence = anomaly_confidence;
     smooth->count_size = EI_CLASSIFIER_LABEL_COUNT + 2;
+
+    // the history starts out as all uncertain
+    memset(smooth->count, 0, sizeof(smooth->count));
+    smooth->count[EI_CLASSIFIER_LABEL_COUNT] = (uint16_t)n_readings;
 }
 
 /**
- * Call when a new reading comes in.
+ * Call when a new reading comes in. The newest reading replaces the oldest one
+ * in the ring buffer and the counts are updated for just those two.
  * @param smooth Pointer to an initialized ei_classifier_smooth_t struct
  * @param result Pointer to a result structure (after calling ei_run_classifier)
  * @returns Label, either 'uncertain', 'anomaly', or a label from the result struct
  */
 const char* ei_classifier_smooth_update(ei_classifier_smooth_t *smooth, ei_impulse_result_t *result) {
-    // clear out the count array
-    memset(smooth->count, 0, EI_CLASSIFIER_LABEL_COUNT + 2);
-
-    // roll through the last_readings buffer
-    numpy::roll(smooth->last_readings, smooth->last_readings_size, -1);
-
     int reading = -1; // uncertain
 
-    // print the predictions
-    // printf("[");
     for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
         if (result->classification[ix].value >= smooth->classifier_confidence) {
             reading = (int)ix;
@@ -85,26 +97,23 @@ const char* ei_classifier_smooth_update(ei_classifier_smooth_t *smooth, ei_impul
     }
 #endif
 
-    smooth->last_readings[smooth->last_readings_size - 1] = reading;
+    if (smooth->last_readings_size > 0) {
+        int *oldest = &smooth->last_readings[smooth->last_readings_head];
+        smooth->count[ei_classifier_smooth_count_ix(*oldest)]--;
+        smooth->count[ei_classifier_smooth_count_ix(reading)]++;
+        *oldest = reading;
 
-    // now count last 10 readings and see what we actually see...
-    for (size_t ix = 0; ix < smooth->last_readings_size; ix++) {
-        if (smooth->last_readings[ix] >= 0) {
-            smooth->count[smooth->last_readings[ix]]++;
-        }
-        else if (smooth->last_readings[ix] == -1) { // uncertain
-            smooth->count[EI_CLASSIFIER_LABEL_COUNT]++;
-        }
-        else if (smooth->last_readings[ix] == -2) { // anomaly
-            smooth->count[EI_CLASSIFIER_LABEL_COUNT + 1]++;
+        smooth->last_readings_head++;
+        if (smooth->last_readings_head == smooth->last_readings_size) {
+            smooth->last_readings_head = 0;
         }
     }
 
     // then loop over the count and see which is highest
-    uint8_t top_result = 0;
-    uint8_t top_count = 0;
+    size_t top_result = 0;
+    uint16_t top_count = 0;
     bool met_confidence_threshold = false;
-    uint8_t confidence_threshold = smooth->min_readings_same; // XX% of windows should be the same
+    uint16_t confidence_threshold = smooth->min_readings_same; // XX% of windows should be the same
     for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT + 2; ix++) {
         if (smooth->count[ix] > top_count) {
             top_result = ix;
@@ -57,6 +57,8 @@ typedef struct {
     int64_t dsp_us;
     int64_t classification_us;
     int64_t anomaly_us;
+    int64_t classification_setup_us; // model init/prepare time spent in this inference
+    int64_t classification_setup_saved_us; // init/prepare time skipped because the model was kept warm
 } ei_impulse_result_timing_t;
 
 typedef struct {
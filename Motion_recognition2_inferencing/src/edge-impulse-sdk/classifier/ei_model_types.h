@@ -29,6 +29,10 @@
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #endif // EI_CLASSIFIER_USE_FULL_TFLITE
 
+namespace tflite {
+class MicroProfilerInterface;
+}
+
 #define EI_CLASSIFIER_NONE                       255
 #define EI_CLASSIFIER_UTENSOR                    1
 #define EI_CLASSIFIER_TFLITE                     2
@@ -152,6 +156,8 @@ typedef struct {
     TfLiteStatus (*model_reset)(void (*free)(void* ptr));
     TfLiteStatus (*model_input)(int, TfLiteTensor*);
     TfLiteStatus (*model_output)(int, TfLiteTensor*);
+    void (*model_set_profiler)(tflite::MicroProfilerInterface*); // optional, per node profiler events
+    TfLiteStatus (*model_invoke_batch)(const int8_t*, int8_t*, size_t); // optional, int8 models: n input rows to n output rows
 } ei_config_tflite_eon_graph_t;
 
 typedef struct {
@@ -29,6 +29,7 @@
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "edge-impulse-sdk/porting/ei_logging.h"
 #include <memory>
+#include <new>
 
 #if EI_CLASSIFIER_HAS_ANOMALY
 #include "inferencing_engines/anomaly.h"
@@ -86,11 +87,240 @@ EI_IMPULSE_ERROR ei_unscale_fmatrix(ei_learning_block_t *block, ei::matrix_t *fm
 static uint64_t classifier_continuous_features_written = 0;
 static RecognizeEvents *avg_scores = NULL;
 
+/* Raw data window for continuous DSP blocks that have no per-slice extractor (spectral analysis) */
+static float *classifier_continuous_window = NULL;
+static size_t classifier_continuous_window_filled = 0;
+/* Running mean / RMS / skewness / kurtosis of every raw axis in that window */
+static spectral::running_moments *classifier_continuous_moments = NULL;
+/* Sliding DFT Welch max-hold of every raw axis, with EIDSP_SPECTRAL_SLIDING_DFT and an FFT spectral block */
+static spectral::sliding_welch *classifier_continuous_welch = NULL;
+/* Number of engines in both arrays above (raw samples per frame) */
+static size_t classifier_continuous_axes = 0;
+
 /* Private functions ------------------------------------------------------- */
 
 /* These functions (up to Public functions section) are not exposed to end-user,
 therefore changes are allowed. */
 
+/**
+ * @brief      Free the raw data window and the running state kept over it
+ */
+static void free_continuous_window(void)
+{
+    ei_free(classifier_continuous_window);
+    classifier_continuous_window = NULL;
+    // both arrays come from ei_calloc and are constructed in place, see push_continuous_window
+    for (size_t axis = 0; classifier_continuous_moments && axis < classifier_continuous_axes; axis++) {
+        classifier_continuous_moments[axis].~running_moments();
+    }
+    ei_free(classifier_continuous_moments);
+    classifier_continuous_moments = NULL;
+    for (size_t axis = 0; classifier_continuous_welch && axis < classifier_continuous_axes; axis++) {
+        classifier_continuous_welch[axis].~sliding_welch();
+    }
+    ei_free(classifier_continuous_welch);
+    classifier_continuous_welch = NULL;
+    classifier_continuous_axes = 0;
+}
+
+/**
+ * @brief      Find the first spectral analysis block that uses the sliding DFT
+ *             (EIDSP_SPECTRAL_SLIDING_DFT, analysis type FFT)
+ *
+ * @param      impulse  struct with information about model and DSP
+ *
+ * @return     Its config, or NULL if there is none.
+ */
+static ei_dsp_config_spectral_analysis_t *find_sliding_dft_config(const ei_impulse_t *impulse)
+{
+#if EIDSP_SPECTRAL_SLIDING_DFT == 1
+    for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+        if (impulse->dsp_blocks[ix].extract_fn != extract_spectral_analysis_features) {
+            continue;
+        }
+        ei_dsp_config_spectral_analysis_t *config =
+            (ei_dsp_config_spectral_analysis_t *)impulse->dsp_blocks[ix].config;
+        if (strcmp(config->analysis_type, "FFT") == 0) {
+            return config;
+        }
+    }
+#endif // EIDSP_SPECTRAL_SLIDING_DFT == 1
+    return NULL;
+}
+
+/**
+ * @brief      Shift a new slice into the raw data window, dropping the oldest samples
+ *
+ * @param      impulse  struct with information about model and DSP
+ * @param      signal   Slice of sample data
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR push_continuous_window(const ei_impulse_t *impulse, signal_t *signal)
+{
+    const size_t window_size = impulse->dsp_input_frame_size;
+
+    const size_t axes = impulse->raw_samples_per_frame;
+
+    if (!classifier_continuous_window) {
+        classifier_continuous_window = (float*)ei_calloc(window_size, sizeof(float));
+        if (!classifier_continuous_window) {
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
+        classifier_continuous_window_filled = 0;
+        classifier_continuous_axes = axes;
+
+        classifier_continuous_moments = (spectral::running_moments*)ei_calloc(axes, sizeof(spectral::running_moments));
+        if (!classifier_continuous_moments) {
+            free_continuous_window();
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
+        for (size_t axis = 0; axis < axes; axis++) {
+            new (&classifier_continuous_moments[axis]) spectral::running_moments();
+        }
+
+        // one engine per raw axis, shared by all blocks with the same FFT settings
+        ei_dsp_config_spectral_analysis_t *sliding_config = find_sliding_dft_config(impulse);
+        if (sliding_config) {
+            classifier_continuous_welch = (spectral::sliding_welch*)ei_calloc(axes, sizeof(spectral::sliding_welch));
+            if (!classifier_continuous_welch) {
+                free_continuous_window();
+                return EI_IMPULSE_ALLOC_FAILED;
+            }
+            for (size_t axis = 0; axis < axes; axis++) {
+                new (&classifier_continuous_welch[axis]) spectral::sliding_welch();
+            }
+            for (size_t axis = 0; axis < axes; axis++) {
+                if (classifier_continuous_welch[axis].init(
+                        window_size / axes,
+                        sliding_config->fft_length,
+                        sliding_config->do_fft_overlap) != EIDSP_OK) {
+                    // start over on the next slice instead of pushing into half set up engines
+                    free_continuous_window();
+                    return EI_IMPULSE_ALLOC_FAILED;
+                }
+            }
+        }
+    }
+    if (classifier_continuous_window_filled == 0) {
+        for (size_t axis = 0; axis < axes; axis++) {
+            classifier_continuous_moments[axis].reset();
+            if (classifier_continuous_welch) {
+                classifier_continuous_welch[axis].reset();
+            }
+        }
+    }
+
+    size_t offset = 0;
+    size_t length = signal->total_length;
+    if (length > window_size) {
+        offset = length - window_size;
+        length = window_size;
+    }
+
+    // samples leaving the window (the zero padding in front was never added)
+    size_t first_real = window_size - classifier_continuous_window_filled;
+    for (size_t ix = first_real; ix < length; ix++) {
+        classifier_continuous_moments[ix % axes].evict(classifier_continuous_window[ix]);
+    }
+
+    memmove(classifier_continuous_window,
+            classifier_continuous_window + length,
+            (window_size - length) * sizeof(float));
+    if (signal->get_data(offset, length, classifier_continuous_window + (window_size - length)) != 0) {
+        // the moments no longer match the window, start over with the next slice
+        classifier_continuous_window_filled = 0;
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    for (size_t ix = window_size - length; ix < window_size; ix++) {
+        classifier_continuous_moments[ix % axes].add(classifier_continuous_window[ix]);
+        if (classifier_continuous_welch) {
+            classifier_continuous_welch[ix % axes].push(classifier_continuous_window[ix]);
+        }
+    }
+
+    classifier_continuous_window_filled += length;
+    if (classifier_continuous_window_filled > window_size) {
+        classifier_continuous_window_filled = window_size;
+    }
+
+    // bound the rounding error of the add / evict pairs
+    if (classifier_continuous_window_filled == window_size) {
+        for (size_t axis = 0; axis < axes; axis++) {
+            if (classifier_continuous_moments[axis].needs_rebase()) {
+                classifier_continuous_moments[axis].rebase(classifier_continuous_window + axis, window_size / axes, axes);
+            }
+        }
+    }
+
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Run a spectral analysis block over the raw data window, once a complete window was collected
+ *
+ * @param      impulse           struct with information about model and DSP
+ * @param      block             DSP block
+ * @param      fm                Output features
+ * @param      features_written  Number of features written (0 while the window is still filling up)
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR extract_continuous_window_features(
+    const ei_impulse_t *impulse,
+    ei_model_dsp_t *block,
+    ei::matrix_t *fm,
+    matrix_size_t *features_written)
+{
+    features_written->rows = 0;
+    features_written->cols = 0;
+
+    if (classifier_continuous_window_filled < impulse->dsp_input_frame_size) {
+        return EI_IMPULSE_OK;
+    }
+
+#if EIDSP_STATIC_WORKSPACE == 1
+    ei::workspace::scope dsp_workspace;
+#endif
+
+    signal_t window_signal;
+    numpy::signal_from_buffer(classifier_continuous_window, impulse->dsp_input_frame_size, &window_signal);
+
+    // running moments in the order of the axes this block uses
+    ei_vector<const spectral::running_moments*> block_moments(block->axes_size);
+    ei_vector<const spectral::sliding_welch*> block_welch(block->axes_size);
+    for (size_t ix = 0; ix < block->axes_size; ix++) {
+#if EIDSP_SIGNAL_C_FN_POINTER
+        size_t axis = ix;
+#else
+        size_t axis = block->axes[ix];
+#endif
+        block_moments[ix] = &classifier_continuous_moments[axis];
+        block_welch[ix] = classifier_continuous_welch ? &classifier_continuous_welch[axis] : NULL;
+    }
+
+    // other analysis types (and FFT blocks with other settings) recompute the spectrum over the window
+    ei_dsp_config_spectral_analysis_t *config = (ei_dsp_config_spectral_analysis_t *)block->config;
+    const spectral::sliding_welch *const *welch =
+        strcmp(config->analysis_type, "FFT") == 0 ? block_welch.data() : NULL;
+
+#if EIDSP_SIGNAL_C_FN_POINTER
+    int ret = extract_spectral_analysis_features_with_moments(&window_signal, fm, block->config, impulse->frequency, block_moments.data(), welch);
+#else
+    SignalWithAxes swa(&window_signal, block->axes, block->axes_size, impulse);
+    int ret = extract_spectral_analysis_features_with_moments(swa.get_signal(), fm, block->config, impulse->frequency, block_moments.data(), welch);
+#endif
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    features_written->rows = fm->rows;
+    features_written->cols = fm->cols;
+    return EI_IMPULSE_OK;
+}
+
 
 /**
  * @brief      Display the results of the inference
@@ -196,6 +426,160 @@ extern "C" EI_IMPULSE_ERROR run_inference(
     return EI_IMPULSE_OK;
 }
 
+/**
+ * @brief      Run one DSP block of the impulse over a window
+ *
+ * @param      handle   Handle from open_impulse
+ * @param      ix       Index of the DSP block
+ * @param      signal   Sample data
+ * @param      output   Features, n_output_features of the block
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR run_dsp_block(ei_impulse_handle_t *handle,
+                                      size_t ix,
+                                      signal_t *signal,
+                                      ei::matrix_t *output)
+{
+    ei_model_dsp_t block = handle->impulse->dsp_blocks[ix];
+
+#if EIDSP_SIGNAL_C_FN_POINTER
+    if (block.axes_size != handle->impulse->raw_samples_per_frame) {
+        ei_printf("ERR: EIDSP_SIGNAL_C_FN_POINTER can only be used when all axes are selected for DSP blocks\n");
+        return EI_IMPULSE_DSP_ERROR;
+    }
+    auto internal_signal = signal;
+#else
+    SignalWithAxes swa(signal, block.axes, block.axes_size, handle->impulse);
+    auto internal_signal = swa.get_signal();
+#endif
+
+    int ret;
+    if (block.factory) { // ie, if we're using state
+        // Msg user
+        static bool has_printed = false;
+        if (!has_printed) {
+            EI_LOGI("Impulse maintains state. Call run_classifier_init() to reset state (e.g. if data stream is interrupted.)\n");
+            has_printed = true;
+        }
+
+        // getter has a lazy init, so we can just call it
+#if EIDSP_STATIC_WORKSPACE == 1
+        // the handle outlives this window, keep it out of the workspace
+        DspHandle *dsp_handle;
+        {
+            ei::workspace::suspend keep_state_on_heap;
+            dsp_handle = handle->state.get_dsp_handle(ix);
+        }
+#else
+        auto dsp_handle = handle->state.get_dsp_handle(ix);
+#endif
+        if(dsp_handle) {
+            ret = dsp_handle->extract(internal_signal, output, block.config, handle->impulse->frequency);
+        } else {
+            return EI_IMPULSE_OUT_OF_MEMORY;
+        }
+    } else {
+        ret = block.extract_fn(internal_signal, output, block.config, handle->impulse->frequency);
+    }
+
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+        return EI_IMPULSE_CANCELED;
+    }
+
+    return EI_IMPULSE_OK;
+}
+
+#if EI_CLASSIFIER_FUSED_DSP_INPUT == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+/* Window handed to write_fused_dsp_input */
+typedef struct {
+    ei_impulse_handle_t *handle;
+    signal_t *signal;
+    ei_impulse_result_t *result;
+} fused_dsp_input_t;
+
+/**
+ * @brief      Whether the DSP block can write the model input directly: one stateless
+ *             spectral analysis block (with int8 output support) feeding one int8
+ *             EON learning block
+ *
+ * @param      impulse  struct with information about model and DSP
+ */
+static bool can_run_fused_dsp_input(const ei_impulse_t *impulse)
+{
+    if (impulse->dsp_blocks_size != 1 || impulse->learning_blocks_size != 1) {
+        return false;
+    }
+    const ei_model_dsp_t *dsp_block = &impulse->dsp_blocks[0];
+    const ei_learning_block_t *learning_block = &impulse->learning_blocks[0];
+    return dsp_block->extract_fn == extract_spectral_analysis_features &&
+        dsp_block->factory == nullptr &&
+        dsp_block->n_output_features == impulse->nn_input_frame_size &&
+        spectral::feature::supports_quantized_output((ei_dsp_config_spectral_analysis_t *)dsp_block->config) &&
+        can_run_nn_inference_from_quantized_writer(learning_block) &&
+        learning_block->input_block_ids[0] == dsp_block->blockId;
+}
+
+/**
+ * @brief      Run the DSP block straight into the input tensor (ei_nn_quantized_writer_t)
+ *
+ * @param      ctx  fused_dsp_input_t
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR write_fused_dsp_input(void *ctx, int8_t *input, size_t input_size, float scale, int32_t zero_point)
+{
+    fused_dsp_input_t *fused = (fused_dsp_input_t *)ctx;
+    const ei_impulse_t *impulse = fused->handle->impulse;
+    ei_model_dsp_t block = impulse->dsp_blocks[0];
+
+    EI_PROFILE_SCOPE("dsp");
+    uint64_t dsp_start_us = ei_read_timer_us();
+
+    if (input_size != block.n_output_features) {
+        ei_printf("ERR: input tensor has size %d bytes, but the DSP block has %d features\n",
+            (int)input_size, (int)block.n_output_features);
+        return EI_IMPULSE_INVALID_SIZE;
+    }
+
+#if EIDSP_STATIC_WORKSPACE == 1
+    ei::workspace::scope dsp_workspace;
+#endif
+
+#if EIDSP_SIGNAL_C_FN_POINTER
+    if (block.axes_size != impulse->raw_samples_per_frame) {
+        ei_printf("ERR: EIDSP_SIGNAL_C_FN_POINTER can only be used when all axes are selected for DSP blocks\n");
+        return EI_IMPULSE_DSP_ERROR;
+    }
+    auto internal_signal = fused->signal;
+#else
+    SignalWithAxes swa(fused->signal, block.axes, block.axes_size, impulse);
+    auto internal_signal = swa.get_signal();
+#endif
+
+    spectral::quantized_features_t features = { input, input_size, scale, zero_point };
+    int ret = extract_spectral_analysis_features_quantized(internal_signal, &features, block.config, impulse->frequency);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
+        return EI_IMPULSE_DSP_ERROR;
+    }
+
+    fused->result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+    fused->result->timing.dsp = (int)(fused->result->timing.dsp_us / 1000);
+
+    if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+        return EI_IMPULSE_CANCELED;
+    }
+
+    return EI_IMPULSE_OK;
+}
+#endif // EI_CLASSIFIER_FUSED_DSP_INPUT == 1
+
 /**
  * @brief      Process a complete impulse
  *
@@ -225,73 +609,69 @@ extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
 #endif
 
     memset(result, 0, sizeof(ei_impulse_result_t));
+
+#if EI_CLASSIFIER_FUSED_DSP_INPUT == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    // no float feature matrix at all, debug output still prints the float features
+    if (!debug && can_run_fused_dsp_input(handle->impulse)) {
+        fused_dsp_input_t fused = { handle, signal, result };
+        return run_nn_inference_from_quantized_writer(handle->impulse, &write_fused_dsp_input, &fused,
+            result, handle->impulse->learning_blocks[0].config, debug);
+    }
+#endif
+
     uint32_t block_num = handle->impulse->dsp_blocks_size + handle->impulse->learning_blocks_size;
 
+#if EIDSP_STATIC_WORKSPACE == 1
+    // features are allocated on the first window and reused afterwards,
+    // DSP scratch memory comes from the static workspace
+    static const ei_impulse_t *features_impulse = nullptr;
+    static std::unique_ptr<ei_feature_t[]> features_ptr;
+    static std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> matrix_ptrs_ptr;
+    if (features_impulse != handle->impulse) {
+        features_ptr.reset(new ei_feature_t[block_num]);
+        matrix_ptrs_ptr.reset(new std::unique_ptr<ei::matrix_t>[block_num]);
+        features_impulse = handle->impulse;
+    }
+#else
     // smart pointer to features array
     std::unique_ptr<ei_feature_t[]> features_ptr(new ei_feature_t[block_num]);
-    ei_feature_t* features = features_ptr.get();
-    memset(features, 0, sizeof(ei_feature_t) * block_num);
 
     // have it outside of the loop to avoid going out of scope
-    std::unique_ptr<ei::matrix_t> *matrix_ptrs = new std::unique_ptr<ei::matrix_t>[block_num];
+    std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> matrix_ptrs_ptr(new std::unique_ptr<ei::matrix_t>[block_num]);
+#endif // EIDSP_STATIC_WORKSPACE == 1
+    ei_feature_t* features = features_ptr.get();
+    memset(features, 0, sizeof(ei_feature_t) * block_num);
+    std::unique_ptr<ei::matrix_t> *matrix_ptrs = matrix_ptrs_ptr.get();
 
     uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
 
     for (size_t ix = 0; ix < handle->impulse->dsp_blocks_size; ix++) {
+        EI_PROFILE_SCOPE("dsp");
         ei_model_dsp_t block = handle->impulse->dsp_blocks[ix];
+#if EIDSP_STATIC_WORKSPACE == 1
+        if (matrix_ptrs[ix]) {
+            memset(matrix_ptrs[ix]->buffer, 0, block.n_output_features * sizeof(float));
+        }
+        else
+#endif
         matrix_ptrs[ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(1, block.n_output_features));
         features[ix].matrix = matrix_ptrs[ix].get();
         features[ix].blockId = block.blockId;
 
+#if EIDSP_STATIC_WORKSPACE == 1
+        ei::workspace::scope dsp_workspace;
+#endif
+
         if (out_features_index + block.n_output_features > handle->impulse->nn_input_frame_size) {
             ei_printf("ERR: Would write outside feature buffer\n");
-            delete[] matrix_ptrs;
-            return EI_IMPULSE_DSP_ERROR;
-        }
-
-#if EIDSP_SIGNAL_C_FN_POINTER
-        if (block.axes_size != handle->impulse->raw_samples_per_frame) {
-            ei_printf("ERR: EIDSP_SIGNAL_C_FN_POINTER can only be used when all axes are selected for DSP blocks\n");
-            delete[] matrix_ptrs;
             return EI_IMPULSE_DSP_ERROR;
         }
-        auto internal_signal = signal;
-#else
-        SignalWithAxes swa(signal, block.axes, block.axes_size, handle->impulse);
-        auto internal_signal = swa.get_signal();
-#endif
-
-        int ret;
-        if (block.factory) { // ie, if we're using state
-            // Msg user
-            static bool has_printed = false;
-            if (!has_printed) {
-                EI_LOGI("Impulse maintains state. Call run_classifier_init() to reset state (e.g. if data stream is interrupted.)\n");
-                has_printed = true;
-            }
-
-            // getter has a lazy init, so we can just call it
-            auto dsp_handle = handle->state.get_dsp_handle(ix);
-            if(dsp_handle) {
-                ret = dsp_handle->extract(internal_signal, features[ix].matrix, block.config, handle->impulse->frequency);
-            } else {
-                return EI_IMPULSE_OUT_OF_MEMORY;
-            }
-        } else {
-            ret = block.extract_fn(internal_signal, features[ix].matrix, block.config, handle->impulse->frequency);
-        }
 
-        if (ret != EIDSP_OK) {
-            ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
-            delete[] matrix_ptrs;
-            return EI_IMPULSE_DSP_ERROR;
-        }
-
-        if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
-            delete[] matrix_ptrs;
-            return EI_IMPULSE_CANCELED;
+        EI_IMPULSE_ERROR dsp_res = run_dsp_block(handle, ix, signal, features[ix].matrix);
+        if (dsp_res != EI_IMPULSE_OK) {
+            return dsp_res;
         }
 
         out_features_index += block.n_output_features;
@@ -302,6 +682,9 @@ extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
         ei_learning_block_t block = handle->impulse->learning_blocks[ix];
 
         if (block.keep_output) {
+#if EIDSP_STATIC_WORKSPACE == 1
+            if (!matrix_ptrs[handle->impulse->dsp_blocks_size + ix])
+#endif
             matrix_ptrs[handle->impulse->dsp_blocks_size + ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(1, block.output_features_count));
             features[handle->impulse->dsp_blocks_size + ix].matrix = matrix_ptrs[handle->impulse->dsp_blocks_size + ix].get();
             features[handle->impulse->dsp_blocks_size + ix].blockId = block.blockId;
@@ -330,9 +713,115 @@ extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
         ei_printf("Running impulse...\n");
     }
 
-    EI_IMPULSE_ERROR res = run_inference(handle, features, result, debug);
-    delete[] matrix_ptrs;
-    return res;
+    return run_inference(handle, features, result, debug);
+}
+
+/**
+ * @brief      Process a batch of complete windows. The DSP blocks run per window
+ *             into one feature matrix per block (a row per window), the learning
+ *             block then runs once over all rows when it supports batches (EON
+ *             int8 classifiers, see run_nn_inference_batch). Otherwise every
+ *             window goes through process_impulse. Results are identical to
+ *             calling process_impulse once per window.
+ *
+ * @param      handle   Handle from open_impulse
+ * @param      signals  Sample data, one signal per window
+ * @param      n        Number of windows
+ * @param      results  Output classifier results, n entries
+ * @param[in]  debug    Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR process_impulse_batch(ei_impulse_handle_t *handle,
+                                                  signal_t *signals,
+                                                  size_t n,
+                                                  ei_impulse_result_t *results,
+                                                  bool debug = false)
+{
+    if (!handle) {
+        return EI_IMPULSE_INFERENCE_ERROR;
+    }
+
+    const ei_impulse_t *impulse = handle->impulse;
+    bool batched = false;
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    batched = impulse->learning_blocks_size == 1 && can_run_nn_inference_batch(&impulse->learning_blocks[0]);
+#endif
+#if (EI_CLASSIFIER_QUANTIZATION_ENABLED == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TENSAIFLOW || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ONNX_TIDL)) || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_DRPAI
+    if (can_run_classifier_image_quantized(impulse, impulse->learning_blocks[0]) == EI_IMPULSE_OK) {
+        batched = false;
+    }
+#endif
+
+    if (!batched) {
+        for (size_t w = 0; w < n; w++) {
+            EI_IMPULSE_ERROR res = process_impulse(handle, &signals[w], &results[w], debug);
+            if (res != EI_IMPULSE_OK) {
+                return res;
+            }
+        }
+        return EI_IMPULSE_OK;
+    }
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    if (n == 0) {
+        return EI_IMPULSE_OK;
+    }
+
+    memset(results, 0, sizeof(ei_impulse_result_t) * n);
+    uint32_t block_num = impulse->dsp_blocks_size + impulse->learning_blocks_size;
+
+    std::unique_ptr<ei_feature_t[]> features_ptr(new ei_feature_t[block_num]);
+    std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> matrix_ptrs(new std::unique_ptr<ei::matrix_t>[block_num]);
+    ei_feature_t *features = features_ptr.get();
+    memset(features, 0, sizeof(ei_feature_t) * block_num);
+
+    size_t out_features_index = 0;
+    for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+        ei_model_dsp_t block = impulse->dsp_blocks[ix];
+        if (out_features_index + block.n_output_features > impulse->nn_input_frame_size) {
+            ei_printf("ERR: Would write outside feature buffer\n");
+            return EI_IMPULSE_DSP_ERROR;
+        }
+        matrix_ptrs[ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(n, block.n_output_features));
+        if (!matrix_ptrs[ix]->buffer) {
+            return EI_IMPULSE_OUT_OF_MEMORY;
+        }
+        features[ix].matrix = matrix_ptrs[ix].get();
+        features[ix].blockId = block.blockId;
+        out_features_index += block.n_output_features;
+    }
+
+    for (size_t w = 0; w < n; w++) {
+        uint64_t dsp_start_us = ei_read_timer_us();
+        for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+            EI_PROFILE_SCOPE("dsp");
+            ei::matrix_t *batch = features[ix].matrix;
+            ei::matrix_t row(1, batch->cols, batch->buffer + w * batch->cols);
+
+#if EIDSP_STATIC_WORKSPACE == 1
+            ei::workspace::scope dsp_workspace;
+#endif
+
+            EI_IMPULSE_ERROR dsp_res = run_dsp_block(handle, ix, &signals[w], &row);
+            if (dsp_res != EI_IMPULSE_OK) {
+                return dsp_res;
+            }
+        }
+        results[w].timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+        results[w].timing.dsp = (int)(results[w].timing.dsp_us / 1000);
+    }
+
+    if (debug) {
+        ei_printf("Running impulse over %d windows...\n", (int)n);
+    }
+
+    ei_learning_block_t block = impulse->learning_blocks[0];
+    return run_nn_inference_batch(impulse, features, n, 0, (uint32_t*)block.input_block_ids,
+        block.input_block_ids_size, results, block.config, debug);
+#else
+    return EI_IMPULSE_OK;
+#endif
 }
 
 /**
@@ -351,36 +840,41 @@ extern "C" EI_IMPULSE_ERROR init_impulse(ei_impulse_handle_t *handle) {
 }
 
 /**
- * @brief      Process a complete impulse for continuous inference
+ * @brief      Run the DSP blocks of the impulse over one slice (continuous mode).
+ *             Pass the same features matrix on every call, slice extractors
+ *             only write the features of the new slice.
  *
- * @param      impulse  struct with information about model and DSP
- * @param      signal   Sample data
- * @param      result   Output classifier results
- * @param[in]  debug    Debug output enable
+ * @param      handle          Impulse handle
+ * @param      signal          Slice of sample data
+ * @param      features        Output features (1 x nn_input_frame_size)
+ * @param      features_ready  Set once a complete window of features was written
+ * @param      result          Only the DSP timing is written
+ * @param[in]  debug           Debug output enable
  *
  * @return     The ei impulse error.
  */
-extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *handle,
+extern "C" EI_IMPULSE_ERROR extract_impulse_features_continuous(ei_impulse_handle_t *handle,
                                             signal_t *signal,
+                                            ei::matrix_t *features,
+                                            bool *features_ready,
                                             ei_impulse_result_t *result,
-                                            bool debug,
-                                            bool enable_maf)
+                                            bool debug)
 {
     auto impulse = handle->impulse;
-    static ei::matrix_t static_features_matrix(1, impulse->nn_input_frame_size);
-    if (!static_features_matrix.buffer) {
-        return EI_IMPULSE_ALLOC_FAILED;
+    *features_ready = false;
+    if (!features->buffer || features->rows * features->cols < impulse->nn_input_frame_size) {
+        return EI_IMPULSE_DSP_ERROR;
     }
 
-    memset(result, 0, sizeof(ei_impulse_result_t));
-
     EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
 
     uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
+    bool window_pushed = false;
 
     for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+        EI_PROFILE_SCOPE("dsp");
         ei_model_dsp_t block = impulse->dsp_blocks[ix];
 
         if (out_features_index + block.n_output_features > impulse->nn_input_frame_size) {
@@ -389,7 +883,37 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
         }
 
         ei::matrix_t fm(1, block.n_output_features,
-                        static_features_matrix.buffer + out_features_index);
+                        features->buffer + out_features_index);
+
+        /* Spectral features are computed over the whole window, slide the raw data instead */
+        if (block.extract_fn == extract_spectral_analysis_features) {
+            if (!window_pushed) {
+                EI_PROFILE_SCOPE("dsp.push");
+                ei_impulse_error = push_continuous_window(impulse, signal);
+                if (ei_impulse_error != EI_IMPULSE_OK) {
+                    return ei_impulse_error;
+                }
+                window_pushed = true;
+            }
+
+            matrix_size_t features_written;
+            ei_impulse_error = extract_continuous_window_features(impulse, &block, &fm, &features_written);
+            if (ei_impulse_error != EI_IMPULSE_OK) {
+                return ei_impulse_error;
+            }
+
+            if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+                return EI_IMPULSE_CANCELED;
+            }
+
+            // count the window once, every following slice reuses the previous samples
+            if (classifier_continuous_features_written < impulse->nn_input_frame_size) {
+                classifier_continuous_features_written += (features_written.rows * features_written.cols);
+            }
+
+            out_features_index += block.n_output_features;
+            continue;
+        }
 
         int (*extract_fn_slice)(ei::signal_t *signal, ei::matrix_t *output_matrix, void *config, const float frequency, matrix_size_t *out_matrix_size);
 
@@ -404,7 +928,7 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
             extract_fn_slice = &extract_mfe_per_slice_features;
         }
         else {
-            ei_printf("ERR: Unknown extract function, only MFCC, MFE and spectrogram supported\n");
+            ei_printf("ERR: Unknown extract function, only MFCC, MFE, spectrogram and spectral analysis supported\n");
             return EI_IMPULSE_DSP_ERROR;
         }
 
@@ -440,112 +964,186 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
 
     if (debug) {
         ei_printf("\r\nFeatures (%d ms.): ", result->timing.dsp);
-        for (size_t ix = 0; ix < static_features_matrix.cols; ix++) {
-            ei_printf_float(static_features_matrix.buffer[ix]);
+        for (size_t ix = 0; ix < features->cols; ix++) {
+            ei_printf_float(features->buffer[ix]);
             ei_printf(" ");
         }
         ei_printf("\n");
     }
 
-    if (classifier_continuous_features_written >= impulse->nn_input_frame_size) {
-        dsp_start_us = ei_read_timer_us();
+    *features_ready = classifier_continuous_features_written >= impulse->nn_input_frame_size;
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Run the learning blocks over a complete window of features (continuous mode)
+ *
+ * @param      handle           Impulse handle
+ * @param      window_features  Features from extract_impulse_features_continuous
+ * @param      result           Output classifier results (DSP timing is added to)
+ * @param[in]  debug            Debug output enable
+ * @param[in]  enable_maf       Enable the moving average filter (performance calibration)
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_inference_continuous(ei_impulse_handle_t *handle,
+                                            const ei::matrix_t *window_features,
+                                            ei_impulse_result_t *result,
+                                            bool debug,
+                                            bool enable_maf)
+{
+    auto impulse = handle->impulse;
+    EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
+
+    uint64_t dsp_start_us = ei_read_timer_us();
 
-        uint32_t block_num = impulse->dsp_blocks_size + impulse->learning_blocks_size;
+    uint32_t block_num = impulse->dsp_blocks_size + impulse->learning_blocks_size;
+
+#if EIDSP_STATIC_WORKSPACE == 1
+    // as in process_impulse: the normalized copies are allocated on the first
+    // window and reused afterwards
+    static const ei_impulse_t *features_impulse = nullptr;
+    static std::unique_ptr<ei_feature_t[]> features_ptr;
+    static std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> matrix_ptrs_ptr;
+    if (features_impulse != impulse) {
+        features_ptr.reset(new ei_feature_t[block_num]);
+        matrix_ptrs_ptr.reset(new std::unique_ptr<ei::matrix_t>[block_num]);
+        features_impulse = impulse;
+    }
+#else
+    // smart pointer to features array
+    std::unique_ptr<ei_feature_t[]> features_ptr(new ei_feature_t[block_num]);
 
-        // smart pointer to features array
-        std::unique_ptr<ei_feature_t[]> features_ptr(new ei_feature_t[block_num]);
-        ei_feature_t* features = features_ptr.get();
-        memset(features, 0, sizeof(ei_feature_t) * block_num);
+    // have it outside of the loop to avoid going out of scope
+    std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> matrix_ptrs_ptr(new std::unique_ptr<ei::matrix_t>[block_num]);
+#endif // EIDSP_STATIC_WORKSPACE == 1
+    ei_feature_t* features = features_ptr.get();
+    memset(features, 0, sizeof(ei_feature_t) * block_num);
+    std::unique_ptr<ei::matrix_t> *matrix_ptrs = matrix_ptrs_ptr.get();
 
-        // have it outside of the loop to avoid going out of scope
-        std::unique_ptr<ei::matrix_t> *matrix_ptrs = new std::unique_ptr<ei::matrix_t>[block_num];
+    size_t out_features_index = 0;
+    // iterate over every dsp block and run normalization
+    for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+        ei_model_dsp_t block = impulse->dsp_blocks[ix];
+#if EIDSP_STATIC_WORKSPACE == 1
+        if (!matrix_ptrs[ix])
+#endif
+        matrix_ptrs[ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(1, block.n_output_features));
+        features[ix].matrix = matrix_ptrs[ix].get();
+        features[ix].blockId = block.blockId;
 
-        out_features_index = 0;
-        // iterate over every dsp block and run normalization
-        for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
-            ei_model_dsp_t block = impulse->dsp_blocks[ix];
-            matrix_ptrs[ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(1, block.n_output_features));
-            features[ix].matrix = matrix_ptrs[ix].get();
-            features[ix].blockId = block.blockId;
-
-            /* Create a copy of the matrix for normalization */
-            for (size_t m_ix = 0; m_ix < block.n_output_features; m_ix++) {
-                features[ix].matrix->buffer[m_ix] = static_features_matrix.buffer[out_features_index + m_ix];
-            }
+        /* Create a copy of the matrix for normalization */
+        for (size_t m_ix = 0; m_ix < block.n_output_features; m_ix++) {
+            features[ix].matrix->buffer[m_ix] = window_features->buffer[out_features_index + m_ix];
+        }
 
-            if (block.extract_fn == extract_mfcc_features) {
-                calc_cepstral_mean_and_var_normalization_mfcc(features[ix].matrix, block.config);
-            }
-            else if (block.extract_fn == extract_spectrogram_features) {
-                calc_cepstral_mean_and_var_normalization_spectrogram(features[ix].matrix, block.config);
-            }
-            else if (block.extract_fn == extract_mfe_features) {
-                calc_cepstral_mean_and_var_normalization_mfe(features[ix].matrix, block.config);
-            }
-            out_features_index += block.n_output_features;
+        if (block.extract_fn == extract_mfcc_features) {
+            calc_cepstral_mean_and_var_normalization_mfcc(features[ix].matrix, block.config);
+        }
+        else if (block.extract_fn == extract_spectrogram_features) {
+            calc_cepstral_mean_and_var_normalization_spectrogram(features[ix].matrix, block.config);
         }
+        else if (block.extract_fn == extract_mfe_features) {
+            calc_cepstral_mean_and_var_normalization_mfe(features[ix].matrix, block.config);
+        }
+        out_features_index += block.n_output_features;
+    }
 
-        result->timing.dsp_us += ei_read_timer_us() - dsp_start_us;
-        result->timing.dsp = (int)(result->timing.dsp_us / 1000);
+    result->timing.dsp_us += ei_read_timer_us() - dsp_start_us;
+    result->timing.dsp = (int)(result->timing.dsp_us / 1000);
 
-        if (debug) {
-            ei_printf("Running impulse...\n");
-        }
+    if (debug) {
+        ei_printf("Running impulse...\n");
+    }
 
-        ei_impulse_error = run_inference(handle, features, result, debug);
+    ei_impulse_error = run_inference(handle, features, result, debug);
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
-        if (impulse->sensor == EI_CLASSIFIER_SENSOR_MICROPHONE) {
-            if((void *)avg_scores != NULL && enable_maf == true) {
-                if (enable_maf && !impulse->calibration.is_configured) {
-                    // perfcal is not configured, print msg first time
-                    static bool has_printed_msg = false;
-
-                    if (!has_printed_msg) {
-                        ei_printf("WARN: run_classifier_continuous, enable_maf is true, but performance calibration is not configured.\n");
-                        ei_printf("       Previously we'd run a moving-average filter over your outputs in this case, but this is now disabled.\n");
-                        ei_printf("       Go to 'Performance calibration' in your Edge Impulse project to configure post-processing parameters.\n");
-                        ei_printf("       (You can enable this from 'Dashboard' if it's not visible in your project)\n");
-                        ei_printf("\n");
-
-                        has_printed_msg = true;
-                    }
+    if (impulse->sensor == EI_CLASSIFIER_SENSOR_MICROPHONE) {
+        if((void *)avg_scores != NULL && enable_maf == true) {
+            if (enable_maf && !impulse->calibration.is_configured) {
+                // perfcal is not configured, print msg first time
+                static bool has_printed_msg = false;
+
+                if (!has_printed_msg) {
+                    ei_printf("WARN: run_classifier_continuous, enable_maf is true, but performance calibration is not configured.\n");
+                    ei_printf("       Previously we'd run a moving-average filter over your outputs in this case, but this is now disabled.\n");
+                    ei_printf("       Go to 'Performance calibration' in your Edge Impulse project to configure post-processing parameters.\n");
+                    ei_printf("       (You can enable this from 'Dashboard' if it's not visible in your project)\n");
+                    ei_printf("\n");
+
+                    has_printed_msg = true;
                 }
-                else {
-                    // perfcal is configured
-                    static bool has_printed_msg = false;
+            }
+            else {
+                // perfcal is configured
+                static bool has_printed_msg = false;
 
-                    if (!has_printed_msg) {
-                        ei_printf("\nPerformance calibration is configured for your project. If no event is detected, all values are 0.\r\n\n");
-                        has_printed_msg = true;
-                    }
+                if (!has_printed_msg) {
+                    ei_printf("\nPerformance calibration is configured for your project. If no event is detected, all values are 0.\r\n\n");
+                    has_printed_msg = true;
+                }
 
-                    int label_detected = avg_scores->trigger(result->classification);
+                int label_detected = avg_scores->trigger(result->classification);
 
-                    if (avg_scores->should_boost()) {
-                        for (int i = 0; i < impulse->label_count; i++) {
-                            if (i == label_detected) {
-                                result->classification[i].value = 1.0f;
-                            }
-                            else {
-                                result->classification[i].value = 0.0f;
-                            }
+                if (avg_scores->should_boost()) {
+                    for (int i = 0; i < impulse->label_count; i++) {
+                        if (i == label_detected) {
+                            result->classification[i].value = 1.0f;
+                        }
+                        else {
+                            result->classification[i].value = 0.0f;
                         }
                     }
                 }
             }
         }
+    }
 #endif
-        delete[] matrix_ptrs;
+
+    return ei_impulse_error;
+}
+
+/**
+ * @brief      Process a complete impulse for continuous inference
+ *
+ * @param      impulse  struct with information about model and DSP
+ * @param      signal   Sample data
+ * @param      result   Output classifier results
+ * @param[in]  debug    Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *handle,
+                                            signal_t *signal,
+                                            ei_impulse_result_t *result,
+                                            bool debug,
+                                            bool enable_maf)
+{
+    auto impulse = handle->impulse;
+    static ei::matrix_t static_features_matrix(1, impulse->nn_input_frame_size);
+    if (!static_features_matrix.buffer) {
+        return EI_IMPULSE_ALLOC_FAILED;
     }
-    else {
-        for (int i = 0; i < impulse->label_count; i++) {
-            // set label correctly in the result struct if we have no results (otherwise is nullptr)
-            result->classification[i].label = impulse->categories[(uint32_t)i];
-        }
+
+    memset(result, 0, sizeof(ei_impulse_result_t));
+
+    bool features_ready;
+    EI_IMPULSE_ERROR ei_impulse_error = extract_impulse_features_continuous(
+        handle, signal, &static_features_matrix, &features_ready, result, debug);
+    if (ei_impulse_error != EI_IMPULSE_OK) {
+        return ei_impulse_error;
     }
 
-    return ei_impulse_error;
+    if (features_ready) {
+        return run_inference_continuous(handle, &static_features_matrix, result, debug, enable_maf);
+    }
+
+    for (int i = 0; i < impulse->label_count; i++) {
+        // set label correctly in the result struct if we have no results (otherwise is nullptr)
+        result->classification[i].label = impulse->categories[(uint32_t)i];
+    }
+    return EI_IMPULSE_OK;
 }
 
 /**
@@ -709,8 +1307,14 @@ extern "C" void run_classifier_init()
 {
 
     classifier_continuous_features_written = 0;
+    classifier_continuous_window_filled = 0;
     ei_dsp_clear_continuous_audio_state();
     init_impulse(&ei_default_impulse);
+    numpy::fft_plan_preload();
+
+#if (EI_CLASSIFIER_COMPILED == 1) && (EI_CLASSIFIER_PERSISTENT_MODEL == 1)
+    ei_tflite_eon_warm_up(ei_default_impulse.impulse);
+#endif
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
 
@@ -730,8 +1334,14 @@ extern "C" void run_classifier_init()
 __attribute__((unused)) void run_classifier_init(ei_impulse_handle_t *handle)
 {
     classifier_continuous_features_written = 0;
+    classifier_continuous_window_filled = 0;
     ei_dsp_clear_continuous_audio_state();
     init_impulse(handle);
+    numpy::fft_plan_preload();
+
+#if (EI_CLASSIFIER_COMPILED == 1) && (EI_CLASSIFIER_PERSISTENT_MODEL == 1)
+    ei_tflite_eon_warm_up(handle->impulse);
+#endif
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
     const ei_model_performance_calibration_t *calibration = &handle->impulse->calibration;
@@ -748,6 +1358,16 @@ extern "C" void run_classifier_deinit(void)
     if((void *)avg_scores != NULL) {
         delete avg_scores;
     }
+
+    if (classifier_continuous_window) {
+        free_continuous_window();
+    }
+
+    numpy::fft_plan_cache_clear();
+
+#if (EI_CLASSIFIER_COMPILED == 1) && (EI_CLASSIFIER_PERSISTENT_MODEL == 1)
+    ei_tflite_eon_release();
+#endif
 }
 
 /**
@@ -806,6 +1426,41 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
     return process_impulse(&ei_default_impulse, signal, result, debug);
 }
 
+/**
+ * Run the classifier over a batch of windows, e.g. when reprocessing logs.
+ * Results are identical to calling run_classifier once per window.
+ * @param signals Sample data, one signal per window
+ * @param n Number of windows
+ * @param results Objects to store the results in, n entries
+ * @param debug Whether to show debug messages (default: false)
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_batch(
+    signal_t *signals,
+    size_t n,
+    ei_impulse_result_t *results,
+    bool debug = false)
+{
+    return process_impulse_batch(&ei_default_impulse, signals, n, results, debug);
+}
+
+/**
+ * Run the impulse over a batch of windows
+ * @param impulse struct with information about model and DSP
+ * @param signals Sample data, one signal per window
+ * @param n Number of windows
+ * @param results Objects to store the results in, n entries
+ * @param debug Whether to show debug messages (default: false)
+ */
+__attribute__((unused)) EI_IMPULSE_ERROR run_classifier_batch(
+    ei_impulse_handle_t *impulse,
+    signal_t *signals,
+    size_t n,
+    ei_impulse_result_t *results,
+    bool debug = false)
+{
+    return process_impulse_batch(impulse, signals, n, results, debug);
+}
+
 /**
  * Run the impulse over a raw features array
  * @param impulse struct with information about model and DSP
@@ -23,6 +23,7 @@
 #include "edge-impulse-sdk/dsp/speechpy/speechpy.hpp"
 #include "edge-impulse-sdk/classifier/ei_signal_with_range.h"
 #include "edge-impulse-sdk/dsp/ei_flatten.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
 #include "model-parameters/model_metadata.h"
 
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
@@ -48,11 +49,20 @@ static float *ei_dsp_cont_current_frame = nullptr;
 static size_t ei_dsp_cont_current_frame_size = 0;
 static int ei_dsp_cont_current_frame_ix = 0;
 
-__attribute__((unused)) int extract_spectral_analysis_features(
+/**
+ * Spectral analysis over a window for which the caller keeps running moments per axis
+ * (e.g. a sliding window), so mean / RMS / skewness / kurtosis are not recomputed.
+ * moments may be nullptr, only the implementation v4 FFT path makes use of them.
+ * welch optionally holds a sliding DFT engine per axis (EIDSP_SPECTRAL_SLIDING_DFT, FFT blocks),
+ * it replaces the Welch max-hold FFTs when moments are given as well.
+ */
+__attribute__((unused)) int extract_spectral_analysis_features_with_moments(
     signal_t *signal,
     matrix_t *output_matrix,
     void *config_ptr,
-    const float frequency)
+    const float frequency,
+    const spectral::running_moments *const *moments,
+    const spectral::sliding_welch *const *welch = nullptr)
 {
     ei_dsp_config_spectral_analysis_t *config = (ei_dsp_config_spectral_analysis_t *)config_ptr;
 
@@ -62,7 +72,10 @@ __attribute__((unused)) int extract_spectral_analysis_features(
         EIDSP_ERR(EIDSP_OUT_OF_MEM);
     }
 
-    signal->get_data(0, signal->total_length, input_matrix.buffer);
+    {
+        EI_PROFILE_SCOPE("dsp.signal");
+        signal->get_data(0, signal->total_length, input_matrix.buffer);
+    }
 
 #if EI_DSP_PARAMS_SPECTRAL_ANALYSIS_ANALYSIS_TYPE_WAVELET || EI_DSP_PARAMS_ALL
     if (strcmp(config->analysis_type, "Wavelet") == 0) {
@@ -83,7 +96,9 @@ __attribute__((unused)) int extract_spectral_analysis_features(
                 &input_matrix,
                 output_matrix,
                 config,
-                frequency);
+                frequency,
+                moments,
+                welch);
         } else {
             return spectral::feature::extract_spectral_analysis_features_v2(
                 &input_matrix,
@@ -113,6 +128,54 @@ __attribute__((unused)) int extract_spectral_analysis_features(
     return EIDSP_NOT_SUPPORTED;
 }
 
+__attribute__((unused)) int extract_spectral_analysis_features(
+    signal_t *signal,
+    matrix_t *output_matrix,
+    void *config_ptr,
+    const float frequency)
+{
+    return extract_spectral_analysis_features_with_moments(signal, output_matrix, config_ptr, frequency, nullptr);
+}
+
+/**
+ * Spectral analysis straight into an int8 buffer (normally the input tensor of the
+ * model), quantized with the tensor's scale and zero point as the features are produced.
+ * Gives the same values as extract_spectral_analysis_features followed by
+ * fill_input_tensor_from_matrix. EIDSP_NOT_SUPPORTED for configs that only produce
+ * float features, see spectral::feature::supports_quantized_output.
+ */
+__attribute__((unused)) int extract_spectral_analysis_features_quantized(
+    signal_t *signal,
+    const spectral::quantized_features_t *output,
+    void *config_ptr,
+    const float frequency)
+{
+#if EI_DSP_PARAMS_SPECTRAL_ANALYSIS_ANALYSIS_TYPE_FFT || EI_DSP_PARAMS_ALL || !EI_DSP_PARAMS_GENERATED
+    ei_dsp_config_spectral_analysis_t *config = (ei_dsp_config_spectral_analysis_t *)config_ptr;
+    if (!spectral::feature::supports_quantized_output(config)) {
+        return EIDSP_NOT_SUPPORTED;
+    }
+
+    matrix_t input_matrix(signal->total_length / config->axes, config->axes);
+    if (!input_matrix.buffer) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
+    {
+        EI_PROFILE_SCOPE("dsp.signal");
+        signal->get_data(0, signal->total_length, input_matrix.buffer);
+    }
+
+    return spectral::feature::extract_spectral_analysis_features_quantized(
+        &input_matrix,
+        output,
+        config,
+        frequency);
+#else
+    return EIDSP_NOT_SUPPORTED;
+#endif
+}
+
 __attribute__((unused)) int extract_raw_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency) {
     ei_dsp_config_raw_t config = *((ei_dsp_config_raw_t*)config_ptr);
 
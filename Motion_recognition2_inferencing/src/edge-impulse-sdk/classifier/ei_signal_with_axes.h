@@ -51,17 +51,20 @@ public:
     }
 
     int get_data(size_t offset, size_t length, float *out_ptr) {
-        size_t offset_on_original_signal = offset / _axes_count * _impulse->raw_samples_per_frame;
-        size_t length_on_original_signal = length / _axes_count * _impulse->raw_samples_per_frame;
+        const size_t frame_size = _impulse->raw_samples_per_frame;
+        size_t offset_on_original_signal = offset / _axes_count * frame_size;
+        size_t frames = length / _axes_count;
 
-        size_t out_ptr_ix = 0;
-
-        for (size_t ix = offset_on_original_signal; ix < offset_on_original_signal + length_on_original_signal; ix += _impulse->raw_samples_per_frame) {
-            for (size_t axis_ix = 0; axis_ix < this->_axes_count; axis_ix++) {
-                int r = _original_signal->get_data(ix + _axes[axis_ix], 1, &out_ptr[out_ptr_ix++]);
-                if (r != 0) {
-                    return r;
-                }
+        // one strided gather per selected axis, written straight into its interleaved slot
+        for (size_t axis_ix = 0; axis_ix < this->_axes_count; axis_ix++) {
+            int r = _original_signal->get_data_strided(
+                offset_on_original_signal + _axes[axis_ix],
+                frame_size,
+                frames,
+                out_ptr + axis_ix,
+                this->_axes_count);
+            if (r != 0) {
+                return r;
             }
         }
 
@@ -27,6 +27,89 @@
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
 #include "edge-impulse-sdk/classifier/inferencing_engines/tflite_helper.h"
 #include "edge-impulse-sdk/classifier/ei_run_dsp.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_profiler.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
+
+#if EI_CLASSIFIER_PERSISTENT_MODEL == 1
+/**
+ * Compiled graphs that stay initialized between inferences. Keyed on the init
+ * function, as graph configs for EON DSP blocks are built on the stack.
+ */
+typedef struct {
+    TfLiteStatus (*model_init)(void*(*alloc_fnc)(size_t, size_t));
+    TfLiteStatus (*model_reset)(void (*free)(void* ptr));
+    uint64_t setup_us; // cost of the cold init, saved on every warm inference
+} ei_tflite_eon_persistent_model_t;
+
+static ei_tflite_eon_persistent_model_t ei_tflite_eon_persistent_models[EI_CLASSIFIER_MAX_PERSISTENT_MODELS];
+static size_t ei_tflite_eon_persistent_models_count = 0;
+
+static ei_tflite_eon_persistent_model_t* ei_tflite_eon_find_persistent_model(ei_config_tflite_eon_graph_t *graph_config) {
+    for (size_t ix = 0; ix < ei_tflite_eon_persistent_models_count; ix++) {
+        if (ei_tflite_eon_persistent_models[ix].model_init == graph_config->model_init) {
+            return &ei_tflite_eon_persistent_models[ix];
+        }
+    }
+    return nullptr;
+}
+#endif // EI_CLASSIFIER_PERSISTENT_MODEL == 1
+
+/**
+ * Initialize the compiled graph, or reuse it if it is kept warm
+ *
+ * @param      graph_config   EON graph
+ * @param      setup_us       Out: init time spent now
+ * @param      setup_saved_us Out: init time skipped because the graph was already initialized
+ *
+ * @return  kTfLiteOk if successful
+ */
+static TfLiteStatus inference_tflite_model_init(
+    ei_config_tflite_eon_graph_t *graph_config,
+    uint64_t *setup_us,
+    uint64_t *setup_saved_us) {
+
+    *setup_us = 0;
+    *setup_saved_us = 0;
+
+#if EI_CLASSIFIER_PERSISTENT_MODEL == 1
+    ei_tflite_eon_persistent_model_t *persistent = ei_tflite_eon_find_persistent_model(graph_config);
+    if (persistent) {
+        *setup_saved_us = persistent->setup_us;
+        return kTfLiteOk;
+    }
+#endif // EI_CLASSIFIER_PERSISTENT_MODEL == 1
+
+    uint64_t init_start_us = ei_read_timer_us();
+    TfLiteStatus init_status = graph_config->model_init(ei_aligned_calloc);
+    *setup_us = ei_read_timer_us() - init_start_us;
+    if (init_status != kTfLiteOk) {
+        return init_status;
+    }
+
+#if EI_CLASSIFIER_PERSISTENT_MODEL == 1
+    if (ei_tflite_eon_persistent_models_count < EI_CLASSIFIER_MAX_PERSISTENT_MODELS) {
+        ei_tflite_eon_persistent_model_t *m = &ei_tflite_eon_persistent_models[ei_tflite_eon_persistent_models_count++];
+        m->model_init = graph_config->model_init;
+        m->model_reset = graph_config->model_reset;
+        m->setup_us = *setup_us;
+    }
+#endif // EI_CLASSIFIER_PERSISTENT_MODEL == 1
+
+    return kTfLiteOk;
+}
+
+/**
+ * Release the compiled graph after an inference, unless it is kept warm
+ */
+static TfLiteStatus inference_tflite_model_reset(ei_config_tflite_eon_graph_t *graph_config) {
+#if EI_CLASSIFIER_PERSISTENT_MODEL == 1
+    if (ei_tflite_eon_find_persistent_model(graph_config)) {
+        return kTfLiteOk;
+    }
+#endif // EI_CLASSIFIER_PERSISTENT_MODEL == 1
+    return graph_config->model_reset(ei_aligned_free);
+}
 
 /**
  * Setup the TFLite runtime
@@ -45,13 +128,19 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
     TfLiteTensor* output,
     TfLiteTensor* output_labels,
     TfLiteTensor* output_scores,
-    ei_unique_ptr_t& p_tensor_arena) {
+    ei_unique_ptr_t& p_tensor_arena,
+    ei_impulse_result_t *result = nullptr) {
 
     ei_config_tflite_eon_graph_t *graph_config = (ei_config_tflite_eon_graph_t*)block_config->graph_config;
 
     *ctx_start_us = ei_read_timer_us();
 
-    TfLiteStatus init_status = graph_config->model_init(ei_aligned_calloc);
+    uint64_t setup_us, setup_saved_us;
+    TfLiteStatus init_status = inference_tflite_model_init(graph_config, &setup_us, &setup_saved_us);
+    if (result) {
+        result->timing.classification_setup_us += setup_us;
+        result->timing.classification_setup_saved_us += setup_saved_us;
+    }
     if (init_status != kTfLiteOk) {
         ei_printf("Failed to initialize the model (error code %d)\n", init_status);
         return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
@@ -107,8 +196,11 @@ static EI_IMPULSE_ERROR inference_tflite_run(
 
     ei_config_tflite_eon_graph_t *graph_config = (ei_config_tflite_eon_graph_t*)block_config->graph_config;
 
-    if (graph_config->model_invoke() != kTfLiteOk) {
-        return EI_IMPULSE_TFLITE_ERROR;
+    {
+        EI_PROFILE_SCOPE("nn.invoke");
+        if (graph_config->model_invoke() != kTfLiteOk) {
+            return EI_IMPULSE_TFLITE_ERROR;
+        }
     }
 
     uint64_t ctx_end_us = ei_read_timer_us();
@@ -121,6 +213,7 @@ static EI_IMPULSE_ERROR inference_tflite_run(
         ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
     }
 
+    EI_PROFILE_SCOPE("nn.dequantize");
     EI_IMPULSE_ERROR fill_res = fill_result_struct_from_output_tensor_tflite(
         impulse, block_config, output, labels_tensor, scores_tensor, result, debug);
 
@@ -185,7 +278,7 @@ EI_IMPULSE_ERROR run_nn_inference_from_dsp(
         return output_res;
     }
 
-    if (graph_config->model_reset(ei_aligned_free) != kTfLiteOk) {
+    if (inference_tflite_model_reset(graph_config) != kTfLiteOk) {
         return EI_IMPULSE_TFLITE_ERROR;
     }
 
@@ -219,6 +312,7 @@ EI_IMPULSE_ERROR run_nn_inference(
     TfLiteTensor output_scores;
     TfLiteTensor output_labels;
 
+    EI_PROFILE_SCOPE("nn");
     uint64_t ctx_start_us = ei_read_timer_us();
     ei_unique_ptr_t p_tensor_arena(nullptr, ei_aligned_free);
 
@@ -229,7 +323,8 @@ EI_IMPULSE_ERROR run_nn_inference(
         &output,
         &output_labels,
         &output_scores,
-        p_tensor_arena);
+        p_tensor_arena,
+        result);
 
     if (init_res != EI_IMPULSE_OK) {
         return init_res;
@@ -238,7 +333,11 @@ EI_IMPULSE_ERROR run_nn_inference(
     uint8_t* tensor_arena = static_cast<uint8_t*>(p_tensor_arena.get());
 
     size_t mtx_size = impulse->dsp_blocks_size + impulse->learning_blocks_size;
-    auto input_res = fill_input_tensor_from_matrix(fmatrix, &input, input_block_ids, input_block_ids_size, mtx_size);
+    EI_IMPULSE_ERROR input_res;
+    {
+        EI_PROFILE_SCOPE("nn.quantize");
+        input_res = fill_input_tensor_from_matrix(fmatrix, &input, input_block_ids, input_block_ids_size, mtx_size);
+    }
     if (input_res != EI_IMPULSE_OK) {
         return input_res;
     }
@@ -259,7 +358,7 @@ EI_IMPULSE_ERROR run_nn_inference(
         }
     }
 
-    graph_config->model_reset(ei_aligned_free);
+    inference_tflite_model_reset(graph_config);
 
     result->timing.classification_us = ei_read_timer_us() - ctx_start_us;
 
@@ -270,6 +369,259 @@ EI_IMPULSE_ERROR run_nn_inference(
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Writes the int8 input tensor in place (e.g. a DSP block quantizing its features
+ * straight into the tensor arena), see run_nn_inference_from_quantized_writer
+ *
+ * @param      ctx         Context passed to run_nn_inference_from_quantized_writer
+ * @param      input       Input tensor data
+ * @param      input_size  Input tensor size in bytes
+ * @param      scale       Input quantization scale
+ * @param      zero_point  Input quantization zero point
+ */
+typedef EI_IMPULSE_ERROR (*ei_nn_quantized_writer_t)(void *ctx, int8_t *input, size_t input_size, float scale, int32_t zero_point);
+
+/**
+ * @brief      Whether a learning block can run through run_nn_inference_from_quantized_writer
+ *             (EON model with an int8 input, output not kept for other blocks)
+ */
+__attribute__((unused)) static bool can_run_nn_inference_from_quantized_writer(const ei_learning_block_t *block) {
+    if (block->infer_fn != run_nn_inference || block->keep_output || block->input_block_ids_size != 1) {
+        return false;
+    }
+    ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)block->config;
+    return block_config->quantized == 1;
+}
+
+/**
+ * @brief      Do neural network inferencing, with the input tensor written by a
+ *             callback instead of quantized from a feature matrix. The callback
+ *             runs after the model is set up, so it writes into the tensor arena
+ *             directly; the time it takes is not counted as classification time.
+ *
+ * @param      write_input  Fills the input tensor
+ * @param      ctx          Passed to write_input
+ * @param      result       Output classifier results
+ * @param[in]  debug        Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+EI_IMPULSE_ERROR run_nn_inference_from_quantized_writer(
+    const ei_impulse_t *impulse,
+    ei_nn_quantized_writer_t write_input,
+    void *ctx,
+    ei_impulse_result_t *result,
+    void *config_ptr,
+    bool debug = false)
+{
+    ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)config_ptr;
+    ei_config_tflite_eon_graph_t *graph_config = (ei_config_tflite_eon_graph_t*)block_config->graph_config;
+
+    TfLiteTensor input;
+    TfLiteTensor output;
+    TfLiteTensor output_scores;
+    TfLiteTensor output_labels;
+
+    uint64_t ctx_start_us = ei_read_timer_us();
+    ei_unique_ptr_t p_tensor_arena(nullptr, ei_aligned_free);
+
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(
+        block_config,
+        &ctx_start_us,
+        &input,
+        &output,
+        &output_labels,
+        &output_scores,
+        p_tensor_arena,
+        result);
+
+    if (init_res != EI_IMPULSE_OK) {
+        return init_res;
+    }
+
+    if (input.type != kTfLiteInt8) {
+        ei_printf("ERR: writing the input in place needs an int8 input tensor\n");
+        inference_tflite_model_reset(graph_config);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    uint64_t write_start_us = ei_read_timer_us();
+    EI_IMPULSE_ERROR input_res = write_input(ctx, input.data.int8, input.bytes, input.params.scale, input.params.zero_point);
+    uint64_t write_us = ei_read_timer_us() - write_start_us;
+    if (input_res != EI_IMPULSE_OK) {
+        inference_tflite_model_reset(graph_config);
+        return input_res;
+    }
+
+    EI_PROFILE_SCOPE("nn");
+    uint8_t* tensor_arena = static_cast<uint8_t*>(p_tensor_arena.get());
+    EI_IMPULSE_ERROR run_res = inference_tflite_run(
+        impulse,
+        block_config,
+        ctx_start_us + write_us,
+        &output,
+        &output_labels,
+        &output_scores,
+        tensor_arena, result, debug);
+
+    inference_tflite_model_reset(graph_config);
+
+    result->timing.classification_us = ei_read_timer_us() - ctx_start_us - write_us;
+
+    return run_res;
+}
+
+/**
+ * @brief      Whether a learning block can run batches through run_nn_inference_batch
+ *             (EON classifier with int8 input and output and a batched invoke)
+ */
+__attribute__((unused)) static bool can_run_nn_inference_batch(const ei_learning_block_t *block) {
+    if (block->infer_fn != run_nn_inference || block->keep_output) {
+        return false;
+    }
+    ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)block->config;
+    ei_config_tflite_eon_graph_t *graph_config = (ei_config_tflite_eon_graph_t*)block_config->graph_config;
+    return graph_config->model_invoke_batch != nullptr &&
+        block_config->quantized == 1 &&
+        block_config->classification_mode == EI_CLASSIFIER_CLASSIFICATION_MODE_CLASSIFICATION &&
+        !block_config->object_detection;
+}
+
+/**
+ * @brief      Do neural network inferencing over a batch of feature matrices.
+ *             Every row is quantized and dequantized exactly like run_nn_inference
+ *             does; the model runs once over all rows (model_invoke_batch).
+ *
+ * @param      fmatrix     Processed matrices, row N of every matrix belongs to window N
+ * @param      batch_size  Number of windows
+ * @param      results     Output classifier results, batch_size entries
+ * @param[in]  debug       Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+EI_IMPULSE_ERROR run_nn_inference_batch(
+    const ei_impulse_t *impulse,
+    ei_feature_t *fmatrix,
+    size_t batch_size,
+    uint32_t learn_block_index,
+    uint32_t* input_block_ids,
+    uint32_t input_block_ids_size,
+    ei_impulse_result_t *results,
+    void *config_ptr,
+    bool debug = false)
+{
+    ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)config_ptr;
+    ei_config_tflite_eon_graph_t *graph_config = (ei_config_tflite_eon_graph_t*)block_config->graph_config;
+
+    TfLiteTensor input;
+    TfLiteTensor output;
+    TfLiteTensor output_scores;
+    TfLiteTensor output_labels;
+
+    EI_PROFILE_SCOPE("nn");
+    uint64_t ctx_start_us = ei_read_timer_us();
+    ei_unique_ptr_t p_tensor_arena(nullptr, ei_aligned_free);
+
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(
+        block_config,
+        &ctx_start_us,
+        &input,
+        &output,
+        &output_labels,
+        &output_scores,
+        p_tensor_arena,
+        &results[0]);
+
+    if (init_res != EI_IMPULSE_OK) {
+        return init_res;
+    }
+
+    if (input.type != kTfLiteInt8 || output.type != kTfLiteInt8) {
+        ei_printf("ERR: batched inference needs int8 input and output tensors\n");
+        inference_tflite_model_reset(graph_config);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    ei_unique_ptr_t p_input_rows(ei_malloc(batch_size * input.bytes), ei_free);
+    ei_unique_ptr_t p_output_rows(ei_malloc(batch_size * output.bytes), ei_free);
+    size_t mtx_size = impulse->dsp_blocks_size + impulse->learning_blocks_size;
+    std::unique_ptr<ei_feature_t[]> p_window(new ei_feature_t[mtx_size]);
+    std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> p_rows(new std::unique_ptr<ei::matrix_t>[mtx_size]);
+    if (!p_input_rows || !p_output_rows || !p_window || !p_rows) {
+        inference_tflite_model_reset(graph_config);
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
+    int8_t *input_rows = static_cast<int8_t*>(p_input_rows.get());
+    int8_t *output_rows = static_cast<int8_t*>(p_output_rows.get());
+
+    // one-row views into the batch matrices, moved along for every window
+    ei_feature_t *window = p_window.get();
+    for (size_t ix = 0; ix < mtx_size; ix++) {
+        window[ix].blockId = fmatrix[ix].blockId;
+        window[ix].matrix = nullptr;
+        if (fmatrix[ix].matrix) {
+            p_rows[ix].reset(new ei::matrix_t(1, fmatrix[ix].matrix->cols, fmatrix[ix].matrix->buffer));
+            window[ix].matrix = p_rows[ix].get();
+        }
+    }
+
+    {
+        EI_PROFILE_SCOPE("nn.quantize");
+        for (size_t row = 0; row < batch_size; row++) {
+            for (size_t ix = 0; ix < mtx_size; ix++) {
+                if (window[ix].matrix) {
+                    window[ix].matrix->buffer = fmatrix[ix].matrix->buffer + row * fmatrix[ix].matrix->cols;
+                }
+            }
+            TfLiteTensor row_input = input;
+            row_input.data.int8 = input_rows + row * input.bytes;
+            EI_IMPULSE_ERROR input_res = fill_input_tensor_from_matrix(window, &row_input, input_block_ids, input_block_ids_size, mtx_size);
+            if (input_res != EI_IMPULSE_OK) {
+                inference_tflite_model_reset(graph_config);
+                return input_res;
+            }
+        }
+    }
+
+    TfLiteStatus invoke_status;
+    {
+        EI_PROFILE_SCOPE("nn.invoke");
+        invoke_status = graph_config->model_invoke_batch(input_rows, output_rows, batch_size);
+    }
+    inference_tflite_model_reset(graph_config);
+    if (invoke_status != kTfLiteOk) {
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
+    // the batch ran as one, every window is charged an equal share
+    uint64_t classification_us = (ei_read_timer_us() - ctx_start_us) / batch_size;
+
+    EI_PROFILE_SCOPE("nn.dequantize");
+    for (size_t row = 0; row < batch_size; row++) {
+        TfLiteTensor row_output = output;
+        row_output.data.int8 = output_rows + row * output.bytes;
+
+        results[row].timing.classification_us = classification_us;
+        results[row].timing.classification = (int)(classification_us / 1000);
+
+        if (debug) {
+            ei_printf("Predictions (window %d):\n", (int)row);
+        }
+
+        EI_IMPULSE_ERROR fill_res = fill_result_struct_from_output_tensor_tflite(
+            impulse, block_config, &row_output, &output_labels, &output_scores, &results[row], debug);
+        if (fill_res != EI_IMPULSE_OK) {
+            return fill_res;
+        }
+    }
+
+    if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+        return EI_IMPULSE_CANCELED;
+    }
+
+    return EI_IMPULSE_OK;
+}
+
 #if EI_CLASSIFIER_QUANTIZATION_ENABLED == 1
 /**
  * Special function to run the classifier on images, only works on TFLite models (either interpreter or EON or for tensaiflow)
@@ -302,7 +654,8 @@ EI_IMPULSE_ERROR run_nn_inference_image_quantized(
         &input, &output,
         &output_labels,
         &output_scores,
-        p_tensor_arena);
+        p_tensor_arena,
+        result);
 
     if (init_res != EI_IMPULSE_OK) {
         return init_res;
@@ -355,7 +708,7 @@ EI_IMPULSE_ERROR run_nn_inference_image_quantized(
         result,
         debug);
 
-    graph_config->model_reset(ei_aligned_free);
+    inference_tflite_model_reset(graph_config);
 
     if (run_res != EI_IMPULSE_OK) {
         return run_res;
@@ -367,6 +720,43 @@ EI_IMPULSE_ERROR run_nn_inference_image_quantized(
 }
 #endif // EI_CLASSIFIER_QUANTIZATION_ENABLED == 1
 
+#if EI_CLASSIFIER_PERSISTENT_MODEL == 1
+/**
+ * @brief      Initialize all compiled learning blocks of an impulse up front, so that
+ *             the first window does not pay for the arena allocation and op prepare.
+ *
+ * @return     The ei impulse error.
+ */
+__attribute__((unused)) static EI_IMPULSE_ERROR ei_tflite_eon_warm_up(const ei_impulse_t *impulse) {
+    for (size_t ix = 0; ix < impulse->learning_blocks_size; ix++) {
+        const ei_learning_block_t &block = impulse->learning_blocks[ix];
+        if (block.infer_fn != run_nn_inference) {
+            continue;
+        }
+        ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)block.config;
+        if (block_config->compiled != 1) {
+            continue;
+        }
+        uint64_t setup_us, setup_saved_us;
+        if (inference_tflite_model_init((ei_config_tflite_eon_graph_t*)block_config->graph_config, &setup_us, &setup_saved_us) != kTfLiteOk) {
+            ei_printf("ERR: Failed to initialize the model for block %u\n", (unsigned)block.blockId);
+            return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+        }
+    }
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Release all compiled graphs that were kept warm
+ */
+__attribute__((unused)) static void ei_tflite_eon_release() {
+    for (size_t ix = 0; ix < ei_tflite_eon_persistent_models_count; ix++) {
+        ei_tflite_eon_persistent_models[ix].model_reset(ei_aligned_free);
+    }
+    ei_tflite_eon_persistent_models_count = 0;
+}
+#endif // EI_CLASSIFIER_PERSISTENT_MODEL == 1
+
 __attribute__((unused)) int extract_tflite_eon_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency) {
     ei_dsp_config_tflite_eon_t *dsp_config = (ei_dsp_config_tflite_eon_t*)config_ptr;
 
@@ -401,5 +791,35 @@ __attribute__((unused)) int extract_tflite_eon_features(signal_t *signal, matrix
     return EIDSP_OK;
 }
 
+/**
+ * @brief      Attach a profiler to the EON compiled models of an impulse, every
+ *             invoke then emits a BeginEvent / EndEvent per node (tagged with
+ *             the node name), e.g. into an EiTfliteProfiler.
+ *
+ * @param      impulse   The impulse
+ * @param      profiler  The profiler, nullptr to detach
+ *
+ * @return     Number of models the profiler was attached to
+ */
+__attribute__((unused)) static size_t ei_tflite_eon_set_profiler(
+    const ei_impulse_t *impulse,
+    tflite::MicroProfilerInterface *profiler)
+{
+    size_t attached = 0;
+    for (size_t ix = 0; ix < impulse->learning_blocks_size; ix++) {
+        if (impulse->learning_blocks[ix].infer_fn != run_nn_inference) {
+            continue;
+        }
+        ei_learning_block_config_tflite_graph_t *block_config =
+            (ei_learning_block_config_tflite_graph_t*)impulse->learning_blocks[ix].config;
+        ei_config_tflite_eon_graph_t *graph_config = (ei_config_tflite_eon_graph_t*)block_config->graph_config;
+        if (graph_config->model_set_profiler) {
+            graph_config->model_set_profiler(profiler);
+            attached++;
+        }
+    }
+    return attached;
+}
+
 #endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
 #endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_EON_H_
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_FC_S8_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_FC_S8_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/fully_connected.h"
+
+// Set to 1 to run every FULLY_CONNECTED node through the TFLM kernel
+#ifndef EI_TFLITE_DISABLE_FC_S8
+#define EI_TFLITE_DISABLE_FC_S8 0
+#endif
+
+// Largest layer (in x out weights) the EON model runs through FullyConnectedS8;
+// bigger layers keep the TFLM kernel (CMSIS-NN / ESP-NN), which wins once the
+// inner loops are long enough for SIMD to pay off
+#ifndef EI_TFLITE_FC_S8_MAX_WEIGHTS
+#define EI_TFLITE_FC_S8_MAX_WEIGHTS 1024
+#endif
+
+#define EI_TFLITE_FC_S8_SELECT(in, out) \
+    (EI_TFLITE_DISABLE_FC_S8 == 0 && (in) * (out) <= EI_TFLITE_FC_S8_MAX_WEIGHTS)
+
+/**
+ * @brief      Bias of one output with the input zero point folded in:
+ *             bias + input_offset * sum(filter_row), so the kernel only needs
+ *             sum(filter * input). constexpr, the EON model folds at compile time.
+ *
+ * @param      filter_row    depth weights of the output
+ * @param      depth         Input features
+ * @param      bias          Bias of the output
+ * @param      input_offset  Negated zero point of the input tensor
+ */
+constexpr int32_t ei_fc_s8_fold_bias(const int8_t *filter_row, size_t depth, int32_t bias, int32_t input_offset) {
+    return depth == 0 ? bias :
+        ei_fc_s8_fold_bias(filter_row + 1, depth - 1, bias + input_offset * filter_row[0], input_offset);
+}
+
+/**
+ * @brief      int8 fully connected layer with the shape and the fused activation
+ *             fixed at compile time. The dot product has a constant trip count
+ *             and is unrolled (and vectorized where the target allows), and the
+ *             input zero point is folded into the bias, see ei_fc_s8_fold_bias.
+ *
+ *             Bit identical to tflite::reference_integer_ops::FullyConnected
+ *             for symmetric (zero point 0) per tensor quantized weights.
+ *
+ * @tparam     In    Input features
+ * @tparam     Out   Output features
+ * @tparam     Act   Fused activation (kTfLiteActNone, kTfLiteActRelu, kTfLiteActRelu6, ...)
+ */
+template <size_t In, size_t Out, TfLiteFusedActivation Act>
+struct FullyConnectedS8 {
+    static_assert(In > 0 && Out > 0, "empty layer");
+
+    /**
+     * @param      op           Requantization (CalculateOpDataFullyConnected)
+     * @param      input        In values
+     * @param      filter       Out x In weights
+     * @param      folded_bias  Out biases with the input zero point folded in
+     * @param      output       Out values
+     */
+    static void Eval(
+        const tflite::OpDataFullyConnected &op,
+        const int8_t *input,
+        const int8_t *filter,
+        const int32_t *folded_bias,
+        int8_t *output)
+    {
+        // without an activation the range is the int8 range, no need to load it
+        const int32_t act_min = Act == kTfLiteActNone ? -128 : op.output_activation_min;
+        const int32_t act_max = Act == kTfLiteActNone ? 127 : op.output_activation_max;
+
+        for (size_t out_c = 0; out_c < Out; out_c++) {
+            int32_t acc = Dot(input, filter + out_c * In) + folded_bias[out_c];
+            acc = tflite::MultiplyByQuantizedMultiplier(acc, op.output_multiplier, op.output_shift);
+            acc += op.output_zero_point;
+            acc = std::max(acc, act_min);
+            acc = std::min(acc, act_max);
+            output[out_c] = static_cast<int8_t>(acc);
+        }
+    }
+
+private:
+    static inline int32_t Dot(const int8_t *input, const int8_t *weights) {
+        int32_t acc = 0;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 8
+#endif
+        for (size_t d = 0; d < In; d++) {
+            acc += weights[d] * input[d];
+        }
+        return acc;
+    }
+};
+
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_FC_S8_H_
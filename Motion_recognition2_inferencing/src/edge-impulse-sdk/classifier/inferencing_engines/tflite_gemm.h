@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_GEMM_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_GEMM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/fully_connected.h"
+
+// Batch rows accumulated together, every filter row is loaded once per block
+#ifndef EI_TFLITE_GEMM_ROW_BLOCK
+#define EI_TFLITE_GEMM_ROW_BLOCK 4
+#endif
+
+/**
+ * @brief      int8 fully connected layer over a batch of rows, as one GEMM
+ *             (output = input * filter^T + bias, requantized per tensor).
+ *
+ *             Same arithmetic as tflite::reference_integer_ops::FullyConnected
+ *             (and the CMSIS-NN / ESP-NN int8 kernels), so every row is bit
+ *             identical to running it through the FULLY_CONNECTED op on its own.
+ *
+ * @param      op         Quantization parameters (CalculateOpDataFullyConnected)
+ * @param      input      rows x depth
+ * @param      rows       Batch size
+ * @param      depth      Input features per row
+ * @param      filter     out_depth x depth
+ * @param      bias       out_depth, may be nullptr
+ * @param      out_depth  Output features per row
+ * @param      output     rows x out_depth
+ */
+static inline void ei_tflite_gemm_fully_connected_s8(
+    const tflite::OpDataFullyConnected &op,
+    const int8_t *input,
+    size_t rows,
+    size_t depth,
+    const int8_t *filter,
+    const int32_t *bias,
+    size_t out_depth,
+    int8_t *output)
+{
+    const int32_t input_offset = -op.input_zero_point;
+    const int32_t filter_offset = -op.filter_zero_point;
+
+    size_t row = 0;
+    for (; row + EI_TFLITE_GEMM_ROW_BLOCK <= rows; row += EI_TFLITE_GEMM_ROW_BLOCK) {
+        const int8_t *in = input + row * depth;
+        for (size_t out_c = 0; out_c < out_depth; out_c++) {
+            const int8_t *f = filter + out_c * depth;
+            int32_t acc[EI_TFLITE_GEMM_ROW_BLOCK] = { 0 };
+            for (size_t d = 0; d < depth; d++) {
+                const int32_t filter_val = f[d] + filter_offset;
+                for (size_t r = 0; r < EI_TFLITE_GEMM_ROW_BLOCK; r++) {
+                    acc[r] += filter_val * (in[r * depth + d] + input_offset);
+                }
+            }
+            for (size_t r = 0; r < EI_TFLITE_GEMM_ROW_BLOCK; r++) {
+                int32_t acc_scaled = acc[r] + (bias ? bias[out_c] : 0);
+                acc_scaled = tflite::MultiplyByQuantizedMultiplier(acc_scaled, op.output_multiplier, op.output_shift);
+                acc_scaled += op.output_zero_point;
+                acc_scaled = std::max(acc_scaled, op.output_activation_min);
+                acc_scaled = std::min(acc_scaled, op.output_activation_max);
+                output[(row + r) * out_depth + out_c] = static_cast<int8_t>(acc_scaled);
+            }
+        }
+    }
+
+    // remaining rows, one at a time
+    for (; row < rows; row++) {
+        const int8_t *in = input + row * depth;
+        for (size_t out_c = 0; out_c < out_depth; out_c++) {
+            const int8_t *f = filter + out_c * depth;
+            int32_t acc = 0;
+            for (size_t d = 0; d < depth; d++) {
+                acc += (f[d] + filter_offset) * (in[d] + input_offset);
+            }
+            acc += bias ? bias[out_c] : 0;
+            acc = tflite::MultiplyByQuantizedMultiplier(acc, op.output_multiplier, op.output_shift);
+            acc += op.output_zero_point;
+            acc = std::max(acc, op.output_activation_min);
+            acc = std::min(acc, op.output_activation_max);
+            output[row * out_depth + out_c] = static_cast<int8_t>(acc);
+        }
+    }
+}
+
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_GEMM_H_
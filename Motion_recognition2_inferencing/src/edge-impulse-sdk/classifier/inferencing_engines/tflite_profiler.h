@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_PROFILER_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_PROFILER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_profiler_interface.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+// Distinct tags (nodes) tracked by EiTfliteProfiler
+#ifndef EI_TFLITE_PROFILER_MAX_TAGS
+#define EI_TFLITE_PROFILER_MAX_TAGS         16
+#endif // EI_TFLITE_PROFILER_MAX_TAGS
+
+// Events that can be open at the same time
+#ifndef EI_TFLITE_PROFILER_MAX_OPEN_EVENTS
+#define EI_TFLITE_PROFILER_MAX_OPEN_EVENTS  8
+#endif // EI_TFLITE_PROFILER_MAX_OPEN_EVENTS
+
+/**
+ * MicroProfilerInterface that aggregates per tag instead of keeping every event
+ * (tflite::MicroProfiler keeps 1024 events, ~20K of RAM, and reads GetCurrentTimeTicks,
+ * which is 0 on most Edge Impulse targets). Ticks come from ei_read_timer_us unless
+ * another tick function is given, e.g. a cycle counter.
+ *
+ * Attach it with ei_tflite_eon_set_profiler (or <model>_set_profiler) and print
+ * LogTicksPerTagCsv() after a number of inferences.
+ */
+class EiTfliteProfiler : public tflite::MicroProfilerInterface {
+public:
+    EiTfliteProfiler(uint64_t (*ticks_fn)() = nullptr) : _ticks_fn(ticks_fn) {
+        ClearEvents();
+    }
+
+    virtual uint32_t BeginEvent(const char *tag) override {
+        uint32_t handle = _next_event++ % EI_TFLITE_PROFILER_MAX_OPEN_EVENTS;
+        _open[handle].tag = tag;
+        _open[handle].start = ticks();
+        return handle;
+    }
+
+    virtual void EndEvent(uint32_t event_handle) override {
+        uint64_t end = ticks();
+        if (event_handle >= EI_TFLITE_PROFILER_MAX_OPEN_EVENTS || !_open[event_handle].tag) {
+            return;
+        }
+        const char *tag = _open[event_handle].tag;
+        uint64_t elapsed = end - _open[event_handle].start;
+        _open[event_handle].tag = nullptr;
+
+        tag_stats_t *s = find_or_add(tag);
+        if (!s) {
+            _dropped++;
+            return;
+        }
+        s->events++;
+        s->ticks += elapsed;
+        if (elapsed > s->max_ticks) {
+            s->max_ticks = elapsed;
+        }
+    }
+
+    /**
+     * Forget all events
+     */
+    void ClearEvents() {
+        memset(_open, 0, sizeof(_open));
+        memset(_tags, 0, sizeof(_tags));
+        _tag_count = 0;
+        _next_event = 0;
+        _dropped = 0;
+    }
+
+    /**
+     * Sum of the ticks over all tags (meaningful when events don't nest)
+     */
+    uint64_t GetTotalTicks() const {
+        uint64_t total = 0;
+        for (size_t ix = 0; ix < _tag_count; ix++) {
+            total += _tags[ix].ticks;
+        }
+        return total;
+    }
+
+    size_t GetTagCount() const {
+        return _tag_count;
+    }
+
+    /**
+     * Totals of one tag, in order of first appearance (i.e. node order)
+     * @returns false if index is out of range
+     */
+    bool GetTag(size_t index, const char **tag, uint32_t *events, uint64_t *ticks, uint64_t *max_ticks) const {
+        if (index >= _tag_count) {
+            return false;
+        }
+        *tag = _tags[index].tag;
+        *events = _tags[index].events;
+        *ticks = _tags[index].ticks;
+        *max_ticks = _tags[index].max_ticks;
+        return true;
+    }
+
+    /**
+     * Print one CSV row per unique tag with the number of events, total, mean and max ticks
+     */
+    void LogTicksPerTagCsv() const {
+        ei_printf("\"Unique Tag\",\"Events\",\"Total ticks\",\"Mean ticks\",\"Max ticks\"\n");
+        for (size_t ix = 0; ix < _tag_count; ix++) {
+            const tag_stats_t &s = _tags[ix];
+            ei_printf("%s,%lu,%llu,%llu,%llu\n", s.tag,
+                (unsigned long)s.events,
+                (unsigned long long)s.ticks,
+                (unsigned long long)(s.events ? s.ticks / s.events : 0),
+                (unsigned long long)s.max_ticks);
+        }
+        ei_printf("total number of ticks,,%llu,,\n", (unsigned long long)GetTotalTicks());
+        if (_dropped) {
+            ei_printf("(%lu events dropped, raise EI_TFLITE_PROFILER_MAX_TAGS)\n", (unsigned long)_dropped);
+        }
+    }
+
+private:
+    typedef struct {
+        const char *tag;
+        uint32_t events;
+        uint64_t ticks;
+        uint64_t max_ticks;
+    } tag_stats_t;
+
+    typedef struct {
+        const char *tag;
+        uint64_t start;
+    } open_event_t;
+
+    uint64_t ticks() const {
+        return _ticks_fn ? _ticks_fn() : ei_read_timer_us();
+    }
+
+    tag_stats_t *find_or_add(const char *tag) {
+        for (size_t ix = 0; ix < _tag_count; ix++) {
+            if (_tags[ix].tag == tag || strcmp(_tags[ix].tag, tag) == 0) {
+                return &_tags[ix];
+            }
+        }
+        if (_tag_count == EI_TFLITE_PROFILER_MAX_TAGS) {
+            return nullptr;
+        }
+        _tags[_tag_count].tag = tag;
+        return &_tags[_tag_count++];
+    }
+
+    uint64_t (*_ticks_fn)();
+    open_event_t _open[EI_TFLITE_PROFILER_MAX_OPEN_EVENTS];
+    tag_stats_t _tags[EI_TFLITE_PROFILER_MAX_TAGS];
+    size_t _tag_count;
+    uint32_t _next_event;
+    uint32_t _dropped;
+};
+
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_PROFILER_H_
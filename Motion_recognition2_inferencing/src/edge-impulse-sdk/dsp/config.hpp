@@ -19,6 +19,13 @@
 #define _EIDSP_CPP_CONFIG_H_
 
 // clang-format off
+// Project settings, ahead of the defaults below (see ei_project_config.h next to model-parameters)
+#ifdef __has_include
+    #if __has_include("ei_project_config.h")
+    #include "ei_project_config.h"
+    #endif
+#endif
+
 #ifndef EIDSP_USE_CMSIS_DSP // __ARM_ARCH_PROFILE is a predefine of arm-gcc.  __TARGET_* is armcc
 #if defined(__MBED__) || __ARM_ARCH_PROFILE == 'M' || defined(__TARGET_CPU_CORTEX_M0) || defined(__TARGET_CPU_CORTEX_M0PLUS) || defined(__TARGET_CPU_CORTEX_M3) || defined(__TARGET_CPU_CORTEX_M4) || defined(__TARGET_CPU_CORTEX_M7) || defined(USE_HAL_DRIVER) || defined(ARDUINO_NRF52_ADAFRUIT)
     // Mbed OS versions before 5.7 are not based on CMSIS5, disable CMSIS-DSP and CMSIS-NN instructions
@@ -85,9 +92,37 @@
 #define EIDSP_PRINT_ALLOCATIONS      1
 #endif
 
+// keep FFT plans (kissfft twiddles, CMSIS rfft instances) alive between calls,
+// keyed by FFT length and direction. Plans stay allocated until numpy::fft_plan_cache_clear()
+#ifndef EIDSP_FFT_PLAN_CACHE
+#define EIDSP_FFT_PLAN_CACHE         1
+#endif // EIDSP_FFT_PLAN_CACHE
+
+#ifndef EIDSP_FFT_PLAN_CACHE_SIZE
+#define EIDSP_FFT_PLAN_CACHE_SIZE    4
+#endif // EIDSP_FFT_PLAN_CACHE_SIZE
+
+// serve DSP scratch allocations (matrices, ei_vector, ei_dsp_malloc) from a static arena
+// while an impulse runs, so steady-state windows don't touch the heap (see ei_workspace.h)
+#ifndef EIDSP_STATIC_WORKSPACE
+#define EIDSP_STATIC_WORKSPACE       0
+#endif // EIDSP_STATIC_WORKSPACE
+
+// continuous mode: spectral analysis blocks with analysis_type "FFT" update their Welch max-hold
+// per sample from a sliding DFT instead of recomputing the FFTs every window (see spectral/sliding_dft.hpp)
+#ifndef EIDSP_SPECTRAL_SLIDING_DFT
+#define EIDSP_SPECTRAL_SLIDING_DFT   0
+#endif // EIDSP_SPECTRAL_SLIDING_DFT
+
 #ifndef EIDSP_SIGNAL_C_FN_POINTER
 #define EIDSP_SIGNAL_C_FN_POINTER    0
 #endif // EIDSP_SIGNAL_C_FN_POINTER
 
+// number of floats signal_t::get_data_strided() reads per get_data call when the signal
+// has no contiguous buffer to gather from (stack buffer)
+#ifndef EIDSP_SIGNAL_GATHER_CHUNK_SIZE
+#define EIDSP_SIGNAL_GATHER_CHUNK_SIZE    64
+#endif // EIDSP_SIGNAL_GATHER_CHUNK_SIZE
+
 // clang-format on
 #endif // _EIDSP_CPP_CONFIG_H_
@@ -18,8 +18,369 @@
 #ifndef __EIPROFILER__H__
 #define __EIPROFILER__H__
 
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 
+// Scoped profiler (EI_PROFILE_SCOPE), compiled out unless enabled
+#ifndef EI_PROFILER_ENABLED
+#define EI_PROFILER_ENABLED             0
+#endif // EI_PROFILER_ENABLED
+
+// Count CPU cycles instead of microseconds where the target has a cycle counter (Xtensa, x86 TSC)
+#ifndef EI_PROFILER_CYCLE_COUNTER
+#define EI_PROFILER_CYCLE_COUNTER       0
+#endif // EI_PROFILER_CYCLE_COUNTER
+
+// Number of distinct scopes (the same name under another parent is another scope)
+#ifndef EI_PROFILER_MAX_SCOPES
+#define EI_PROFILER_MAX_SCOPES          24
+#endif // EI_PROFILER_MAX_SCOPES
+
+// Samples kept per scope for the percentiles, older samples are overwritten
+#ifndef EI_PROFILER_SAMPLES_PER_SCOPE
+#define EI_PROFILER_SAMPLES_PER_SCOPE   32
+#endif // EI_PROFILER_SAMPLES_PER_SCOPE
+
+#ifndef EI_PROFILER_MAX_DEPTH
+#define EI_PROFILER_MAX_DEPTH           8
+#endif // EI_PROFILER_MAX_DEPTH
+
+// Storage class of the per thread scope stack. Define it empty on targets without
+// thread local storage, then only one thread may open scopes.
+#ifndef EI_PROFILER_THREAD_LOCAL
+#define EI_PROFILER_THREAD_LOCAL        thread_local
+#endif // EI_PROFILER_THREAD_LOCAL
+
+#if EI_PROFILER_ENABLED == 1
+
+namespace ei {
+
+/**
+ * Hierarchical scoped profiler. Every EI_PROFILE_SCOPE("name") measures the time until the end
+ * of the enclosing block and files it under the scope that was open when it started, so the same
+ * name called from two places shows up twice in the tree. Per scope it keeps count, total, min,
+ * max and the last EI_PROFILER_SAMPLES_PER_SCOPE samples, from which report() prints
+ * p50 / p95 / p99. All state is static, nothing is allocated.
+ *
+ * Every thread has its own stack of open scopes, so scopes opened by different tasks (e.g. DSP
+ * and inference) each form their own tree in the shared scope table. Samples are recorded with
+ * atomics; only creating a scope, the first time it is opened, takes a lock.
+ */
+class profiler {
+public:
+    typedef struct {
+        const char *name;
+        int parent;
+        uint32_t count;
+        uint64_t total;
+        uint32_t min;
+        uint32_t max;
+        uint32_t p50;
+        uint32_t p95;
+        uint32_t p99;
+    } scope_stats_t;
+
+    /**
+     * RAII scope, use EI_PROFILE_SCOPE
+     */
+    class scope {
+    public:
+        scope(const char *name) : _id(begin(name)), _start(now()) {
+        }
+        ~scope() {
+            end(_id, now() - _start);
+        }
+    private:
+        int _id;
+        uint32_t _start;
+    };
+
+    /**
+     * Current time in profiler ticks (microseconds or cycles)
+     */
+    static uint32_t now() {
+#if EI_PROFILER_CYCLE_COUNTER == 1 && defined(__XTENSA__)
+        uint32_t ccount;
+        __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+        return ccount;
+#elif EI_PROFILER_CYCLE_COUNTER == 1 && (defined(__x86_64__) || defined(__i386__))
+        return (uint32_t)__builtin_ia32_rdtsc();
+#else
+        return (uint32_t)ei_read_timer_us();
+#endif
+    }
+
+    static const char *unit() {
+#if EI_PROFILER_CYCLE_COUNTER == 1 && (defined(__XTENSA__) || defined(__x86_64__) || defined(__i386__))
+        return "cycles";
+#else
+        return "us";
+#endif
+    }
+
+    /**
+     * Number of scopes seen so far, valid ids for get_stats are 0..scope_count()-1
+     */
+    static int scope_count() {
+        return state().scope_count.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Statistics of a scope, parents always have a lower id than their children.
+     * Samples recorded by other threads meanwhile may be partly included.
+     * @returns false if the id is invalid
+     */
+    static bool get_stats(int id, scope_stats_t *stats) {
+        if (id < 0 || id >= scope_count()) {
+            return false;
+        }
+        const scope_data_t &s = state().scopes[id];
+        const uint32_t count = s.count.load(std::memory_order_acquire);
+        stats->name = s.name;
+        stats->parent = s.parent;
+        stats->count = count;
+        stats->total = s.total.load(std::memory_order_relaxed);
+        stats->min = count ? ~s.min_inverted.load(std::memory_order_relaxed) : 0;
+        stats->max = s.max.load(std::memory_order_relaxed);
+
+        uint32_t sorted[EI_PROFILER_SAMPLES_PER_SCOPE];
+        size_t n = count < EI_PROFILER_SAMPLES_PER_SCOPE ? count : EI_PROFILER_SAMPLES_PER_SCOPE;
+        for (size_t ix = 0; ix < n; ix++) {
+            sorted[ix] = s.samples[ix].load(std::memory_order_relaxed);
+        }
+        // insertion sort, the ring is small
+        for (size_t ix = 1; ix < n; ix++) {
+            uint32_t v = sorted[ix];
+            size_t jx = ix;
+            while (jx > 0 && sorted[jx - 1] > v) {
+                sorted[jx] = sorted[jx - 1];
+                jx--;
+            }
+            sorted[jx] = v;
+        }
+        stats->p50 = percentile(sorted, n, 50);
+        stats->p95 = percentile(sorted, n, 95);
+        stats->p99 = percentile(sorted, n, 99);
+        return true;
+    }
+
+    /**
+     * Print the scope tree with count, mean and percentiles
+     */
+    static void report() {
+        ei_printf("Profile (%s):\n", unit());
+        ei_printf("%-32s %8s %10s %8s %8s %8s %8s\n", "scope", "count", "mean", "p50", "p95", "p99", "max");
+        const int count = scope_count();
+        for (int id = 0; id < count; id++) {
+            if (state().scopes[id].parent == -1) {
+                report_tree(id, 0);
+            }
+        }
+        const uint32_t dropped = state().dropped.load(std::memory_order_relaxed);
+        if (dropped) {
+            ei_printf("(%lu samples not recorded, raise EI_PROFILER_MAX_SCOPES / EI_PROFILER_MAX_DEPTH)\n",
+                (unsigned long)dropped);
+        }
+    }
+
+    /**
+     * Forget all scopes and samples (must not be called while a scope is open, on any thread)
+     */
+    static void reset() {
+        state_t &s = state();
+        lock();
+        s.scope_count.store(0, std::memory_order_release);
+        for (int id = 0; id < EI_PROFILER_MAX_SCOPES; id++) {
+            scope_data_t &d = s.scopes[id];
+            d.name = NULL;
+            d.parent = 0;
+            d.count.store(0, std::memory_order_relaxed);
+            d.total.store(0, std::memory_order_relaxed);
+            d.min_inverted.store(0, std::memory_order_relaxed);
+            d.max.store(0, std::memory_order_relaxed);
+            for (size_t ix = 0; ix < EI_PROFILER_SAMPLES_PER_SCOPE; ix++) {
+                d.samples[ix].store(0, std::memory_order_relaxed);
+            }
+        }
+        s.dropped.store(0, std::memory_order_relaxed);
+        unlock();
+    }
+
+private:
+    typedef struct {
+        // set once, before the scope is published through scope_count
+        const char *name;
+        int parent;
+        std::atomic<uint32_t> count;
+        std::atomic<uint64_t> total;
+        std::atomic<uint32_t> min_inverted;    // ~min, so that zero means no sample yet
+        std::atomic<uint32_t> max;
+        std::atomic<uint32_t> samples[EI_PROFILER_SAMPLES_PER_SCOPE];
+    } scope_data_t;
+
+    typedef struct {
+        scope_data_t scopes[EI_PROFILER_MAX_SCOPES];
+        std::atomic<int> scope_count;
+        std::atomic<uint32_t> dropped;
+        std::atomic_flag creating;
+    } state_t;
+
+    typedef struct {
+        int stack[EI_PROFILER_MAX_DEPTH];
+        int depth;
+    } thread_state_t;
+
+    static state_t &state() {
+        static state_t s = { { }, { 0 }, { 0 }, ATOMIC_FLAG_INIT };
+        return s;
+    }
+
+    static thread_state_t &thread_state() {
+        static EI_PROFILER_THREAD_LOCAL thread_state_t t = { { 0 }, 0 };
+        return t;
+    }
+
+    /**
+     * Serializes creating scopes (and reset). Waits by sleeping instead of spinning, so a high
+     * priority task can not starve a preempted holder on the same core.
+     */
+    static void lock() {
+        while (state().creating.test_and_set(std::memory_order_acquire)) {
+            ei_sleep(1);
+        }
+    }
+
+    static void unlock() {
+        state().creating.clear(std::memory_order_release);
+    }
+
+    static int find(int parent, const char *name, int from, int count) {
+        const state_t &s = state();
+        for (int ix = from; ix < count; ix++) {
+            if (s.scopes[ix].parent == parent &&
+                (s.scopes[ix].name == name || strcmp(s.scopes[ix].name, name) == 0)) {
+                return ix;
+            }
+        }
+        return -1;
+    }
+
+    static int begin(const char *name) {
+        state_t &s = state();
+        thread_state_t &t = thread_state();
+        // past the stack nothing is recorded (end() drops it), so no scope is created there either
+        int parent = t.depth >= EI_PROFILER_MAX_DEPTH ? -2 : (t.depth > 0 ? t.stack[t.depth - 1] : -1);
+
+        int id = -1;
+        if (parent != -2) {
+            int count = s.scope_count.load(std::memory_order_acquire);
+            id = find(parent, name, 0, count);
+            if (id == -1) {
+                // first time for this scope, another thread may be creating it as well
+                lock();
+                int now = s.scope_count.load(std::memory_order_relaxed);
+                id = find(parent, name, count, now);
+                if (id == -1 && now < EI_PROFILER_MAX_SCOPES) {
+                    id = now;
+                    s.scopes[id].name = name;
+                    s.scopes[id].parent = parent;
+                    s.scope_count.store(now + 1, std::memory_order_release);
+                }
+                unlock();
+            }
+        }
+
+        // children of an unrecorded scope are not recorded either (-2)
+        if (t.depth < EI_PROFILER_MAX_DEPTH) {
+            t.stack[t.depth] = id == -1 ? -2 : id;
+        }
+        t.depth++;
+        return id;
+    }
+
+    static void end(int id, uint32_t elapsed) {
+        state_t &s = state();
+        thread_state_t &t = thread_state();
+        if (t.depth > 0) {
+            t.depth--;
+        }
+        if (id < 0 || t.depth >= EI_PROFILER_MAX_DEPTH) {
+            s.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        scope_data_t &d = s.scopes[id];
+        uint32_t min_inverted = d.min_inverted.load(std::memory_order_relaxed);
+        while (~elapsed > min_inverted &&
+               !d.min_inverted.compare_exchange_weak(min_inverted, ~elapsed, std::memory_order_relaxed)) {
+        }
+        uint32_t max = d.max.load(std::memory_order_relaxed);
+        while (elapsed > max && !d.max.compare_exchange_weak(max, elapsed, std::memory_order_relaxed)) {
+        }
+        d.total.fetch_add(elapsed, std::memory_order_relaxed);
+        // the count picks the ring slot, and publishes the sample to get_stats
+        uint32_t slot = d.count.load(std::memory_order_relaxed);
+        d.samples[slot % EI_PROFILER_SAMPLES_PER_SCOPE].store(elapsed, std::memory_order_relaxed);
+        d.count.fetch_add(1, std::memory_order_release);
+    }
+
+    static uint32_t percentile(const uint32_t *sorted, size_t n, size_t p) {
+        if (n == 0) {
+            return 0;
+        }
+        // nearest rank
+        size_t rank = (p * n + 99) / 100;
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    static void report_tree(int id, int level) {
+        scope_stats_t st;
+        get_stats(id, &st);
+
+        char label[33];
+        int indent = level * 2 < 16 ? level * 2 : 16;
+        memset(label, ' ', indent);
+        strncpy(label + indent, st.name, sizeof(label) - 1 - indent);
+        label[sizeof(label) - 1] = '\0';
+
+        ei_printf("%-32s %8lu %10lu %8lu %8lu %8lu %8lu\n", label,
+            (unsigned long)st.count,
+            (unsigned long)(st.count ? st.total / st.count : 0),
+            (unsigned long)st.p50, (unsigned long)st.p95, (unsigned long)st.p99,
+            (unsigned long)st.max);
+
+        const int count = scope_count();
+        for (int child = id + 1; child < count; child++) {
+            if (state().scopes[child].parent == id) {
+                report_tree(child, level + 1);
+            }
+        }
+    }
+};
+
+} // namespace ei
+
+#define EI_PROFILER_CONCAT_INNER(a, b)  a##b
+#define EI_PROFILER_CONCAT(a, b)        EI_PROFILER_CONCAT_INNER(a, b)
+
+/**
+ * Time the rest of the enclosing block under the given scope name
+ */
+#define EI_PROFILE_SCOPE(name)          ei::profiler::scope EI_PROFILER_CONCAT(_ei_profile_scope_, __LINE__)(name)
+#define EI_PROFILE_REPORT()             ei::profiler::report()
+#define EI_PROFILE_RESET()              ei::profiler::reset()
+
+#else
+
+#define EI_PROFILE_SCOPE(name)
+#define EI_PROFILE_REPORT()
+#define EI_PROFILE_RESET()
+
+#endif // EI_PROFILER_ENABLED == 1
+
 class EiProfiler {
 public:
     EiProfiler()
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EIDSP_WORKSPACE_H_
+#define _EIDSP_WORKSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include "../porting/ei_classifier_porting.h"
+#include "config.hpp"
+
+#if EIDSP_STATIC_WORKSPACE == 1
+
+#include <atomic>
+
+#ifndef __has_include
+#define __has_include 1
+#endif // __has_include
+
+#if __has_include("model-parameters/model_metadata.h")
+#include "model-parameters/model_metadata.h"
+#endif
+
+// Size of the static DSP workspace. The default covers a copy of the raw window
+// plus the intermediate matrices of the DSP blocks. Check workspace::high_water()
+// and workspace::heap_fallbacks() after a few windows to tune it.
+#ifndef EIDSP_STATIC_WORKSPACE_SIZE
+#if defined(EI_CLASSIFIER_RAW_SAMPLE_COUNT) && defined(EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME)
+#define EIDSP_STATIC_WORKSPACE_SIZE  (EI_CLASSIFIER_RAW_SAMPLE_COUNT * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME * sizeof(float) * 4 + 4096)
+#else
+#define EIDSP_STATIC_WORKSPACE_SIZE  (16 * 1024)
+#endif
+#endif // EIDSP_STATIC_WORKSPACE_SIZE
+
+// Storage class of the per thread workspace state (a few bytes of TLS per task).
+// Define it empty on targets without thread local storage, then only one thread
+// may use the workspace.
+#ifndef EIDSP_WORKSPACE_THREAD_LOCAL
+#define EIDSP_WORKSPACE_THREAD_LOCAL    thread_local
+#endif // EIDSP_WORKSPACE_THREAD_LOCAL
+
+namespace ei {
+
+/**
+ * Bump allocator over a static arena. While a workspace::scope is open, DSP allocations
+ * (matrices, ei_vector, ei_dsp_malloc) are served from the arena; freeing the most recent
+ * block gives it back right away, everything else is reclaimed when the scope closes.
+ * If the arena runs out we fall back to the heap and count it.
+ *
+ * Scopes and suspends are per thread. The arena belongs to the thread whose outermost scope
+ * claimed it, until that scope closes; a scope opened on another thread meanwhile (e.g. DSP and
+ * inference running as separate tasks) allocates from the heap and counts as a fallback.
+ * Allocations made outside a scope go to the heap whatever other threads do.
+ */
+class workspace {
+public:
+    /**
+     * Open the workspace for the lifetime of this object
+     */
+    class scope {
+    public:
+        scope() : _was_active(thread_state().active) {
+            thread_state_t &t = thread_state();
+            if (t.scopes++ == 0) {
+                t.owner = !state().owned.exchange(true, std::memory_order_acquire);
+            }
+            _mark = t.owner ? state().top : 0;
+            t.active = true;
+        }
+        ~scope() {
+            thread_state_t &t = thread_state();
+            if (t.owner) {
+                state().top = _mark;
+            }
+            t.active = _was_active;
+            if (--t.scopes == 0 && t.owner) {
+                t.owner = false;
+                state().owned.store(false, std::memory_order_release);
+            }
+        }
+    private:
+        size_t _mark;
+        bool _was_active;
+    };
+
+    /**
+     * Allocations that outlive the current window (e.g. lazily created DSP state)
+     * must go to the heap, suspend the workspace around them
+     */
+    class suspend {
+    public:
+        suspend() : _was_active(thread_state().active) {
+            thread_state().active = false;
+        }
+        ~suspend() {
+            thread_state().active = _was_active;
+        }
+    private:
+        bool _was_active;
+    };
+
+    static void *allocate(size_t size) {
+        thread_state_t &t = thread_state();
+        if (!t.active) {
+            return ei_malloc(size);
+        }
+
+        workspace_state_t &s = state();
+        // another thread holds the arena
+        if (!t.owner) {
+            s.heap_fallbacks.fetch_add(1, std::memory_order_relaxed);
+            return ei_malloc(size);
+        }
+
+        size_t needed = header_size + ((size + alignment - 1) & ~(alignment - 1));
+        if (s.top + needed > EIDSP_STATIC_WORKSPACE_SIZE) {
+            s.heap_fallbacks.fetch_add(1, std::memory_order_relaxed);
+            return ei_malloc(size);
+        }
+
+        uint8_t *block = arena() + s.top;
+        *(size_t*)block = needed;
+        s.top += needed;
+        if (s.top > s.high_water.load(std::memory_order_relaxed)) {
+            s.high_water.store(s.top, std::memory_order_relaxed);
+        }
+        return block + header_size;
+    }
+
+    static void *allocate_zeroed(size_t num, size_t size) {
+        void *ptr = allocate(num * size);
+        if (ptr) {
+            memset(ptr, 0, num * size);
+        }
+        return ptr;
+    }
+
+    static void deallocate(void *ptr) {
+        uint8_t *p = (uint8_t*)ptr;
+        if (p < arena() || p >= arena() + EIDSP_STATIC_WORKSPACE_SIZE) {
+            ei_free(ptr);
+            return;
+        }
+
+        // only the last block can be handed back, the rest goes when the scope closes
+        workspace_state_t &s = state();
+        uint8_t *block = p - header_size;
+        if (thread_state().owner && block + *(size_t*)block == arena() + s.top) {
+            s.top = block - arena();
+        }
+    }
+
+    /**
+     * Peak number of arena bytes in use since boot
+     */
+    static size_t high_water() {
+        return state().high_water.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Number of allocations in a scope that went to the heap, because they did not fit
+     * in the arena or another thread held it
+     */
+    static uint32_t heap_fallbacks() {
+        return state().heap_fallbacks.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t alignment = 8;
+    static const size_t header_size = 8;
+
+    // arena state, only the thread that owns the arena touches top
+    typedef struct {
+        size_t top;
+        std::atomic<bool> owned;
+        std::atomic<size_t> high_water;
+        std::atomic<uint32_t> heap_fallbacks;
+    } workspace_state_t;
+
+    typedef struct {
+        bool active;        // in a scope and not suspended
+        bool owner;         // the outermost scope of this thread holds the arena
+        uint32_t scopes;    // open scopes on this thread
+    } thread_state_t;
+
+    static workspace_state_t &state() {
+        static workspace_state_t s = { 0, { false }, { 0 }, { 0 } };
+        return s;
+    }
+
+    static thread_state_t &thread_state() {
+        static EIDSP_WORKSPACE_THREAD_LOCAL thread_state_t t = { false, false, 0 };
+        return t;
+    }
+
+    static uint8_t *arena() {
+        alignas(8) static uint8_t buffer[EIDSP_STATIC_WORKSPACE_SIZE];
+        return buffer;
+    }
+};
+
+} // namespace ei
+
+#define ei_workspace_malloc(size)       ei::workspace::allocate(size)
+#define ei_workspace_calloc(num, size)  ei::workspace::allocate_zeroed(num, size)
+#define ei_workspace_free(ptr)          ei::workspace::deallocate(ptr)
+
+#else
+
+#define ei_workspace_malloc             ei_malloc
+#define ei_workspace_calloc             ei_calloc
+#define ei_workspace_free               ei_free
+
+#endif // EIDSP_STATIC_WORKSPACE == 1
+
+#endif // _EIDSP_WORKSPACE_H_
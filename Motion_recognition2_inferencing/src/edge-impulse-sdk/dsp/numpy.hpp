@@ -32,6 +32,7 @@
 #include <cfloat>
 #include "ei_vector.h"
 #include <algorithm>
+#include <atomic>
 #include "numpy_types.h"
 #include "config.hpp"
 #include "returntypes.hpp"
@@ -1238,8 +1239,8 @@ public:
         }
         else {
             // hardware acceleration only works for the powers above...
-            arm_rfft_fast_instance_f32 rfft_instance;
-            int status = cmsis_rfft_init_f32(&rfft_instance, n_fft);
+            arm_rfft_fast_instance_f32 *rfft_instance;
+            int status = cmsis_rfft_plan(n_fft, &rfft_instance);
             if (status != ARM_MATH_SUCCESS) {
                 return status;
             }
@@ -1249,7 +1250,7 @@ public:
                 EIDSP_ERR(EIDSP_OUT_OF_MEM);
             }
 
-            arm_rfft_fast_f32(&rfft_instance, fft_input.buffer, fft_output.buffer, 0);
+            arm_rfft_fast_f32(rfft_instance, fft_input.buffer, fft_output.buffer, 0);
 
             output[0] = fft_output.buffer[0];
             output[n_fft_out_features - 1] = fft_output.buffer[1];
@@ -1323,8 +1324,8 @@ public:
         }
         else {
             // hardware acceleration only works for the powers above...
-            arm_rfft_fast_instance_f32 rfft_instance;
-            int status = cmsis_rfft_init_f32(&rfft_instance, n_fft);
+            arm_rfft_fast_instance_f32 *rfft_instance;
+            int status = cmsis_rfft_plan(n_fft, &rfft_instance);
             if (status != ARM_MATH_SUCCESS) {
                 return status;
             }
@@ -1334,7 +1335,7 @@ public:
                 EIDSP_ERR(EIDSP_OUT_OF_MEM);
             }
 
-            arm_rfft_fast_f32(&rfft_instance, fft_input.buffer, fft_output.buffer, 0);
+            arm_rfft_fast_f32(rfft_instance, fft_input.buffer, fft_output.buffer, 0);
 
             output[0].r = fft_output.buffer[0];
             output[0].i = 0.0f;
@@ -1479,6 +1480,8 @@ public:
     static int signal_from_buffer(const float *data, size_t data_size, signal_t *signal)
     {
         signal->total_length = data_size;
+        signal->buffer = data;
+        signal->buffer_type = EI_SIGNAL_BUFFER_FLOAT32;
 #ifdef __MBED__
         signal->get_data = mbed::callback(&numpy::signal_get_data, data);
 #else
@@ -1489,6 +1492,29 @@ public:
         return EIDSP_OK;
     }
 
+    /**
+     * Create a signal structure from an int16 buffer (e.g. raw interleaved sensor samples),
+     * values are converted to float when read.
+     * @param data Buffer, make sure to keep this pointer alive
+     * @param data_size Size of the buffer
+     * @param signal Output signal
+     * @returns EIDSP_OK if ok
+     */
+    static int signal_from_int16_buffer(const int16_t *data, size_t data_size, signal_t *signal)
+    {
+        signal->total_length = data_size;
+        signal->buffer = data;
+        signal->buffer_type = EI_SIGNAL_BUFFER_INT16;
+#ifdef __MBED__
+        signal->get_data = mbed::callback(&numpy::signal_get_data_int16_to_float, data);
+#else
+        signal->get_data = [data](size_t offset, size_t length, float *out_ptr) {
+            return numpy::signal_get_data_int16_to_float(data, offset, length, out_ptr);
+        };
+#endif
+        return EIDSP_OK;
+    }
+
 #endif
 
 #if defined ( __GNUC__ )
@@ -1694,6 +1720,172 @@ public:
         return EIDSP_OK;
     }
 
+    /**
+     * Entry in the process-wide FFT plan cache. A plan holds scratch memory,
+     * busy keeps it to one caller at a time (e.g. DSP on several host threads).
+     */
+    typedef struct {
+        size_t n_fft;
+        int inverse_fft;
+        kiss_fftr_cfg cfg;
+        size_t mem_length;
+        std::atomic<bool> busy;
+    } kiss_fftr_plan_t;
+
+    static kiss_fftr_plan_t *kiss_fftr_plans() {
+        static kiss_fftr_plan_t plans[EIDSP_FFT_PLAN_CACHE_SIZE] = { };
+        return plans;
+    }
+
+    /**
+     * Get a kissfft real FFT plan for n_fft / direction. Plans are created on first use
+     * and kept in the plan cache (and counted once by the allocation tracker),
+     * when the cache is full (or disabled) a plan is allocated for this call only.
+     * A cached plan belongs to the caller until it is released; a thread that finds
+     * the plan in use by another one gets a second plan (cached if there is room).
+     * @param n_fft FFT length
+     * @param inverse_fft 1 for the inverse transform
+     * @param mem_length Out: size of the plan in bytes
+     * @returns plan, or NULL if out of memory. Hand back with kiss_fftr_plan_release
+     */
+    static kiss_fftr_cfg kiss_fftr_plan_acquire(size_t n_fft, int inverse_fft, size_t *mem_length) {
+#if EIDSP_FFT_PLAN_CACHE == 1
+        kiss_fftr_plan_t *plans = kiss_fftr_plans();
+        kiss_fftr_plan_t *free_slot = NULL;
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (plans[ix].busy.exchange(true, std::memory_order_acquire)) {
+                continue;
+            }
+            if (plans[ix].cfg && plans[ix].n_fft == n_fft && plans[ix].inverse_fft == inverse_fft) {
+                if (free_slot) {
+                    free_slot->busy.store(false, std::memory_order_release);
+                }
+                *mem_length = plans[ix].mem_length;
+                return plans[ix].cfg;
+            }
+            // keep the first empty slot claimed, in case there is no plan yet
+            if (!plans[ix].cfg && !free_slot) {
+                free_slot = &plans[ix];
+                continue;
+            }
+            plans[ix].busy.store(false, std::memory_order_release);
+        }
+#endif
+
+        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, inverse_fft, NULL, NULL, mem_length);
+        if (!cfg) {
+#if EIDSP_FFT_PLAN_CACHE == 1
+            if (free_slot) {
+                free_slot->busy.store(false, std::memory_order_release);
+            }
+#endif
+            return NULL;
+        }
+
+        ei_dsp_register_alloc(*mem_length, cfg);
+
+#if EIDSP_FFT_PLAN_CACHE == 1
+        if (free_slot) {
+            free_slot->n_fft = n_fft;
+            free_slot->inverse_fft = inverse_fft;
+            free_slot->cfg = cfg;
+            free_slot->mem_length = *mem_length;
+        }
+#endif
+
+        return cfg;
+    }
+
+    /**
+     * Hand back a plan from kiss_fftr_plan_acquire. Cached plans stay alive.
+     */
+    static void kiss_fftr_plan_release(kiss_fftr_cfg cfg, size_t mem_length) {
+#if EIDSP_FFT_PLAN_CACHE == 1
+        kiss_fftr_plan_t *plans = kiss_fftr_plans();
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (plans[ix].cfg == cfg) {
+                plans[ix].busy.store(false, std::memory_order_release);
+                return;
+            }
+        }
+#endif
+        ei_dsp_free(cfg, mem_length);
+    }
+
+    /**
+     * Create the plan for an FFT length up front, so the first window doesn't pay for it
+     * @param n_fft FFT length
+     * @returns 0 if OK
+     */
+    static int fft_plan_preload(size_t n_fft) {
+#if EIDSP_USE_CMSIS_DSP
+        if (n_fft == 32 || n_fft == 64 || n_fft == 128 || n_fft == 256 ||
+            n_fft == 512 || n_fft == 1024 || n_fft == 2048 || n_fft == 4096) {
+            arm_rfft_fast_instance_f32 *rfft_instance;
+            return cmsis_rfft_plan(n_fft, &rfft_instance);
+        }
+#endif
+        size_t mem_length;
+        kiss_fftr_cfg cfg = kiss_fftr_plan_acquire(n_fft, 0, &mem_length);
+        if (!cfg) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        kiss_fftr_plan_release(cfg, mem_length);
+        return EIDSP_OK;
+    }
+
+    /**
+     * Create the plans for all FFT lengths the model was exported with (EI_CLASSIFIER_LOAD_FFT_*)
+     * @returns 0 if OK
+     */
+    static int fft_plan_preload() {
+        int ret = EIDSP_OK;
+#if EI_CLASSIFIER_LOAD_FFT_32 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(32);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_64 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(64);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_128 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(128);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_256 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(256);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_512 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(512);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_1024 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(1024);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_2048 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(2048);
+#endif
+#if EI_CLASSIFIER_LOAD_FFT_4096 == 1
+        if (ret == EIDSP_OK) ret = fft_plan_preload(4096);
+#endif
+        return ret;
+    }
+
+    /**
+     * Free all cached FFT plans (no FFT may be running)
+     */
+    static void fft_plan_cache_clear() {
+        kiss_fftr_plan_t *plans = kiss_fftr_plans();
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (plans[ix].cfg) {
+                ei_dsp_free(plans[ix].cfg, plans[ix].mem_length);
+                plans[ix].cfg = NULL;
+            }
+        }
+#if EIDSP_USE_CMSIS_DSP
+        cmsis_rfft_plan_t *cmsis_plans = cmsis_rfft_plans();
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            cmsis_plans[ix].n_fft = 0;
+        }
+#endif
+    }
+
     static int software_rfft(float *fft_input, float *output, size_t n_fft, size_t n_fft_out_features) {
         kiss_fft_cpx *fft_output = (kiss_fft_cpx*)ei_dsp_malloc(n_fft_out_features * sizeof(kiss_fft_cpx));
         if (!fft_output) {
@@ -1702,15 +1894,13 @@ public:
 
         size_t kiss_fftr_mem_length;
 
-        // create fftr context
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
+        // create fftr context, or take it from the plan cache
+        kiss_fftr_cfg cfg = kiss_fftr_plan_acquire(n_fft, 0, &kiss_fftr_mem_length);
         if (!cfg) {
             ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        ei_dsp_register_alloc(kiss_fftr_mem_length, cfg);
-
         // execute the rfft operation
         kiss_fftr(cfg, fft_input, fft_output);
 
@@ -1719,7 +1909,7 @@ public:
             output[ix] = sqrt(pow(fft_output[ix].r, 2) + pow(fft_output[ix].i, 2));
         }
 
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
+        kiss_fftr_plan_release(cfg, kiss_fftr_mem_length);
         ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
 
         return EIDSP_OK;
@@ -1727,20 +1917,18 @@ public:
 
     static int software_rfft(float *fft_input, fft_complex_t *output, size_t n_fft, size_t n_fft_out_features)
     {
-        // create fftr context
+        // create fftr context, or take it from the plan cache
         size_t kiss_fftr_mem_length;
 
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
+        kiss_fftr_cfg cfg = kiss_fftr_plan_acquire(n_fft, 0, &kiss_fftr_mem_length);
         if (!cfg) {
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        ei_dsp_register_alloc(kiss_fftr_mem_length, cfg);
-
         // execute the rfft operation
         kiss_fftr(cfg, fft_input, (kiss_fft_cpx*)output);
 
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
+        kiss_fftr_plan_release(cfg, kiss_fftr_mem_length);
 
         return EIDSP_OK;
     }
@@ -1751,6 +1939,14 @@ public:
         return 0;
     }
 
+    static int signal_get_data_int16_to_float(const int16_t *in_buffer, size_t offset, size_t length, float *out_ptr)
+    {
+        for (size_t ix = 0; ix < length; ix++) {
+            out_ptr[ix] = (float)in_buffer[offset + ix];
+        }
+        return 0;
+    }
+
     static int signal_get_data_i16(int16_t *in_buffer, size_t offset, size_t length, int16_t *out_ptr)
     {
         memcpy(out_ptr, in_buffer + offset, length * sizeof(int16_t));
@@ -2154,6 +2350,50 @@ public:
         return arm_rfft_fast_init_f32(rfft_instance, n_fft);
 #endif
     }
+
+    typedef struct {
+        size_t n_fft;
+        arm_rfft_fast_instance_f32 instance;
+    } cmsis_rfft_plan_t;
+
+    static cmsis_rfft_plan_t *cmsis_rfft_plans() {
+        static cmsis_rfft_plan_t plans[EIDSP_FFT_PLAN_CACHE_SIZE] = { };
+        return plans;
+    }
+
+    /**
+     * Get an initialized CMSIS-DSP fast rfft instance for n_fft. Instances only point
+     * into the constant tables, so they are cached without touching the heap.
+     */
+    static int cmsis_rfft_plan(const size_t n_fft, arm_rfft_fast_instance_f32 **rfft_instance)
+    {
+#if EIDSP_FFT_PLAN_CACHE == 1
+        cmsis_rfft_plan_t *plans = cmsis_rfft_plans();
+        cmsis_rfft_plan_t *free_slot = NULL;
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            if (plans[ix].n_fft == n_fft) {
+                *rfft_instance = &plans[ix].instance;
+                return ARM_MATH_SUCCESS;
+            }
+            if (plans[ix].n_fft == 0 && !free_slot) {
+                free_slot = &plans[ix];
+            }
+        }
+        if (free_slot) {
+            int status = cmsis_rfft_init_f32(&free_slot->instance, n_fft);
+            if (status != ARM_MATH_SUCCESS) {
+                return status;
+            }
+            free_slot->n_fft = n_fft;
+            *rfft_instance = &free_slot->instance;
+            return ARM_MATH_SUCCESS;
+        }
+#endif
+        // cache full (or disabled), reinitialize a single scratch instance
+        static arm_rfft_fast_instance_f32 scratch_instance;
+        *rfft_instance = &scratch_instance;
+        return cmsis_rfft_init_f32(&scratch_instance, n_fft);
+    }
 #endif // #if EIDSP_USE_CMSIS_DSP
 
     /**
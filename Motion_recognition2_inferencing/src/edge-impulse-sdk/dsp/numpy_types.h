@@ -91,7 +91,7 @@ typedef struct ei_matrix {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (float*)ei_calloc(n_rows * n_cols * sizeof(float), 1);
+            buffer = (float*)ei_workspace_calloc(n_rows * n_cols * sizeof(float), 1);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -116,7 +116,7 @@ typedef struct ei_matrix {
 
     ~ei_matrix() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei_workspace_free(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -190,7 +190,7 @@ typedef struct ei_matrix_i8 {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (int8_t*)ei_calloc(n_rows * n_cols * sizeof(int8_t), 1);
+            buffer = (int8_t*)ei_workspace_calloc(n_rows * n_cols * sizeof(int8_t), 1);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -215,7 +215,7 @@ typedef struct ei_matrix_i8 {
 
     ~ei_matrix_i8() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei_workspace_free(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -286,7 +286,7 @@ typedef struct ei_matrix_i32 {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (int32_t*)ei_calloc(n_rows * n_cols * sizeof(int32_t), 1);
+            buffer = (int32_t*)ei_workspace_calloc(n_rows * n_cols * sizeof(int32_t), 1);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -311,7 +311,7 @@ typedef struct ei_matrix_i32 {
 
     ~ei_matrix_i32() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei_workspace_free(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -393,7 +393,7 @@ typedef struct ei_quantized_matrix {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (uint8_t*)ei_calloc(n_rows * n_cols * sizeof(uint8_t), 1);
+            buffer = (uint8_t*)ei_workspace_calloc(n_rows * n_cols * sizeof(uint8_t), 1);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -418,7 +418,7 @@ typedef struct ei_quantized_matrix {
 
     ~ei_quantized_matrix() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei_workspace_free(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -489,7 +489,7 @@ typedef struct ei_matrix_u8 {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (uint8_t*)ei_calloc(n_rows * n_cols * sizeof(uint8_t), 1);
+            buffer = (uint8_t*)ei_workspace_calloc(n_rows * n_cols * sizeof(uint8_t), 1);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -514,7 +514,7 @@ typedef struct ei_matrix_u8 {
 
     ~ei_matrix_u8() {
         if (buffer && buffer_managed_by_me) {
-            ei_free(buffer);
+            ei_workspace_free(buffer);
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -556,6 +556,15 @@ typedef enum {
     DCT_NORMALIZATION_ORTHO
 } DCT_NORMALIZATION_MODE;
 
+/**
+ * Contiguous buffer a signal was created from (see numpy::signal_from_buffer)
+ */
+typedef enum {
+    EI_SIGNAL_BUFFER_NONE = 0,
+    EI_SIGNAL_BUFFER_FLOAT32,
+    EI_SIGNAL_BUFFER_INT16
+} ei_signal_buffer_type_t;
+
 /**
  * Sensor signal structure
  */
@@ -578,6 +587,73 @@ typedef struct ei_signal_t {
 #endif // EIDSP_SIGNAL_C_FN_POINTER == 1
 
     size_t total_length;
+
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+    /**
+     * Optional backing buffer, set by numpy::signal_from_buffer and
+     * numpy::signal_from_int16_buffer. When set, get_data_strided() reads it
+     * directly instead of calling get_data.
+     */
+    const void *buffer = nullptr;
+    ei_signal_buffer_type_t buffer_type = EI_SIGNAL_BUFFER_NONE;
+
+    /**
+     * Gather every stride'th value of the signal:
+     * out_ptr[ix * out_stride] = signal[offset + ix * stride] for ix < count
+     * @param offset The offset of the first value in the signal
+     * @param stride Distance between two values in the signal (e.g. values per frame)
+     * @param count Number of values to gather
+     * @param out_ptr Out buffer
+     * @param out_stride Distance between two values in out_ptr
+     * @returns 0 if OK
+     */
+    int get_data_strided(size_t offset, size_t stride, size_t count, float *out_ptr, size_t out_stride = 1) const {
+        if (count == 0) {
+            return 0;
+        }
+        if (buffer_type == EI_SIGNAL_BUFFER_FLOAT32 && buffer) {
+            const float *in = (const float *)buffer + offset;
+            for (size_t ix = 0; ix < count; ix++) {
+                out_ptr[ix * out_stride] = in[ix * stride];
+            }
+            return 0;
+        }
+        if (buffer_type == EI_SIGNAL_BUFFER_INT16 && buffer) {
+            const int16_t *in = (const int16_t *)buffer + offset;
+            for (size_t ix = 0; ix < count; ix++) {
+                out_ptr[ix * out_stride] = (float)in[ix * stride];
+            }
+            return 0;
+        }
+        if (stride == 1 && out_stride == 1) {
+            return get_data(offset, count, out_ptr);
+        }
+
+        // read the span in chunks and pick the values we need
+        float chunk[EIDSP_SIGNAL_GATHER_CHUNK_SIZE];
+        size_t per_chunk = stride <= EIDSP_SIGNAL_GATHER_CHUNK_SIZE ? EIDSP_SIGNAL_GATHER_CHUNK_SIZE / stride : 1;
+        for (size_t ix = 0; ix < count; ix += per_chunk) {
+            size_t n = count - ix < per_chunk ? count - ix : per_chunk;
+            size_t span = (n - 1) * stride + 1;
+            if (span > EIDSP_SIGNAL_GATHER_CHUNK_SIZE) {
+                // stride larger than the chunk, one value at a time
+                int r = get_data(offset + ix * stride, 1, &out_ptr[ix * out_stride]);
+                if (r != 0) {
+                    return r;
+                }
+                continue;
+            }
+            int r = get_data(offset + ix * stride, span, chunk);
+            if (r != 0) {
+                return r;
+            }
+            for (size_t jx = 0; jx < n; jx++) {
+                out_ptr[(ix + jx) * out_stride] = chunk[jx * stride];
+            }
+        }
+        return 0;
+    }
+#endif // EIDSP_SIGNAL_C_FN_POINTER == 0
 } signal_t;
 
 #ifdef __cplusplus
@@ -20,11 +20,20 @@
 
 #include <stdint.h>
 #include "processing.hpp"
+#include "moments.hpp"
+#include "sliding_dft.hpp"
 #include "wavelet.hpp"
 #include "signal.hpp"
 #include "edge-impulse-sdk/dsp/ei_utils.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
+#include "edge-impulse-sdk/classifier/ei_quantize.h"
 #include "model-parameters/model_metadata.h"
 
+// Features per axis that extract_spec_features keeps on the stack when writing quantized output
+#ifndef EI_SPECTRAL_QUANTIZED_ROW_STACK
+#define EI_SPECTRAL_QUANTIZED_ROW_STACK 64
+#endif
+
 namespace ei {
 namespace spectral {
 
@@ -34,6 +43,18 @@ typedef enum {
     filter_highpass = 2
 } filter_t;
 
+/**
+ * int8 destination for features, e.g. the input tensor of a quantized model.
+ * Every feature is quantized on the way out (like the model input:
+ * value / scale + zero_point, saturated) instead of being written as float.
+ */
+typedef struct {
+    int8_t *buffer;
+    size_t size;
+    float scale;
+    int32_t zero_point;
+} quantized_features_t;
+
 class feature {
 public:
 
@@ -116,7 +137,10 @@ public:
 
             // calculate FFT
             EI_DSP_MATRIX(fft_matrix, 1, fft_length / 2 + 1);
-            ret = numpy::rfft(axis_matrix.buffer, axis_matrix.cols, fft_matrix.buffer, fft_matrix.cols, fft_length);
+            {
+                EI_PROFILE_SCOPE("spectral.fft");
+                ret = numpy::rfft(axis_matrix.buffer, axis_matrix.cols, fft_matrix.buffer, fft_matrix.cols, fft_length);
+            }
             if (ret != EIDSP_OK) {
                 EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
             }
@@ -126,8 +150,11 @@ public:
 
             // we're now using the FFT matrix to calculate peaks etc.
             EI_DSP_MATRIX(peaks_matrix, fft_peaks, 2);
-            ret = spectral::processing::find_fft_peaks(&fft_matrix, &peaks_matrix,
-                sampling_freq, fft_peaks_threshold, fft_length);
+            {
+                EI_PROFILE_SCOPE("spectral.peaks");
+                ret = spectral::processing::find_fft_peaks(&fft_matrix, &peaks_matrix,
+                    sampling_freq, fft_peaks_threshold, fft_length);
+            }
             if (ret != EIDSP_OK) {
                 EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
             }
@@ -323,6 +350,14 @@ public:
     /**
      * @brief Calculates the spectral analysis features.
      *
+     * @param moments Optional running moments per row (axis) of the unscaled input,
+     *  used instead of recomputing mean, RMS, skewness and kurtosis over the window.
+     *  Ignored when the signal gets filtered first.
+     * @param welch Optional sliding DFT engine per row (axis), fed with the same unscaled
+     *  samples as moments, used instead of numpy::welch_max_hold. Only used together with moments.
+     * @param quantized Optional int8 destination, replaces output_matrix (which may be nullptr).
+     *  The features of every row are built in a small float scratch row and quantized from there.
+     *
      * @return the number of features calculated
      */
     static size_t extract_spec_features(
@@ -331,7 +366,10 @@ public:
         ei_dsp_config_spectral_analysis_t *config,
         const float sampling_freq,
         const bool remove_mean = true,
-        const bool transpose_and_scale_input = true)
+        const bool transpose_and_scale_input = true,
+        const running_moments *const *moments = nullptr,
+        const sliding_welch *const *welch = nullptr,
+        const quantized_features_t *quantized = nullptr)
     {
         if (transpose_and_scale_input) {
             // transpose the matrix so we have one row per axis
@@ -369,7 +407,24 @@ public:
             is_high_pass = true;
         }
 
-        if (remove_mean){
+        // the running moments describe the raw (unscaled, unfiltered) signal
+        if ((do_filter && config->filter_order) || !remove_mean || !transpose_and_scale_input) {
+            moments = nullptr;
+        }
+        const float moments_scale = config->scale_axes;
+
+        if (moments) {
+            EI_PROFILE_SCOPE("spectral.mean");
+            for (size_t row = 0; row < input_matrix->rows; row++) {
+                float mean = moments[row]->mean() * moments_scale;
+                float *data_window = input_matrix->get_row_ptr(row);
+                for (size_t i = 0; i < input_matrix->cols; i++) {
+                    data_window[i] -= mean;
+                }
+            }
+        }
+        else if (remove_mean){
+            EI_PROFILE_SCOPE("spectral.mean");
             EI_TRY(processing::subtract_mean(input_matrix));
         }
 
@@ -390,59 +445,98 @@ public:
         }
         size_t num_bins = stop_bin - start_bin;
 
-        float *feature_out = output_matrix->buffer;
-        const float *feature_out_ori = feature_out;
+        // moments (3), FFT skew and kurtosis (v4 only) and the bins of one row,
+        // on the stack unless the FFT is long
+        const size_t row_size = 3 + (config->implementation_version == 4 ? 2 : 0) + num_bins;
+        float row_stack[EI_SPECTRAL_QUANTIZED_ROW_STACK];
+        ei_vector<float> row_heap(quantized && row_size > EI_SPECTRAL_QUANTIZED_ROW_STACK ? row_size : 0);
+        float *row_scratch = row_size > EI_SPECTRAL_QUANTIZED_ROW_STACK ? row_heap.data() : row_stack;
+
+        float *feature_out = quantized ? row_scratch : output_matrix->buffer;
+        size_t num_features = 0;
         for (size_t row = 0; row < input_matrix->rows; row++) {
+            float *row_out = feature_out;
             float *data_window = input_matrix->get_row_ptr(row);
             size_t data_size = input_matrix->cols;
 
-            matrix_t rms_in_matrix(1, data_size, data_window);
-            matrix_t rms_out_matrix(1, 1, feature_out);
-            EI_TRY(numpy::rms(&rms_in_matrix, &rms_out_matrix));
-
-            feature_out++;
+            const sliding_welch *row_welch = nullptr;
+            if (moments && welch && welch[row] &&
+                welch[row]->matches(data_size, config->fft_length, config->do_fft_overlap) &&
+                welch[row]->ready()) {
+                row_welch = welch[row];
+            }
 
-            // Standard Deviation
-            float stddev = *(feature_out-1); //= sqrt(numpy::variance(data_window, data_size));
-            if (stddev == 0.0f) {
-                stddev = 1e-10f;
+            if (moments) {
+                EI_PROFILE_SCOPE("spectral.moments");
+                // RMS scales with the axis, skew flips sign with it, kurtosis is scale invariant
+                *feature_out++ = moments[row]->rms() * fabs(moments_scale);
+                *feature_out++ = moments[row]->skew() * (moments_scale < 0 ? -1.0f : 1.0f);
+                *feature_out++ = moments[row]->kurtosis();
             }
-            // Don't add std dev as a feature b/c it's the same as RMS
-            // Skew and Kurtosis w/ shortcut:
-            // See definition at https://en.wikipedia.org/wiki/Skewness
-            // See definition at https://en.wikipedia.org/wiki/Kurtosis
-            // Substitute 0 for mean (b/c it is subtracted out above)
-            // Skew becomes: mean(X^3) / stddev^3
-            // Kurtosis becomes: mean(X^4) / stddev^4
-            // Note, this is the Fisher definition of Kurtosis, so subtract 3
-            // (see https://docs.scipy.org/doc/scipy/reference/generated/scipy.stats.kurtosis.html)
-            float s_sum = 0;
-            float k_sum = 0;
-            float temp;
-            for (size_t i = 0; i < data_size; i++) {
-                temp = data_window[i] * data_window[i] * data_window[i];
-                s_sum += temp;
-                k_sum += temp * data_window[i];
+            else {
+                EI_PROFILE_SCOPE("spectral.moments");
+                matrix_t rms_in_matrix(1, data_size, data_window);
+                matrix_t rms_out_matrix(1, 1, feature_out);
+                EI_TRY(numpy::rms(&rms_in_matrix, &rms_out_matrix));
+
+                feature_out++;
+
+                // Standard Deviation
+                float stddev = *(feature_out-1); //= sqrt(numpy::variance(data_window, data_size));
+                if (stddev == 0.0f) {
+                    stddev = 1e-10f;
+                }
+                // Don't add std dev as a feature b/c it's the same as RMS
+                // Skew and Kurtosis w/ shortcut:
+                // See definition at https://en.wikipedia.org/wiki/Skewness
+                // See definition at https://en.wikipedia.org/wiki/Kurtosis
+                // Substitute 0 for mean (b/c it is subtracted out above)
+                // Skew becomes: mean(X^3) / stddev^3
+                // Kurtosis becomes: mean(X^4) / stddev^4
+                // Note, this is the Fisher definition of Kurtosis, so subtract 3
+                // (see https://docs.scipy.org/doc/scipy/reference/generated/scipy.stats.kurtosis.html)
+                float s_sum = 0;
+                float k_sum = 0;
+                float temp;
+                for (size_t i = 0; i < data_size; i++) {
+                    temp = data_window[i] * data_window[i] * data_window[i];
+                    s_sum += temp;
+                    k_sum += temp * data_window[i];
+                }
+                // Skewness out
+                temp = stddev * stddev * stddev;
+                *feature_out++ = (s_sum / data_size) / temp;
+                // Kurtosis out
+                *feature_out++ = ((k_sum / data_size) / (temp * stddev)) - 3;
             }
-            // Skewness out
-            temp = stddev * stddev * stddev;
-            *feature_out++ = (s_sum / data_size) / temp;
-            // Kurtosis out
-            *feature_out++ = ((k_sum / data_size) / (temp * stddev)) - 3;
 
             if (config->implementation_version == 4) {
 
                 size_t fft_out_size = config->fft_length / 2 + 1;
                 ei_vector<float> fft_out(fft_out_size);
-                EI_TRY(numpy::welch_max_hold(
-                    data_window,
-                    data_size,
-                    fft_out.data(),
-                    0,
-                    fft_out_size,
-                    config->fft_length,
-                    config->do_fft_overlap));
+                {
+                EI_PROFILE_SCOPE("spectral.fft");
+                if (row_welch) {
+                    EI_TRY(row_welch->max_hold(
+                        moments[row]->mean_double(),
+                        moments_scale,
+                        fft_out.data(),
+                        0,
+                        fft_out_size));
+                }
+                else {
+                    EI_TRY(numpy::welch_max_hold(
+                        data_window,
+                        data_size,
+                        fft_out.data(),
+                        0,
+                        fft_out_size,
+                        config->fft_length,
+                        config->do_fft_overlap));
+                }
+                }
 
+                EI_PROFILE_SCOPE("spectral.fft_moments");
                 matrix_t x(1, fft_out.size(), const_cast<float *>(fft_out.data()));
                 matrix_t out(1, 1);
 
@@ -452,7 +546,16 @@ public:
                 for (size_t i = start_bin; i < stop_bin; i++) {
                     feature_out[i - start_bin] = fft_out[i];
                 }
+            } else if (row_welch) {
+                EI_PROFILE_SCOPE("spectral.fft");
+                EI_TRY(row_welch->max_hold(
+                    moments[row]->mean_double(),
+                    moments_scale,
+                    feature_out,
+                    start_bin,
+                    stop_bin));
             } else {
+                EI_PROFILE_SCOPE("spectral.fft");
                 EI_TRY(numpy::welch_max_hold(
                     data_window,
                     data_size,
@@ -463,13 +566,27 @@ public:
                     config->do_fft_overlap));
             }
             if (config->do_log) {
+                EI_PROFILE_SCOPE("spectral.log");
                 numpy::zero_handling(feature_out, num_bins);
                 ei_matrix temp(num_bins, 1, feature_out);
                 numpy::log10(&temp);
             }
             feature_out += num_bins;
+
+            const size_t row_features = feature_out - row_out;
+            if (quantized) {
+                if (num_features + row_features > quantized->size) {
+                    return 0;
+                }
+                int8_t *quantized_out = quantized->buffer + num_features;
+                for (size_t ix = 0; ix < row_features; ix++) {
+                    quantized_out[ix] = static_cast<int8_t>(
+                        pre_cast_quantize(row_out[ix], quantized->scale, quantized->zero_point, true));
+                }
+                feature_out = row_out;
+            }
+            num_features += row_features;
         }
-        size_t num_features = feature_out - feature_out_ori;
         return num_features;
     }
 
@@ -484,6 +601,49 @@ public:
         return n_features == output_matrix->cols ? EIDSP_OK : EIDSP_MATRIX_SIZE_MISMATCH;
     }
 
+    /**
+     * @brief Whether extract_spectral_analysis_features_quantized handles this config:
+     *  FFT analysis, implementation v2 / v3, or v4 without decimation and extra low
+     *  frequency features. Those all come straight out of extract_spec_features.
+     */
+    static bool supports_quantized_output(const ei_dsp_config_spectral_analysis_t *config)
+    {
+        if (strcmp(config->analysis_type, "FFT") != 0) {
+            return false;
+        }
+        if (config->implementation_version == 4) {
+            return config->extra_low_freq == false && config->input_decimation_ratio == 1;
+        }
+        return config->implementation_version == 2 || config->implementation_version == 3;
+    }
+
+    /**
+     * @brief Same features as extract_spectral_analysis_features_v2 / v4, but
+     *  quantized straight into an int8 buffer, without a float output matrix.
+     *
+     * @param moments Optional running moments per axis (v4 only, see extract_spec_features)
+     * @param welch Optional sliding DFT engines per axis (v4 only, see extract_spec_features)
+     */
+    static int extract_spectral_analysis_features_quantized(
+        matrix_t *input_matrix,
+        const quantized_features_t *output,
+        ei_dsp_config_spectral_analysis_t *config,
+        const float sampling_freq,
+        const running_moments *const *moments = nullptr,
+        const sliding_welch *const *welch = nullptr)
+    {
+        if (!supports_quantized_output(config)) {
+            EIDSP_ERR(EIDSP_NOT_SUPPORTED);
+        }
+        if (config->implementation_version != 4) {
+            moments = nullptr;
+            welch = nullptr;
+        }
+        size_t n_features = extract_spec_features(
+            input_matrix, nullptr, config, sampling_freq, true, true, moments, welch, output);
+        return n_features == output->size ? EIDSP_OK : EIDSP_MATRIX_SIZE_MISMATCH;
+    }
+
     static int extract_spectral_analysis_features_v3(
         matrix_t *input_matrix,
         matrix_t *output_matrix,
@@ -575,11 +735,17 @@ public:
         return out_size;
     }
 
+    /**
+     * @param moments Optional running moments per axis of the window (see extract_spec_features)
+     * @param welch Optional sliding DFT engines per axis of the window (see extract_spec_features)
+     */
     static int extract_spectral_analysis_features_v4(
         matrix_t *input_matrix,
         matrix_t *output_matrix,
         ei_dsp_config_spectral_analysis_t *config_p,
-        const float sampling_freq)
+        const float sampling_freq,
+        const running_moments *const *moments = nullptr,
+        const sliding_welch *const *welch = nullptr)
     {
         auto config_copy = *config_p;
         auto config = &config_copy;
@@ -588,7 +754,7 @@ public:
         }
         else if (config->extra_low_freq == false && config->input_decimation_ratio == 1) {
             size_t n_features =
-                extract_spec_features(input_matrix, output_matrix, config, sampling_freq);
+                extract_spec_features(input_matrix, output_matrix, config, sampling_freq, true, true, moments, welch);
             return n_features == output_matrix->cols ? EIDSP_OK : EIDSP_MATRIX_SIZE_MISMATCH;
         }
         else {
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EIDSP_SPECTRAL_MOMENTS_H_
+#define _EIDSP_SPECTRAL_MOMENTS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+// number of add/evict updates after which running_moments asks for a rebase
+#ifndef EIDSP_MOMENTS_REBASE_INTERVAL
+#define EIDSP_MOMENTS_REBASE_INTERVAL    1024
+#endif // EIDSP_MOMENTS_REBASE_INTERVAL
+
+namespace ei {
+namespace spectral {
+
+/**
+ * Running power sums S1..S4 of a sliding window of samples, so the mean, RMS (of the
+ * mean-subtracted signal), skewness and kurtosis used by the spectral features can be
+ * updated in O(1) per sample instead of recomputed over the whole window.
+ *
+ * The sums are kept around a shift (the window mean at the last rebase) in double precision,
+ * which avoids the cancellation of the textbook raw-moment formulas. Add/evict pairs still
+ * accumulate rounding error, so after EIDSP_MOMENTS_REBASE_INTERVAL updates needs_rebase()
+ * returns true and the owner should call rebase() with the current window.
+ */
+class running_moments {
+public:
+    running_moments() {
+        reset();
+    }
+
+    void reset(float shift = 0.0f) {
+        _shift = shift;
+        _n = 0;
+        _s1 = _s2 = _s3 = _s4 = 0.0;
+        _updates = 0;
+    }
+
+    /**
+     * Add a sample entering the window
+     */
+    void add(float x) {
+        double d = (double)x - _shift;
+        double d2 = d * d;
+        _n++;
+        _s1 += d;
+        _s2 += d2;
+        _s3 += d2 * d;
+        _s4 += d2 * d2;
+        _updates++;
+    }
+
+    /**
+     * Remove a sample leaving the window (must have been added before)
+     */
+    void evict(float x) {
+        if (_n == 0) {
+            return;
+        }
+        double d = (double)x - _shift;
+        double d2 = d * d;
+        _n--;
+        _s1 -= d;
+        _s2 -= d2;
+        _s3 -= d2 * d;
+        _s4 -= d2 * d2;
+        _updates++;
+    }
+
+    /**
+     * Recompute the sums from the window, shifted around its mean
+     * @param data First sample of the window
+     * @param count Number of samples in the window
+     * @param stride Distance between two samples (number of interleaved axes)
+     */
+    void rebase(const float *data, size_t count, size_t stride = 1) {
+        double sum = 0.0;
+        for (size_t ix = 0; ix < count; ix++) {
+            sum += data[ix * stride];
+        }
+        reset(count > 0 ? (float)(sum / count) : 0.0f);
+        for (size_t ix = 0; ix < count; ix++) {
+            add(data[ix * stride]);
+        }
+        _updates = 0;
+    }
+
+    bool needs_rebase() const {
+        return _updates >= EIDSP_MOMENTS_REBASE_INTERVAL;
+    }
+
+    size_t count() const {
+        return _n;
+    }
+
+    float mean() const {
+        return (float)mean_double();
+    }
+
+    /**
+     * Mean before rounding to float, for consumers that subtract it from a sum of many samples
+     */
+    double mean_double() const {
+        if (_n == 0) {
+            return 0.0;
+        }
+        return (double)_shift + _s1 / _n;
+    }
+
+    /**
+     * RMS of the mean-subtracted window (population standard deviation)
+     */
+    float rms() const {
+        double m2, m3, m4;
+        central_moments(&m2, &m3, &m4);
+        return (float)sqrt(m2);
+    }
+
+    /**
+     * Skewness, mean(X^3) / stddev^3 over the mean-subtracted window
+     */
+    float skew() const {
+        double m2, m3, m4;
+        central_moments(&m2, &m3, &m4);
+        double stddev = stddev_or_epsilon(m2);
+        return (float)(m3 / (stddev * stddev * stddev));
+    }
+
+    /**
+     * Kurtosis (Fisher definition), mean(X^4) / stddev^4 - 3 over the mean-subtracted window
+     */
+    float kurtosis() const {
+        double m2, m3, m4;
+        central_moments(&m2, &m3, &m4);
+        double stddev = stddev_or_epsilon(m2);
+        double stddev2 = stddev * stddev;
+        return (float)(m4 / (stddev2 * stddev2) - 3.0);
+    }
+
+private:
+    /**
+     * Central moments E[(X-mean)^k] for k = 2..4, from the shifted power sums
+     */
+    void central_moments(double *m2, double *m3, double *m4) const {
+        if (_n == 0) {
+            *m2 = *m3 = *m4 = 0.0;
+            return;
+        }
+        double a1 = _s1 / _n;
+        double a2 = _s2 / _n;
+        double a3 = _s3 / _n;
+        double a4 = _s4 / _n;
+        double a1_2 = a1 * a1;
+
+        *m2 = a2 - a1_2;
+        if (*m2 < 0.0) {
+            *m2 = 0.0;
+        }
+        *m3 = a3 - 3.0 * a1 * a2 + 2.0 * a1_2 * a1;
+        *m4 = a4 - 4.0 * a1 * a3 + 6.0 * a1_2 * a2 - 3.0 * a1_2 * a1_2;
+    }
+
+    // same guard as the batch path, which uses 1e-10 for a flat signal
+    static double stddev_or_epsilon(double m2) {
+        float stddev = (float)sqrt(m2);
+        return stddev == 0.0f ? 1e-10 : (double)stddev;
+    }
+
+    float _shift;
+    size_t _n;
+    double _s1;
+    double _s2;
+    double _s3;
+    double _s4;
+    uint32_t _updates;
+};
+
+} // namespace spectral
+} // namespace ei
+
+#endif // _EIDSP_SPECTRAL_MOMENTS_H_
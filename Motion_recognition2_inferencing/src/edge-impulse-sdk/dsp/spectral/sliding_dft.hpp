@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _EIDSP_SPECTRAL_SLIDING_DFT_H_
+#define _EIDSP_SPECTRAL_SLIDING_DFT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../config.hpp"
+#include "../returntypes.hpp"
+#include "../../porting/ei_classifier_porting.h"
+
+// number of samples after which the sliding DFT sums are recomputed from the samples
+#ifndef EIDSP_SLIDING_DFT_REBASE_INTERVAL
+#define EIDSP_SLIDING_DFT_REBASE_INTERVAL    1024
+#endif // EIDSP_SLIDING_DFT_REBASE_INTERVAL
+
+namespace ei {
+namespace spectral {
+
+/**
+ * Sliding DFT version of numpy::welch_max_hold over the last window_size samples of one axis.
+ *
+ * welch_max_hold cuts the window into segments of fft_points (hop fft_points / 2 with overlap),
+ * the last ones zero padded, and keeps the max power per bin. Here every segment length is a
+ * running DFT updated in O(bins) per sample:
+ *  - full-length segments all come from one running DFT; its power spectrum is kept for the
+ *    last few samples, so segments that ended earlier in the window are a lookup,
+ *  - zero-padded segments always end at the newest sample and have their own running DFT.
+ *
+ * Sums are kept in absolute time (twiddle index (k * t) mod fft_points from a table), so adding
+ * and evicting samples only accumulates additive rounding error, the sums are recomputed every
+ * EIDSP_SLIDING_DFT_REBASE_INTERVAL samples anyway. The mean subtraction of the batch path is
+ * applied at read out: it only affects bin 0 of full segments, and shifts zero-padded segments
+ * by mean * DFT(ones).
+ */
+class sliding_welch {
+public:
+    sliding_welch() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    ~sliding_welch() {
+        free_buffers();
+    }
+
+    /**
+     * Allocate the state for a window / FFT configuration
+     * @param window_size Samples per window (of this axis)
+     * @param fft_points FFT length
+     * @param do_overlap Whether segments overlap by half an FFT
+     * @returns 0 if OK
+     */
+    int init(size_t window_size, size_t fft_points, bool do_overlap) {
+        free_buffers();
+        if (window_size == 0 || fft_points == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        _window_size = window_size;
+        _fft_points = fft_points;
+        _do_overlap = do_overlap;
+        _bins = fft_points / 2 + 1;
+
+        size_t hop = do_overlap ? fft_points / 2 : fft_points;
+        if (hop == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        // same segmentation as welch_max_hold
+        _full_segments = 0;
+        _partial_segments = 0;
+        for (size_t start = 0; start < window_size; start += hop) {
+            if (start + fft_points <= window_size) {
+                _full_segments++;
+            }
+            else {
+                _partial_segments++;
+            }
+        }
+        _hop = hop;
+        // the first full segment ended window_size - fft_points samples ago
+        _history_depth = _full_segments > 0 ? window_size - fft_points + 1 : 0;
+        _ring_size = window_size > fft_points ? window_size : fft_points;
+
+        // spans: [0] full length, [1..] zero-padded segments
+        size_t spans = 1 + _partial_segments;
+        _twiddle = (double*)ei_calloc(fft_points * 2, sizeof(double));
+        _span_length = (size_t*)ei_calloc(spans, sizeof(size_t));
+        _sums = (double*)ei_calloc(spans * _bins * 2, sizeof(double));
+        _ones = (double*)ei_calloc(spans * _bins * 2, sizeof(double));
+        _history = (float*)ei_calloc((_history_depth > 0 ? _history_depth : 1) * _bins, sizeof(float));
+        _history_dc = (double*)ei_calloc(_history_depth > 0 ? _history_depth : 1, sizeof(double));
+        _ring = (float*)ei_calloc(_ring_size, sizeof(float));
+        if (!_twiddle || !_span_length || !_sums || !_ones || !_history || !_history_dc || !_ring) {
+            free_buffers();
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        for (size_t n = 0; n < fft_points; n++) {
+            double phi = -2.0 * M_PI * (double)n / (double)fft_points;
+            _twiddle[n * 2] = cos(phi);
+            _twiddle[n * 2 + 1] = sin(phi);
+        }
+
+        _span_length[0] = fft_points;
+        size_t p = 1;
+        for (size_t start = 0; start < window_size; start += hop) {
+            if (start + fft_points > window_size) {
+                _span_length[p++] = window_size - start;
+            }
+        }
+
+        // DFT of a run of ones of the span length, for the mean correction
+        for (size_t s = 0; s < spans; s++) {
+            for (size_t k = 0; k < _bins; k++) {
+                double re = 0, im = 0;
+                for (size_t n = 0; n < _span_length[s]; n++) {
+                    size_t tw = (k * n) % fft_points;
+                    re += _twiddle[tw * 2];
+                    im += _twiddle[tw * 2 + 1];
+                }
+                _ones[(s * _bins + k) * 2] = re;
+                _ones[(s * _bins + k) * 2 + 1] = im;
+            }
+        }
+
+        reset();
+        return EIDSP_OK;
+    }
+
+    /**
+     * Forget all samples
+     */
+    void reset() {
+        _pushed = 0;
+        _since_rebase = 0;
+        if (_sums) {
+            memset(_sums, 0, (1 + _partial_segments) * _bins * 2 * sizeof(double));
+        }
+    }
+
+    bool matches(size_t window_size, size_t fft_points, bool do_overlap) const {
+        return _ring && _window_size == window_size && _fft_points == fft_points && _do_overlap == do_overlap;
+    }
+
+    /**
+     * Whether a complete window was pushed
+     */
+    bool ready() const {
+        return _ring && _pushed >= _window_size;
+    }
+
+    /**
+     * Add the newest sample, the oldest one leaves the window
+     */
+    void push(float x) {
+        if (!_ring) {
+            return;
+        }
+
+        uint64_t t = _pushed;
+        size_t spans = 1 + _partial_segments;
+        for (size_t s = 0; s < spans; s++) {
+            size_t length = _span_length[s];
+            double *sums = _sums + s * _bins * 2;
+            if (t >= length) {
+                uint64_t t_out = t - length;
+                accumulate(sums, -(double)_ring[t_out % _ring_size], t_out);
+            }
+            accumulate(sums, (double)x, t);
+        }
+
+        _ring[t % _ring_size] = x;
+        _pushed++;
+
+        if (++_since_rebase >= EIDSP_SLIDING_DFT_REBASE_INTERVAL) {
+            rebase();
+        }
+
+        // keep the power spectrum of the full-length span, bin 0 as the plain sum (in double, the
+        // mean is subtracted from it at read out)
+        if (_history_depth > 0) {
+            float *h = _history + (t % _history_depth) * _bins;
+            _history_dc[t % _history_depth] = _sums[0];
+            h[0] = 0.0f;
+            for (size_t k = 1; k < _bins; k++) {
+                double re = _sums[k * 2];
+                double im = _sums[k * 2 + 1];
+                h[k] = (float)(re * re + im * im);
+            }
+        }
+    }
+
+    /**
+     * Max-hold power spectrum of the window, as numpy::welch_max_hold would compute
+     * over the window after subtracting mean and multiplying by scale.
+     * @param output Output, stop_bin - start_bin values
+     * @returns 0 if OK
+     */
+    int max_hold(double mean, float scale, float *output, size_t start_bin, size_t stop_bin) const {
+        if (!ready()) {
+            EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
+        }
+        if (stop_bin > _bins || start_bin > stop_bin) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        const double norm = (double)scale * (double)scale / (double)_fft_points;
+        const uint64_t newest = _pushed - 1;
+
+        memset(output, 0, sizeof(float) * (stop_bin - start_bin));
+
+        for (size_t seg = 0; seg < _full_segments; seg++) {
+            // segment seg ended this many samples before the newest one
+            size_t lag = _window_size - seg * _hop - _fft_points;
+            const float *h = _history + ((newest - lag) % _history_depth) * _bins;
+            const double h_dc = _history_dc[(newest - lag) % _history_depth];
+            for (size_t k = start_bin; k < stop_bin; k++) {
+                double power;
+                if (k == 0) {
+                    double dc = h_dc - mean * (double)_fft_points;
+                    power = dc * dc;
+                }
+                else {
+                    power = h[k];
+                }
+                float v = (float)(power * norm);
+                if (v > output[k - start_bin]) {
+                    output[k - start_bin] = v;
+                }
+            }
+        }
+
+        for (size_t s = 1; s < 1 + _partial_segments; s++) {
+            size_t length = _span_length[s];
+            const double *sums = _sums + s * _bins * 2;
+            const double *ones = _ones + s * _bins * 2;
+            uint64_t span_start = _pushed - length;
+            for (size_t k = start_bin; k < stop_bin; k++) {
+                // sums are relative to absolute time, rotate mean * DFT(ones) to the span start
+                size_t tw = (size_t)((k * (span_start % _fft_points)) % _fft_points);
+                double rot_re = _twiddle[tw * 2];
+                double rot_im = _twiddle[tw * 2 + 1];
+                double m_re = mean * (ones[k * 2] * rot_re - ones[k * 2 + 1] * rot_im);
+                double m_im = mean * (ones[k * 2] * rot_im + ones[k * 2 + 1] * rot_re);
+                double re = sums[k * 2] - m_re;
+                double im = sums[k * 2 + 1] - m_im;
+                float v = (float)((re * re + im * im) * norm);
+                if (v > output[k - start_bin]) {
+                    output[k - start_bin] = v;
+                }
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+private:
+    void accumulate(double *sums, double x, uint64_t t) {
+        size_t phase = (size_t)(t % _fft_points);
+        for (size_t k = 0; k < _bins; k++) {
+            size_t tw = (k * phase) % _fft_points;
+            sums[k * 2] += x * _twiddle[tw * 2];
+            sums[k * 2 + 1] += x * _twiddle[tw * 2 + 1];
+        }
+    }
+
+    /**
+     * Recompute the running sums from the buffered samples
+     */
+    void rebase() {
+        _since_rebase = 0;
+        size_t spans = 1 + _partial_segments;
+        memset(_sums, 0, spans * _bins * 2 * sizeof(double));
+        for (size_t s = 0; s < spans; s++) {
+            size_t length = _span_length[s];
+            uint64_t first = _pushed > length ? _pushed - length : 0;
+            for (uint64_t t = first; t < _pushed; t++) {
+                accumulate(_sums + s * _bins * 2, (double)_ring[t % _ring_size], t);
+            }
+        }
+    }
+
+    void free_buffers() {
+        ei_free(_twiddle);
+        ei_free(_span_length);
+        ei_free(_sums);
+        ei_free(_ones);
+        ei_free(_history);
+        ei_free(_history_dc);
+        ei_free(_ring);
+        _twiddle = nullptr;
+        _span_length = nullptr;
+        _sums = nullptr;
+        _ones = nullptr;
+        _history = nullptr;
+        _history_dc = nullptr;
+        _ring = nullptr;
+    }
+
+    size_t _window_size;
+    size_t _fft_points;
+    bool _do_overlap;
+    size_t _bins;
+    size_t _hop;
+    size_t _full_segments;
+    size_t _partial_segments;
+    size_t _history_depth;
+    size_t _ring_size;
+    uint64_t _pushed;
+    uint32_t _since_rebase;
+
+    double *_twiddle;       // fft_points complex, e^(-j 2 pi n / fft_points)
+    size_t *_span_length;   // per span
+    double *_sums;          // per span, bins complex
+    double *_ones;          // per span, bins complex DFT of ones
+    float *_history;        // history_depth x bins, power of the full-length span
+    double *_history_dc;    // history_depth, plain sum of the full-length span
+    float *_ring;           // last ring_size samples
+};
+
+} // namespace spectral
+} // namespace ei
+
+#endif // _EIDSP_SPECTRAL_SLIDING_DFT_H_
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2022 EdgeImpulse Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an "AS
+ * IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language
+ * governing permissions and limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../ei_classifier_porting.h"
+#if EI_PORTING_POSIX == 1 && EI_PORTING_ARDUINO == 0 && EI_PORTING_ESPRESSIF == 0
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+#define EI_WEAK_FN __attribute__((weak))
+
+EI_WEAK_FN EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
+    return EI_IMPULSE_OK;
+}
+
+EI_WEAK_FN EI_IMPULSE_ERROR ei_sleep(int32_t time_ms) {
+    if (time_ms <= 0) {
+        return EI_IMPULSE_OK;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = time_ms / 1000;
+    ts.tv_nsec = (time_ms % 1000) * 1000000L;
+    // resume after signals until the full time has passed
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+    return EI_IMPULSE_OK;
+}
+
+uint64_t ei_read_timer_us() {
+    // monotonic, so profiling is not affected by wall clock adjustments
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+uint64_t ei_read_timer_ms() {
+    return ei_read_timer_us() / 1000;
+}
+
+EI_WEAK_FN void ei_serial_set_baudrate(int baudrate)
+{
+
+}
+
+EI_WEAK_FN void ei_putchar(char c)
+{
+    putchar(c);
+}
+
+EI_WEAK_FN char ei_getchar()
+{
+    int c = getchar();
+    return c == EOF ? 0 : (char)c;
+}
+
+/**
+ *  Printf function uses vprintf and outputs to stdout
+ */
+EI_WEAK_FN void ei_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+EI_WEAK_FN void ei_printf_float(float f) {
+    ei_printf("%f", f);
+}
+
+EI_WEAK_FN void *ei_malloc(size_t size) {
+    return malloc(size);
+}
+
+EI_WEAK_FN void *ei_calloc(size_t nitems, size_t size) {
+    return calloc(nitems, size);
+}
+
+EI_WEAK_FN void ei_free(void *ptr) {
+    free(ptr);
+}
+
+#endif // EI_PORTING_POSIX == 1 && EI_PORTING_ARDUINO == 0 && EI_PORTING_ESPRESSIF == 0
@@ -0,0 +1,26 @@
+/*
+ * Project settings of this impulse library. dsp/config.hpp and
+ * classifier/ei_classifier_config.h include this file before their defaults,
+ * so every translation unit of the library sees the same settings. Defines in
+ * the sketch do not reach the library's own .cpp files in the Arduino build,
+ * so settings that change inline SDK code belong here (or in build flags,
+ * which take precedence).
+ */
+
+#ifndef _EI_PROJECT_CONFIG_H_
+#define _EI_PROJECT_CONFIG_H_
+
+// Serve DSP scratch buffers from a static arena, so steady-state windows don't touch the heap
+// (see dsp/ei_workspace.h). This also keeps the EON model initialized between windows instead
+// of rebuilding the arena on every inference (EI_CLASSIFIER_PERSISTENT_MODEL).
+#ifndef EIDSP_STATIC_WORKSPACE
+#define EIDSP_STATIC_WORKSPACE       1
+#endif // EIDSP_STATIC_WORKSPACE
+
+// run_classifier_continuous slides 7 of 30 frames per window, update the spectrum of the
+// accelerometer block per sample instead (see dsp/spectral/sliding_dft.hpp)
+#ifndef EIDSP_SPECTRAL_SLIDING_DFT
+#define EIDSP_SPECTRAL_SLIDING_DFT   1
+#endif // EIDSP_SPECTRAL_SLIDING_DFT
+
+#endif // _EI_PROJECT_CONFIG_H_
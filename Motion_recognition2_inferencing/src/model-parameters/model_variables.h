@@ -74,6 +74,8 @@ const ei_config_tflite_eon_graph_t ei_config_tflite_graph_5 = {
     .model_reset = &tflite_learn_5_reset,
     .model_input = &tflite_learn_5_input,
     .model_output = &tflite_learn_5_output,
+    .model_set_profiler = &tflite_learn_5_set_profiler,
+    .model_invoke_batch = &tflite_learn_5_invoke_batch,
 };
 
 const ei_learning_block_config_tflite_graph_t ei_learning_block_config_5 = {
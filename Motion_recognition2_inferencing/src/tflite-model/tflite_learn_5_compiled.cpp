@@ -25,7 +25,14 @@
 #include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_profiler_interface.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/kernels/fully_connected.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_gemm.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_fc_s8.h"
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
+#include "tflite-model/tflite_learn_5_compiled.h"
+#include <new>
 
 #if EI_CLASSIFIER_PRINT_STATE
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
@@ -81,12 +88,8 @@ uint8_t tensor_arena[kTensorArenaSize] ALIGN(16);
 uint8_t tensor_arena[kTensorArenaSize] ALIGN(16) __attribute__((section(".tensor_arena")));
 #else
 #define EI_CLASSIFIER_ALLOCATION_HEAP 1
-uint8_t* tensor_arena = NULL;
 #endif
 
-static uint8_t* tensor_boundary;
-static uint8_t* current_location;
-
 template <int SZ, class T> struct TfArray {
   int sz; T elem[SZ];
 };
@@ -114,24 +117,24 @@ typedef struct {
   int16_t index;
 } TfLiteEvalTensorWithIndex;
 
-TfLiteContext ctx{};
 static const int MAX_TFL_TENSOR_COUNT = 4;
-static TfLiteTensorWithIndex tflTensors[MAX_TFL_TENSOR_COUNT];
 static const int MAX_TFL_EVAL_COUNT = 4;
-static TfLiteEvalTensorWithIndex tflEvalTensors[MAX_TFL_EVAL_COUNT];
-TfLiteRegistration registrations[OP_LAST];
+static const int NODE_COUNT = 4;
+// Batched invokes: rows per tile and the widest int8 activation (bytes per row)
+static const size_t BATCH_TILE = 8;
+static const size_t BATCH_MAX_WIDTH = 39;
 
 namespace g0 {
 const TfArray<2, int> tensor_dimension0 = { 2, { 1,39 } };
 const TfArray<1, float> quant0_scale = { 1, { 2.8098578453063965, } };
 const TfArray<1, int> quant0_zero = { 1, { -127 } };
 const TfLiteAffineQuantization quant0 = { (TfLiteFloatArray*)&quant0_scale, (TfLiteIntArray*)&quant0_zero, 0 };
-const ALIGN(8) int32_t tensor_data1[3] = { -17, 36, -12, };
+constexpr ALIGN(8) int32_t tensor_data1[3] = { -17, 36, -12, };
 const TfArray<1, int> tensor_dimension1 = { 1, { 3 } };
 const TfArray<1, float> quant1_scale = { 1, { 0.003365806769579649, } };
 const TfArray<1, int> quant1_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant1 = { (TfLiteFloatArray*)&quant1_scale, (TfLiteIntArray*)&quant1_zero, 0 };
-const ALIGN(16) int8_t tensor_data2[3*10] = { 
+constexpr ALIGN(16) int8_t tensor_data2[3*10] = { 
   72, 11, 90, -100, -45, 31, 88, -104, -127, 87, 
   80, 89, -8, -64, -119, 45, 37, -84, 30, -20, 
   -102, -27, 114, -6, -108, -119, -102, -56, 111, 36, 
@@ -140,12 +143,12 @@ const TfArray<2, int> tensor_dimension2 = { 2, { 3,10 } };
 const TfArray<1, float> quant2_scale = { 1, { 0.0052973739802837372, } };
 const TfArray<1, int> quant2_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant2 = { (TfLiteFloatArray*)&quant2_scale, (TfLiteIntArray*)&quant2_zero, 0 };
-const ALIGN(16) int32_t tensor_data3[10] = { -1, 34, -17, -7, 0, 33, -2, -4, 6, -13, };
+constexpr ALIGN(16) int32_t tensor_data3[10] = { -1, 34, -17, -7, 0, 33, -2, -4, 6, -13, };
 const TfArray<1, int> tensor_dimension3 = { 1, { 10 } };
 const TfArray<1, float> quant3_scale = { 1, { 0.0047056693583726883, } };
 const TfArray<1, int> quant3_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant3 = { (TfLiteFloatArray*)&quant3_scale, (TfLiteIntArray*)&quant3_zero, 0 };
-const ALIGN(16) int8_t tensor_data4[10*20] = { 
+constexpr ALIGN(16) int8_t tensor_data4[10*20] = { 
   41, -74, -72, 67, 97, 16, 111, -109, -10, -47, 24, 16, 71, 119, 51, -87, 0, -28, -71, 25, 
   -57, -104, 71, 122, 47, -45, -54, -99, -92, 23, -54, -51, 80, 12, 65, 86, -56, 32, -45, -31, 
   -23, -100, -25, 76, -57, -60, -54, 0, -48, -14, 23, 34, -45, -87, -27, -91, 85, -127, -101, -81, 
@@ -161,12 +164,12 @@ const TfArray<2, int> tensor_dimension4 = { 2, { 10,20 } };
 const TfArray<1, float> quant4_scale = { 1, { 0.0037995839957147837, } };
 const TfArray<1, int> quant4_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant4 = { (TfLiteFloatArray*)&quant4_scale, (TfLiteIntArray*)&quant4_zero, 0 };
-const ALIGN(16) int32_t tensor_data5[20] = { 0, -5, 2, 15, -1, -2, -2, -1, -11, -2, 3, -5, 11, -2, 0, 4, -2, 7, 0, 0, };
+constexpr ALIGN(16) int32_t tensor_data5[20] = { 0, -5, 2, 15, -1, -2, -2, -1, -11, -2, 3, -5, 11, -2, 0, 4, -2, 7, 0, 0, };
 const TfArray<1, int> tensor_dimension5 = { 1, { 20 } };
 const TfArray<1, float> quant5_scale = { 1, { 0.010103249922394753, } };
 const TfArray<1, int> quant5_zero = { 1, { 0 } };
 const TfLiteAffineQuantization quant5 = { (TfLiteFloatArray*)&quant5_scale, (TfLiteIntArray*)&quant5_zero, 0 };
-const ALIGN(16) int8_t tensor_data6[20*39] = { 
+constexpr ALIGN(16) int8_t tensor_data6[20*39] = { 
   0, -12, -19, 72, 25, 42, 25, -56, 29, -70, -3, 31, -77, -57, -19, 77, 22, 63, -42, -42, 75, -23, 73, 15, -80, 55, -43, -43, -61, -78, 21, 27, 52, -72, -82, 38, -54, 63, -8, 
   -99, -9, 71, -1, -17, 0, 13, 12, 24, 66, -69, 22, -2, 4, 55, -52, 52, 31, 74, -66, -29, -22, 58, -31, 31, 28, -29, 62, -25, -76, -2, 67, 60, 69, 45, -41, -84, -23, 8, 
   61, -1, -85, -55, 41, -38, 60, 80, 90, -1, -60, 21, -57, 46, -76, 67, 29, 50, 9, 43, 94, -75, 56, -62, 17, -16, 88, 54, -47, -64, -37, 64, 50, -57, -11, -22, -68, 1, 56, 
@@ -222,29 +225,38 @@ const TfArray<1, int> inputs3 = { 1, { 9 } };
 const TfArray<1, int> outputs3 = { 1, { 10 } };
 };
 
+// FULLY_CONNECTED biases with the input zero point folded in (FullyConnectedS8)
+namespace g0 {
+constexpr int32_t folded_bias0[20] = { ei_fc_s8_fold_bias(&tensor_data6[0*39], 39, tensor_data5[0], 127), ei_fc_s8_fold_bias(&tensor_data6[1*39], 39, tensor_data5[1], 127), ei_fc_s8_fold_bias(&tensor_data6[2*39], 39, tensor_data5[2], 127), ei_fc_s8_fold_bias(&tensor_data6[3*39], 39, tensor_data5[3], 127), ei_fc_s8_fold_bias(&tensor_data6[4*39], 39, tensor_data5[4], 127), ei_fc_s8_fold_bias(&tensor_data6[5*39], 39, tensor_data5[5], 127), ei_fc_s8_fold_bias(&tensor_data6[6*39], 39, tensor_data5[6], 127), ei_fc_s8_fold_bias(&tensor_data6[7*39], 39, tensor_data5[7], 127), ei_fc_s8_fold_bias(&tensor_data6[8*39], 39, tensor_data5[8], 127), ei_fc_s8_fold_bias(&tensor_data6[9*39], 39, tensor_data5[9], 127), ei_fc_s8_fold_bias(&tensor_data6[10*39], 39, tensor_data5[10], 127), ei_fc_s8_fold_bias(&tensor_data6[11*39], 39, tensor_data5[11], 127), ei_fc_s8_fold_bias(&tensor_data6[12*39], 39, tensor_data5[12], 127), ei_fc_s8_fold_bias(&tensor_data6[13*39], 39, tensor_data5[13], 127), ei_fc_s8_fold_bias(&tensor_data6[14*39], 39, tensor_data5[14], 127), ei_fc_s8_fold_bias(&tensor_data6[15*39], 39, tensor_data5[15], 127), ei_fc_s8_fold_bias(&tensor_data6[16*39], 39, tensor_data5[16], 127), ei_fc_s8_fold_bias(&tensor_data6[17*39], 39, tensor_data5[17], 127), ei_fc_s8_fold_bias(&tensor_data6[18*39], 39, tensor_data5[18], 127), ei_fc_s8_fold_bias(&tensor_data6[19*39], 39, tensor_data5[19], 127), };
+constexpr int32_t folded_bias1[10] = { ei_fc_s8_fold_bias(&tensor_data4[0*20], 20, tensor_data3[0], 128), ei_fc_s8_fold_bias(&tensor_data4[1*20], 20, tensor_data3[1], 128), ei_fc_s8_fold_bias(&tensor_data4[2*20], 20, tensor_data3[2], 128), ei_fc_s8_fold_bias(&tensor_data4[3*20], 20, tensor_data3[3], 128), ei_fc_s8_fold_bias(&tensor_data4[4*20], 20, tensor_data3[4], 128), ei_fc_s8_fold_bias(&tensor_data4[5*20], 20, tensor_data3[5], 128), ei_fc_s8_fold_bias(&tensor_data4[6*20], 20, tensor_data3[6], 128), ei_fc_s8_fold_bias(&tensor_data4[7*20], 20, tensor_data3[7], 128), ei_fc_s8_fold_bias(&tensor_data4[8*20], 20, tensor_data3[8], 128), ei_fc_s8_fold_bias(&tensor_data4[9*20], 20, tensor_data3[9], 128), };
+constexpr int32_t folded_bias2[3] = { ei_fc_s8_fold_bias(&tensor_data2[0*10], 10, tensor_data1[0], 128), ei_fc_s8_fold_bias(&tensor_data2[1*10], 10, tensor_data1[1], 128), ei_fc_s8_fold_bias(&tensor_data2[2*10], 10, tensor_data1[2], 128), };
+};
+
+// kTfLiteArenaRw tensors hold their offset into the arena of the model instance
 TensorInfo_t tensorData[] = {
-{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(tensor_arena + 0), (TfLiteIntArray*)&g0::tensor_dimension0, 39, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant0))}, },
+{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(0), (TfLiteIntArray*)&g0::tensor_dimension0, 39, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant0))}, },
 { kTfLiteMmapRo, kTfLiteInt32, (int32_t*)g0::tensor_data1, (TfLiteIntArray*)&g0::tensor_dimension1, 12, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant1))}, },
 { kTfLiteMmapRo, kTfLiteInt8, (int32_t*)g0::tensor_data2, (TfLiteIntArray*)&g0::tensor_dimension2, 30, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant2))}, },
 { kTfLiteMmapRo, kTfLiteInt32, (int32_t*)g0::tensor_data3, (TfLiteIntArray*)&g0::tensor_dimension3, 40, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant3))}, },
 { kTfLiteMmapRo, kTfLiteInt8, (int32_t*)g0::tensor_data4, (TfLiteIntArray*)&g0::tensor_dimension4, 200, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant4))}, },
 { kTfLiteMmapRo, kTfLiteInt32, (int32_t*)g0::tensor_data5, (TfLiteIntArray*)&g0::tensor_dimension5, 80, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant5))}, },
 { kTfLiteMmapRo, kTfLiteInt8, (int32_t*)g0::tensor_data6, (TfLiteIntArray*)&g0::tensor_dimension6, 780, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant6))}, },
-{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(tensor_arena + 48), (TfLiteIntArray*)&g0::tensor_dimension7, 20, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant7))}, },
-{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(tensor_arena + 0), (TfLiteIntArray*)&g0::tensor_dimension8, 10, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant8))}, },
-{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(tensor_arena + 16), (TfLiteIntArray*)&g0::tensor_dimension9, 3, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant9))}, },
-{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(tensor_arena + 0), (TfLiteIntArray*)&g0::tensor_dimension10, 3, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant10))}, },
+{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(48), (TfLiteIntArray*)&g0::tensor_dimension7, 20, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant7))}, },
+{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(0), (TfLiteIntArray*)&g0::tensor_dimension8, 10, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant8))}, },
+{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(16), (TfLiteIntArray*)&g0::tensor_dimension9, 3, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant9))}, },
+{ kTfLiteArenaRw, kTfLiteInt8, (int32_t*)(0), (TfLiteIntArray*)&g0::tensor_dimension10, 3, {kTfLiteAffineQuantization, const_cast<void*>(static_cast<const void*>(&g0::quant10))}, },
 };
 
+// Copied into every model instance (init stores the kernel state in user_data)
 #ifndef TF_LITE_STATIC_MEMORY
-TfLiteNode tflNodes[4] = {
+const TfLiteNode tflNodes[NODE_COUNT] = {
 { (TfLiteIntArray*)&g0::inputs0, (TfLiteIntArray*)&g0::outputs0, (TfLiteIntArray*)&g0::inputs0, nullptr, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata0)), nullptr, 0, },
 { (TfLiteIntArray*)&g0::inputs1, (TfLiteIntArray*)&g0::outputs1, (TfLiteIntArray*)&g0::inputs1, nullptr, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata1)), nullptr, 0, },
 { (TfLiteIntArray*)&g0::inputs2, (TfLiteIntArray*)&g0::outputs2, (TfLiteIntArray*)&g0::inputs2, nullptr, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata2)), nullptr, 0, },
 { (TfLiteIntArray*)&g0::inputs3, (TfLiteIntArray*)&g0::outputs3, (TfLiteIntArray*)&g0::inputs3, nullptr, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata3)), nullptr, 0, },
 };
 #else
-TfLiteNode tflNodes[4] = {
+const TfLiteNode tflNodes[NODE_COUNT] = {
 { (TfLiteIntArray*)&g0::inputs0, (TfLiteIntArray*)&g0::outputs0, (TfLiteIntArray*)&g0::inputs0, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata0)), nullptr, 0, },
 { (TfLiteIntArray*)&g0::inputs1, (TfLiteIntArray*)&g0::outputs1, (TfLiteIntArray*)&g0::inputs1, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata1)), nullptr, 0, },
 { (TfLiteIntArray*)&g0::inputs2, (TfLiteIntArray*)&g0::outputs2, (TfLiteIntArray*)&g0::inputs2, nullptr, const_cast<void*>(static_cast<const void*>(&g0::opdata2)), nullptr, 0, },
@@ -255,6 +267,10 @@ TfLiteNode tflNodes[4] = {
 used_operators_e used_ops[] =
 {OP_FULLY_CONNECTED, OP_FULLY_CONNECTED, OP_FULLY_CONNECTED, OP_SOFTMAX, };
 
+// Profiler tag per node (MicroProfilerInterface events and EI_PROFILE_SCOPE)
+static const char *const node_tags[] =
+{"nn.layer0.fully_connected", "nn.layer1.fully_connected", "nn.layer2.fully_connected", "nn.layer3.softmax", };
+
 
 // Indices into tflTensors and tflNodes for subgraphs
 const size_t tflTensors_subgraph_index[] = {0, 11, };
@@ -270,32 +286,123 @@ static const int out_tensor_indices[] = {
 };
 
 
-size_t current_subgraph_index = 0;
+typedef struct {
+  size_t bytes;
+  void *ptr;
+} scratch_buffer_t;
+
+class EonMicroContext : public MicroContext {
+ public:
+
+  explicit EonMicroContext(tflite_learn_5_model_t *model): MicroContext(nullptr, nullptr, nullptr), model_(model) { }
+
+  void* AllocatePersistentBuffer(size_t bytes);
+
+  TfLiteStatus RequestScratchBufferInArena(size_t bytes,
+                                           int* buffer_index);
+
+  void* GetScratchBuffer(int buffer_index);
+
+  TfLiteTensor* AllocateTempTfLiteTensor(int tensor_index);
+
+  void DeallocateTempTfLiteTensor(TfLiteTensor* tensor) {
+    return;
+  }
+
+  bool IsAllTempTfLiteTensorDeallocated() {
+    return true;
+  }
+
+  TfLiteEvalTensor* GetEvalTensor(int tensor_index);
+
+  tflite_learn_5_model_t *model_;
+};
+
+} // namespace
+
+// Everything one inference touches, so instances can run on different threads
+struct tflite_learn_5_model {
+  tflite_learn_5_model() : micro_context(this) { }
+
+  TfLiteContext ctx{};
+  EonMicroContext micro_context;
+
+  uint8_t* tensor_arena = nullptr;
+  bool tensor_arena_allocated = false;
+  uint8_t* tensor_boundary = nullptr;
+  uint8_t* current_location = nullptr;
+
+  TfLiteTensorWithIndex tflTensors[MAX_TFL_TENSOR_COUNT];
+  TfLiteEvalTensorWithIndex tflEvalTensors[MAX_TFL_EVAL_COUNT];
+  TfLiteRegistration registrations[OP_LAST];
+  TfLiteNode tflNodes[NODE_COUNT];
+  size_t current_subgraph_index = 0;
+
+  scratch_buffer_t scratch_buffers[EI_MAX_SCRATCH_BUFFER_COUNT];
+  size_t scratch_buffers_ix = 0;
+  void* overflow_buffers[EI_MAX_OVERFLOW_BUFFER_COUNT];
+  size_t overflow_buffers_ix = 0;
+  size_t overflow_bytes = 0;
+
+  // Persistent + scratch bytes requested by each node in init / prepare
+  size_t node_arena_bytes[NODE_COUNT];
+  // Quantization parameters of the FULLY_CONNECTED nodes (FullyConnectedS8, batched invokes)
+  OpDataFullyConnected fc_op_data[NODE_COUNT];
+  MicroProfilerInterface *node_profiler = nullptr;
+};
+
+namespace {
 
-static void init_tflite_tensor(size_t i, TfLiteTensor *tensor) {
+// Instance behind the global tflite_learn_5_* functions
+tflite_learn_5_model_t default_model;
+
+static tflite_learn_5_model_t *ModelOf(const struct TfLiteContext* ctx) {
+  return static_cast<EonMicroContext*>(ctx->impl_)->model_;
+}
+
+template <size_t In, size_t Out, TfLiteFusedActivation Act>
+static TfLiteStatus InvokeFullyConnectedS8(tflite_learn_5_model_t *model, size_t i, const int32_t *folded_bias) {
+  const TfLiteNode &node = model->tflNodes[i];
+  FullyConnectedS8<In, Out, Act>::Eval(model->fc_op_data[i],
+    (const int8_t*)(model->tensor_arena + (uintptr_t)tensorData[node.inputs->data[0]].data),
+    (const int8_t*)tensorData[node.inputs->data[1]].data,
+    folded_bias,
+    (int8_t*)(model->tensor_arena + (uintptr_t)tensorData[node.outputs->data[0]].data));
+  return kTfLiteOk;
+}
+
+static TfLiteStatus InvokeNode0(tflite_learn_5_model_t *model) {
+  return InvokeFullyConnectedS8<39, 20, kTfLiteActRelu>(model, 0, g0::folded_bias0);
+}
+static TfLiteStatus InvokeNode1(tflite_learn_5_model_t *model) {
+  return InvokeFullyConnectedS8<20, 10, kTfLiteActRelu>(model, 1, g0::folded_bias1);
+}
+static TfLiteStatus InvokeNode2(tflite_learn_5_model_t *model) {
+  return InvokeFullyConnectedS8<10, 3, kTfLiteActNone>(model, 2, g0::folded_bias2);
+}
+
+// Nodes with a shape-specialized kernel, nullptr runs the TFLM registration
+typedef TfLiteStatus (*node_kernel_t)(tflite_learn_5_model_t *model);
+static const node_kernel_t node_kernels[NODE_COUNT] = {
+  EI_TFLITE_FC_S8_SELECT(39, 20) ? &InvokeNode0 : nullptr,
+  EI_TFLITE_FC_S8_SELECT(20, 10) ? &InvokeNode1 : nullptr,
+  EI_TFLITE_FC_S8_SELECT(10, 3) ? &InvokeNode2 : nullptr,
+  nullptr,
+};
+
+static void init_tflite_tensor(const tflite_learn_5_model_t *model, size_t i, TfLiteTensor *tensor) {
   tensor->type = tensorData[i].type;
   tensor->is_variable = false;
-
-#if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
   tensor->allocation_type = tensorData[i].allocation_type;
-#else
-  tensor->allocation_type = (tensor_arena <= tensorData[i].data && tensorData[i].data < tensor_arena + kTensorArenaSize) ? kTfLiteArenaRw : kTfLiteMmapRo;
-#endif
   tensor->bytes = tensorData[i].bytes;
   tensor->dims = tensorData[i].dims;
 
-#if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
-  if(tensor->allocation_type == kTfLiteArenaRw){
-    uint8_t* start = (uint8_t*) ((uintptr_t)tensorData[i].data + (uintptr_t) tensor_arena);
-
-    tensor->data.data =  start;
+  if (tensor->allocation_type == kTfLiteArenaRw) {
+    tensor->data.data = model->tensor_arena + (uintptr_t)tensorData[i].data;
   }
   else {
-      tensor->data.data = tensorData[i].data;
+    tensor->data.data = tensorData[i].data;
   }
-#else
-  tensor->data.data = tensorData[i].data;
-#endif // EI_CLASSIFIER_ALLOCATION_HEAP
   tensor->quantization = tensorData[i].quantization;
   if (tensor->quantization.type == kTfLiteAffineQuantization) {
     TfLiteAffineQuantization const* quant = ((TfLiteAffineQuantization const*)(tensorData[i].quantization.params));
@@ -305,36 +412,28 @@ static void init_tflite_tensor(size_t i, TfLiteTensor *tensor) {
 
 }
 
-static void init_tflite_eval_tensor(int i, TfLiteEvalTensor *tensor) {
+static void init_tflite_eval_tensor(const tflite_learn_5_model_t *model, int i, TfLiteEvalTensor *tensor) {
 
   tensor->type = tensorData[i].type;
 
   tensor->dims = tensorData[i].dims;
 
-#if defined(EI_CLASSIFIER_ALLOCATION_HEAP)
-  auto allocation_type = tensorData[i].allocation_type;
-  if(allocation_type == kTfLiteArenaRw) {
-    uint8_t* start = (uint8_t*) ((uintptr_t)tensorData[i].data + (uintptr_t) tensor_arena);
-
-    tensor->data.data =  start;
+  if (tensorData[i].allocation_type == kTfLiteArenaRw) {
+    tensor->data.data = model->tensor_arena + (uintptr_t)tensorData[i].data;
   }
   else {
     tensor->data.data = tensorData[i].data;
   }
-#else
-  tensor->data.data = tensorData[i].data;
-#endif // EI_CLASSIFIER_ALLOCATION_HEAP
 }
 
-static void* overflow_buffers[EI_MAX_OVERFLOW_BUFFER_COUNT];
-static size_t overflow_buffers_ix = 0;
 static void * AllocatePersistentBufferImpl(struct TfLiteContext* ctx,
                                        size_t bytes) {
+  tflite_learn_5_model_t *model = ModelOf(ctx);
   void *ptr;
   uint32_t align_bytes = (bytes % 16) ? 16 - (bytes % 16) : 0;
 
-  if (current_location - (bytes + align_bytes) < tensor_boundary) {
-    if (overflow_buffers_ix > EI_MAX_OVERFLOW_BUFFER_COUNT - 1) {
+  if (model->current_location - (bytes + align_bytes) < model->tensor_boundary) {
+    if (model->overflow_buffers_ix > EI_MAX_OVERFLOW_BUFFER_COUNT - 1) {
       ei_printf("ERR: Failed to allocate persistent buffer of size %d, does not fit in tensor arena and reached EI_MAX_OVERFLOW_BUFFER_COUNT\n",
         (int)bytes);
       return NULL;
@@ -347,33 +446,27 @@ static void * AllocatePersistentBufferImpl(struct TfLiteContext* ctx,
       ei_printf("ERR: Failed to allocate persistent buffer of size %d\n", (int)bytes);
       return NULL;
     }
-    overflow_buffers[overflow_buffers_ix++] = ptr;
+    model->overflow_buffers[model->overflow_buffers_ix++] = ptr;
+    model->overflow_bytes += bytes;
     return ptr;
   }
 
-  current_location -= bytes;
+  model->current_location -= bytes;
 
   // align to the left aligned boundary of 16 bytes
-  current_location -= 15; // for alignment
-  current_location += 16 - ((uintptr_t)(current_location) & 15);
+  model->current_location -= 15; // for alignment
+  model->current_location += 16 - ((uintptr_t)(model->current_location) & 15);
 
-  ptr = current_location;
+  ptr = model->current_location;
   memset(ptr, 0, bytes);
 
   return ptr;
 }
 
-typedef struct {
-  size_t bytes;
-  void *ptr;
-} scratch_buffer_t;
-
-static scratch_buffer_t scratch_buffers[EI_MAX_SCRATCH_BUFFER_COUNT];
-static size_t scratch_buffers_ix = 0;
-
 static TfLiteStatus RequestScratchBufferInArenaImpl(struct TfLiteContext* ctx, size_t bytes,
                                                 int* buffer_idx) {
-  if (scratch_buffers_ix > EI_MAX_SCRATCH_BUFFER_COUNT - 1) {
+  tflite_learn_5_model_t *model = ModelOf(ctx);
+  if (model->scratch_buffers_ix > EI_MAX_SCRATCH_BUFFER_COUNT - 1) {
     ei_printf("ERR: Failed to allocate scratch buffer of size %d, reached EI_MAX_SCRATCH_BUFFER_COUNT\n",
       (int)bytes);
     return kTfLiteError;
@@ -389,48 +482,55 @@ static TfLiteStatus RequestScratchBufferInArenaImpl(struct TfLiteContext* ctx, s
     return kTfLiteError;
   }
 
-  scratch_buffers[scratch_buffers_ix] = b;
-  *buffer_idx = scratch_buffers_ix;
+  model->scratch_buffers[model->scratch_buffers_ix] = b;
+  *buffer_idx = model->scratch_buffers_ix;
 
-  scratch_buffers_ix++;
+  model->scratch_buffers_ix++;
 
   return kTfLiteOk;
 }
 
 static void* GetScratchBufferImpl(struct TfLiteContext* ctx, int buffer_idx) {
-  if (buffer_idx > (int)scratch_buffers_ix) {
+  tflite_learn_5_model_t *model = ModelOf(ctx);
+  if (buffer_idx > (int)model->scratch_buffers_ix) {
     return NULL;
   }
-  return scratch_buffers[buffer_idx].ptr;
+  return model->scratch_buffers[buffer_idx].ptr;
+}
+
+// Bytes handed out by AllocatePersistentBuffer (end of the arena + overflow buffers)
+static size_t PersistentBytesUsed(const tflite_learn_5_model_t *model) {
+  return (size_t)(model->tensor_arena + kTensorArenaSize - model->current_location) + model->overflow_bytes;
 }
 
 static const uint16_t TENSOR_IX_UNUSED = 0x7FFF;
 
-static void ResetTensors() {
+static void ResetTensors(tflite_learn_5_model_t *model) {
   for (size_t ix = 0; ix < MAX_TFL_TENSOR_COUNT; ix++) {
-    tflTensors[ix].index = TENSOR_IX_UNUSED;
+    model->tflTensors[ix].index = TENSOR_IX_UNUSED;
   }
   for (size_t ix = 0; ix < MAX_TFL_EVAL_COUNT; ix++) {
-    tflEvalTensors[ix].index = TENSOR_IX_UNUSED;
+    model->tflEvalTensors[ix].index = TENSOR_IX_UNUSED;
   }
 }
 
 static TfLiteTensor* GetTensorImpl(const struct TfLiteContext* context,
                                int tensor_idx) {
+  tflite_learn_5_model_t *model = ModelOf(context);
 
-  tensor_idx = tflTensors_subgraph_index[current_subgraph_index] + tensor_idx;
+  tensor_idx = tflTensors_subgraph_index[model->current_subgraph_index] + tensor_idx;
 
   for (size_t ix = 0; ix < MAX_TFL_TENSOR_COUNT; ix++) {
     // already used? OK!
-    if (tflTensors[ix].index == tensor_idx) {
-      return &tflTensors[ix].tensor;
+    if (model->tflTensors[ix].index == tensor_idx) {
+      return &model->tflTensors[ix].tensor;
     }
     // passed all the ones we've used, so end of the list?
-    if (tflTensors[ix].index == TENSOR_IX_UNUSED) {
+    if (model->tflTensors[ix].index == TENSOR_IX_UNUSED) {
       // init the tensor
-      init_tflite_tensor(tensor_idx, &tflTensors[ix].tensor);
-      tflTensors[ix].index = tensor_idx;
-      return &tflTensors[ix].tensor;
+      init_tflite_tensor(model, tensor_idx, &model->tflTensors[ix].tensor);
+      model->tflTensors[ix].index = tensor_idx;
+      return &model->tflTensors[ix].tensor;
     }
   }
 
@@ -440,20 +540,21 @@ static TfLiteTensor* GetTensorImpl(const struct TfLiteContext* context,
 
 static TfLiteEvalTensor* GetEvalTensorImpl(const struct TfLiteContext* context,
                                        int tensor_idx) {
+  tflite_learn_5_model_t *model = ModelOf(context);
 
-  tensor_idx = tflTensors_subgraph_index[current_subgraph_index] + tensor_idx;
+  tensor_idx = tflTensors_subgraph_index[model->current_subgraph_index] + tensor_idx;
 
   for (size_t ix = 0; ix < MAX_TFL_EVAL_COUNT; ix++) {
     // already used? OK!
-    if (tflEvalTensors[ix].index == tensor_idx) {
-      return &tflEvalTensors[ix].tensor;
+    if (model->tflEvalTensors[ix].index == tensor_idx) {
+      return &model->tflEvalTensors[ix].tensor;
     }
     // passed all the ones we've used, so end of the list?
-    if (tflEvalTensors[ix].index == TENSOR_IX_UNUSED) {
+    if (model->tflEvalTensors[ix].index == TENSOR_IX_UNUSED) {
       // init the tensor
-      init_tflite_eval_tensor(tensor_idx, &tflEvalTensors[ix].tensor);
-      tflEvalTensors[ix].index = tensor_idx;
-      return &tflEvalTensors[ix].tensor;
+      init_tflite_eval_tensor(model, tensor_idx, &model->tflEvalTensors[ix].tensor);
+      model->tflEvalTensors[ix].index = tensor_idx;
+      return &model->tflEvalTensors[ix].tensor;
     }
   }
 
@@ -461,62 +562,93 @@ static TfLiteEvalTensor* GetEvalTensorImpl(const struct TfLiteContext* context,
   return nullptr;
 }
 
-class EonMicroContext : public MicroContext {
- public:
- 
-  EonMicroContext(): MicroContext(nullptr, nullptr, nullptr) { }
+void* EonMicroContext::AllocatePersistentBuffer(size_t bytes) {
+  return AllocatePersistentBufferImpl(&model_->ctx, bytes);
+}
 
-  void* AllocatePersistentBuffer(size_t bytes) {
-    return AllocatePersistentBufferImpl(nullptr, bytes);
-  }
+TfLiteStatus EonMicroContext::RequestScratchBufferInArena(size_t bytes,
+                                                          int* buffer_index) {
+  return RequestScratchBufferInArenaImpl(&model_->ctx, bytes, buffer_index);
+}
 
-  TfLiteStatus RequestScratchBufferInArena(size_t bytes,
-                                           int* buffer_index) {
-  return RequestScratchBufferInArenaImpl(nullptr, bytes, buffer_index);
-  }
+void* EonMicroContext::GetScratchBuffer(int buffer_index) {
+  return GetScratchBufferImpl(&model_->ctx, buffer_index);
+}
 
-  void* GetScratchBuffer(int buffer_index) {
-    return GetScratchBufferImpl(nullptr, buffer_index);
-  }
- 
-  TfLiteTensor* AllocateTempTfLiteTensor(int tensor_index) {
-    return GetTensorImpl(nullptr, tensor_index);
-  }
+TfLiteTensor* EonMicroContext::AllocateTempTfLiteTensor(int tensor_index) {
+  return GetTensorImpl(&model_->ctx, tensor_index);
+}
 
-  void DeallocateTempTfLiteTensor(TfLiteTensor* tensor) {
-    return;
-  }
+TfLiteEvalTensor* EonMicroContext::GetEvalTensor(int tensor_index) {
+  return GetEvalTensorImpl(&model_->ctx, tensor_index);
+}
 
-  bool IsAllTempTfLiteTensorDeallocated() {
-    return true;
-  }
+#if EI_CLASSIFIER_PRINT_STATE
+static void PrintTensors(const tflite_learn_5_model_t *model, const TfLiteIntArray *tensors) {
+  for (size_t ix = 0; ix < tensors->size; ix++) {
+    auto d = tensorData[tensors->data[ix]];
 
-  TfLiteEvalTensor* GetEvalTensor(int tensor_index) {
-    return GetEvalTensorImpl(nullptr, tensor_index);
-  }
+    size_t data_ptr = (size_t)d.data;
 
-};
+    if (d.allocation_type == kTfLiteArenaRw) {
+      data_ptr = (size_t)model->tensor_arena + data_ptr;
+    }
 
+    if (d.type == TfLiteType::kTfLiteInt8) {
+      int8_t* data = (int8_t*)data_ptr;
+      ei_printf("        %lu (%zu bytes, ptr=%p, alloc_type=%d, type=%d): ", ix, d.bytes, data, (int)d.allocation_type, (int)d.type);
+      for (size_t jx = 0; jx < d.bytes; jx++) {
+        ei_printf("%d ", data[jx]);
+      }
+    }
+    else {
+      float* data = (float*)data_ptr;
+      ei_printf("        %lu (%zu bytes, ptr=%p, alloc_type=%d, type=%d): ", ix, d.bytes, data, (int)d.allocation_type, (int)d.type);
+      for (size_t jx = 0; jx < d.bytes / 4; jx++) {
+        ei_printf("%f ", data[jx]);
+      }
+    }
+    ei_printf("\n");
+  }
+  ei_printf("\n");
+}
+#endif // EI_CLASSIFIER_PRINT_STATE
 
 } // namespace
 
-TfLiteStatus tflite_learn_5_init( void*(*alloc_fnc)(size_t,size_t) ) {
-#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
-  tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
-  if (!tensor_arena) {
-    ei_printf("ERR: failed to allocate tensor arena\n");
-    return kTfLiteError;
+TfLiteStatus tflite_learn_5_init(tflite_learn_5_model_t *model, void*(*alloc_fnc)(size_t,size_t) ) {
+#ifndef EI_CLASSIFIER_ALLOCATION_HEAP
+  // the static arena belongs to the default instance, others come from alloc_fnc
+  if (model == &default_model) {
+    model->tensor_arena = tensor_arena;
+    model->tensor_arena_allocated = false;
+    memset(tensor_arena, 0, kTensorArenaSize);
   }
-#else
-  memset(tensor_arena, 0, kTensorArenaSize);
+  else
 #endif
-  tensor_boundary = tensor_arena;
-  current_location = tensor_arena + kTensorArenaSize;
+  {
+    model->tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
+    if (!model->tensor_arena) {
+      ei_printf("ERR: failed to allocate tensor arena\n");
+      return kTfLiteError;
+    }
+    model->tensor_arena_allocated = true;
+  }
+  model->tensor_boundary = model->tensor_arena;
+  model->current_location = model->tensor_arena + kTensorArenaSize;
+  model->scratch_buffers_ix = 0;
+  model->overflow_buffers_ix = 0;
+  model->overflow_bytes = 0;
+  memset(model->node_arena_bytes, 0, sizeof(model->node_arena_bytes));
+  memcpy(model->tflNodes, tflNodes, sizeof(model->tflNodes));
+
+  TfLiteContext &ctx = model->ctx;
+  MicroProfilerInterface *profiler = model->node_profiler;
+  ctx = TfLiteContext{};
+  ctx.profiler = profiler;
 
-  EonMicroContext micro_context_;
-  
   // Set microcontext as the context ptr
-  ctx.impl_ = static_cast<void*>(&micro_context_);
+  ctx.impl_ = static_cast<void*>(&model->micro_context);
   // Setup tflitecontext functions
   ctx.AllocatePersistentBuffer = &AllocatePersistentBufferImpl;
   ctx.RequestScratchBufferInArena = &RequestScratchBufferInArenaImpl;
@@ -528,144 +660,256 @@ TfLiteStatus tflite_learn_5_init( void*(*alloc_fnc)(size_t,size_t) ) {
   ctx.tensors_size = 11;
   for (size_t i = 0; i < 11; ++i) {
     TfLiteTensor tensor;
-    init_tflite_tensor(i, &tensor);
+    init_tflite_tensor(model, i, &tensor);
     if (tensor.allocation_type == kTfLiteArenaRw) {
       auto data_end_ptr = (uint8_t*)tensor.data.data + tensorData[i].bytes;
-      if (data_end_ptr > tensor_boundary) {
-        tensor_boundary = data_end_ptr;
+      if (data_end_ptr > model->tensor_boundary) {
+        model->tensor_boundary = data_end_ptr;
       }
     }
   }
 
-  if (tensor_boundary > current_location /* end of arena size */) {
+  if (model->tensor_boundary > model->current_location /* end of arena size */) {
     ei_printf("ERR: tensor arena is too small, does not fit model - even without scratch buffers\n");
     return kTfLiteError;
   }
 
-  registrations[OP_FULLY_CONNECTED] = Register_FULLY_CONNECTED();
-  registrations[OP_SOFTMAX] = Register_SOFTMAX();
+  model->registrations[OP_FULLY_CONNECTED] = Register_FULLY_CONNECTED();
+  model->registrations[OP_SOFTMAX] = Register_SOFTMAX();
 
   for (size_t g = 0; g < 1; ++g) {
-    current_subgraph_index = g;
+    model->current_subgraph_index = g;
     for(size_t i = tflNodes_subgraph_index[g]; i < tflNodes_subgraph_index[g+1]; ++i) {
-      if (registrations[used_ops[i]].init) {
-        tflNodes[i].user_data = registrations[used_ops[i]].init(&ctx, (const char*)tflNodes[i].builtin_data, 0);
+      if (model->registrations[used_ops[i]].init) {
+        size_t used = PersistentBytesUsed(model);
+        model->tflNodes[i].user_data = model->registrations[used_ops[i]].init(&ctx, (const char*)model->tflNodes[i].builtin_data, 0);
+        model->node_arena_bytes[i] += PersistentBytesUsed(model) - used;
       }
     }
   }
-  current_subgraph_index = 0;
+  model->current_subgraph_index = 0;
 
   for(size_t g = 0; g < 1; ++g) {
-    current_subgraph_index = g;
+    model->current_subgraph_index = g;
     for(size_t i = tflNodes_subgraph_index[g]; i < tflNodes_subgraph_index[g+1]; ++i) {
-      if (registrations[used_ops[i]].prepare) {
-        ResetTensors();
-        TfLiteStatus status = registrations[used_ops[i]].prepare(&ctx, &tflNodes[i]);
+      if (model->registrations[used_ops[i]].prepare) {
+        ResetTensors(model);
+        size_t used = PersistentBytesUsed(model);
+        TfLiteStatus status = model->registrations[used_ops[i]].prepare(&ctx, &model->tflNodes[i]);
+        model->node_arena_bytes[i] += PersistentBytesUsed(model) - used;
         if (status != kTfLiteOk) {
           return status;
         }
       }
     }
   }
-  current_subgraph_index = 0;
+  model->current_subgraph_index = 0;
+
+  for (size_t i = 0; i < NODE_COUNT; ++i) {
+    if (used_ops[i] != OP_FULLY_CONNECTED) {
+      continue;
+    }
+    const TfLiteIntArray *inputs = model->tflNodes[i].inputs;
+    TfLiteTensor input, filter, bias, output;
+    init_tflite_tensor(model, inputs->data[0], &input);
+    init_tflite_tensor(model, inputs->data[1], &filter);
+    init_tflite_tensor(model, inputs->data[2], &bias);
+    init_tflite_tensor(model, model->tflNodes[i].outputs->data[0], &output);
+    const TfLiteFullyConnectedParams *params = (const TfLiteFullyConnectedParams*)model->tflNodes[i].builtin_data;
+    TfLiteStatus status = CalculateOpDataFullyConnected(&ctx, params->activation, input.type,
+      &input, &filter, &bias, &output, &model->fc_op_data[i]);
+    if (status != kTfLiteOk) {
+      return status;
+    }
+  }
 
   return kTfLiteOk;
 }
 
-TfLiteStatus tflite_learn_5_input(int index, TfLiteTensor *tensor) {
-  init_tflite_tensor(in_tensor_indices[index], tensor);
+TfLiteStatus tflite_learn_5_input(tflite_learn_5_model_t *model, int index, TfLiteTensor *tensor) {
+  init_tflite_tensor(model, in_tensor_indices[index], tensor);
   return kTfLiteOk;
 }
 
-TfLiteStatus tflite_learn_5_output(int index, TfLiteTensor *tensor) {
-  init_tflite_tensor(out_tensor_indices[index], tensor);
+TfLiteStatus tflite_learn_5_output(tflite_learn_5_model_t *model, int index, TfLiteTensor *tensor) {
+  init_tflite_tensor(model, out_tensor_indices[index], tensor);
   return kTfLiteOk;
 }
 
-TfLiteStatus tflite_learn_5_invoke() {
-  for (size_t i = 0; i < 4; ++i) {
-    ResetTensors();
-
-    TfLiteStatus status = registrations[used_ops[i]].invoke(&ctx, &tflNodes[i]);
-
-#if EI_CLASSIFIER_PRINT_STATE
-    ei_printf("layer %lu\n", i);
-    ei_printf("    inputs:\n");
-    for (size_t ix = 0; ix < tflNodes[i].inputs->size; ix++) {
-      auto d = tensorData[tflNodes[i].inputs->data[ix]];
-
-      size_t data_ptr = (size_t)d.data;
-
-      if (d.allocation_type == kTfLiteArenaRw) {
-        data_ptr = (size_t)tensor_arena + data_ptr;
-      }
-
-      if (d.type == TfLiteType::kTfLiteInt8) {
-        int8_t* data = (int8_t*)data_ptr;
-        ei_printf("        %lu (%zu bytes, ptr=%p, alloc_type=%d, type=%d): ", ix, d.bytes, data, (int)d.allocation_type, (int)d.type);
-        for (size_t jx = 0; jx < d.bytes; jx++) {
-          ei_printf("%d ", data[jx]);
-        }
+TfLiteStatus tflite_learn_5_invoke(tflite_learn_5_model_t *model) {
+  for (size_t i = 0; i < NODE_COUNT; ++i) {
+    ResetTensors(model);
+
+    TfLiteStatus status;
+    {
+      EI_PROFILE_SCOPE(node_tags[i]);
+      MicroProfilerInterface *profiler = model->node_profiler;
+      uint32_t event = profiler ? profiler->BeginEvent(node_tags[i]) : 0;
+      if (node_kernels[i]) {
+        status = node_kernels[i](model);
       }
       else {
-        float* data = (float*)data_ptr;
-        ei_printf("        %lu (%zu bytes, ptr=%p, alloc_type=%d, type=%d): ", ix, d.bytes, data, (int)d.allocation_type, (int)d.type);
-        for (size_t jx = 0; jx < d.bytes / 4; jx++) {
-          ei_printf("%f ", data[jx]);
-        }
+        status = model->registrations[used_ops[i]].invoke(&model->ctx, &model->tflNodes[i]);
+      }
+      if (profiler) {
+        profiler->EndEvent(event);
       }
-      ei_printf("\n");
     }
-    ei_printf("\n");
 
-    ei_printf("    outputs:\n");
-    for (size_t ix = 0; ix < tflNodes[i].outputs->size; ix++) {
-      auto d = tensorData[tflNodes[i].outputs->data[ix]];
+#if EI_CLASSIFIER_PRINT_STATE
+    ei_printf("layer %lu\n", i);
+    ei_printf("    inputs:\n");
+    PrintTensors(model, model->tflNodes[i].inputs);
 
-      size_t data_ptr = (size_t)d.data;
+    ei_printf("    outputs:\n");
+    PrintTensors(model, model->tflNodes[i].outputs);
+#endif // EI_CLASSIFIER_PRINT_STATE
 
-      if (d.allocation_type == kTfLiteArenaRw) {
-        data_ptr = (size_t)tensor_arena + data_ptr;
-      }
+    if (status != kTfLiteOk) {
+      return status;
+    }
+  }
+  return kTfLiteOk;
+}
 
-      if (d.type == TfLiteType::kTfLiteInt8) {
-        int8_t* data = (int8_t*)data_ptr;
-        ei_printf("        %lu (%zu bytes, ptr=%p, alloc_type=%d, type=%d): ", ix, d.bytes, data, (int)d.allocation_type, (int)d.type);
-        for (size_t jx = 0; jx < d.bytes; jx++) {
-          ei_printf("%d ", data[jx]);
-        }
+TfLiteStatus tflite_learn_5_invoke_batch(tflite_learn_5_model_t *model, const int8_t *input, int8_t *output, size_t batches) {
+  // ping-pong activations of BATCH_TILE rows
+  int8_t tile[2][BATCH_TILE * BATCH_MAX_WIDTH];
+
+  for (size_t start = 0; start < batches; start += BATCH_TILE) {
+    const size_t rows = batches - start < BATCH_TILE ? batches - start : BATCH_TILE;
+    const int8_t *in = input + start * tensorData[in_tensor_indices[0]].bytes;
+
+    for (size_t i = 0; i < NODE_COUNT; ++i) {
+      const TfLiteNode &node = model->tflNodes[i];
+      const size_t in_width = tensorData[node.inputs->data[0]].bytes;
+      const size_t out_width = tensorData[node.outputs->data[0]].bytes;
+      int8_t *out = (i == NODE_COUNT - 1) ? output + start * out_width : tile[i & 1];
+
+      EI_PROFILE_SCOPE(node_tags[i]);
+      MicroProfilerInterface *profiler = model->node_profiler;
+      uint32_t event = profiler ? profiler->BeginEvent(node_tags[i]) : 0;
+
+      if (used_ops[i] == OP_FULLY_CONNECTED) {
+        // one GEMM over all rows of the tile
+        ei_tflite_gemm_fully_connected_s8(model->fc_op_data[i], in, rows, in_width,
+          (const int8_t*)tensorData[node.inputs->data[1]].data, (const int32_t*)tensorData[node.inputs->data[2]].data,
+          out_width, out);
       }
       else {
-        float* data = (float*)data_ptr;
-        ei_printf("        %lu (%zu bytes, ptr=%p, alloc_type=%d, type=%d): ", ix, d.bytes, data, (int)d.allocation_type, (int)d.type);
-        for (size_t jx = 0; jx < d.bytes / 4; jx++) {
-          ei_printf("%f ", data[jx]);
+        // other ops run row by row on the arena tensors
+        int8_t *node_in = (int8_t*)model->tensor_arena + (uintptr_t)tensorData[node.inputs->data[0]].data;
+        const int8_t *node_out = (int8_t*)model->tensor_arena + (uintptr_t)tensorData[node.outputs->data[0]].data;
+        for (size_t row = 0; row < rows; ++row) {
+          memcpy(node_in, in + row * in_width, in_width);
+          ResetTensors(model);
+          TfLiteStatus status = model->registrations[used_ops[i]].invoke(&model->ctx, &model->tflNodes[i]);
+          if (status != kTfLiteOk) {
+            return status;
+          }
+          memcpy(out + row * out_width, node_out, out_width);
         }
       }
-      ei_printf("\n");
-    }
-    ei_printf("\n");
-#endif // EI_CLASSIFIER_PRINT_STATE
 
-    if (status != kTfLiteOk) {
-      return status;
+      if (profiler) {
+        profiler->EndEvent(event);
+      }
+      in = out;
     }
   }
   return kTfLiteOk;
 }
 
-TfLiteStatus tflite_learn_5_reset( void (*free_fnc)(void* ptr) ) {
-#ifdef EI_CLASSIFIER_ALLOCATION_HEAP
-  free_fnc(tensor_arena);
-#endif
+TfLiteStatus tflite_learn_5_reset(tflite_learn_5_model_t *model, void (*free_fnc)(void* ptr) ) {
+  if (model->tensor_arena_allocated) {
+    free_fnc(model->tensor_arena);
+  }
+  model->tensor_arena = nullptr;
+  model->tensor_arena_allocated = false;
 
   // scratch buffers are allocated within the arena, so just reset the counter so memory can be reused
-  scratch_buffers_ix = 0;
+  model->scratch_buffers_ix = 0;
 
   // overflow buffers are on the heap, so free them first
-  for (size_t ix = 0; ix < overflow_buffers_ix; ix++) {
-    ei_free(overflow_buffers[ix]);
+  for (size_t ix = 0; ix < model->overflow_buffers_ix; ix++) {
+    ei_free(model->overflow_buffers[ix]);
   }
-  overflow_buffers_ix = 0;
+  model->overflow_buffers_ix = 0;
   return kTfLiteOk;
 }
+
+void tflite_learn_5_set_profiler(tflite_learn_5_model_t *model, MicroProfilerInterface *profiler) {
+  model->node_profiler = profiler;
+  model->ctx.profiler = profiler;
+}
+
+size_t tflite_learn_5_node_arena_bytes(const tflite_learn_5_model_t *model, size_t index) {
+  return index < NODE_COUNT ? model->node_arena_bytes[index] : 0;
+}
+
+size_t tflite_learn_5_arena_used(const tflite_learn_5_model_t *model) {
+  return (size_t)(model->tensor_boundary - model->tensor_arena) + PersistentBytesUsed(model);
+}
+
+tflite_learn_5_model_t *tflite_learn_5_create( void*(*alloc_fnc)(size_t,size_t), void (*free_fnc)(void* ptr) ) {
+  void *mem = alloc_fnc(16, sizeof(tflite_learn_5_model_t));
+  if (!mem) {
+    ei_printf("ERR: failed to allocate model instance\n");
+    return nullptr;
+  }
+  tflite_learn_5_model_t *model = new (mem) tflite_learn_5_model_t();
+  if (tflite_learn_5_init(model, alloc_fnc) != kTfLiteOk) {
+    tflite_learn_5_destroy(model, free_fnc);
+    return nullptr;
+  }
+  return model;
+}
+
+void tflite_learn_5_destroy(tflite_learn_5_model_t *model, void (*free_fnc)(void* ptr) ) {
+  if (!model) {
+    return;
+  }
+  tflite_learn_5_reset(model, free_fnc);
+  model->~tflite_learn_5_model_t();
+  free_fnc(model);
+}
+
+TfLiteStatus tflite_learn_5_init( void*(*alloc_fnc)(size_t,size_t) ) {
+  return tflite_learn_5_init(&default_model, alloc_fnc);
+}
+
+TfLiteStatus tflite_learn_5_input(int index, TfLiteTensor *tensor) {
+  return tflite_learn_5_input(&default_model, index, tensor);
+}
+
+TfLiteStatus tflite_learn_5_output(int index, TfLiteTensor *tensor) {
+  return tflite_learn_5_output(&default_model, index, tensor);
+}
+
+TfLiteStatus tflite_learn_5_invoke() {
+  return tflite_learn_5_invoke(&default_model);
+}
+
+TfLiteStatus tflite_learn_5_invoke_batch(const int8_t *input, int8_t *output, size_t batches) {
+  return tflite_learn_5_invoke_batch(&default_model, input, output, batches);
+}
+
+TfLiteStatus tflite_learn_5_reset( void (*free_fnc)(void* ptr) ) {
+  return tflite_learn_5_reset(&default_model, free_fnc);
+}
+
+void tflite_learn_5_set_profiler(MicroProfilerInterface *profiler) {
+  tflite_learn_5_set_profiler(&default_model, profiler);
+}
+
+const char *tflite_learn_5_node_tag(size_t index) {
+  return index < NODE_COUNT ? node_tags[index] : nullptr;
+}
+
+size_t tflite_learn_5_node_arena_bytes(size_t index) {
+  return tflite_learn_5_node_arena_bytes(&default_model, index);
+}
+
+size_t tflite_learn_5_arena_used() {
+  return tflite_learn_5_arena_used(&default_model);
+}
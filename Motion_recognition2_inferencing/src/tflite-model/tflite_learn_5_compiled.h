@@ -25,6 +25,15 @@
 
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 
+namespace tflite {
+class MicroProfilerInterface;
+}
+
+// Model instance: context, tensor arena and per node state. Every instance
+// can run on its own thread; the functions without an instance argument use a
+// built-in default instance (which owns the static arena if there is one).
+typedef struct tflite_learn_5_model tflite_learn_5_model_t;
+
 // Sets up the model with init and prepare steps.
 TfLiteStatus tflite_learn_5_init( void*(*alloc_fnc)(size_t,size_t) );
 // Returns the input tensor with the given index.
@@ -33,8 +42,34 @@ TfLiteStatus tflite_learn_5_input(int index, TfLiteTensor* tensor);
 TfLiteStatus tflite_learn_5_output(int index, TfLiteTensor* tensor);
 // Runs inference for the model.
 TfLiteStatus tflite_learn_5_invoke();
+// Runs inference on `batches` int8 input rows (input tensor bytes each) into int8 output rows.
+// Fully connected layers run as one GEMM per tile of rows; results match invoke() row by row.
+TfLiteStatus tflite_learn_5_invoke_batch(const int8_t *input, int8_t *output, size_t batches);
 //Frees memory allocated
 TfLiteStatus tflite_learn_5_reset( void (*free)(void* ptr) );
+// Emits a BeginEvent / EndEvent per node on every invoke (nullptr to disable).
+void tflite_learn_5_set_profiler(tflite::MicroProfilerInterface *profiler);
+// Returns the profiler tag of a node.
+const char *tflite_learn_5_node_tag(size_t index);
+// Returns the persistent and scratch bytes a node allocated in init / prepare.
+size_t tflite_learn_5_node_arena_bytes(size_t index);
+// Returns the arena bytes in use (tensors, persistent and scratch buffers, overflow buffers).
+size_t tflite_learn_5_arena_used();
+
+// Allocates an instance and its arena with alloc_fnc and runs init. Returns nullptr on failure.
+tflite_learn_5_model_t *tflite_learn_5_create( void*(*alloc_fnc)(size_t,size_t), void (*free)(void* ptr) );
+// Resets an instance and frees it.
+void tflite_learn_5_destroy(tflite_learn_5_model_t *model, void (*free)(void* ptr) );
+// Same as the functions above, on the given instance.
+TfLiteStatus tflite_learn_5_init(tflite_learn_5_model_t *model, void*(*alloc_fnc)(size_t,size_t) );
+TfLiteStatus tflite_learn_5_input(tflite_learn_5_model_t *model, int index, TfLiteTensor* tensor);
+TfLiteStatus tflite_learn_5_output(tflite_learn_5_model_t *model, int index, TfLiteTensor* tensor);
+TfLiteStatus tflite_learn_5_invoke(tflite_learn_5_model_t *model);
+TfLiteStatus tflite_learn_5_invoke_batch(tflite_learn_5_model_t *model, const int8_t *input, int8_t *output, size_t batches);
+TfLiteStatus tflite_learn_5_reset(tflite_learn_5_model_t *model, void (*free)(void* ptr) );
+void tflite_learn_5_set_profiler(tflite_learn_5_model_t *model, tflite::MicroProfilerInterface *profiler);
+size_t tflite_learn_5_node_arena_bytes(const tflite_learn_5_model_t *model, size_t index);
+size_t tflite_learn_5_arena_used(const tflite_learn_5_model_t *model);
 
 
 // Returns the number of input tensors.
@@ -45,5 +80,9 @@ inline size_t tflite_learn_5_inputs() {
 inline size_t tflite_learn_5_outputs() {
   return 1;
 }
+// Returns the number of nodes.
+inline size_t tflite_learn_5_nodes() {
+  return 4;
+}
 
 #endif
@@ -0,0 +1,88 @@
+/* Activity recognition - host acquisition benchmark
+ *
+ * A thread stands in for the LIS2DW12 FIFO watermark interrupt: it wakes up
+ * once per FIFO burst, pushes the burst into AccelAcquisition and the main
+ * thread consumes model windows through the signal_t interface, the same way
+ * the sketch feeds run_classifier. Reports throughput, producer wake-up jitter
+ * and dropped frames.
+ *
+ * Usage: acquisition_bench [odr_hz] [seconds] [watermark]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "../src/accel_acquisition.h"
+
+#define WINDOW_FRAMES 30
+
+typedef std::chrono::steady_clock bench_clock;
+
+static uint32_t now_us(bench_clock::time_point start) {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(bench_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    const double odr_hz = argc > 1 ? atof(argv[1]) : 5000.0;
+    const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    const size_t watermark = argc > 3 ? (size_t)atoi(argv[3]) : 25;
+    const uint32_t period_us = (uint32_t)(1e6 / odr_hz);
+
+    static AccelAcquisition<256> acquisition(period_us, 1);
+    std::atomic<bool> running(true);
+    std::vector<double> jitter_us;
+    uint64_t produced = 0;
+
+    const bench_clock::time_point start = bench_clock::now();
+
+    std::thread producer([&]() {
+        int16_t burst[32 * ACCEL_AXES];
+        bench_clock::time_point next = start;
+        const auto burst_period = std::chrono::microseconds((uint64_t)period_us * watermark);
+        while (running.load()) {
+            next += burst_period;
+            std::this_thread::sleep_until(next);
+            jitter_us.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - next).count() / 1000.0);
+            for (size_t ix = 0; ix < watermark * ACCEL_AXES; ix++) {
+                burst[ix] = (int16_t)((produced * ACCEL_AXES + ix) & 0x3fff);
+            }
+            acquisition.push_fifo(burst, watermark, now_us(start));
+            produced += watermark;
+        }
+    });
+
+    uint64_t windows = 0;
+    uint64_t consumed = 0;
+    float window[WINDOW_FRAMES * ACCEL_AXES];
+    while (std::chrono::duration<double>(bench_clock::now() - start).count() < seconds) {
+        ei::signal_t signal;
+        if (acquisition.window_signal(WINDOW_FRAMES, &signal) != ei::EIDSP_OK) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        signal.get_data(0, signal.total_length, window);
+        acquisition.release(WINDOW_FRAMES);
+        windows++;
+        consumed += WINDOW_FRAMES;
+    }
+    running.store(false);
+    producer.join();
+
+    const double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+    std::sort(jitter_us.begin(), jitter_us.end());
+    const auto pct = [&](double p) {
+        return jitter_us.empty() ? 0.0 : jitter_us[(size_t)(p * (jitter_us.size() - 1))];
+    };
+
+    printf("odr_hz,watermark,elapsed_s,frames_produced,frames_consumed,windows,frames_per_s,dropped,jitter_p50_us,jitter_p99_us,jitter_max_us\n");
+    printf("%.1f,%zu,%.3f,%llu,%llu,%llu,%.1f,%u,%.1f,%.1f,%.1f\n",
+        odr_hz, watermark, elapsed,
+        (unsigned long long)produced, (unsigned long long)consumed, (unsigned long long)windows,
+        (double)consumed / elapsed, acquisition.dropped(),
+        pct(0.5), pct(0.99), jitter_us.empty() ? 0.0 : jitter_us.back());
+    return 0;
+}
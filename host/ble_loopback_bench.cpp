@@ -0,0 +1,248 @@
+/* Activity recognition - BLE result protocol benchmark
+ *
+ * Sends a simulated stream of results (one per hop, activities lasting a
+ * random number of windows) through ResultBatcher into a loopback stand-in
+ * for the BLE stack: a bounded notification queue, drained by a thread that
+ * plays the phone and decodes every packet with result_protocol_decode().
+ * Every record is checked against what was sent (sequence, timestamp, class,
+ * scores). The same stream is then counted as the text notifications the
+ * sketch used to send ("walk=0.9123").
+ *
+ * Reports notifications (radio events), payload and on-air bytes per result
+ * for both, the flush reasons and the encode + decode throughput. Exits with
+ * 1 if a record was lost or decoded wrong.
+ *
+ * Usage: ble_loopback_bench [results] [payload_bytes] [timeout_ms] [hop_ms]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "../src/result_protocol.h"
+
+// LE 1M PHY: preamble, access address, LL header and CRC, plus L2CAP and ATT headers
+#define BLE_PACKET_OVERHEAD     (1 + 4 + 2 + 3 + 4 + 3)
+#define BLE_US_PER_BYTE         8
+// Notifications the stack buffers before notify() blocks
+#define LOOPBACK_QUEUE_DEPTH    32
+// Period of the pipeline's transport idle callback
+#define LOOPBACK_IDLE_MS        250
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint8_t class_id;
+    float scores[EI_CLASSIFIER_LABEL_COUNT];
+} sent_result_t;
+
+/**
+ * Stand-in for the BLE stack: notify() queues a copy of the packet, the
+ * receiver thread takes them out in order
+ */
+class LoopbackLink {
+public:
+    LoopbackLink() : _closed(false), _notifications(0), _bytes(0) { }
+
+    void notify(const uint8_t *packet, size_t size) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _space.wait(lock, [this] { return _queue.size() < LOOPBACK_QUEUE_DEPTH; });
+        _queue.push_back(std::vector<uint8_t>(packet, packet + size));
+        _notifications++;
+        _bytes += size;
+        _ready.notify_one();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _ready.notify_one();
+    }
+
+    /**
+     * @return     false once the link is closed and empty
+     */
+    bool receive(std::vector<uint8_t> *packet) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _ready.wait(lock, [this] { return !_queue.empty() || _closed; });
+        if (_queue.empty()) {
+            return false;
+        }
+        packet->swap(_queue.front());
+        _queue.pop_front();
+        _space.notify_one();
+        return true;
+    }
+
+    uint64_t notifications() const {
+        return _notifications;
+    }
+
+    uint64_t bytes() const {
+        return _bytes;
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::condition_variable _space;
+    std::deque<std::vector<uint8_t>> _queue;
+    bool _closed;
+    uint64_t _notifications;
+    uint64_t _bytes;
+};
+
+typedef struct {
+    const std::vector<sent_result_t> *sent;
+    size_t received;
+    size_t errors;
+} receiver_t;
+
+static void send_packet(const uint8_t *packet, size_t size, void *ctx) {
+    ((LoopbackLink *)ctx)->notify(packet, size);
+}
+
+static bool check_record(const result_record_t *record, size_t index, const sent_result_t *sent) {
+    if (record->sequence != (uint16_t)index || record->timestamp_ms != sent->timestamp_ms
+        || record->class_id != sent->class_id) {
+        return false;
+    }
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (record->scores[ix] != result_protocol_quantize(sent->scores[ix])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void receive_loop(LoopbackLink *link, receiver_t *receiver) {
+    std::vector<uint8_t> packet;
+    result_record_t records[RESULT_PROTOCOL_MAX_PAYLOAD / RESULT_PROTOCOL_RECORD_SIZE(0)];
+    result_packet_info_t info;
+
+    while (link->receive(&packet)) {
+        int count = result_protocol_decode(packet.data(), packet.size(), &info, records,
+                                           sizeof(records) / sizeof(records[0]));
+        if (count <= 0 || info.score_count != EI_CLASSIFIER_LABEL_COUNT) {
+            receiver->errors++;
+            continue;
+        }
+        for (int ix = 0; ix < count; ix++) {
+            const size_t index = receiver->received++;
+            if (index >= receiver->sent->size() || !check_record(&records[ix], index, &(*receiver->sent)[index])) {
+                receiver->errors++;
+            }
+        }
+    }
+}
+
+static void make_results(std::vector<sent_result_t> *results, size_t count, uint32_t hop_ms) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> segment(1, 40);
+    std::uniform_int_distribution<int> activity(0, EI_CLASSIFIER_LABEL_COUNT);
+    std::uniform_real_distribution<float> confidence(0.6f, 1.0f);
+    std::uniform_int_distribution<int> jitter(0, 20);
+
+    uint32_t timestamp_ms = 1000;
+    uint8_t class_id = RESULT_CLASS_NONE;
+    int left = 2;
+    results->resize(count);
+    for (size_t ix = 0; ix < count; ix++) {
+        if (left-- == 0) {
+            class_id = (uint8_t)activity(rng);
+            left = segment(rng);
+        }
+        sent_result_t *result = &(*results)[ix];
+        result->timestamp_ms = timestamp_ms;
+        result->class_id = class_id;
+        // the top label (or none, for unknown) gets most of the score
+        const float top = class_id < EI_CLASSIFIER_LABEL_COUNT ? confidence(rng) : 0.4f;
+        for (size_t label = 0; label < EI_CLASSIFIER_LABEL_COUNT; label++) {
+            result->scores[label] = label == class_id ? top : (1.0f - top) / (EI_CLASSIFIER_LABEL_COUNT - 1);
+        }
+        timestamp_ms += hop_ms + jitter(rng);
+    }
+}
+
+static size_t text_size(const sent_result_t *result) {
+    char text[32];
+    if (result->class_id >= EI_CLASSIFIER_LABEL_COUNT) {
+        return strlen("Unknown Activity");
+    }
+    return (size_t)snprintf(text, sizeof(text), "%s=%.4f",
+        ei_classifier_inferencing_categories[result->class_id], result->scores[result->class_id]);
+}
+
+int main(int argc, char **argv) {
+    const size_t count = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+    size_t payload = argc > 2 ? (size_t)atol(argv[2]) : RESULT_PROTOCOL_MIN_PAYLOAD;
+    const uint32_t timeout_ms = argc > 3 ? (uint32_t)atol(argv[3]) : 10000;
+    const uint32_t hop_ms = argc > 4 ? (uint32_t)atol(argv[4]) : 1000 * (EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2) / EI_CLASSIFIER_FREQUENCY;
+    if (count == 0 || hop_ms == 0) {
+        fprintf(stderr, "Usage: %s [results] [payload_bytes] [timeout_ms] [hop_ms]\n", argv[0]);
+        return 1;
+    }
+
+    payload = payload < RESULT_PROTOCOL_MIN_PAYLOAD ? RESULT_PROTOCOL_MIN_PAYLOAD
+            : payload > RESULT_PROTOCOL_MAX_PAYLOAD ? RESULT_PROTOCOL_MAX_PAYLOAD : payload;
+
+    std::vector<sent_result_t> sent;
+    make_results(&sent, count, hop_ms);
+
+    LoopbackLink link;
+    receiver_t receiver = { &sent, 0, 0 };
+    ResultBatcher<EI_CLASSIFIER_LABEL_COUNT> batcher(send_packet, &link, payload, timeout_ms);
+
+    const bench_clock::time_point start = bench_clock::now();
+    std::thread phone(receive_loop, &link, &receiver);
+    uint32_t now_ms = sent[0].timestamp_ms;
+    for (size_t ix = 0; ix < count; ix++) {
+        // idle callbacks of the transport task until the next result
+        for (; now_ms + LOOPBACK_IDLE_MS <= sent[ix].timestamp_ms; now_ms += LOOPBACK_IDLE_MS) {
+            batcher.poll(now_ms);
+        }
+        batcher.add(sent[ix].timestamp_ms, sent[ix].class_id, sent[ix].scores);
+    }
+    batcher.flush();
+    link.close();
+    phone.join();
+    const double elapsed_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    result_batcher_stats_t stats;
+    batcher.get_stats(&stats);
+
+    uint64_t text_bytes = 0;
+    for (size_t ix = 0; ix < count; ix++) {
+        text_bytes += text_size(&sent[ix]);
+    }
+
+    const double binary_air = (double)(link.bytes() + link.notifications() * BLE_PACKET_OVERHEAD);
+    const double text_air = (double)(text_bytes + count * BLE_PACKET_OVERHEAD);
+    printf("%zu results, hop %u ms, payload %zu bytes, timeout %u ms\n",
+        count, (unsigned)hop_ms, payload, (unsigned)timeout_ms);
+    printf("%-8s %14s %14s %14s %14s\n", "", "notifications", "payload B/res", "air B/res", "air us/res");
+    printf("%-8s %14llu %14.2f %14.2f %14.1f\n", "text",
+        (unsigned long long)count, (double)text_bytes / count, text_air / count, text_air * BLE_US_PER_BYTE / count);
+    printf("%-8s %14llu %14.2f %14.2f %14.1f\n", "binary",
+        (unsigned long long)link.notifications(), (double)link.bytes() / count, binary_air / count,
+        binary_air * BLE_US_PER_BYTE / count);
+    printf("records per packet %.2f, flushed: %u full, %u class change, %u timeout, %u other\n",
+        (double)stats.records / stats.packets, (unsigned)stats.full, (unsigned)stats.class_change,
+        (unsigned)stats.timeout, (unsigned)stats.other);
+    printf("encode + loopback + decode: %.0f results/s\n", count / elapsed_s);
+
+    if (receiver.errors || receiver.received != count) {
+        printf("FAILED: %zu of %zu records received, %zu errors\n", receiver.received, count, receiver.errors);
+        return 1;
+    }
+    printf("all records decoded\n");
+    return 0;
+}
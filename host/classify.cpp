@@ -0,0 +1,286 @@
+/* Activity recognition - host classifier
+ *
+ * Runs the production impulse (spectral DSP block + EON compiled model) on a
+ * raw accelerometer recording, so DSP and inference can be profiled on a Linux
+ * machine with exactly the code that runs on the ESP32.
+ *
+ * The input holds interleaved x,y,z values in mg separated by commas or
+ * whitespace ("Copy raw features" in Edge Impulse, or a longer recording).
+ *
+ *  - default: classify consecutive, non-overlapping windows
+ *  - --continuous: feed the recording in slices of EI_CLASSIFIER_SLICE_SIZE
+ *    frames through run_classifier_continuous, like the sketch does
+ *  - --batch N: classify the same windows N at a time with run_classifier_batch
+ *
+ * Configured with -DEI_PROFILER=ON it also prints the scope profile
+ * (EI_PROFILE_SCOPE) of all runs. --ops prints the per-node latency of the EON
+ * model (CSV, in ns) and the arena bytes each node allocated. --decode runs the
+ * results through the temporal decoder of the sketch (src/activity_decoder.h)
+ * and prints the decided activity of every window.
+ *
+ * Usage: classify [--continuous | --batch N] [--repeat N] [--ops] [--decode] [--debug] <file | ->
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "tflite-model/tflite_learn_5_compiled.h"
+#include "../src/activity_decoder.h"
+
+typedef struct {
+    uint64_t runs;
+    int64_t dsp_us;
+    int64_t classification_us;
+    int64_t max_us;
+} timing_stats_t;
+
+static int read_values(const char *path, std::vector<float> *values) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    int c;
+    char token[32];
+    size_t len = 0;
+    do {
+        c = fgetc(f);
+        if (c == EOF || c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (len > 0) {
+                token[len] = '\0';
+                char *end;
+                float v = strtof(token, &end);
+                if (*end != '\0') {
+                    fprintf(stderr, "Invalid value '%s'\n", token);
+                    if (f != stdin) fclose(f);
+                    return -1;
+                }
+                values->push_back(v);
+                len = 0;
+            }
+        }
+        else if (len < sizeof(token) - 1) {
+            token[len++] = (char)c;
+        }
+    } while (c != EOF);
+
+    if (f != stdin) {
+        fclose(f);
+    }
+    return 0;
+}
+
+static void print_result(size_t frame, const ei_impulse_result_t *result) {
+    printf("%6zu", frame);
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        printf("  %s: %.5f", result->classification[ix].label, result->classification[ix].value);
+    }
+    printf("  (DSP %d us, NN %d us)\n", (int)result->timing.dsp_us, (int)result->timing.classification_us);
+}
+
+typedef struct {
+    size_t frame;
+    float scores[EI_CLASSIFIER_LABEL_COUNT];
+} window_scores_t;
+
+static void add_window(std::vector<window_scores_t> *windows, size_t frame, const ei_impulse_result_t *result) {
+    window_scores_t window;
+    window.frame = frame;
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        window.scores[ix] = result->classification[ix].value;
+    }
+    windows->push_back(window);
+}
+
+static void print_decoded(const std::vector<window_scores_t> &windows) {
+    printf("\nDecoded (lag %d windows):\n", ACTIVITY_DECODER_LAG);
+    ActivityDecoder decoder;
+    for (size_t ix = 0; ix < windows.size(); ix++) {
+        int state = decoder.update(windows[ix].scores);
+        if (state >= 0) {
+            printf("%6zu  %s\n", windows[ix - ACTIVITY_DECODER_LAG].frame, ActivityDecoder::label(state));
+        }
+    }
+
+    // the last windows are only decided by the end of the recording
+    int tail[ACTIVITY_DECODER_LAG + 1];
+    size_t count = decoder.best_path(tail);
+    size_t first = count > ACTIVITY_DECODER_LAG ? 1 : 0;
+    for (size_t ix = first; ix < count; ix++) {
+        printf("%6zu  %s\n", windows[windows.size() - count + ix].frame, ActivityDecoder::label(tail[ix]));
+    }
+}
+
+static uint64_t ticks_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void print_ops(const EiTfliteProfiler *profiler) {
+    printf("\nPer node latency (ns):\n");
+    profiler->LogTicksPerTagCsv();
+
+    printf("\n\"Node\",\"Arena bytes\"\n");
+    for (size_t ix = 0; ix < tflite_learn_5_nodes(); ix++) {
+        printf("%s,%zu\n", tflite_learn_5_node_tag(ix), tflite_learn_5_node_arena_bytes(ix));
+    }
+    printf("arena used (tensors + buffers),%zu\n", tflite_learn_5_arena_used());
+}
+
+static void add_timing(timing_stats_t *stats, const ei_impulse_result_t *result) {
+    int64_t total = result->timing.dsp_us + result->timing.classification_us;
+    stats->runs++;
+    stats->dsp_us += result->timing.dsp_us;
+    stats->classification_us += result->timing.classification_us;
+    if (total > stats->max_us) {
+        stats->max_us = total;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool continuous = false;
+    bool debug = false;
+    bool ops = false;
+    bool decode = false;
+    int repeat = 1;
+    int batch = 0;
+    const char *path = NULL;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "--continuous") == 0) {
+            continuous = true;
+        }
+        else if (strcmp(argv[ix], "--debug") == 0) {
+            debug = true;
+        }
+        else if (strcmp(argv[ix], "--ops") == 0) {
+            ops = true;
+        }
+        else if (strcmp(argv[ix], "--decode") == 0) {
+            decode = true;
+        }
+        else if (strcmp(argv[ix], "--repeat") == 0 && ix + 1 < argc) {
+            repeat = atoi(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "--batch") == 0 && ix + 1 < argc) {
+            batch = atoi(argv[++ix]);
+        }
+        else {
+            path = argv[ix];
+        }
+    }
+    if (!path || repeat < 1 || batch < 0 || (batch && continuous)) {
+        fprintf(stderr, "Usage: %s [--continuous | --batch N] [--repeat N] [--ops] [--decode] [--debug] <file | ->\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<float> values;
+    if (read_values(path, &values) != 0) {
+        return 1;
+    }
+
+    const size_t frame_size = EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+    const size_t frames = values.size() / frame_size;
+    if (frames < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+        fprintf(stderr, "Need at least %d frames (%d values), got %zu values\n",
+            EI_CLASSIFIER_RAW_SAMPLE_COUNT, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, values.size());
+        return 1;
+    }
+
+    static EiTfliteProfiler profiler(&ticks_ns);
+    if (ops && ei_tflite_eon_set_profiler(ei_default_impulse.impulse, &profiler) == 0) {
+        fprintf(stderr, "No EON compiled model to profile\n");
+        return 1;
+    }
+
+    timing_stats_t stats = { 0, 0, 0, 0 };
+    std::vector<window_scores_t> history;
+    for (int run = 0; run < repeat; run++) {
+        const bool print = run == repeat - 1;
+        run_classifier_init();
+
+        if (continuous) {
+            // results are valid once a full window went through, as in the sketch
+            for (size_t frame = 0; frame + EI_CLASSIFIER_SLICE_SIZE <= frames; frame += EI_CLASSIFIER_SLICE_SIZE) {
+                signal_t signal;
+                numpy::signal_from_buffer(&values[frame * frame_size], EI_CLASSIFIER_SLICE_SIZE * frame_size, &signal);
+                ei_impulse_result_t result = { 0 };
+                EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result, debug);
+                if (res != EI_IMPULSE_OK) {
+                    fprintf(stderr, "run_classifier_continuous failed (%d)\n", res);
+                    return 1;
+                }
+                if (frame + EI_CLASSIFIER_SLICE_SIZE < EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+                    continue;
+                }
+                add_timing(&stats, &result);
+                if (print) {
+                    print_result(frame + EI_CLASSIFIER_SLICE_SIZE, &result);
+                    add_window(&history, frame + EI_CLASSIFIER_SLICE_SIZE, &result);
+                }
+            }
+        }
+        else if (batch) {
+            const size_t windows = frames / EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+            std::vector<signal_t> signals(batch);
+            std::vector<ei_impulse_result_t> results(batch);
+            for (size_t window = 0; window < windows; window += batch) {
+                const size_t n = windows - window < (size_t)batch ? windows - window : (size_t)batch;
+                for (size_t ix = 0; ix < n; ix++) {
+                    numpy::signal_from_buffer(&values[(window + ix) * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE],
+                        EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signals[ix]);
+                }
+                EI_IMPULSE_ERROR res = run_classifier_batch(signals.data(), n, results.data(), debug);
+                if (res != EI_IMPULSE_OK) {
+                    fprintf(stderr, "run_classifier_batch failed (%d)\n", res);
+                    return 1;
+                }
+                for (size_t ix = 0; ix < n; ix++) {
+                    add_timing(&stats, &results[ix]);
+                    if (print) {
+                        print_result((window + ix + 1) * EI_CLASSIFIER_RAW_SAMPLE_COUNT, &results[ix]);
+                        add_window(&history, (window + ix + 1) * EI_CLASSIFIER_RAW_SAMPLE_COUNT, &results[ix]);
+                    }
+                }
+            }
+        }
+        else {
+            for (size_t frame = 0; frame + EI_CLASSIFIER_RAW_SAMPLE_COUNT <= frames; frame += EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+                signal_t signal;
+                numpy::signal_from_buffer(&values[frame * frame_size], EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+                ei_impulse_result_t result = { 0 };
+                EI_IMPULSE_ERROR res = run_classifier(&signal, &result, debug);
+                if (res != EI_IMPULSE_OK) {
+                    fprintf(stderr, "run_classifier failed (%d)\n", res);
+                    return 1;
+                }
+                add_timing(&stats, &result);
+                if (print) {
+                    print_result(frame + EI_CLASSIFIER_RAW_SAMPLE_COUNT, &result);
+                    add_window(&history, frame + EI_CLASSIFIER_RAW_SAMPLE_COUNT, &result);
+                }
+            }
+        }
+
+        run_classifier_deinit();
+    }
+
+    printf("%llu inferences, mean DSP %.1f us, mean NN %.1f us, max total %lld us\n",
+        (unsigned long long)stats.runs,
+        (double)stats.dsp_us / stats.runs,
+        (double)stats.classification_us / stats.runs,
+        (long long)stats.max_us);
+    if (decode) {
+        print_decoded(history);
+    }
+    if (ops) {
+        print_ops(&profiler);
+    }
+    EI_PROFILE_REPORT();
+    return 0;
+}
@@ -0,0 +1,723 @@
+/* Activity recognition - SDK microbenchmarks
+ *
+ * Times the building blocks of the impulse (numpy / spectral kernels, the
+ * axis gather, the EON model) on 30x3 accelerometer windows, and counts the
+ * ei_malloc / ei_calloc calls each operation makes. Results can be written
+ * as CSV or JSON, so runs before and after an SDK update can be compared.
+ *
+ * Windows come from a recording (interleaved x,y,z in mg, like `classify`
+ * reads) or, without --input, from built-in stand / walk / run shaped windows.
+ *
+ * Buffers the benchmarks pass in are not allocated per op, so allocs/op is
+ * what the kernel itself allocates.
+ *
+ * The fc_s8 / fc_tflm pairs time one fully connected layer in each shape of
+ * the model (random weights, per-window random inputs) through FullyConnectedS8
+ * and through the TFLM reference kernel; setup fails if the outputs differ.
+ * The extract_spectral_analysis_features_quantized entry (DSP straight into
+ * the int8 model input) fails setup the same way if it does not match the
+ * float features quantized afterwards.
+ *
+ * Usage: microbench [--input file] [--filter name] [--min-time seconds] [--csv | --json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <memory>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_smooth.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_fc_s8.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+
+/* Allocation counting ----------------------------------------------------- */
+
+// the POSIX porting layer defines these weak, so these take over
+static uint64_t alloc_count = 0;
+static uint64_t alloc_bytes = 0;
+
+void *ei_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return malloc(size);
+}
+
+void *ei_calloc(size_t nitems, size_t size) {
+    alloc_count++;
+    alloc_bytes += nitems * size;
+    return calloc(nitems, size);
+}
+
+void ei_free(void *ptr) {
+    free(ptr);
+}
+
+/* Inputs ------------------------------------------------------------------ */
+
+#define WINDOW_FRAMES   EI_CLASSIFIER_RAW_SAMPLE_COUNT
+#define WINDOW_AXES     EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME
+#define WINDOW_SIZE     EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE
+
+typedef struct {
+    float data[WINDOW_SIZE];
+} window_t;
+
+static int read_windows(const char *path, std::vector<window_t> *windows) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    std::vector<float> values;
+    char token[32];
+    size_t len = 0;
+    int c;
+    do {
+        c = fgetc(f);
+        if (c == EOF || c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (len > 0) {
+                token[len] = '\0';
+                values.push_back(strtof(token, NULL));
+                len = 0;
+            }
+        }
+        else if (len < sizeof(token) - 1) {
+            token[len++] = (char)c;
+        }
+    } while (c != EOF);
+    fclose(f);
+
+    for (size_t ix = 0; ix + WINDOW_SIZE <= values.size(); ix += WINDOW_SIZE) {
+        window_t w;
+        memcpy(w.data, &values[ix], sizeof(w.data));
+        windows->push_back(w);
+    }
+    if (windows->empty()) {
+        fprintf(stderr, "%s holds less than one window (%d values)\n", path, WINDOW_SIZE);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Stand / walk / run shaped windows at EI_CLASSIFIER_FREQUENCY: gravity on z,
+ * step frequency harmonics with increasing amplitude, sensor noise
+ */
+static void make_windows(std::vector<window_t> *windows) {
+    const float step_hz[] = { 0.0f, 1.8f, 2.8f };
+    const float amplitude[] = { 0.0f, 300.0f, 900.0f };
+    const float noise[] = { 5.0f, 50.0f, 150.0f };
+    uint32_t seed = 1;
+
+    for (size_t activity = 0; activity < 3; activity++) {
+        for (size_t phase = 0; phase < 4; phase++) {
+            window_t w;
+            for (size_t frame = 0; frame < WINDOW_FRAMES; frame++) {
+                float t = (float)(frame + phase * 7) / EI_CLASSIFIER_FREQUENCY;
+                float a = 2.0f * (float)M_PI * step_hz[activity] * t;
+                float r[3];
+                for (size_t axis = 0; axis < 3; axis++) {
+                    seed = seed * 1103515245 + 12345;
+                    r[axis] = (((seed >> 16) & 0x7fff) / 16384.0f - 1.0f) * noise[activity];
+                }
+                w.data[frame * WINDOW_AXES + 0] = amplitude[activity] * sinf(a) + r[0];
+                w.data[frame * WINDOW_AXES + 1] = amplitude[activity] * 0.66f * cosf(a) + r[1];
+                w.data[frame * WINDOW_AXES + 2] = 1000.0f + amplitude[activity] * 0.9f * sinf(2.0f * a) + r[2];
+            }
+            windows->push_back(w);
+        }
+    }
+}
+
+/* Harness ----------------------------------------------------------------- */
+
+typedef struct {
+    const char *name;
+    std::function<int(const window_t *)> fn;
+    std::function<int()> setup;     // optional, before the first op
+    std::function<void()> teardown; // optional, after the last op or a failed setup
+} benchmark_t;
+
+typedef struct {
+    const char *name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+} benchmark_result_t;
+
+typedef std::chrono::steady_clock bench_clock;
+
+/**
+ * Keep the compiler from dropping work whose results are never read
+ */
+static inline void keep(const void *ptr) {
+    __asm__ __volatile__("" : : "g"(ptr) : "memory");
+}
+
+static int run_benchmark(const benchmark_t *bench, const std::vector<window_t> &windows,
+    double min_time_s, benchmark_result_t *result)
+{
+    if (bench->setup && bench->setup() != 0) {
+        fprintf(stderr, "%s setup failed\n", bench->name);
+        if (bench->teardown) {
+            bench->teardown();
+        }
+        return -1;
+    }
+
+    // warm up: lazily created state (FFT plans, model arena) is not part of the steady state
+    for (size_t ix = 0; ix < windows.size(); ix++) {
+        if (bench->fn(&windows[ix]) != 0) {
+            fprintf(stderr, "%s failed\n", bench->name);
+            if (bench->teardown) {
+                bench->teardown();
+            }
+            return -1;
+        }
+    }
+
+    uint64_t iterations = windows.size();
+    while (true) {
+        uint64_t allocs_before = alloc_count;
+        uint64_t bytes_before = alloc_bytes;
+        bench_clock::time_point start = bench_clock::now();
+        for (uint64_t ix = 0; ix < iterations; ix++) {
+            bench->fn(&windows[ix % windows.size()]);
+        }
+        double elapsed_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+
+        if (elapsed_ns >= min_time_s * 1e9 || iterations >= (1ULL << 32)) {
+            result->name = bench->name;
+            result->iterations = iterations;
+            result->ns_per_op = elapsed_ns / iterations;
+            result->allocs_per_op = (double)(alloc_count - allocs_before) / iterations;
+            result->bytes_per_op = (double)(alloc_bytes - bytes_before) / iterations;
+            if (bench->teardown) {
+                bench->teardown();
+            }
+            return 0;
+        }
+
+        // aim a bit past the minimum time on the next round
+        double scale = elapsed_ns > 0 ? (min_time_s * 1e9 * 1.2) / elapsed_ns : 10.0;
+        if (scale > 10.0) {
+            scale = 10.0;
+        }
+        if (scale < 2.0) {
+            scale = 2.0;
+        }
+        iterations = (uint64_t)(iterations * scale);
+    }
+}
+
+/* Benchmarks -------------------------------------------------------------- */
+
+static ei_dsp_config_spectral_analysis_t *spectral_config() {
+    return (ei_dsp_config_spectral_analysis_t *)ei_dsp_blocks[0].config;
+}
+
+/**
+ * One axis of the window, as the spectral block sees it after transposing
+ */
+static void copy_axis(const window_t *w, size_t axis, float *out) {
+    for (size_t frame = 0; frame < WINDOW_FRAMES; frame++) {
+        out[frame] = w->data[frame * WINDOW_AXES + axis];
+    }
+}
+
+static void transpose_window(const window_t *w, matrix_t *out) {
+    for (size_t axis = 0; axis < WINDOW_AXES; axis++) {
+        copy_axis(w, axis, out->buffer + axis * WINDOW_FRAMES);
+    }
+}
+
+// private instance of the EON model, for the model benchmark: the default one
+// belongs to run_classifier, which keeps it initialized with a persistent model
+static tflite_learn_5_model_t *bench_model = NULL;
+// quantized features of every window, for the model benchmark
+static TfLiteTensor model_input;
+static std::vector<int8_t> quantized_inputs;
+
+// quantization of the model input, for the fused DSP benchmarks
+static TfLiteQuantizationParams input_params;
+
+static int load_input_params() {
+    tflite_learn_5_model_t *model = tflite_learn_5_create(ei_aligned_calloc, ei_aligned_free);
+    TfLiteTensor input;
+    if (!model) {
+        return -1;
+    }
+    const bool ok = tflite_learn_5_input(model, 0, &input) == kTfLiteOk && input.type == kTfLiteInt8;
+    if (ok) {
+        input_params = input.params;
+    }
+    tflite_learn_5_destroy(model, ei_aligned_free);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Features of a window quantized like run_classifier does without
+ * EI_CLASSIFIER_FUSED_DSP_INPUT: float matrix first, then a quantize pass
+ */
+static int features_then_quantize(const window_t *w, int8_t *out) {
+    signal_t signal;
+    numpy::signal_from_buffer(w->data, WINDOW_SIZE, &signal);
+    float features_buffer[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+    matrix_t features(1, ei_dsp_blocks[0].n_output_features, features_buffer);
+    int ret = extract_spectral_analysis_features(&signal, &features, ei_dsp_blocks[0].config, EI_CLASSIFIER_FREQUENCY);
+    for (size_t ix = 0; ix < features.cols; ix++) {
+        out[ix] = (int8_t)pre_cast_quantize(features.buffer[ix], input_params.scale, input_params.zero_point, true);
+    }
+    return ret;
+}
+
+static int features_quantized(const window_t *w, int8_t *out) {
+    signal_t signal;
+    numpy::signal_from_buffer(w->data, WINDOW_SIZE, &signal);
+    spectral::quantized_features_t features = {
+        out, ei_dsp_blocks[0].n_output_features, input_params.scale, input_params.zero_point };
+    return extract_spectral_analysis_features_quantized(&signal, &features, ei_dsp_blocks[0].config, EI_CLASSIFIER_FREQUENCY);
+}
+
+/**
+ * One fully connected layer in a model shape, with random weights and inputs
+ */
+template <size_t In, size_t Out>
+struct fc_layer_t {
+    int8_t filter[Out * In];
+    int32_t bias[Out];
+    int32_t folded_bias[Out];
+    std::vector<int8_t> inputs;     // In per window
+    int8_t output[Out];
+    tflite::OpDataFullyConnected op;
+};
+
+template <size_t In, size_t Out, TfLiteFusedActivation Act>
+static void add_fc_benchmarks(std::vector<benchmark_t> *benchmarks, const std::vector<window_t> &windows,
+    const char *s8_name, const char *tflm_name)
+{
+    typedef fc_layer_t<In, Out> layer_t;
+    std::shared_ptr<layer_t> layer(new layer_t());
+    const window_t *first = windows.data();
+
+    srand(In * 1000 + Out);
+    for (size_t ix = 0; ix < Out * In; ix++) {
+        layer->filter[ix] = (int8_t)(rand() % 255 - 127);
+    }
+    layer->inputs.resize(windows.size() * In);
+    for (size_t ix = 0; ix < layer->inputs.size(); ix++) {
+        layer->inputs[ix] = (int8_t)(rand() % 256 - 128);
+    }
+    layer->op.input_zero_point = -128;
+    layer->op.filter_zero_point = 0;
+    layer->op.output_zero_point = Act == kTfLiteActNone ? 12 : -128;
+    layer->op.output_activation_min = -128;
+    layer->op.output_activation_max = 127;
+    tflite::QuantizeMultiplier(1.0 / (In * 160.0), &layer->op.output_multiplier, &layer->op.output_shift);
+    for (size_t out_c = 0; out_c < Out; out_c++) {
+        layer->bias[out_c] = rand() % 2001 - 1000;
+        layer->folded_bias[out_c] = ei_fc_s8_fold_bias(&layer->filter[out_c * In], In, layer->bias[out_c], -layer->op.input_zero_point);
+    }
+
+    auto run_tflm = [layer, first](const window_t *w) {
+        static const int32_t input_dims[] = { 1, (int32_t)In };
+        static const int32_t filter_dims[] = { (int32_t)Out, (int32_t)In };
+        static const int32_t bias_dims[] = { (int32_t)Out };
+        static const int32_t output_dims[] = { 1, (int32_t)Out };
+        const tflite::RuntimeShape input_shape(2, input_dims);
+        const tflite::RuntimeShape filter_shape(2, filter_dims);
+        const tflite::RuntimeShape bias_shape(1, bias_dims);
+        const tflite::RuntimeShape output_shape(2, output_dims);
+        tflite::reference_integer_ops::FullyConnected(tflite::FullyConnectedParamsQuantized(layer->op),
+            input_shape, &layer->inputs[(w - first) * In], filter_shape, layer->filter,
+            bias_shape, layer->bias, output_shape, layer->output);
+        keep(layer->output);
+        return 0;
+    };
+
+    auto run_s8 = [layer, first](const window_t *w) {
+        FullyConnectedS8<In, Out, Act>::Eval(layer->op, &layer->inputs[(w - first) * In],
+            layer->filter, layer->folded_bias, layer->output);
+        keep(layer->output);
+        return 0;
+    };
+
+    // both kernels have to agree on every window before anything is timed
+    const size_t window_count = windows.size();
+    auto check = [layer, first, window_count, run_tflm, run_s8]() {
+        for (size_t wx = 0; wx < window_count; wx++) {
+            int8_t expected[Out];
+            run_tflm(&first[wx]);
+            memcpy(expected, layer->output, Out);
+            run_s8(&first[wx]);
+            if (memcmp(expected, layer->output, Out) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    };
+
+    benchmarks->push_back({ s8_name, run_s8, check });
+    benchmarks->push_back({ tflm_name, run_tflm });
+}
+
+/**
+ * ei_classifier_smooth_update over n_readings, fed a label (or uncertain) per window
+ */
+static void add_smooth_benchmark(std::vector<benchmark_t> *benchmarks, const std::vector<window_t> &windows,
+    size_t n_readings, const char *name)
+{
+    std::shared_ptr<ei_classifier_smooth_t> smooth(new ei_classifier_smooth_t());
+    const window_t *first = windows.data();
+
+    benchmarks->push_back({ name, [smooth, first](const window_t *w) {
+        ei_impulse_result_t result = { 0 };
+        const size_t reading = (size_t)(w - first) % (EI_CLASSIFIER_LABEL_COUNT + 1);
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            result.classification[ix].label = ei_classifier_inferencing_categories[ix];
+            result.classification[ix].value = ix == reading ? 0.9f : 0.05f;
+        }
+        keep(ei_classifier_smooth_update(smooth.get(), &result));
+        return 0;
+    },
+    [smooth, n_readings]() {
+        ei_classifier_smooth_init(smooth.get(), n_readings, (uint16_t)(n_readings * 7 / 10));
+        return 0;
+    },
+    [smooth]() { ei_classifier_smooth_free(smooth.get()); }
+    });
+}
+
+static std::vector<benchmark_t> make_benchmarks(const std::vector<window_t> &windows) {
+    std::vector<benchmark_t> benchmarks;
+    const size_t fft_length = spectral_config()->fft_length;
+
+    benchmarks.push_back({ "numpy::rfft", [fft_length](const window_t *w) {
+        float axis[WINDOW_FRAMES];
+        float out[64];
+        copy_axis(w, 0, axis);
+        int ret = numpy::rfft(axis, WINDOW_FRAMES, out, fft_length / 2 + 1, fft_length);
+        keep(out);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "numpy::rms", [](const window_t *w) {
+        float in_buffer[WINDOW_SIZE], out_buffer[WINDOW_AXES];
+        matrix_t in(WINDOW_AXES, WINDOW_FRAMES, in_buffer);
+        matrix_t out(WINDOW_AXES, 1, out_buffer);
+        transpose_window(w, &in);
+        int ret = numpy::rms(&in, &out);
+        keep(out_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "numpy::skew", [](const window_t *w) {
+        float in_buffer[WINDOW_SIZE], out_buffer[WINDOW_AXES];
+        matrix_t in(WINDOW_AXES, WINDOW_FRAMES, in_buffer);
+        matrix_t out(WINDOW_AXES, 1, out_buffer);
+        transpose_window(w, &in);
+        int ret = numpy::skew(&in, &out);
+        keep(out_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "numpy::kurtosis", [](const window_t *w) {
+        float in_buffer[WINDOW_SIZE], out_buffer[WINDOW_AXES];
+        matrix_t in(WINDOW_AXES, WINDOW_FRAMES, in_buffer);
+        matrix_t out(WINDOW_AXES, 1, out_buffer);
+        transpose_window(w, &in);
+        int ret = numpy::kurtosis(&in, &out);
+        keep(out_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "numpy::welch_max_hold", [fft_length](const window_t *w) {
+        // computes in place, so every op works on a fresh copy of the axis
+        float axis[WINDOW_FRAMES];
+        float out[64];
+        copy_axis(w, 0, axis);
+        int ret = numpy::welch_max_hold(axis, WINDOW_FRAMES, out, 0, fft_length / 2 + 1,
+            fft_length, spectral_config()->do_fft_overlap);
+        keep(out);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "processing::find_fft_peaks", [fft_length](const window_t *w) {
+        float axis[WINDOW_FRAMES];
+        copy_axis(w, 0, axis);
+        float fft_buffer[64], peaks_buffer[64];
+        matrix_t fft_matrix(1, fft_length / 2 + 1, fft_buffer);
+        int ret = numpy::rfft(axis, WINDOW_FRAMES, fft_matrix.buffer, fft_matrix.cols, fft_length);
+        if (ret != EIDSP_OK) {
+            return ret;
+        }
+        matrix_t peaks_matrix(spectral_config()->spectral_peaks_count, 2, peaks_buffer);
+        ret = spectral::processing::find_fft_peaks(&fft_matrix, &peaks_matrix,
+            EI_CLASSIFIER_FREQUENCY, spectral_config()->spectral_peaks_threshold, fft_length);
+        keep(peaks_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "processing::spectral_power_edges", [fft_length](const window_t *w) {
+        static const float edges[] = { 0.1f, 0.5f, 1.0f, 2.0f, 5.0f };
+        static const size_t edge_count = sizeof(edges) / sizeof(edges[0]);
+        float axis_buffer[WINDOW_FRAMES], fft_buffer[64], freq_buffer[64], out_buffer[edge_count];
+        matrix_t axis_matrix(1, WINDOW_FRAMES, axis_buffer);
+        copy_axis(w, 0, axis_matrix.buffer);
+        matrix_t fft_matrix(1, fft_length / 2 + 1, fft_buffer);
+        matrix_t freq_matrix(1, fft_length / 2 + 1, freq_buffer);
+        int ret = spectral::processing::periodogram(&axis_matrix, &fft_matrix, &freq_matrix,
+            EI_CLASSIFIER_FREQUENCY, fft_length);
+        if (ret != EIDSP_OK) {
+            return ret;
+        }
+        matrix_t edges_matrix(edge_count, 1, const_cast<float *>(edges));
+        matrix_t out_matrix(edge_count - 1, 1, out_buffer);
+        ret = spectral::processing::spectral_power_edges(&fft_matrix, &freq_matrix,
+            &edges_matrix, &out_matrix, EI_CLASSIFIER_FREQUENCY);
+        keep(out_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "processing::butterworth_lowpass_filter", [](const window_t *w) {
+        float in_buffer[WINDOW_SIZE];
+        matrix_t in(WINDOW_AXES, WINDOW_FRAMES, in_buffer);
+        transpose_window(w, &in);
+        int ret = spectral::processing::butterworth_lowpass_filter(&in, EI_CLASSIFIER_FREQUENCY,
+            spectral_config()->filter_cutoff, spectral_config()->filter_order);
+        keep(in_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "processing::butterworth_highpass_filter", [](const window_t *w) {
+        float in_buffer[WINDOW_SIZE];
+        matrix_t in(WINDOW_AXES, WINDOW_FRAMES, in_buffer);
+        transpose_window(w, &in);
+        int ret = spectral::processing::butterworth_highpass_filter(&in, EI_CLASSIFIER_FREQUENCY,
+            spectral_config()->filter_cutoff, spectral_config()->filter_order);
+        keep(in_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "SignalWithAxes::get_data (buffer)", [](const window_t *w) {
+        static uint8_t axes[] = { 0, 2 };
+        signal_t signal;
+        numpy::signal_from_buffer(w->data, WINDOW_SIZE, &signal);
+        SignalWithAxes swa(&signal, axes, sizeof(axes), ei_default_impulse.impulse);
+        float out[WINDOW_FRAMES * sizeof(axes)];
+        int ret = swa.get_signal()->get_data(0, WINDOW_FRAMES * sizeof(axes), out);
+        keep(out);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "SignalWithAxes::get_data (callback)", [](const window_t *w) {
+        static uint8_t axes[] = { 0, 2 };
+        signal_t signal;
+        signal.total_length = WINDOW_SIZE;
+        signal.get_data = [w](size_t offset, size_t length, float *out_ptr) {
+            memcpy(out_ptr, w->data + offset, length * sizeof(float));
+            return 0;
+        };
+        SignalWithAxes swa(&signal, axes, sizeof(axes), ei_default_impulse.impulse);
+        float out[WINDOW_FRAMES * sizeof(axes)];
+        int ret = swa.get_signal()->get_data(0, WINDOW_FRAMES * sizeof(axes), out);
+        keep(out);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "extract_spectral_analysis_features", [](const window_t *w) {
+        signal_t signal;
+        numpy::signal_from_buffer(w->data, WINDOW_SIZE, &signal);
+        float features_buffer[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+        matrix_t features(1, ei_dsp_blocks[0].n_output_features, features_buffer);
+        int ret = extract_spectral_analysis_features(&signal, &features, ei_dsp_blocks[0].config, EI_CLASSIFIER_FREQUENCY);
+        keep(features_buffer);
+        return ret;
+    }});
+
+    benchmarks.push_back({ "extract_spectral_analysis_features + quantize", [](const window_t *w) {
+        int8_t out[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+        int ret = features_then_quantize(w, out);
+        keep(out);
+        return ret;
+    }, load_input_params });
+
+    // both paths have to give the same input tensor on every window before anything is timed
+    benchmarks.push_back({ "extract_spectral_analysis_features_quantized", [](const window_t *w) {
+        int8_t out[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+        int ret = features_quantized(w, out);
+        keep(out);
+        return ret;
+    },
+    [&windows]() {
+        if (load_input_params() != 0) {
+            return -1;
+        }
+        for (size_t wx = 0; wx < windows.size(); wx++) {
+            int8_t expected[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE], actual[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+            if (features_then_quantize(&windows[wx], expected) != EIDSP_OK ||
+                features_quantized(&windows[wx], actual) != EIDSP_OK ||
+                memcmp(expected, actual, ei_dsp_blocks[0].n_output_features) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }});
+
+    benchmarks.push_back({ "tflite_learn_5_invoke", [&windows](const window_t *w) {
+        memcpy(model_input.data.int8, &quantized_inputs[(w - windows.data()) * model_input.bytes], model_input.bytes);
+        return tflite_learn_5_invoke(bench_model) == kTfLiteOk ? 0 : -1;
+    },
+    // on a private instance, so the default one run_classifier uses is left alone;
+    // the features of every window are computed and quantized up front
+    [&windows]() {
+        bench_model = tflite_learn_5_create(ei_aligned_calloc, ei_aligned_free);
+        if (!bench_model ||
+            tflite_learn_5_input(bench_model, 0, &model_input) != kTfLiteOk ||
+            model_input.type != kTfLiteInt8) {
+            return -1;
+        }
+        quantized_inputs.resize(windows.size() * model_input.bytes);
+        for (size_t wx = 0; wx < windows.size(); wx++) {
+            signal_t signal;
+            numpy::signal_from_buffer(windows[wx].data, WINDOW_SIZE, &signal);
+            matrix_t features(1, ei_dsp_blocks[0].n_output_features);
+            int ret = extract_spectral_analysis_features(&signal, &features, ei_dsp_blocks[0].config, EI_CLASSIFIER_FREQUENCY);
+            if (ret != EIDSP_OK || features.cols != model_input.bytes) {
+                return -1;
+            }
+            for (size_t ix = 0; ix < features.cols; ix++) {
+                float q = roundf(features.buffer[ix] / model_input.params.scale) + model_input.params.zero_point;
+                quantized_inputs[wx * model_input.bytes + ix] = (int8_t)(q < -128 ? -128 : (q > 127 ? 127 : q));
+            }
+        }
+        return 0;
+    },
+    []() {
+        if (bench_model) {
+            tflite_learn_5_destroy(bench_model, ei_aligned_free);
+            bench_model = NULL;
+        }
+    }
+    });
+
+    add_fc_benchmarks<39, 20, kTfLiteActRelu>(&benchmarks, windows, "fc_s8<39,20,relu>", "fc_tflm 39x20 relu");
+    add_fc_benchmarks<20, 10, kTfLiteActRelu>(&benchmarks, windows, "fc_s8<20,10,relu>", "fc_tflm 20x10 relu");
+    add_fc_benchmarks<10, 3, kTfLiteActNone>(&benchmarks, windows, "fc_s8<10,3,none>", "fc_tflm 10x3 none");
+
+    benchmarks.push_back({ "run_classifier", [](const window_t *w) {
+        signal_t signal;
+        numpy::signal_from_buffer(w->data, WINDOW_SIZE, &signal);
+        ei_impulse_result_t result = { 0 };
+        return run_classifier(&signal, &result, false) == EI_IMPULSE_OK ? 0 : -1;
+    }});
+
+    add_smooth_benchmark(&benchmarks, windows, 10, "ei_classifier_smooth_update (10)");
+    add_smooth_benchmark(&benchmarks, windows, 600, "ei_classifier_smooth_update (600)");
+
+    return benchmarks;
+}
+
+/* Output ------------------------------------------------------------------ */
+
+static void print_table(const std::vector<benchmark_result_t> &results) {
+    printf("%-42s %12s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+    for (const benchmark_result_t &r : results) {
+        printf("%-42s %12llu %12.1f %12.2f %12.1f\n", r.name, (unsigned long long)r.iterations,
+            r.ns_per_op, r.allocs_per_op, r.bytes_per_op);
+    }
+}
+
+static void print_csv(const std::vector<benchmark_result_t> &results) {
+    printf("benchmark,iterations,ns_per_op,allocs_per_op,bytes_per_op\n");
+    for (const benchmark_result_t &r : results) {
+        printf("\"%s\",%llu,%.3f,%.3f,%.3f\n", r.name, (unsigned long long)r.iterations,
+            r.ns_per_op, r.allocs_per_op, r.bytes_per_op);
+    }
+}
+
+static void print_json(const std::vector<benchmark_result_t> &results, size_t window_count, bool synthetic) {
+    printf("{\n");
+    printf("  \"project\": \"%s\",\n", EI_CLASSIFIER_PROJECT_NAME);
+    printf("  \"deploy_version\": %d,\n", EI_CLASSIFIER_PROJECT_DEPLOY_VERSION);
+    printf("  \"windows\": %zu,\n", window_count);
+    printf("  \"input\": \"%s\",\n", synthetic ? "synthetic" : "recording");
+    printf("  \"benchmarks\": [\n");
+    for (size_t ix = 0; ix < results.size(); ix++) {
+        const benchmark_result_t &r = results[ix];
+        printf("    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.3f }%s\n",
+            r.name, (unsigned long long)r.iterations, r.ns_per_op, r.allocs_per_op, r.bytes_per_op,
+            ix + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL;
+    const char *filter = NULL;
+    double min_time_s = 0.2;
+    enum { OUTPUT_TABLE, OUTPUT_CSV, OUTPUT_JSON } output = OUTPUT_TABLE;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "--input") == 0 && ix + 1 < argc) {
+            input = argv[++ix];
+        }
+        else if (strcmp(argv[ix], "--filter") == 0 && ix + 1 < argc) {
+            filter = argv[++ix];
+        }
+        else if (strcmp(argv[ix], "--min-time") == 0 && ix + 1 < argc) {
+            min_time_s = atof(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "--csv") == 0) {
+            output = OUTPUT_CSV;
+        }
+        else if (strcmp(argv[ix], "--json") == 0) {
+            output = OUTPUT_JSON;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--input file] [--filter name] [--min-time seconds] [--csv | --json]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<window_t> windows;
+    if (input) {
+        if (read_windows(input, &windows) != 0) {
+            return 1;
+        }
+    }
+    else {
+        make_windows(&windows);
+    }
+
+    run_classifier_init();
+
+    std::vector<benchmark_t> benchmarks = make_benchmarks(windows);
+    std::vector<benchmark_result_t> results;
+    for (const benchmark_t &bench : benchmarks) {
+        if (filter && !strstr(bench.name, filter)) {
+            continue;
+        }
+        benchmark_result_t result;
+        if (run_benchmark(&bench, windows, min_time_s, &result) != 0) {
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    run_classifier_deinit();
+
+    switch (output) {
+        case OUTPUT_CSV: print_csv(results); break;
+        case OUTPUT_JSON: print_json(results, windows.size(), input == NULL); break;
+        default: print_table(results); break;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+/* Activity recognition - host pipeline benchmark
+ *
+ * Runs ActivityPipeline on POSIX threads. A thread stands in for the
+ * LIS2DW12: it generates frames at the output data rate into a simulated FIFO
+ * and signals the watermark; the transport stage can be slowed down to see
+ * backpressure build up in the queues. Reports per stage load, captured and
+ * dropped windows, queue high-water marks and end-to-end latency. Exits
+ * with 1 if a stage reported an error or no result came out.
+ *
+ * Usage: pipeline_bench [odr_hz] [seconds] [watermark] [transport_delay_us] [hop_frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "../src/activity_pipeline.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct {
+    int16_t xyz[ACCEL_AXES];
+} fifo_frame_t;
+
+typedef struct {
+    SampleRing<fifo_frame_t, 256> fifo;
+    std::atomic<bool> overrun;      // a frame did not fit into the FIFO since the last read
+    std::atomic<uint32_t> results;
+    uint32_t transport_delay_us;
+} bench_ctx_t;
+
+static size_t read_fifo(int16_t *xyz, size_t max_frames, bool *overrun, void *ctx) {
+    bench_ctx_t *bench = (bench_ctx_t *)ctx;
+    *overrun = bench->overrun.exchange(false);
+    size_t frames = 0;
+    fifo_frame_t frame;
+    while (frames < max_frames && bench->fifo.pop(&frame)) {
+        for (size_t axis = 0; axis < ACCEL_AXES; axis++) {
+            xyz[frames * ACCEL_AXES + axis] = frame.xyz[axis];
+        }
+        frames++;
+    }
+    return frames;
+}
+
+static void publish(const activity_result_t *result, void *ctx) {
+    bench_ctx_t *bench = (bench_ctx_t *)ctx;
+    (void)result;
+    if (bench->transport_delay_us) {
+        std::this_thread::sleep_for(std::chrono::microseconds(bench->transport_delay_us));
+    }
+    bench->results.fetch_add(1);
+}
+
+static void print_stage(const char *name, const pipeline_stage_stats_t *stage, double elapsed) {
+    printf("%s,%u,%.1f,%u,%.2f\n", name, stage->items,
+        stage->items ? (double)stage->busy_us / stage->items : 0.0,
+        stage->max_us, 100.0 * (double)stage->busy_us / (elapsed * 1e6));
+}
+
+static void print_queue(const char *name, const pipeline_queue_stats_t *queue) {
+    printf("%s,%u,%u,%u,%u\n", name, queue->pushed, queue->dropped, queue->high_water, queue->capacity);
+}
+
+int main(int argc, char **argv) {
+    const double odr_hz = argc > 1 ? atof(argv[1]) : 1000.0;
+    const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    const size_t watermark = argc > 3 ? (size_t)atoi(argv[3]) : 25;
+    static bench_ctx_t bench;
+    bench.transport_delay_us = argc > 4 ? (uint32_t)atoi(argv[4]) : 0;
+    const size_t hop_frames = argc > 5 ? (size_t)atoi(argv[5]) : EI_CLASSIFIER_SLICE_SIZE;
+    const uint32_t period_us = (uint32_t)(1e6 / odr_hz);
+
+    run_classifier_init();
+
+    static ActivityPipeline pipeline(period_us, 1, hop_frames);
+    if (!pipeline.start(&activity_pipeline_default_config, &read_fifo, &publish, &bench)) {
+        fprintf(stderr, "Failed to start the pipeline\n");
+        return 1;
+    }
+
+    const bench_clock::time_point start = bench_clock::now();
+    bench_clock::time_point next = start;
+    const auto burst_period = std::chrono::microseconds((uint64_t)period_us * watermark);
+    uint64_t produced = 0;
+    while (std::chrono::duration<double>(bench_clock::now() - start).count() < seconds) {
+        next += burst_period;
+        std::this_thread::sleep_until(next);
+        for (size_t ix = 0; ix < watermark; ix++) {
+            const double t = (double)produced++ / odr_hz;
+            fifo_frame_t frame;
+            frame.xyz[0] = (int16_t)(400.0 * sin(2.0 * M_PI * 1.5 * t));
+            frame.xyz[1] = (int16_t)(200.0 * cos(2.0 * M_PI * 3.0 * t));
+            frame.xyz[2] = (int16_t)(1000.0 + 100.0 * sin(2.0 * M_PI * 0.5 * t));
+            if (!bench.fifo.push(frame)) {
+                bench.overrun.store(true);
+            }
+        }
+        pipeline.fifo_ready();
+    }
+    const double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+    pipeline.stop();
+
+    activity_pipeline_stats_t stats;
+    pipeline.get_stats(&stats);
+
+    printf("odr_hz,watermark,elapsed_s,frames_produced,results,frames_dropped,fifo_overruns,errors,max_latency_us\n");
+    printf("%.1f,%zu,%.3f,%llu,%u,%u,%u,%u,%u\n\n", odr_hz, watermark, elapsed,
+        (unsigned long long)produced, bench.results.load(), stats.frames_dropped, stats.fifo_overruns,
+        stats.errors, stats.max_latency_us);
+
+    printf("stage,items,mean_us,max_us,load_pct\n");
+    print_stage("acquisition", &stats.acquisition, elapsed);
+    print_stage("features", &stats.features, elapsed);
+    print_stage("inference", &stats.inference, elapsed);
+    print_stage("transport", &stats.transport, elapsed);
+
+    printf("\ncapture,hop_frames,completed,dropped,consumed\n");
+    printf("windows,%zu,%u,%u,%u\n", hop_frames, stats.capture.completed, stats.capture.dropped, stats.capture.consumed);
+
+    printf("\nqueue,pushed,dropped,high_water,capacity\n");
+    print_queue("features", &stats.windows);
+    print_queue("results", &stats.results);
+
+#if EIDSP_STATIC_WORKSPACE == 1
+    printf("\nworkspace,high_water,size,heap_fallbacks\n");
+    printf("dsp,%zu,%zu,%u\n", ei::workspace::high_water(), (size_t)EIDSP_STATIC_WORKSPACE_SIZE,
+        (unsigned)ei::workspace::heap_fallbacks());
+#endif
+
+    // a stage that failed or a pipeline that never produced a result fails the run (ctest)
+    if (stats.errors != 0 || bench.results.load() == 0) {
+        fprintf(stderr, "FAILED: %u errors, %u results\n", stats.errors, bench.results.load());
+        return 1;
+    }
+    return 0;
+}
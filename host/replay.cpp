@@ -0,0 +1,666 @@
+/* Activity recognition - offline replay and rescoring
+ *
+ * Re-runs the impulse over recorded accelerometer logs, e.g. weeks of
+ * wristband data after the model changed. Inputs are memory-mapped and are
+ * either raw sample logs copied off the device (src/sample_log.h) or text
+ * recordings in the classify format (interleaved x,y,z in mg). Every input
+ * is cut into windows of EI_CLASSIFIER_RAW_SAMPLE_COUNT frames, one every
+ * --hop frames (the sketch's half window by default).
+ *
+ * Windows are scored in chunks on a work-stealing thread pool: every worker
+ * owns a deque of chunks, takes from its back and steals from the front of
+ * the others' once it runs dry, so a long file does not hold the run up.
+ * A worker runs the DSP blocks of the impulse itself and the model on its
+ * own instance of the EON model (tflite_learn_5_create), over the whole
+ * chunk at once (tflite_learn_5_invoke_batch). Quantization matches
+ * run_classifier, so the scores are the ones classify prints.
+ *
+ * The true label of an input is given as path:label, or taken from the file
+ * name when it starts with a label ("walk-0312.log"). Prints windows/s and a
+ * confusion matrix over the labelled inputs (top score as the prediction),
+ * --out writes every window as CSV. --scaling repeats the scoring with 1, 2,
+ * 4, ... threads up to --threads and prints the speedup.
+ *
+ * Usage: replay [--threads N] [--hop frames] [--chunk windows] [--out results.csv] [--scaling]
+ *               <log | recording>[:label] ...
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "tflite-model/tflite_learn_5_compiled.h"
+#include "../src/sample_log.h"
+
+#define REPLAY_DEFAULT_CHUNK    64
+#define REPLAY_NO_LABEL         -1
+
+typedef std::chrono::steady_clock replay_clock;
+
+/**
+ * One input, decoded to impulse values
+ */
+typedef struct {
+    std::string path;
+    int label;
+    bool sample_log;
+    std::vector<float> values;          // interleaved x,y,z
+    std::vector<int64_t> timestamps_us; // per frame, sample logs only
+    size_t first_window;                // index of its first window over all inputs
+    size_t windows;
+    std::string error;
+} replay_input_t;
+
+/**
+ * Windows [first, first + count) of an input
+ */
+typedef struct {
+    size_t input;
+    size_t first;
+    size_t count;
+} replay_chunk_t;
+
+typedef struct {
+    float scores[EI_CLASSIFIER_LABEL_COUNT];
+    bool ok;
+} window_result_t;
+
+/**
+ * @brief      Runs a fixed set of tasks on worker threads. Tasks are dealt round
+ *             robin into one deque per worker; a worker pops from the back of its
+ *             own deque and, once that is empty, steals from the front of the
+ *             others', starting with its neighbour.
+ */
+class WorkStealingPool {
+public:
+    typedef std::function<void(size_t worker, size_t task)> task_fn;
+
+    explicit WorkStealingPool(size_t threads) : _queues(threads), _steals(0) { }
+
+    /**
+     * @brief      Run tasks 0 .. tasks - 1, returns when all are done
+     *
+     * @param      start  Called once per worker in its thread, before its first task
+     */
+    void run(size_t tasks, const std::function<void(size_t worker)> &start, const task_fn &fn) {
+        for (size_t ix = 0; ix < tasks; ix++) {
+            _queues[ix % _queues.size()].tasks.push_back(ix);
+        }
+        std::vector<std::thread> threads;
+        for (size_t worker = 0; worker < _queues.size(); worker++) {
+            threads.emplace_back([this, worker, &start, &fn] {
+                start(worker);
+                size_t task;
+                while (pop(worker, &task) || steal(worker, &task)) {
+                    fn(worker, task);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    size_t threads() const {
+        return _queues.size();
+    }
+
+    uint64_t steals() const {
+        return _steals.load();
+    }
+
+private:
+    struct queue_t {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool pop(size_t worker, size_t *task) {
+        queue_t *queue = &_queues[worker];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->tasks.empty()) {
+            return false;
+        }
+        *task = queue->tasks.back();
+        queue->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t worker, size_t *task) {
+        // tasks are never added while running, so one pass over the others is enough
+        for (size_t offset = 1; offset < _queues.size(); offset++) {
+            queue_t *victim = &_queues[(worker + offset) % _queues.size()];
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (!victim->tasks.empty()) {
+                *task = victim->tasks.front();
+                victim->tasks.pop_front();
+                _steals.fetch_add(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<queue_t> _queues;
+    std::atomic<uint64_t> _steals;
+};
+
+/**
+ * @brief      Per worker state: impulse handle, model instance and the buffers
+ *             of one chunk
+ */
+class WindowScorer {
+public:
+    explicit WindowScorer(size_t max_windows)
+        : _handle(ei_default_impulse.impulse),
+          _model(tflite_learn_5_create(ei_aligned_calloc, ei_aligned_free))
+    {
+        memset(&_input, 0, sizeof(_input));
+        memset(&_output, 0, sizeof(_output));
+        const ei_impulse_t *impulse = ei_default_impulse.impulse;
+        _block = &impulse->learning_blocks[0];
+        _block_config = (ei_learning_block_config_tflite_graph_t *)_block->config;
+        if (!_model || tflite_learn_5_input(_model, 0, &_input) != kTfLiteOk
+            || tflite_learn_5_output(_model, 0, &_output) != kTfLiteOk) {
+            return;
+        }
+        _input_rows.resize(max_windows * _input.bytes);
+        _output_rows.resize(max_windows * _output.bytes);
+        _features.resize(impulse->dsp_blocks_size + impulse->learning_blocks_size);
+        _rows.resize(impulse->dsp_blocks_size);
+        _views.resize(impulse->dsp_blocks_size);
+        for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+            _rows[ix].reset(new ei::matrix_t(max_windows, impulse->dsp_blocks[ix].n_output_features));
+            _views[ix].reset(new ei::matrix_t(1, _rows[ix]->cols, _rows[ix]->buffer));
+            _features[ix].matrix = _views[ix].get();
+            _features[ix].blockId = impulse->dsp_blocks[ix].blockId;
+        }
+    }
+
+    ~WindowScorer() {
+        if (_model) {
+            tflite_learn_5_destroy(_model, ei_aligned_free);
+        }
+    }
+
+    /**
+     * @brief      Whether the model is int8 and could be set up
+     */
+    bool ready() const {
+        return _model && _input.type == kTfLiteInt8 && _output.type == kTfLiteInt8;
+    }
+
+    /**
+     * @brief      Score count windows starting at values, hop_values apart
+     */
+    void score(const float *values, size_t hop_values, size_t count, window_result_t *results) {
+        const ei_impulse_t *impulse = ei_default_impulse.impulse;
+        size_t ok = 0;
+        for (size_t w = 0; w < count; w++) {
+            ei::signal_t signal;
+            ei::numpy::signal_from_buffer(values + w * hop_values, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+            results[w].ok = true;
+            for (size_t ix = 0; ix < impulse->dsp_blocks_size && results[w].ok; ix++) {
+                // one row of the chunk matrix per window, the row views move along
+                _views[ix]->buffer = _rows[ix]->buffer + ok * _rows[ix]->cols;
+                memset(_views[ix]->buffer, 0, _rows[ix]->cols * sizeof(float));
+                results[w].ok = run_dsp_block(&_handle, ix, &signal, _views[ix].get()) == EI_IMPULSE_OK;
+            }
+            if (!results[w].ok) {
+                continue;
+            }
+            TfLiteTensor row_input = _input;
+            row_input.data.int8 = &_input_rows[ok * _input.bytes];
+            results[w].ok = fill_input_tensor_from_matrix(_features.data(), &row_input, (uint32_t *)_block->input_block_ids,
+                                                          _block->input_block_ids_size, _features.size()) == EI_IMPULSE_OK;
+            if (results[w].ok) {
+                ok++;
+            }
+        }
+
+        if (ok > 0 && tflite_learn_5_invoke_batch(_model, _input_rows.data(), _output_rows.data(), ok) != kTfLiteOk) {
+            for (size_t w = 0; w < count; w++) {
+                results[w].ok = false;
+            }
+        }
+
+        size_t row = 0;
+        for (size_t w = 0; w < count; w++) {
+            if (!results[w].ok) {
+                continue;
+            }
+            ei_impulse_result_t result;
+            memset(&result, 0, sizeof(result));
+            TfLiteTensor row_output = _output;
+            row_output.data.int8 = &_output_rows[row++ * _output.bytes];
+            results[w].ok = fill_result_struct_from_output_tensor_tflite(impulse, _block_config, &row_output,
+                                                                         &row_output, &row_output, &result, false) == EI_IMPULSE_OK;
+            for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+                results[w].scores[ix] = result.classification[ix].value;
+            }
+        }
+    }
+
+private:
+    ei_impulse_handle_t _handle;
+    tflite_learn_5_model_t *_model;
+    const ei_learning_block_t *_block;
+    ei_learning_block_config_tflite_graph_t *_block_config;
+    TfLiteTensor _input;
+    TfLiteTensor _output;
+    std::vector<int8_t> _input_rows;
+    std::vector<int8_t> _output_rows;
+    std::vector<std::unique_ptr<ei::matrix_t>> _rows;   // features of the chunk, per DSP block
+    std::vector<std::unique_ptr<ei::matrix_t>> _views;  // the current window's row of _rows
+    std::vector<ei_feature_t> _features;                // over _views
+};
+
+/**
+ * @brief      Read-only mapping of a whole file
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const char *path) : _data(NULL), _size(0) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                _data = (const uint8_t *)data;
+                _size = (size_t)st.st_size;
+                madvise(data, _size, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (_data) {
+            munmap((void *)_data, _size);
+        }
+    }
+
+    const uint8_t *data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+};
+
+static bool is_sample_log(const uint8_t *data, size_t size) {
+    if (size == 0 || size % SAMPLE_LOG_BLOCK_SIZE != 0) {
+        return false;
+    }
+    for (size_t offset = 0; offset < size; offset += SAMPLE_LOG_BLOCK_SIZE) {
+        sample_log_block_t info;
+        if (sample_log_decode(&data[offset], &info, NULL, 0) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void load_sample_log(const uint8_t *data, size_t size, replay_input_t *input) {
+    std::vector<std::pair<uint32_t, size_t>> blocks;
+    for (size_t offset = 0; offset < size; offset += SAMPLE_LOG_BLOCK_SIZE) {
+        sample_log_block_t info;
+        if (sample_log_decode(&data[offset], &info, NULL, 0) > 0) {
+            blocks.push_back(std::make_pair(info.sequence, offset));
+        }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    std::vector<accel_frame_t> frames(SAMPLE_LOG_BLOCK_SIZE);
+    int64_t timestamp_us = 0;
+    uint32_t last_us = 0;
+    for (size_t ix = 0; ix < blocks.size(); ix++) {
+        sample_log_block_t info;
+        const int count = sample_log_decode(&data[blocks[ix].second], &info, frames.data(), frames.size());
+        for (int frame = 0; frame < count; frame++) {
+            timestamp_us = input->timestamps_us.empty() ? frames[frame].timestamp_us
+                         : timestamp_us + (int32_t)(frames[frame].timestamp_us - last_us);
+            last_us = frames[frame].timestamp_us;
+            input->timestamps_us.push_back(timestamp_us);
+            for (size_t axis = 0; axis < ACCEL_AXES; axis++) {
+                input->values.push_back(frames[frame].xyz[axis]);
+            }
+        }
+    }
+}
+
+static void load_text(const uint8_t *data, size_t size, replay_input_t *input) {
+    char token[32];
+    size_t len = 0;
+    for (size_t ix = 0; ix <= size; ix++) {
+        const int c = ix < size ? data[ix] : ' ';
+        if (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            if (len > 0) {
+                token[len] = '\0';
+                char *end;
+                const float v = strtof(token, &end);
+                if (*end != '\0') {
+                    input->error = std::string("invalid value '") + token + "'";
+                    return;
+                }
+                input->values.push_back(v);
+                len = 0;
+            }
+        }
+        else if (len < sizeof(token) - 1) {
+            token[len++] = (char)c;
+        }
+    }
+}
+
+static void load_input(replay_input_t *input) {
+    MappedFile file(input->path.c_str());
+    if (!file.data()) {
+        input->error = "failed to map the file";
+        return;
+    }
+    input->sample_log = is_sample_log(file.data(), file.size());
+    if (input->sample_log) {
+        load_sample_log(file.data(), file.size(), input);
+    }
+    else {
+        load_text(file.data(), file.size(), input);
+    }
+}
+
+static int find_label(const char *name, size_t len) {
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        const char *label = ei_classifier_inferencing_categories[ix];
+        if (strlen(label) <= len && strncasecmp(name, label, strlen(label)) == 0
+            && (strlen(label) == len || !isalpha((unsigned char)name[strlen(label)]))) {
+            return (int)ix;
+        }
+    }
+    return REPLAY_NO_LABEL;
+}
+
+/**
+ * @brief      path:label, or the label the file name starts with
+ */
+static void parse_input_arg(const char *arg, replay_input_t *input) {
+    input->path = arg;
+    input->label = REPLAY_NO_LABEL;
+    const char *colon = strrchr(arg, ':');
+    if (colon) {
+        const int label = find_label(colon + 1, strlen(colon + 1));
+        if (label != REPLAY_NO_LABEL && strlen(colon + 1) == strlen(ei_classifier_inferencing_categories[label])) {
+            input->path.assign(arg, colon - arg);
+            input->label = label;
+            return;
+        }
+    }
+    const char *slash = strrchr(input->path.c_str(), '/');
+    const char *name = slash ? slash + 1 : input->path.c_str();
+    input->label = find_label(name, strlen(name));
+}
+
+/**
+ * @return     Seconds the scoring took, -1 if a worker could not set up the model
+ */
+static double score_all(const std::vector<replay_input_t> &inputs, const std::vector<replay_chunk_t> &chunks,
+                        size_t threads, size_t hop, size_t chunk_windows,
+                        std::vector<window_result_t> *results, uint64_t *steals)
+{
+    WorkStealingPool pool(threads);
+    std::vector<std::unique_ptr<WindowScorer>> scorers(threads);
+    std::atomic<bool> failed(false);
+
+    const replay_clock::time_point start = replay_clock::now();
+    pool.run(chunks.size(),
+        [&](size_t worker) {
+            scorers[worker].reset(new WindowScorer(chunk_windows));
+            if (!scorers[worker]->ready()) {
+                failed.store(true);
+            }
+        },
+        [&](size_t worker, size_t task) {
+            if (!scorers[worker]->ready()) {
+                return;
+            }
+            const replay_chunk_t *chunk = &chunks[task];
+            const replay_input_t *input = &inputs[chunk->input];
+            scorers[worker]->score(&input->values[chunk->first * hop * ACCEL_AXES], hop * ACCEL_AXES, chunk->count,
+                                   &(*results)[input->first_window + chunk->first]);
+        });
+    const double elapsed_s = std::chrono::duration<double>(replay_clock::now() - start).count();
+    *steals = pool.steals();
+    return failed.load() ? -1.0 : elapsed_s;
+}
+
+static int top_label(const window_result_t *result) {
+    int top = 0;
+    for (size_t ix = 1; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->scores[ix] > result->scores[top]) {
+            top = (int)ix;
+        }
+    }
+    return top;
+}
+
+static int write_results(const char *path, const std::vector<replay_input_t> &inputs,
+                         const std::vector<window_result_t> &results, size_t hop)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    fprintf(f, "file,window,first_frame,start_s,label,predicted");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        fprintf(f, ",%s", ei_classifier_inferencing_categories[ix]);
+    }
+    fprintf(f, "\n");
+    for (const replay_input_t &input : inputs) {
+        for (size_t w = 0; w < input.windows; w++) {
+            const window_result_t *result = &results[input.first_window + w];
+            const size_t frame = w * hop;
+            const double start_s = input.sample_log ? (input.timestamps_us[frame] - input.timestamps_us[0]) / 1e6
+                                                    : (double)frame / EI_CLASSIFIER_FREQUENCY;
+            fprintf(f, "%s,%zu,%zu,%.3f,%s,%s", input.path.c_str(), w, frame, start_s,
+                input.label == REPLAY_NO_LABEL ? "" : ei_classifier_inferencing_categories[input.label],
+                result->ok ? ei_classifier_inferencing_categories[top_label(result)] : "error");
+            for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+                fprintf(f, ",%.5f", result->ok ? result->scores[ix] : 0.0f);
+            }
+            fprintf(f, "\n");
+        }
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static void print_confusion(const std::vector<replay_input_t> &inputs, const std::vector<window_result_t> &results) {
+    uint64_t confusion[EI_CLASSIFIER_LABEL_COUNT][EI_CLASSIFIER_LABEL_COUNT] = { };
+    uint64_t labelled = 0;
+    uint64_t correct = 0;
+    for (const replay_input_t &input : inputs) {
+        if (input.label == REPLAY_NO_LABEL) {
+            continue;
+        }
+        for (size_t w = 0; w < input.windows; w++) {
+            const window_result_t *result = &results[input.first_window + w];
+            if (result->ok) {
+                const int predicted = top_label(result);
+                confusion[input.label][predicted]++;
+                labelled++;
+                correct += predicted == input.label;
+            }
+        }
+    }
+    if (labelled == 0) {
+        printf("\nno labelled inputs, no confusion matrix\n");
+        return;
+    }
+
+    printf("\nconfusion matrix (rows: label, columns: predicted)\n%-10s", "");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        printf(" %10s", ei_classifier_inferencing_categories[ix]);
+    }
+    printf(" %10s\n", "recall");
+    for (size_t label = 0; label < EI_CLASSIFIER_LABEL_COUNT; label++) {
+        uint64_t total = 0;
+        printf("%-10s", ei_classifier_inferencing_categories[label]);
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            printf(" %10llu", (unsigned long long)confusion[label][ix]);
+            total += confusion[label][ix];
+        }
+        if (total > 0) {
+            printf(" %9.1f%%\n", 100.0 * confusion[label][label] / total);
+        }
+        else {
+            printf(" %10s\n", "-");
+        }
+    }
+    printf("accuracy %.1f%% over %llu windows\n", 100.0 * correct / labelled, (unsigned long long)labelled);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--threads N] [--hop frames] [--chunk windows] [--out results.csv] [--scaling]\n"
+                    "       %*s <log | recording>[:label] ...\n", name, (int)strlen(name), "");
+}
+
+int main(int argc, char **argv) {
+    size_t threads = std::thread::hardware_concurrency();
+    size_t hop = EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2;
+    size_t chunk_windows = REPLAY_DEFAULT_CHUNK;
+    const char *out_path = NULL;
+    bool scaling = false;
+    std::vector<replay_input_t> inputs;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "--threads") == 0 && ix + 1 < argc) {
+            threads = (size_t)atol(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "--hop") == 0 && ix + 1 < argc) {
+            hop = (size_t)atol(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "--chunk") == 0 && ix + 1 < argc) {
+            chunk_windows = (size_t)atol(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "--out") == 0 && ix + 1 < argc) {
+            out_path = argv[++ix];
+        }
+        else if (strcmp(argv[ix], "--scaling") == 0) {
+            scaling = true;
+        }
+        else if (argv[ix][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            inputs.push_back(replay_input_t());
+            parse_input_arg(argv[ix], &inputs.back());
+        }
+    }
+    if (inputs.empty() || threads == 0 || hop == 0 || chunk_windows == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // one file per task, decoding and parsing go over the same pool
+    const replay_clock::time_point load_start = replay_clock::now();
+    WorkStealingPool loader(std::min(threads, inputs.size()));
+    loader.run(inputs.size(), [](size_t) { }, [&inputs](size_t, size_t task) {
+        load_input(&inputs[task]);
+    });
+    const double load_s = std::chrono::duration<double>(replay_clock::now() - load_start).count();
+
+    size_t windows = 0;
+    uint64_t frames = 0;
+    std::vector<replay_chunk_t> chunks;
+    for (size_t ix = 0; ix < inputs.size(); ix++) {
+        replay_input_t *input = &inputs[ix];
+        if (!input->error.empty()) {
+            fprintf(stderr, "%s: %s\n", input->path.c_str(), input->error.c_str());
+            return 1;
+        }
+        const size_t input_frames = input->values.size() / ACCEL_AXES;
+        input->first_window = windows;
+        input->windows = input_frames < EI_CLASSIFIER_RAW_SAMPLE_COUNT ? 0
+                       : (input_frames - EI_CLASSIFIER_RAW_SAMPLE_COUNT) / hop + 1;
+        for (size_t first = 0; first < input->windows; first += chunk_windows) {
+            chunks.push_back(replay_chunk_t { ix, first, std::min(chunk_windows, input->windows - first) });
+        }
+        windows += input->windows;
+        frames += input_frames;
+        printf("%s: %s, %zu frames, %zu windows, label %s\n", input->path.c_str(),
+            input->sample_log ? "sample log" : "text", input_frames, input->windows,
+            input->label == REPLAY_NO_LABEL ? "-" : ei_classifier_inferencing_categories[input->label]);
+    }
+    if (windows == 0) {
+        fprintf(stderr, "No complete window (%d frames) in the inputs\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+        return 1;
+    }
+    printf("%llu frames loaded in %.3f s\n", (unsigned long long)frames, load_s);
+
+    std::vector<window_result_t> results(windows);
+    if (scaling) {
+        printf("\n%8s %14s %10s %10s %10s\n", "threads", "windows/s", "speedup", "efficiency", "steals");
+        double single_rate = 0.0;
+        for (size_t count = 1; count <= threads; count = count * 2 > threads && count < threads ? threads : count * 2) {
+            uint64_t steals;
+            const double elapsed_s = score_all(inputs, chunks, count, hop, chunk_windows, &results, &steals);
+            if (elapsed_s < 0) {
+                fprintf(stderr, "Failed to set up the model\n");
+                return 1;
+            }
+            const double rate = windows / elapsed_s;
+            if (count == 1) {
+                single_rate = rate;
+            }
+            printf("%8zu %14.0f %9.2fx %9.0f%% %10llu\n", count, rate, rate / single_rate,
+                100.0 * rate / single_rate / count, (unsigned long long)steals);
+        }
+    }
+    else {
+        uint64_t steals;
+        const double elapsed_s = score_all(inputs, chunks, threads, hop, chunk_windows, &results, &steals);
+        if (elapsed_s < 0) {
+            fprintf(stderr, "Failed to set up the model\n");
+            return 1;
+        }
+        printf("\n%zu windows (hop %zu frames) in %zu chunks on %zu threads: %.3f s, %.0f windows/s, %llu steals\n",
+            windows, hop, chunks.size(), threads, elapsed_s, windows / elapsed_s, (unsigned long long)steals);
+    }
+
+    size_t errors = 0;
+    for (const window_result_t &result : results) {
+        errors += !result.ok;
+    }
+    if (errors) {
+        printf("%zu windows failed\n", errors);
+    }
+    print_confusion(inputs, results);
+
+    if (out_path && write_results(out_path, inputs, results, hop) != 0) {
+        return 1;
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/* Activity recognition - result log benchmark
+ *
+ * Runs ResultLog on a simulated flash file system and a simulated BLE link,
+ * in three steps:
+ *
+ *  1. offline: no phone for the given hours, a result is appended every hop
+ *  2. reset: power is cut (the partial block in RAM is lost), one block of the
+ *     backlog gets corrupted and a new ResultLog has to find the rest
+ *  3. sync: the phone reconnects, the backlog goes through result_log_sync()
+ *     and ResultBatcher at the link's notification rate, every decoded record
+ *     is checked against what was appended. The link drops once during the
+ *     sync, the records of the lost packet have to go out again.
+ *
+ * The file system is modelled on SPIFFS: a write reprograms every page whose
+ * data it touches (251 data bytes per 256 byte page) plus the file's index
+ * page, and every 16 reprogrammed pages cost one 4 KB sector erase. Step 1
+ * also runs with flush() after every record, i.e. unbuffered appends.
+ *
+ * Reports write amplification (flash bytes programmed per byte of results),
+ * page programs and erases per hour and the flash time they take, then the
+ * sync time over the link and the host throughput of read + encode + decode.
+ *
+ * Usage: result_log_bench [hours] [hop_ms] [connection_interval_ms] [notifications_per_event]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "../src/result_log.h"
+
+#define FLASH_PAGE_SIZE             256
+#define FLASH_PAGE_DATA             251
+#define FLASH_SECTOR_PAGES          16
+// Typical SPI NOR figures (page program, 4 KB sector erase)
+#define FLASH_PAGE_PROGRAM_US       700
+#define FLASH_SECTOR_ERASE_US       45000
+
+typedef std::chrono::steady_clock bench_clock;
+typedef ResultBatcher<EI_CLASSIFIER_LABEL_COUNT> batcher_t;
+
+/**
+ * SPIFFS file stand-in, counts what the writes cost in flash
+ */
+class SimulatedFlash {
+public:
+    explicit SimulatedFlash(size_t size) : _data(size, 0xff), _writes(0), _page_programs(0) { }
+
+    bool read(uint32_t offset, void *data, size_t size) {
+        if (offset + size > _data.size()) {
+            return false;
+        }
+        memcpy(data, &_data[offset], size);
+        return true;
+    }
+
+    bool write(uint32_t offset, const void *data, size_t size) {
+        if (offset + size > _data.size()) {
+            return false;
+        }
+        memcpy(&_data[offset], data, size);
+        _writes++;
+        _page_programs += (offset + size - 1) / FLASH_PAGE_DATA - offset / FLASH_PAGE_DATA + 1 + 1;
+        return true;
+    }
+
+    void corrupt(uint32_t offset) {
+        _data[offset] ^= 0x5a;
+    }
+
+    uint64_t writes() const {
+        return _writes;
+    }
+
+    uint64_t page_programs() const {
+        return _page_programs;
+    }
+
+    uint64_t erases() const {
+        return _page_programs / FLASH_SECTOR_PAGES;
+    }
+
+    double busy_ms() const {
+        return (_page_programs * FLASH_PAGE_PROGRAM_US + erases() * FLASH_SECTOR_ERASE_US) / 1000.0;
+    }
+
+private:
+    std::vector<uint8_t> _data;
+    uint64_t _writes;
+    uint64_t _page_programs;
+};
+
+typedef ResultLog<SimulatedFlash, EI_CLASSIFIER_LABEL_COUNT, RESULT_LOG_BLOCKS> log_t;
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint8_t class_id;
+    uint8_t scores[EI_CLASSIFIER_LABEL_COUNT];
+} appended_t;
+
+typedef struct {
+    log_t *log;
+    const std::vector<appended_t> *appended;
+    uint32_t packets;
+    uint32_t records;
+    uint32_t last_sequence;
+    uint32_t errors;
+    uint32_t drop_packet;   // this packet does not arrive (link lost)
+    uint32_t sent;
+} phone_t;
+
+/**
+ * Notification callback: the phone decodes and checks the packet, the log
+ * learns it was delivered
+ */
+static void deliver_packet(const uint8_t *packet, size_t size, void *ctx) {
+    phone_t *phone = (phone_t *)ctx;
+    if (phone->sent++ == phone->drop_packet) {
+        // as the sketch does when notifying without a connection
+        phone->log->rewind();
+        return;
+    }
+    result_record_t records[RESULT_PROTOCOL_MAX_PAYLOAD / RESULT_PROTOCOL_RECORD_SIZE(0)];
+    result_packet_info_t info;
+    int count = result_protocol_decode(packet, size, &info, records, sizeof(records) / sizeof(records[0]));
+    if (count <= 0) {
+        phone->errors++;
+        return;
+    }
+    phone->packets++;
+    for (int ix = 0; ix < count; ix++) {
+        // widen the 16 bit sequence around the last one seen
+        const uint32_t sequence = phone->last_sequence + (uint16_t)(records[ix].sequence - (uint16_t)phone->last_sequence);
+        const appended_t *sent = sequence < phone->appended->size() ? &(*phone->appended)[sequence] : NULL;
+        if ((phone->records > 0 && sequence <= phone->last_sequence) || !sent
+            || sent->timestamp_ms != records[ix].timestamp_ms || sent->class_id != records[ix].class_id
+            || memcmp(sent->scores, records[ix].scores, EI_CLASSIFIER_LABEL_COUNT) != 0) {
+            phone->errors++;
+        }
+        phone->last_sequence = sequence;
+        phone->records++;
+    }
+    phone->log->acknowledge(info.sequence, info.record_count);
+}
+
+static void make_result(uint32_t ix, uint32_t hop_ms, appended_t *result, float *scores) {
+    // activities of 20 windows, scores with some variation
+    result->timestamp_ms = 1000 + ix * hop_ms;
+    result->class_id = (uint8_t)((ix / 20) % (EI_CLASSIFIER_LABEL_COUNT + 1));
+    for (size_t label = 0; label < EI_CLASSIFIER_LABEL_COUNT; label++) {
+        scores[label] = label == result->class_id ? 0.7f + (ix % 7) * 0.04f : (ix % 5) * 0.03f;
+        result->scores[label] = result_protocol_quantize(scores[label]);
+    }
+}
+
+/**
+ * @return     false if the sync lost or garbled records it should have delivered
+ */
+static bool run(const char *name, bool unbuffered, uint32_t results, uint32_t hop_ms, double hours,
+                uint32_t interval_ms, uint32_t per_event, bool report_sync) {
+    SimulatedFlash flash(log_t::STORAGE_SIZE);
+    std::vector<appended_t> appended(results);
+
+    log_t *log = new log_t(&flash);
+    log->begin();
+    for (uint32_t ix = 0; ix < results; ix++) {
+        float scores[EI_CLASSIFIER_LABEL_COUNT];
+        make_result(ix, hop_ms, &appended[ix], scores);
+        log->append(appended[ix].timestamp_ms, appended[ix].class_id, scores);
+        if (unbuffered) {
+            log->flush();
+        }
+    }
+
+    result_log_stats_t stats;
+    log->get_stats(&stats);
+    const double logged = (double)results * log_t::RECORD_SIZE;
+    printf("%-12s %8.2f %12.0f %10.0f %12.1f\n", name,
+        flash.page_programs() * FLASH_PAGE_SIZE / logged,
+        flash.page_programs() / hours, flash.erases() / hours, flash.busy_ms() / hours / 1000.0);
+
+    // power cut: the partial block is gone, a complete block that is not the
+    // newest one gets corrupted
+    const uint32_t in_ram = unbuffered ? 0 : results % log_t::RECORDS_PER_BLOCK;
+    const uint32_t corrupt_block = results / log_t::RECORDS_PER_BLOCK - 2;
+    flash.corrupt(corrupt_block % RESULT_LOG_BLOCKS * RESULT_LOG_BLOCK_SIZE + RESULT_LOG_HEADER_SIZE + 5);
+    delete log;
+
+    log = new log_t(&flash);
+    log->begin();
+    const size_t backlog = log->unsynced();
+
+    phone_t phone = { log, &appended, 0, 0, 0, 0, 3, 0 };
+    batcher_t batcher(deliver_packet, &phone, RESULT_PROTOCOL_MAX_PAYLOAD);
+    uint32_t events = 0;
+    const bench_clock::time_point start = bench_clock::now();
+    while (log->pending() > 0) {
+        result_log_sync(log, &batcher, per_event);
+        events++;
+    }
+    log->commit();
+    const double elapsed_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+    log->get_stats(&stats);
+
+    const uint32_t overwritten = results - in_ram - (uint32_t)backlog;
+    const uint32_t expected = (uint32_t)backlog - log_t::RECORDS_PER_BLOCK;
+    if (report_sync) {
+        printf("\nbacklog after reset: %zu records (%u overwritten while offline, %u lost in RAM)\n",
+            backlog, overwritten, in_ram);
+        printf("sync: %u records in %u packets (1 lost and resent), %u corrupt block(s) skipped, %.2f s at %u notifications / %u ms\n",
+            phone.records, phone.packets, (unsigned)stats.corrupt_blocks,
+            events * interval_ms / 1000.0, (unsigned)per_event, (unsigned)interval_ms);
+        printf("host read + encode + decode: %.0f records/s\n", phone.records / elapsed_s);
+    }
+    delete log;
+
+    if (phone.errors || phone.records != expected || stats.corrupt_blocks != 1) {
+        printf("%s FAILED: %u of %u records delivered, %u errors\n", name, phone.records, expected, phone.errors);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const double hours = argc > 1 ? atof(argv[1]) : 2.0;
+    const uint32_t hop_ms = argc > 2 ? (uint32_t)atol(argv[2]) : 1000 * (EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2) / EI_CLASSIFIER_FREQUENCY;
+    const uint32_t interval_ms = argc > 3 ? (uint32_t)atol(argv[3]) : 15;
+    const uint32_t per_event = argc > 4 ? (uint32_t)atol(argv[4]) : 4;
+    const uint32_t results = (uint32_t)(hours * 3600 * 1000 / hop_ms);
+    if (hours <= 0 || hop_ms == 0 || interval_ms == 0 || per_event == 0
+        || results < 2 * log_t::RECORDS_PER_BLOCK) {
+        fprintf(stderr, "Usage: %s [hours] [hop_ms] [connection_interval_ms] [notifications_per_event]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%u results over %.1f h (hop %u ms), log of %u blocks x %u records (%u bytes)\n\n",
+        results, hours, (unsigned)hop_ms, (unsigned)RESULT_LOG_BLOCKS, (unsigned)log_t::RECORDS_PER_BLOCK,
+        (unsigned)log_t::STORAGE_SIZE);
+    printf("%-12s %8s %12s %10s %12s\n", "appends", "write amp", "programs/h", "erases/h", "flash s/h");
+    bool ok = run("unbuffered", true, results, hop_ms, hours, interval_ms, per_event, false);
+    ok = run("block", false, results, hop_ms, hours, interval_ms, per_event, true) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+/* Activity recognition - raw sample log decoder
+ *
+ * Converts a raw sample log copied off the device (/samples.log, see
+ * src/sample_log.h) to CSV (timestamp_us,x,y,z, one frame per line) or to a
+ * NumPy .npy file (int64, shape (frames, 4), same columns). Blocks are put
+ * in sequence order, so a log that wrapped around starts at its oldest
+ * block; slots that hold no valid block are skipped. Timestamps are unwrapped
+ * into 64 bits.
+ *
+ * --encode writes a log from a recording in the classify format (interleaved
+ * x,y,z in mg), stamped the way the pipeline does it (FIFO bursts of
+ * ACC_FIFO_WATERMARK sensor samples, decimated, stamped at the read time),
+ * decodes it again and checks every frame. It reports the bytes per frame
+ * and the flash page programs per frame against the text lines the sketch
+ * used to write ("millis, x, y, z"), on the SPIFFS model of
+ * host/result_log_bench.cpp: a write programs every page whose data it
+ * touches (251 bytes per page) plus the file's index page. Text goes through
+ * the 128 byte stdio buffer of the ESP32 VFS, so it reaches SPIFFS in 128
+ * byte writes.
+ *
+ * Usage: sample_log_decode [--npy out.npy] <samples.log>
+ *        sample_log_decode --encode <recording> <samples.log>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "../src/sample_log.h"
+
+// As configured in the sketch: 50 Hz sensor, FIFO watermark 25, decimated to the impulse rate
+#define SENSOR_ODR_PERIOD_US    20000
+#define SENSOR_FIFO_WATERMARK   25
+#define SENSOR_DECIMATION       (1000000 / SENSOR_ODR_PERIOD_US / EI_CLASSIFIER_FREQUENCY)
+#define SPIFFS_PAGE_SIZE        256
+#define SPIFFS_PAGE_DATA        251
+#define STDIO_BUFFER_SIZE       128
+
+/**
+ * Log file in memory
+ */
+class MemoryStorage {
+public:
+    explicit MemoryStorage(size_t size) : data(size, 0), writes(0) { }
+
+    bool read(uint32_t offset, void *out, size_t size) {
+        if (offset + size > data.size()) {
+            return false;
+        }
+        memcpy(out, &data[offset], size);
+        return true;
+    }
+
+    bool write(uint32_t offset, const void *in, size_t size) {
+        if (offset + size > data.size()) {
+            return false;
+        }
+        memcpy(&data[offset], in, size);
+        writes++;
+        return true;
+    }
+
+    std::vector<uint8_t> data;
+    uint32_t writes;
+};
+
+typedef SampleLog<MemoryStorage, SAMPLE_LOG_BLOCKS> sample_log_t;
+
+typedef struct {
+    uint32_t sequence;
+    std::vector<accel_frame_t> frames;
+} decoded_block_t;
+
+static int read_file(const char *path, std::vector<uint8_t> *data) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    uint8_t chunk[SAMPLE_LOG_BLOCK_SIZE];
+    size_t size;
+    while ((size = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data->insert(data->end(), chunk, chunk + size);
+    }
+    fclose(f);
+    return 0;
+}
+
+static int read_values(const char *path, std::vector<int16_t> *values) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    char token[32];
+    while (fscanf(f, " %31[^, \t\r\n]%*[, \t\r\n]", token) == 1) {
+        char *end;
+        const float v = strtof(token, &end);
+        if (*end != '\0') {
+            fprintf(stderr, "Invalid value '%s'\n", token);
+            fclose(f);
+            return -1;
+        }
+        values->push_back((int16_t)v);
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+ * @brief      Frames of all valid blocks, oldest block first
+ */
+static void decode_log(const std::vector<uint8_t> &data, std::vector<accel_frame_t> *frames, size_t *blocks) {
+    std::vector<decoded_block_t> decoded;
+    std::vector<accel_frame_t> block_frames(SAMPLE_LOG_BLOCK_SIZE);
+    for (size_t offset = 0; offset + SAMPLE_LOG_BLOCK_SIZE <= data.size(); offset += SAMPLE_LOG_BLOCK_SIZE) {
+        sample_log_block_t info;
+        const int count = sample_log_decode(&data[offset], &info, block_frames.data(), block_frames.size());
+        if (count <= 0) {
+            continue;
+        }
+        decoded.push_back(decoded_block_t { info.sequence, std::vector<accel_frame_t>(block_frames.begin(), block_frames.begin() + count) });
+    }
+    std::sort(decoded.begin(), decoded.end(), [](const decoded_block_t &a, const decoded_block_t &b) {
+        return a.sequence < b.sequence;
+    });
+    for (const decoded_block_t &block : decoded) {
+        frames->insert(frames->end(), block.frames.begin(), block.frames.end());
+    }
+    *blocks = decoded.size();
+}
+
+static void unwrap_timestamps(const std::vector<accel_frame_t> &frames, std::vector<int64_t> *timestamps) {
+    int64_t timestamp_us = frames.empty() ? 0 : frames[0].timestamp_us;
+    for (size_t ix = 0; ix < frames.size(); ix++) {
+        if (ix > 0) {
+            timestamp_us += (int32_t)(frames[ix].timestamp_us - frames[ix - 1].timestamp_us);
+        }
+        timestamps->push_back(timestamp_us);
+    }
+}
+
+static int write_npy(const char *path, const std::vector<accel_frame_t> &frames, const std::vector<int64_t> &timestamps) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    // format 1.0: magic, version, header length, header dict padded to 64 bytes
+    char header[128];
+    int len = snprintf(header, sizeof(header), "{'descr': '<i8', 'fortran_order': False, 'shape': (%zu, 4), }", frames.size());
+    while ((10 + len + 1) % 64 != 0) {
+        header[len++] = ' ';
+    }
+    header[len++] = '\n';
+    const uint8_t preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, (uint8_t)len, (uint8_t)(len >> 8) };
+    fwrite(preamble, 1, sizeof(preamble), f);
+    fwrite(header, 1, len, f);
+    for (size_t ix = 0; ix < frames.size(); ix++) {
+        const int64_t row[4] = { timestamps[ix], frames[ix].xyz[0], frames[ix].xyz[1], frames[ix].xyz[2] };
+        fwrite(row, sizeof(row[0]), 4, f);
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static int decode(const char *log_path, const char *npy_path) {
+    std::vector<uint8_t> data;
+    if (read_file(log_path, &data) != 0) {
+        return 1;
+    }
+    std::vector<accel_frame_t> frames;
+    std::vector<int64_t> timestamps;
+    size_t blocks;
+    decode_log(data, &frames, &blocks);
+    unwrap_timestamps(frames, &timestamps);
+    fprintf(stderr, "%zu frames in %zu blocks (%zu slots)\n", frames.size(), blocks, data.size() / SAMPLE_LOG_BLOCK_SIZE);
+
+    if (npy_path) {
+        return write_npy(npy_path, frames, timestamps) == 0 ? 0 : 1;
+    }
+    printf("timestamp_us,x,y,z\n");
+    for (size_t ix = 0; ix < frames.size(); ix++) {
+        printf("%lld,%d,%d,%d\n", (long long)timestamps[ix], frames[ix].xyz[0], frames[ix].xyz[1], frames[ix].xyz[2]);
+    }
+    return 0;
+}
+
+/**
+ * @brief      SPIFFS pages programmed by a write: the data pages it touches plus the index page
+ */
+static uint64_t page_programs(uint64_t offset, size_t size) {
+    return (offset + size - 1) / SPIFFS_PAGE_DATA - offset / SPIFFS_PAGE_DATA + 1 + 1;
+}
+
+static int encode(const char *recording_path, const char *log_path) {
+    std::vector<int16_t> values;
+    if (read_values(recording_path, &values) != 0) {
+        return 1;
+    }
+    const size_t sensor_samples = values.size() / ACCEL_AXES * SENSOR_DECIMATION;
+    if (sensor_samples == 0) {
+        fprintf(stderr, "No samples in %s\n", recording_path);
+        return 1;
+    }
+
+    // the recording is at the impulse rate, hold every frame for the decimation
+    // so the acquisition keeps exactly the recorded ones
+    std::vector<int16_t> sensor(sensor_samples * ACCEL_AXES);
+    for (size_t ix = 0; ix < sensor_samples; ix++) {
+        memcpy(&sensor[ix * ACCEL_AXES], &values[ix / SENSOR_DECIMATION * ACCEL_AXES], ACCEL_AXES * sizeof(int16_t));
+    }
+
+    MemoryStorage storage(sample_log_t::STORAGE_SIZE);
+    sample_log_t *log = new sample_log_t(&storage, SENSOR_ODR_PERIOD_US * SENSOR_DECIMATION);
+    log->begin();
+    AccelAcquisition<64> acquisition(SENSOR_ODR_PERIOD_US, SENSOR_DECIMATION);
+    std::vector<accel_frame_t> logged;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> read_latency_us(0, 3000);
+
+    uint64_t text_bytes = 0;
+    uint64_t text_programs = 0;
+    uint64_t text_buffered = 0;
+    for (size_t first = 0; first < sensor_samples; first += SENSOR_FIFO_WATERMARK) {
+        const size_t count = std::min((size_t)SENSOR_FIFO_WATERMARK, sensor_samples - first);
+        const uint32_t read_us = (uint32_t)((first + count) * SENSOR_ODR_PERIOD_US) + read_latency_us(rng);
+        const size_t stored = acquisition.push_fifo(&sensor[first * ACCEL_AXES], count, read_us);
+        for (size_t ix = acquisition.buffered() - stored; ix < acquisition.buffered(); ix++) {
+            const accel_frame_t *frame = &acquisition.frame(ix);
+            log->add(frame);
+            log->write();
+            logged.push_back(*frame);
+
+            char line[64];
+            text_buffered += snprintf(line, sizeof(line), "%u, %d, %d, %d\r\n",
+                (unsigned)(frame->timestamp_us / 1000), frame->xyz[0], frame->xyz[1], frame->xyz[2]);
+            for (; text_buffered >= STDIO_BUFFER_SIZE; text_buffered -= STDIO_BUFFER_SIZE) {
+                text_programs += page_programs(text_bytes, STDIO_BUFFER_SIZE);
+                text_bytes += STDIO_BUFFER_SIZE;
+            }
+        }
+        acquisition.release(stored);
+    }
+    if (text_buffered > 0) {
+        text_programs += page_programs(text_bytes, text_buffered);
+        text_bytes += text_buffered;
+    }
+    log->close();
+    log->write();
+
+    sample_log_stats_t stats;
+    log->get_stats(&stats);
+    uint64_t log_programs = 0;
+    for (uint32_t block = 0; block < stats.blocks_written; block++) {
+        log_programs += page_programs((uint64_t)(block % SAMPLE_LOG_BLOCKS) * SAMPLE_LOG_BLOCK_SIZE, SAMPLE_LOG_BLOCK_SIZE);
+    }
+    delete log;
+
+    FILE *f = fopen(log_path, "wb");
+    if (!f || fwrite(storage.data.data(), 1, storage.data.size(), f) != storage.data.size() || fclose(f) != 0) {
+        fprintf(stderr, "Failed to write %s\n", log_path);
+        return 1;
+    }
+
+    // read it back like a log from the device
+    std::vector<uint8_t> data;
+    std::vector<accel_frame_t> decoded;
+    size_t blocks;
+    if (read_file(log_path, &data) != 0) {
+        return 1;
+    }
+    decode_log(data, &decoded, &blocks);
+    const size_t kept = std::min(logged.size(), decoded.size());
+    size_t errors = 0;
+    for (size_t ix = 0; ix < kept; ix++) {
+        const accel_frame_t *expected = &logged[logged.size() - kept + ix];
+        if (decoded[ix].timestamp_us != expected->timestamp_us
+            || memcmp(decoded[ix].xyz, expected->xyz, sizeof(expected->xyz)) != 0) {
+            errors++;
+        }
+    }
+
+    const double frames = (double)logged.size();
+    printf("%zu frames (%u Hz), %u blocks written, %.1f frames per block\n",
+        logged.size(), (unsigned)EI_CLASSIFIER_FREQUENCY, (unsigned)stats.blocks_written,
+        stats.blocks_written ? frames / stats.blocks_written : 0.0);
+    printf("%-8s %12s %12s %14s %14s\n", "", "written B", "B/frame", "programs/frame", "flash B/frame");
+    printf("%-8s %12llu %12.2f %14.3f %14.1f\n", "text", (unsigned long long)text_bytes, text_bytes / frames,
+        text_programs / frames, text_programs * SPIFFS_PAGE_SIZE / frames);
+    printf("%-8s %12u %12.2f %14.3f %14.1f\n", "binary", (unsigned)stats.bytes_written, stats.encoded_bytes / frames,
+        log_programs / frames, log_programs * SPIFFS_PAGE_SIZE / frames);
+    printf("flash writes %.1fx smaller\n", (double)text_programs / log_programs);
+
+    if (errors || (decoded.size() != logged.size() && stats.blocks_written <= SAMPLE_LOG_BLOCKS)) {
+        printf("FAILED: %zu of %zu frames decoded, %zu errors\n", decoded.size(), logged.size(), errors);
+        return 1;
+    }
+    printf("%zu frames decoded from %zu blocks\n", decoded.size(), blocks);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "--encode") == 0) {
+        return encode(argv[2], argv[3]);
+    }
+    if (argc == 4 && strcmp(argv[1], "--npy") == 0) {
+        return decode(argv[3], argv[2]);
+    }
+    if (argc == 2 && argv[1][0] != '-') {
+        return decode(argv[1], NULL);
+    }
+    fprintf(stderr, "Usage: %s [--npy out.npy] <samples.log>\n"
+                    "       %s --encode <recording> <samples.log>\n", argv[0], argv[0]);
+    return 1;
+}
@@ -0,0 +1,153 @@
+/* Activity recognition - interrupt-driven accelerometer acquisition
+ *
+ * The LIS2DW12 FIFO watermark (or data-ready) interrupt only flags that data
+ * is pending (bus access is not allowed in the ISR); the FIFO is then drained
+ * in one burst and the frames are pushed, timestamped and decimated to the
+ * impulse rate, into a SampleRing.
+ * The inference side reads windows straight out of the ring through a
+ * signal_t, so no intermediate feature copy is needed.
+ */
+
+#ifndef _ACCEL_ACQUISITION_H_
+#define _ACCEL_ACQUISITION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sample_ring.h"
+#include "edge-impulse-sdk/dsp/numpy_types.h"
+#include "edge-impulse-sdk/dsp/returntypes.hpp"
+
+#define ACCEL_AXES 3
+
+/**
+ * One accelerometer sample as delivered by the sensor (mg, int16 per axis)
+ */
+typedef struct {
+    uint32_t timestamp_us;
+    int16_t xyz[ACCEL_AXES];
+} accel_frame_t;
+
+/**
+ * @brief      Accelerometer acquisition front-end.
+ *
+ * @tparam     N     Ring capacity in frames, power of two, at least one model
+ *                   window plus one FIFO burst
+ */
+template <size_t N>
+class AccelAcquisition {
+public:
+    /**
+     * @param      odr_period_us  Sensor output data period (e.g. 20000 for 50 Hz)
+     * @param      decimation     Keep every n'th sensor sample (e.g. 5 to go from 50 Hz to 10 Hz)
+     */
+    AccelAcquisition(uint32_t odr_period_us, uint32_t decimation)
+        : _odr_period_us(odr_period_us), _decimation(decimation ? decimation : 1), _phase(0)
+    {
+    }
+
+    /**
+     * @brief      Producer: push a burst of interleaved x,y,z sensor samples.
+     *             The newest sample is stamped with newest_timestamp_us, older ones
+     *             are spaced by the sensor output data period.
+     *
+     * @return     Number of frames stored in the ring (after decimation)
+     */
+    size_t push_fifo(const int16_t *xyz, size_t frames, uint32_t newest_timestamp_us) {
+        size_t stored = 0;
+        for (size_t ix = 0; ix < frames; ix++) {
+            if (_phase++ % _decimation != 0) {
+                continue;
+            }
+            accel_frame_t frame;
+            frame.timestamp_us = newest_timestamp_us - (uint32_t)(frames - 1 - ix) * _odr_period_us;
+            frame.xyz[0] = xyz[ix * ACCEL_AXES + 0];
+            frame.xyz[1] = xyz[ix * ACCEL_AXES + 1];
+            frame.xyz[2] = xyz[ix * ACCEL_AXES + 2];
+            if (_ring.push(frame)) {
+                stored++;
+            }
+        }
+        return stored;
+    }
+
+    /**
+     * @brief      Consumer: whether at least window_frames frames are buffered
+     */
+    bool window_ready(size_t window_frames) const {
+        return _ring.size() >= window_frames;
+    }
+
+#if !EIDSP_SIGNAL_C_FN_POINTER
+    /**
+     * @brief      Consumer: expose the oldest window_frames frames as a signal
+     *             (interleaved x,y,z floats). The frames stay in the ring until
+     *             release() is called, so the signal is valid until then.
+     */
+    int window_signal(size_t window_frames, ei::signal_t *signal) {
+        if (!window_ready(window_frames)) {
+            return ei::EIDSP_OUT_OF_BOUNDS;
+        }
+        signal->total_length = window_frames * ACCEL_AXES;
+        // the ring wraps, so there is no contiguous buffer to gather from
+        signal->buffer = nullptr;
+        signal->buffer_type = ei::EI_SIGNAL_BUFFER_NONE;
+        signal->get_data = [this](size_t offset, size_t length, float *out_ptr) {
+            return this->get_data(offset, length, out_ptr);
+        };
+        return ei::EIDSP_OK;
+    }
+#endif // !EIDSP_SIGNAL_C_FN_POINTER
+
+    /**
+     * @brief      Consumer: copy signal values [offset, offset + length) of the current window
+     */
+    int get_data(size_t offset, size_t length, float *out_ptr) const {
+        size_t frame_ix = offset / ACCEL_AXES;
+        size_t axis_ix = offset % ACCEL_AXES;
+        for (size_t ix = 0; ix < length; ix++) {
+            out_ptr[ix] = (float)_ring.peek(frame_ix).xyz[axis_ix];
+            if (++axis_ix == ACCEL_AXES) {
+                axis_ix = 0;
+                frame_ix++;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief      Consumer: the ix'th oldest buffered frame
+     */
+    const accel_frame_t &frame(size_t ix) const {
+        return _ring.peek(ix);
+    }
+
+    /**
+     * @brief      Consumer: timestamp of the ix'th oldest buffered frame
+     */
+    uint32_t timestamp_us(size_t ix) const {
+        return _ring.peek(ix).timestamp_us;
+    }
+
+    /**
+     * @brief      Consumer: drop the hop_frames oldest frames (window hop)
+     */
+    void release(size_t hop_frames) {
+        _ring.advance(hop_frames);
+    }
+
+    size_t buffered() const {
+        return _ring.size();
+    }
+
+    uint32_t dropped() const {
+        return _ring.dropped();
+    }
+
+private:
+    SampleRing<accel_frame_t, N> _ring;
+    uint32_t _odr_period_us;
+    uint32_t _decimation;
+    uint32_t _phase;
+};
+
+#endif // _ACCEL_ACQUISITION_H_
@@ -0,0 +1,357 @@
+/* Activity recognition - temporal decoder
+ *
+ * Hidden Markov model over consecutive windows: the hidden state is the
+ * activity (every label of the model plus "unknown"), the classifier scores
+ * of a window are its emission likelihoods, and a transition matrix says how
+ * likely the activity changes from one window to the next. Two decoders run
+ * on every window:
+ *
+ * forward filter     P(state of the newest window | all windows so far),
+ *                    available right away
+ * fixed-lag Viterbi  state of the most likely sequence, decided LAG windows
+ *                    late: window t is read off the best path ending at t + LAG
+ *
+ * Temporal context makes up for noisy single windows, so shorter or lower
+ * rate windows (or a smaller model) can reach the same accuracy. Everything
+ * is sized by template parameters; updates never allocate and take
+ * O(STATES^2) time.
+ */
+
+#ifndef _ACTIVITY_DECODER_H_
+#define _ACTIVITY_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+/**
+ * @brief      Online HMM decoder with a fixed lag.
+ *
+ * @tparam     STATES  Hidden states (at most 255)
+ * @tparam     LAG     Windows a Viterbi decision is delayed by (0: best path end)
+ */
+template <size_t STATES, size_t LAG>
+class ViterbiDecoder {
+    static_assert(STATES >= 2 && STATES <= 255, "ViterbiDecoder needs 2 to 255 states");
+
+public:
+    ViterbiDecoder() {
+        set_sticky(0.9f);
+        float prior[STATES];
+        for (size_t s = 0; s < STATES; s++) {
+            prior[s] = 1.0f / STATES;
+        }
+        set_prior(prior);
+        reset();
+    }
+
+    /**
+     * @brief      Set the transition matrix. Every row is normalized, so only the
+     *             ratios within a row matter.
+     *
+     * @param      transitions  transitions[from][to]
+     */
+    void set_transitions(const float transitions[STATES][STATES]) {
+        for (size_t from = 0; from < STATES; from++) {
+            float sum = 0.0f;
+            for (size_t to = 0; to < STATES; to++) {
+                sum += transitions[from][to] > 0.0f ? transitions[from][to] : 0.0f;
+            }
+            for (size_t to = 0; to < STATES; to++) {
+                float p = sum > 0.0f && transitions[from][to] > 0.0f ? transitions[from][to] / sum : 0.0f;
+                if (sum <= 0.0f) {
+                    p = 1.0f / STATES;
+                }
+                _transitions[from][to] = p;
+                _log_transitions[from][to] = safe_log(p);
+            }
+        }
+    }
+
+    /**
+     * @brief      Transition matrix where the state stays with probability stay
+     *             and every other state is equally likely otherwise
+     */
+    void set_sticky(float stay) {
+        float transitions[STATES][STATES];
+        for (size_t from = 0; from < STATES; from++) {
+            for (size_t to = 0; to < STATES; to++) {
+                transitions[from][to] = from == to ? stay : (1.0f - stay) / (STATES - 1);
+            }
+        }
+        set_transitions(transitions);
+    }
+
+    /**
+     * @brief      State probabilities before the first window (normalized)
+     */
+    void set_prior(const float prior[STATES]) {
+        float sum = 0.0f;
+        for (size_t s = 0; s < STATES; s++) {
+            sum += prior[s] > 0.0f ? prior[s] : 0.0f;
+        }
+        for (size_t s = 0; s < STATES; s++) {
+            _prior[s] = sum > 0.0f ? (prior[s] > 0.0f ? prior[s] / sum : 0.0f) : 1.0f / STATES;
+        }
+    }
+
+    /**
+     * @brief      Forget all windows (e.g. after a gap in the data)
+     */
+    void reset() {
+        _steps = 0;
+        for (size_t s = 0; s < STATES; s++) {
+            _filtered[s] = _prior[s];
+            _score[s] = safe_log(_prior[s]);
+        }
+    }
+
+    /**
+     * @brief      Add the next window
+     *
+     * @param      likelihoods  Emission likelihood of every state for this window,
+     *                          does not need to sum to 1
+     *
+     * @return     State of the window LAG windows back on the best path, or -1
+     *             while fewer than LAG + 1 windows were seen
+     */
+    int update(const float likelihoods[STATES]) {
+        float filtered[STATES];
+        float score[STATES];
+        uint8_t *from = _from[_steps % (LAG + 1)];
+
+        float filtered_sum = 0.0f;
+        float best_score = -HUGE_VALF;
+        for (size_t to = 0; to < STATES; to++) {
+            const float likelihood = likelihoods[to] > EMISSION_FLOOR ? likelihoods[to] : EMISSION_FLOOR;
+
+            float predicted;
+            if (_steps == 0) {
+                predicted = _prior[to];
+                score[to] = _score[to];
+                from[to] = (uint8_t)to;
+            }
+            else {
+                predicted = 0.0f;
+                size_t best_from = 0;
+                float best = -HUGE_VALF;
+                for (size_t prev = 0; prev < STATES; prev++) {
+                    predicted += _filtered[prev] * _transitions[prev][to];
+                    const float candidate = _score[prev] + _log_transitions[prev][to];
+                    if (candidate > best) {
+                        best = candidate;
+                        best_from = prev;
+                    }
+                }
+                score[to] = best;
+                from[to] = (uint8_t)best_from;
+            }
+
+            filtered[to] = predicted * likelihood;
+            filtered_sum += filtered[to];
+            score[to] += logf(likelihood);
+            if (score[to] > best_score) {
+                best_score = score[to];
+            }
+        }
+
+        // scores are only compared with each other, keep them near 0
+        for (size_t s = 0; s < STATES; s++) {
+            _filtered[s] = filtered_sum > 0.0f ? filtered[s] / filtered_sum : 1.0f / STATES;
+            _score[s] = score[s] - best_score;
+        }
+        _steps++;
+
+        return decided();
+    }
+
+    /**
+     * @brief      State of the window LAG windows back on the current best path,
+     *             -1 while fewer than LAG + 1 windows were seen
+     */
+    int decided() const {
+        if (_steps <= LAG) {
+            return -1;
+        }
+        int state = best_state();
+        for (size_t back = 0; back < LAG; back++) {
+            state = _from[(_steps - 1 - back) % (LAG + 1)][state];
+        }
+        return state;
+    }
+
+    /**
+     * @brief      Best path over the newest windows, oldest first. Call after the
+     *             last window to also decide the LAG windows that are still open.
+     *
+     * @param      states  Output, at least LAG + 1 entries
+     *
+     * @return     Number of windows written (min(windows seen, LAG + 1))
+     */
+    size_t best_path(int *states) const {
+        const size_t count = _steps < LAG + 1 ? _steps : LAG + 1;
+        if (count == 0) {
+            return 0;
+        }
+        int state = best_state();
+        states[count - 1] = state;
+        for (size_t back = 1; back < count; back++) {
+            state = _from[(_steps - back) % (LAG + 1)][state];
+            states[count - 1 - back] = state;
+        }
+        return count;
+    }
+
+    /**
+     * @brief      Forward filtered probability of every state for the newest window
+     */
+    const float *filtered() const {
+        return _filtered;
+    }
+
+    int filtered_state() const {
+        return argmax(_filtered);
+    }
+
+    size_t steps() const {
+        return _steps;
+    }
+
+private:
+    // a zero score would rule a state out for good
+    static constexpr float EMISSION_FLOOR = 1e-6f;
+    static constexpr float LOG_FLOOR = -1e30f;
+
+    static float safe_log(float p) {
+        return p > 0.0f ? logf(p) : LOG_FLOOR;
+    }
+
+    static int argmax(const float *values) {
+        size_t best = 0;
+        for (size_t s = 1; s < STATES; s++) {
+            if (values[s] > values[best]) {
+                best = s;
+            }
+        }
+        return (int)best;
+    }
+
+    int best_state() const {
+        return argmax(_score);
+    }
+
+    float _transitions[STATES][STATES];
+    float _log_transitions[STATES][STATES];
+    float _prior[STATES];
+    float _filtered[STATES];        // forward probabilities of the newest window
+    float _score[STATES];           // log score of the best path ending in every state
+    uint8_t _from[LAG + 1][STATES]; // back pointers of the newest windows, ring indexed by window
+    size_t _steps;
+};
+
+// Decoder states: the labels of the model, then unknown
+#define ACTIVITY_DECODER_UNKNOWN    EI_CLASSIFIER_LABEL_COUNT
+#define ACTIVITY_DECODER_STATES     (EI_CLASSIFIER_LABEL_COUNT + 1)
+
+// Windows a decision is delayed by, at 50% overlap 2 windows are 3 s
+#ifndef ACTIVITY_DECODER_LAG
+#define ACTIVITY_DECODER_LAG        2
+#endif
+
+/**
+ * @brief      ViterbiDecoder over the classifier results. The emission of a label
+ *             is its score, the emission of unknown grows with the score the top
+ *             label is missing: it equals the top score exactly when that is at
+ *             the threshold, so on its own a window whose top score is below the
+ *             threshold is unknown (the rule the sketch used to apply per window).
+ */
+class ActivityDecoder {
+public:
+    /**
+     * @param      unknown_threshold  Top score below which a window counts as unknown
+     *                                (0 < threshold < 1)
+     * @param      stay               Probability that the activity stays the same
+     *                                from one window to the next
+     */
+    explicit ActivityDecoder(float unknown_threshold = 0.5f, float stay = 0.9f)
+        : _unknown_scale(unknown_threshold / (1.0f - unknown_threshold))
+    {
+        _hmm.set_sticky(stay);
+    }
+
+    /**
+     * @brief      Set the transition matrix, transitions[from][to] over the labels
+     *             in model order and unknown last (rows are normalized)
+     */
+    void set_transitions(const float transitions[ACTIVITY_DECODER_STATES][ACTIVITY_DECODER_STATES]) {
+        _hmm.set_transitions(transitions);
+    }
+
+    void reset() {
+        _hmm.reset();
+    }
+
+    /**
+     * @brief      Add the scores of the next window
+     *
+     * @param      scores  EI_CLASSIFIER_LABEL_COUNT label scores
+     *
+     * @return     Decided state of the window ACTIVITY_DECODER_LAG windows back
+     *             (label index or ACTIVITY_DECODER_UNKNOWN), -1 until then
+     */
+    int update(const float *scores) {
+        float likelihoods[ACTIVITY_DECODER_STATES];
+        float top = 0.0f;
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            likelihoods[ix] = scores[ix];
+            if (scores[ix] > top) {
+                top = scores[ix];
+            }
+        }
+        likelihoods[ACTIVITY_DECODER_UNKNOWN] = _unknown_scale * (1.0f - top);
+        return _hmm.update(likelihoods);
+    }
+
+    int update(const ei_impulse_result_t *result) {
+        float scores[EI_CLASSIFIER_LABEL_COUNT];
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            scores[ix] = result->classification[ix].value;
+        }
+        return update(scores);
+    }
+
+    /**
+     * @brief      See ViterbiDecoder::best_path, states needs ACTIVITY_DECODER_LAG + 1 entries
+     */
+    size_t best_path(int *states) const {
+        return _hmm.best_path(states);
+    }
+
+    /**
+     * @brief      Forward filtered probability of every state for the newest window
+     */
+    const float *filtered() const {
+        return _hmm.filtered();
+    }
+
+    int filtered_state() const {
+        return _hmm.filtered_state();
+    }
+
+    /**
+     * @brief      Name of a decoder state
+     */
+    static const char *label(int state) {
+        if (state >= 0 && state < EI_CLASSIFIER_LABEL_COUNT) {
+            return ei_classifier_inferencing_categories[state];
+        }
+        return "unknown";
+    }
+
+private:
+    ViterbiDecoder<ACTIVITY_DECODER_STATES, ACTIVITY_DECODER_LAG> _hmm;
+    float _unknown_scale;
+};
+
+#endif // _ACTIVITY_DECODER_H_
@@ -0,0 +1,452 @@
+/* Activity recognition - task pipeline
+ *
+ *   acquisition -> windows -> features -> features -> inference -> results -> transport
+ *
+ * acquisition  drains the sensor FIFO when the watermark interrupt fires and
+ *              fills a triple-buffered window (WindowBuffer), one window is
+ *              completed every hop
+ * features     runs the DSP blocks over the frames new in the window
+ *              (extract_impulse_features_continuous), or over the whole window
+ *              after windows were dropped
+ * inference    runs the model over complete windows (run_inference_continuous)
+ * transport    hands results to the application (BLE notify, serial, ...)
+ *
+ * The acquisition task can also hand every decimated frame to a callback,
+ * e.g. to record the classifier's input (src/sample_log.h).
+ *
+ * Every stage runs in its own task, so sampling continues while the model
+ * runs and a slow BLE notify only delays the results queue. On the ESP32 the
+ * default layout keeps acquisition and transport on the protocol core (0,
+ * next to the BLE stack) and DSP / inference on the application core (1).
+ * The sensor and the transport are callbacks, on Linux the same pipeline
+ * runs on POSIX threads (see host/pipeline_bench.cpp).
+ */
+
+#ifndef _ACTIVITY_PIPELINE_H_
+#define _ACTIVITY_PIPELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "accel_acquisition.h"
+#include "pipeline.h"
+#include "window_buffer.h"
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+// Frames drained from the sensor FIFO in one burst (the LIS2DW12 FIFO depth)
+#ifndef ACTIVITY_PIPELINE_FIFO_FRAMES
+#define ACTIVITY_PIPELINE_FIFO_FRAMES     32
+#endif
+// Decimated frames buffered between the FIFO and the window capture
+#define ACTIVITY_PIPELINE_RING_FRAMES     64
+#define ACTIVITY_PIPELINE_QUEUE_DEPTH     4
+// Stages re-check for stop() at least this often
+#define ACTIVITY_PIPELINE_POLL_MS         1000
+// Period of the transport idle callback while no results arrive
+#ifndef ACTIVITY_PIPELINE_IDLE_MS
+#define ACTIVITY_PIPELINE_IDLE_MS         250
+#endif
+
+typedef WindowBuffer<EI_CLASSIFIER_RAW_SAMPLE_COUNT, ACCEL_AXES> activity_window_buffer_t;
+
+/**
+ * Features of a complete window
+ */
+typedef struct {
+    uint32_t timestamp_us;      // newest frame of the window
+    uint32_t dsp_us;
+    float features[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+} activity_features_t;
+
+/**
+ * Classification of one window, as handed to the transport
+ */
+typedef struct {
+    uint32_t timestamp_us;      // newest frame of the window
+    uint32_t latency_us;        // from that frame to the transport stage
+    uint32_t dsp_us;
+    uint32_t classification_us;
+    float scores[EI_CLASSIFIER_LABEL_COUNT];
+} activity_result_t;
+
+typedef struct {
+    pipeline_task_config_t acquisition;
+    pipeline_task_config_t features;
+    pipeline_task_config_t inference;
+    pipeline_task_config_t transport;
+} activity_pipeline_config_t;
+
+typedef struct {
+    pipeline_stage_stats_t acquisition;
+    pipeline_stage_stats_t features;
+    pipeline_stage_stats_t inference;
+    pipeline_stage_stats_t transport;
+    window_buffer_stats_t capture;
+    pipeline_queue_stats_t windows;
+    pipeline_queue_stats_t results;
+    uint32_t frames_dropped;    // frame ring overflow (capture behind the sensor)
+    uint32_t fifo_overruns;     // sensor FIFO overflowed before it was drained (samples lost)
+    uint32_t errors;            // failed DSP / inference runs
+    uint32_t max_latency_us;
+} activity_pipeline_stats_t;
+
+/**
+ * Reads up to max_frames interleaved x,y,z samples from the sensor FIFO,
+ * returns the number of frames read. Sets *overrun if the FIFO overflowed
+ * since the last read (check before reading, draining clears the flag).
+ */
+typedef size_t (*activity_read_fifo_fn)(int16_t *xyz, size_t max_frames, bool *overrun, void *ctx);
+/**
+ * Publishes one result (runs in the transport task)
+ */
+typedef void (*activity_publish_fn)(const activity_result_t *result, void *ctx);
+/**
+ * Called in the transport task after every result and at least every
+ * ACTIVITY_PIPELINE_IDLE_MS, e.g. to flush batched results on a timeout
+ */
+typedef void (*activity_idle_fn)(void *ctx);
+/**
+ * Called in the acquisition task with every frame kept after decimation,
+ * before it goes into the window. Must not block.
+ */
+typedef void (*activity_frame_fn)(const accel_frame_t *frame, void *ctx);
+
+/**
+ * Default layout for the ESP32 (two cores)
+ */
+static const activity_pipeline_config_t activity_pipeline_default_config = {
+    { "acq", 3072, 5, 0 },
+    { "dsp", 6144, 3, 1 },
+    { "infer", 6144, 2, 1 },
+    { "transport", 4096, 1, 0 },
+};
+
+class ActivityPipeline {
+public:
+    /**
+     * @param      odr_period_us  Sensor output data period (e.g. 20000 for 50 Hz)
+     * @param      decimation     Keep every n'th sensor sample
+     * @param      hop_frames     Frames between two classified windows, e.g.
+     *                            EI_CLASSIFIER_RAW_SAMPLE_COUNT / 2 for 50% overlap
+     */
+    ActivityPipeline(uint32_t odr_period_us, uint32_t decimation, size_t hop_frames = EI_CLASSIFIER_SLICE_SIZE)
+        : _acquisition(odr_period_us, decimation),
+          _capture(hop_frames),
+          _features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE),
+          _last_sequence(0),
+          _drain_ms(drain_period_ms(odr_period_us)),
+          _running(false),
+          _errors(0),
+          _fifo_overruns(0),
+          _max_latency_us(0),
+          _read_fifo(nullptr),
+          _publish(nullptr),
+          _idle(nullptr),
+          _frame(nullptr),
+          _ctx(nullptr)
+    {
+    }
+
+    /**
+     * @brief      Start the four stage tasks. Call run_classifier_init() first.
+     * @param      idle  Optional, called in the transport task (see activity_idle_fn)
+     * @param      frame Optional, called in the acquisition task (see activity_frame_fn)
+     * @return     false if a task could not be created (the pipeline is stopped again)
+     */
+    bool start(const activity_pipeline_config_t *config,
+               activity_read_fifo_fn read_fifo,
+               activity_publish_fn publish,
+               void *ctx,
+               activity_idle_fn idle = nullptr,
+               activity_frame_fn frame = nullptr)
+    {
+        if (_running.load() || !_features.buffer) {
+            return false;
+        }
+        _read_fifo = read_fifo;
+        _publish = publish;
+        _idle = idle;
+        _frame = frame;
+        _ctx = ctx;
+        _running.store(true);
+
+        bool ok = _transport_task.start(&config->transport, &ActivityPipeline::transport_entry, this)
+            && _inference_task.start(&config->inference, &ActivityPipeline::inference_entry, this)
+            && _features_task.start(&config->features, &ActivityPipeline::features_entry, this)
+            && _acquisition_task.start(&config->acquisition, &ActivityPipeline::acquisition_entry, this);
+        if (!ok) {
+            stop();
+        }
+        return ok;
+    }
+
+    /**
+     * @brief      Stop all stages and wait for them to exit
+     */
+    void stop() {
+        _running.store(false);
+        _fifo_ready.give();
+        _capture_ready.give();
+        _windows.wake();
+        _results.wake();
+        _acquisition_task.join();
+        _features_task.join();
+        _inference_task.join();
+        _transport_task.join();
+    }
+
+    /**
+     * @brief      Sensor FIFO watermark interrupt, only wakes the acquisition task
+     */
+    void fifo_interrupt() {
+        _fifo_ready.give_from_isr();
+    }
+
+    /**
+     * @brief      Same as fifo_interrupt(), from task context
+     */
+    void fifo_ready() {
+        _fifo_ready.give();
+    }
+
+    void get_stats(activity_pipeline_stats_t *stats) const {
+        _acquisition_stats.get_stats(&stats->acquisition);
+        _features_stats.get_stats(&stats->features);
+        _inference_stats.get_stats(&stats->inference);
+        _transport_stats.get_stats(&stats->transport);
+        _capture.get_stats(&stats->capture);
+        _windows.get_stats(&stats->windows);
+        _results.get_stats(&stats->results);
+        stats->frames_dropped = _acquisition.dropped();
+        stats->fifo_overruns = _fifo_overruns.load(std::memory_order_relaxed);
+        stats->errors = _errors.load(std::memory_order_relaxed);
+        stats->max_latency_us = _max_latency_us.load(std::memory_order_relaxed);
+    }
+
+private:
+    static uint32_t now_us() {
+        return (uint32_t)ei_read_timer_us();
+    }
+
+    /**
+     * Fallback drain period: half the time the sensor takes to fill its FIFO,
+     * so a missed watermark interrupt does not overflow it
+     */
+    static uint32_t drain_period_ms(uint32_t odr_period_us) {
+        const uint32_t ms = (uint32_t)((uint64_t)odr_period_us * ACTIVITY_PIPELINE_FIFO_FRAMES / 2 / 1000);
+        if (ms < 1) {
+            return 1;
+        }
+        return ms < ACTIVITY_PIPELINE_POLL_MS ? ms : ACTIVITY_PIPELINE_POLL_MS;
+    }
+
+    static void acquisition_entry(void *arg) {
+        ((ActivityPipeline *)arg)->acquisition_loop();
+    }
+
+    static void features_entry(void *arg) {
+        ((ActivityPipeline *)arg)->features_loop();
+    }
+
+    static void inference_entry(void *arg) {
+        ((ActivityPipeline *)arg)->inference_loop();
+    }
+
+    static void transport_entry(void *arg) {
+        ((ActivityPipeline *)arg)->transport_loop();
+    }
+
+    void acquisition_loop() {
+        int16_t xyz[ACTIVITY_PIPELINE_FIFO_FRAMES * ACCEL_AXES];
+        float values[EI_CLASSIFIER_RAW_SAMPLE_COUNT * ACCEL_AXES];
+
+        while (_running.load(std::memory_order_relaxed)) {
+            // drain on timeouts too, a FIFO that filled before the interrupt was
+            // attached never raises the watermark edge again. Also woken by the
+            // DSP stage when it took a window and deferred frames can move on.
+            _fifo_ready.wait(_drain_ms);
+            if (!_running.load(std::memory_order_relaxed)) {
+                break;
+            }
+
+            const uint32_t start_us = now_us();
+            bool overrun = false;
+            size_t frames = _read_fifo(xyz, ACTIVITY_PIPELINE_FIFO_FRAMES, &overrun, _ctx);
+            if (overrun) {
+                _fifo_overruns.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (frames > 0) {
+                const size_t stored = _acquisition.push_fifo(xyz, frames, start_us);
+                if (_frame) {
+                    const size_t buffered = _acquisition.buffered();
+                    for (size_t ix = buffered - stored; ix < buffered; ix++) {
+                        _frame(&_acquisition.frame(ix), _ctx);
+                    }
+                }
+            }
+
+            // move the frames into the window, in chunks that end on a window boundary
+            size_t buffered;
+            while ((buffered = _acquisition.buffered()) > 0) {
+                size_t count = _capture.frames_until_window();
+                if (count > buffered) {
+                    count = buffered;
+                }
+                // a burst can complete several windows at once: keep the frames in the
+                // ring until the DSP stage took the pending window, unless the ring
+                // runs out of room
+                if (count == _capture.frames_until_window() && _capture.pending()
+                        && buffered < ACTIVITY_PIPELINE_RING_FRAMES / 2) {
+                    break;
+                }
+                _acquisition.get_data(0, count * ACCEL_AXES, values);
+                const uint32_t timestamp_us = _acquisition.timestamp_us(count - 1);
+                _acquisition.release(count);
+                // otherwise a window the DSP stage did not take yet is replaced (counted)
+                if (_capture.write(values, count, timestamp_us)) {
+                    _capture_ready.give();
+                }
+            }
+            _acquisition_stats.add(now_us() - start_us);
+        }
+    }
+
+    void features_loop() {
+        activity_features_t window;
+        ei_impulse_result_t timing;
+
+        while (_running.load(std::memory_order_relaxed)) {
+            const activity_window_buffer_t::window_t *captured = _capture.acquire();
+            if (!captured) {
+                _capture_ready.wait(ACTIVITY_PIPELINE_POLL_MS);
+                continue;
+            }
+
+            // let acquisition move frames it held back for this window
+            _fifo_ready.give();
+
+            const uint32_t start_us = now_us();
+
+            // the continuous DSP state slides over the frames new since the previous
+            // window; after a dropped window, the whole window replaces it
+            size_t new_frames = EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+            if (captured->sequence == _last_sequence + 1 && _last_sequence != 0) {
+                new_frames = _capture.hop_frames();
+            }
+            _last_sequence = captured->sequence;
+
+            ei::signal_t signal;
+            ei::numpy::signal_from_buffer(
+                captured->data + (EI_CLASSIFIER_RAW_SAMPLE_COUNT - new_frames) * ACCEL_AXES,
+                new_frames * ACCEL_AXES, &signal);
+
+            bool ready = false;
+            timing.timing.dsp_us = 0;
+            if (extract_impulse_features_continuous(&ei_default_impulse, &signal, &_features, &ready, &timing, false) != EI_IMPULSE_OK) {
+                _errors.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (ready) {
+                window.timestamp_us = captured->timestamp_us;
+                window.dsp_us = (uint32_t)timing.timing.dsp_us;
+                memcpy(window.features, _features.buffer, sizeof(window.features));
+                _windows.push(window);
+            }
+            _features_stats.add(now_us() - start_us);
+        }
+    }
+
+    void inference_loop() {
+        activity_features_t window;
+        activity_result_t out;
+        ei_impulse_result_t result;
+
+        while (_running.load(std::memory_order_relaxed)) {
+            if (!_windows.pop(&window, ACTIVITY_PIPELINE_POLL_MS)) {
+                continue;
+            }
+
+            const uint32_t start_us = now_us();
+            ei::matrix_t features(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, window.features);
+            memset(&result, 0, sizeof(result));
+            if (run_inference_continuous(&ei_default_impulse, &features, &result, false, true) != EI_IMPULSE_OK) {
+                _errors.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            out.timestamp_us = window.timestamp_us;
+            out.latency_us = 0;
+            out.dsp_us = window.dsp_us + (uint32_t)result.timing.dsp_us;
+            out.classification_us = (uint32_t)result.timing.classification_us;
+            for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+                out.scores[ix] = result.classification[ix].value;
+            }
+            _results.push(out);
+            _inference_stats.add(now_us() - start_us);
+        }
+    }
+
+    void transport_loop() {
+        activity_result_t result;
+
+        const uint32_t wait_ms = _idle ? ACTIVITY_PIPELINE_IDLE_MS : ACTIVITY_PIPELINE_POLL_MS;
+
+        while (_running.load(std::memory_order_relaxed)) {
+            if (!_results.pop(&result, wait_ms)) {
+                if (_idle) {
+                    _idle(_ctx);
+                }
+                continue;
+            }
+
+            const uint32_t start_us = now_us();
+            result.latency_us = start_us - result.timestamp_us;
+            if (result.latency_us > _max_latency_us.load(std::memory_order_relaxed)) {
+                _max_latency_us.store(result.latency_us, std::memory_order_relaxed);
+            }
+            _publish(&result, _ctx);
+            if (_idle) {
+                _idle(_ctx);
+            }
+            _transport_stats.add(now_us() - start_us);
+        }
+    }
+
+    // acquisition task only
+    AccelAcquisition<ACTIVITY_PIPELINE_RING_FRAMES> _acquisition;
+    activity_window_buffer_t _capture;
+    // features task only
+    ei::matrix_t _features;
+    uint32_t _last_sequence;
+    // fallback drain period of the acquisition task
+    const uint32_t _drain_ms;
+
+    PipelineEvent _fifo_ready;
+    PipelineEvent _capture_ready;
+    PipelineQueue<activity_features_t, ACTIVITY_PIPELINE_QUEUE_DEPTH> _windows;
+    PipelineQueue<activity_result_t, ACTIVITY_PIPELINE_QUEUE_DEPTH> _results;
+
+    PipelineTask _acquisition_task;
+    PipelineTask _features_task;
+    PipelineTask _inference_task;
+    PipelineTask _transport_task;
+
+    PipelineStageStats _acquisition_stats;
+    PipelineStageStats _features_stats;
+    PipelineStageStats _inference_stats;
+    PipelineStageStats _transport_stats;
+
+    std::atomic<bool> _running;
+    std::atomic<uint32_t> _errors;
+    std::atomic<uint32_t> _fifo_overruns;
+    std::atomic<uint32_t> _max_latency_us;
+    activity_read_fifo_fn _read_fifo;
+    activity_publish_fn _publish;
+    activity_idle_fn _idle;
+    activity_frame_fn _frame;
+    void *_ctx;
+};
+
+#endif // _ACTIVITY_PIPELINE_H_
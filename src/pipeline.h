@@ -0,0 +1,128 @@
+/* Activity recognition - pipeline building blocks
+ *
+ * Stages run in their own task and hand messages to the next stage through
+ * bounded lock-free queues (a SampleRing plus an event to wake the consumer).
+ * A full queue never blocks the producer: the message is dropped and counted,
+ * so a slow stage shows up as backpressure in the stats instead of stalling
+ * acquisition.
+ */
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "sample_ring.h"
+#include "pipeline_task.h"
+
+/**
+ * Backpressure counters of one queue
+ */
+typedef struct {
+    uint32_t pushed;        // messages accepted
+    uint32_t dropped;       // messages dropped because the queue was full
+    uint32_t depth;         // messages waiting right now
+    uint32_t high_water;    // most messages ever waiting
+    uint32_t capacity;
+} pipeline_queue_stats_t;
+
+/**
+ * Work done by one stage
+ */
+typedef struct {
+    uint32_t items;         // messages processed
+    uint64_t busy_us;       // time spent processing them
+    uint32_t max_us;        // longest single message
+} pipeline_stage_stats_t;
+
+/**
+ * @brief      Bounded SPSC queue between two stages.
+ *
+ * @tparam     T     Message type, must be trivially copyable
+ * @tparam     N     Capacity, power of two
+ */
+template <typename T, size_t N>
+class PipelineQueue {
+public:
+    PipelineQueue() : _pushed(0), _high_water(0) { }
+
+    /**
+     * @brief      Producer: enqueue a message and wake the consumer
+     * @return     false if the queue was full and the message was dropped
+     */
+    bool push(const T &msg) {
+        if (!_ring.push(msg)) {
+            return false;
+        }
+        _pushed.fetch_add(1, std::memory_order_relaxed);
+        const uint32_t depth = (uint32_t)_ring.size();
+        if (depth > _high_water.load(std::memory_order_relaxed)) {
+            _high_water.store(depth, std::memory_order_relaxed);
+        }
+        _ready.give();
+        return true;
+    }
+
+    /**
+     * @brief      Consumer: dequeue a message, waiting up to timeout_ms for one
+     * @return     false if no message arrived in time
+     */
+    bool pop(T *msg, uint32_t timeout_ms) {
+        if (_ring.pop(msg)) {
+            return true;
+        }
+        _ready.wait(timeout_ms);
+        return _ring.pop(msg);
+    }
+
+    /**
+     * @brief      Wake a consumer blocked in pop() (e.g. to stop the pipeline)
+     */
+    void wake() {
+        _ready.give();
+    }
+
+    void get_stats(pipeline_queue_stats_t *stats) const {
+        stats->pushed = _pushed.load(std::memory_order_relaxed);
+        stats->dropped = _ring.dropped();
+        stats->depth = (uint32_t)_ring.size();
+        stats->high_water = _high_water.load(std::memory_order_relaxed);
+        stats->capacity = (uint32_t)N;
+    }
+
+private:
+    SampleRing<T, N> _ring;
+    PipelineEvent _ready;
+    std::atomic<uint32_t> _pushed;
+    std::atomic<uint32_t> _high_water;
+};
+
+/**
+ * @brief      Stage counters, written by the stage task and read by anyone.
+ */
+class PipelineStageStats {
+public:
+    PipelineStageStats() : _items(0), _busy_us(0), _max_us(0) { }
+
+    void add(uint32_t busy_us) {
+        _items.fetch_add(1, std::memory_order_relaxed);
+        _busy_us.fetch_add(busy_us, std::memory_order_relaxed);
+        if (busy_us > _max_us.load(std::memory_order_relaxed)) {
+            _max_us.store(busy_us, std::memory_order_relaxed);
+        }
+    }
+
+    void get_stats(pipeline_stage_stats_t *stats) const {
+        stats->items = _items.load(std::memory_order_relaxed);
+        stats->busy_us = _busy_us.load(std::memory_order_relaxed);
+        stats->max_us = _max_us.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> _items;
+    std::atomic<uint64_t> _busy_us;
+    std::atomic<uint32_t> _max_us;
+};
+
+#endif // _PIPELINE_H_
@@ -0,0 +1,215 @@
+/* Activity recognition - pipeline task backend
+ *
+ * The few OS primitives the pipeline needs: a task pinned to a core and an
+ * event a task can block on (given from another task or from an ISR).
+ * On the ESP32 they map to FreeRTOS tasks and binary semaphores, everywhere
+ * else to POSIX threads and a mutex / condition variable, so the same
+ * pipeline also runs on Linux.
+ */
+
+#ifndef _PIPELINE_TASK_H_
+#define _PIPELINE_TASK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM) || defined(ARDUINO_ARCH_ESP32)
+#define PIPELINE_TASK_FREERTOS 1
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#else
+#define PIPELINE_TASK_FREERTOS 0
+#include <errno.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#define PIPELINE_TASK_ANY_CORE -1
+
+/**
+ * Where and how a pipeline task runs
+ */
+typedef struct {
+    const char *name;
+    uint32_t stack_bytes;   // ignored by the POSIX backend (default thread stack)
+    uint32_t priority;      // FreeRTOS priority, ignored by the POSIX backend
+    int core;               // core to pin to, PIPELINE_TASK_ANY_CORE to let the scheduler pick
+} pipeline_task_config_t;
+
+/**
+ * @brief      Event a task can wait on. give() wakes the waiter, gives while
+ *             the event is still pending collapse into one (binary semaphore).
+ */
+class PipelineEvent {
+public:
+    PipelineEvent() {
+#if PIPELINE_TASK_FREERTOS
+        _sem = xSemaphoreCreateBinary();
+#else
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_cond, NULL);
+        _given = false;
+#endif
+    }
+
+    ~PipelineEvent() {
+#if PIPELINE_TASK_FREERTOS
+        vSemaphoreDelete(_sem);
+#else
+        pthread_cond_destroy(&_cond);
+        pthread_mutex_destroy(&_mutex);
+#endif
+    }
+
+    void give() {
+#if PIPELINE_TASK_FREERTOS
+        xSemaphoreGive(_sem);
+#else
+        pthread_mutex_lock(&_mutex);
+        _given = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_mutex);
+#endif
+    }
+
+    /**
+     * @brief      Give from an interrupt handler (same as give() on POSIX)
+     */
+    void give_from_isr() {
+#if PIPELINE_TASK_FREERTOS
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(_sem, &woken);
+        if (woken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
+#else
+        give();
+#endif
+    }
+
+    /**
+     * @brief      Block until the event is given or timeout_ms passed
+     * @return     true if the event was given
+     */
+    bool wait(uint32_t timeout_ms) {
+#if PIPELINE_TASK_FREERTOS
+        return xSemaphoreTake(_sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+#else
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&_mutex);
+        int rc = 0;
+        while (!_given && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&_cond, &_mutex, &deadline);
+        }
+        const bool given = _given;
+        _given = false;
+        pthread_mutex_unlock(&_mutex);
+        return given;
+#endif
+    }
+
+private:
+    PipelineEvent(const PipelineEvent &) = delete;
+    PipelineEvent &operator=(const PipelineEvent &) = delete;
+
+#if PIPELINE_TASK_FREERTOS
+    SemaphoreHandle_t _sem;
+#else
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
+    bool _given;
+#endif
+};
+
+/**
+ * @brief      A running pipeline task. join() returns once the task function returned.
+ */
+class PipelineTask {
+public:
+    PipelineTask() : _fn(nullptr), _arg(nullptr), _started(false) { }
+
+    /**
+     * @brief      Start fn(arg) as a task
+     * @return     false if the task could not be created
+     */
+    bool start(const pipeline_task_config_t *config, void (*fn)(void *), void *arg) {
+        if (_started) {
+            return false;
+        }
+        _fn = fn;
+        _arg = arg;
+#if PIPELINE_TASK_FREERTOS
+        const BaseType_t core = config->core == PIPELINE_TASK_ANY_CORE ? tskNO_AFFINITY : config->core;
+        _started = xTaskCreatePinnedToCore(&PipelineTask::entry, config->name, config->stack_bytes,
+            this, config->priority, NULL, core) == pdPASS;
+#else
+        _started = pthread_create(&_thread, NULL, &PipelineTask::entry, this) == 0;
+#if defined(__linux__)
+        if (_started && config->core != PIPELINE_TASK_ANY_CORE) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(config->core, &cpus);
+            // best effort, the host may have fewer cores than the ESP32 layout asks for
+            pthread_setaffinity_np(_thread, sizeof(cpus), &cpus);
+        }
+        if (_started && config->name) {
+            char name[16];
+            snprintf(name, sizeof(name), "%s", config->name);
+            pthread_setname_np(_thread, name);
+        }
+#endif // __linux__
+#endif
+        return _started;
+    }
+
+    /**
+     * @brief      Wait for the task function to return
+     */
+    void join() {
+        if (!_started) {
+            return;
+        }
+#if PIPELINE_TASK_FREERTOS
+        while (!_done.wait(1000)) { }
+#else
+        pthread_join(_thread, NULL);
+#endif
+        _started = false;
+    }
+
+private:
+#if PIPELINE_TASK_FREERTOS
+    static void entry(void *arg) {
+        PipelineTask *task = (PipelineTask *)arg;
+        task->_fn(task->_arg);
+        task->_done.give();
+        vTaskDelete(NULL);
+    }
+
+    PipelineEvent _done;
+#else
+    static void *entry(void *arg) {
+        PipelineTask *task = (PipelineTask *)arg;
+        task->_fn(task->_arg);
+        return NULL;
+    }
+
+    pthread_t _thread;
+#endif
+
+    void (*_fn)(void *);
+    void *_arg;
+    bool _started;
+};
+
+#endif // _PIPELINE_TASK_H_
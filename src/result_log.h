@@ -0,0 +1,496 @@
+/* Activity recognition - store-and-forward result log
+ *
+ * Every result is appended to a circular log in flash and sent to the phone
+ * from there, so results produced while no phone is connected are kept and
+ * go out in bulk after the next connection. The log is a fixed size file of
+ * BLOCKS blocks followed by a cursor:
+ *
+ *   block    uint32  RESULT_LOG_MAGIC
+ *            uint32  sequence number of the first record
+ *            uint32  sequence of the oldest record not yet delivered
+ *            uint16  records in the block
+ *            uint16  0
+ *            uint32  CRC-32 of the header fields above and the records
+ *            records, RESULT_LOG_RECORD_SIZE(SCORES) bytes each:
+ *            uint32 sequence, uint32 timestamp ms, uint8 class id,
+ *            uint8 scores (score * 255)
+ *   cursor   uint32  RESULT_LOG_MAGIC
+ *            uint32  sequence of the oldest record not yet delivered
+ *            uint32  CRC-32 of the above
+ *
+ * Records are numbered consecutively and block n holds the records
+ * n * RECORDS_PER_BLOCK onwards, in slot n % BLOCKS. Appends collect in a RAM
+ * block and go to flash once per full block (or on flush()). A block is the
+ * data of one SPIFFS page, so it costs one page program (plus the file's
+ * index page) instead of one per record. A full log overwrites its oldest block,
+ * whether it was delivered or not. A block with a bad CRC is skipped when
+ * read back.
+ *
+ * Delivery is at least once: read() hands out records, acknowledge() marks
+ * them delivered once the BLE stack accepted the notification (onStatus
+ * SUCCESS_NOTIFY, which needs the phone to have enabled notifications), and
+ * rewind() hands them out again if it did not. Every block carries the delivered position at the time
+ * it was written, the cursor is only written by commit() (after a sync), so
+ * after a reset at most a block is sent twice; the phone drops duplicates by
+ * sequence number.
+ *
+ * The storage is a template parameter with
+ *   bool read(uint32_t offset, void *data, size_t size);
+ *   bool write(uint32_t offset, const void *data, size_t size);
+ * over STORAGE_SIZE bytes (a SPIFFS file on the device, a simulated flash on
+ * the host, see host/result_log_bench.cpp). Not thread safe, the log belongs
+ * to the transport task.
+ */
+
+#ifndef _RESULT_LOG_H_
+#define _RESULT_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "result_protocol.h"
+
+#define RESULT_LOG_MAGIC                0x31474c52  // "RLG1"
+// Data of one SPIFFS page (256 bytes minus the 5 byte page header)
+#define RESULT_LOG_BLOCK_SIZE           251
+#define RESULT_LOG_HEADER_SIZE          20
+#define RESULT_LOG_CURSOR_SIZE          12
+// Blocks of the sketch's log, 512 blocks of 19 results are 4 hours at a 1.5 s hop
+#ifndef RESULT_LOG_BLOCKS
+#define RESULT_LOG_BLOCKS               512
+#endif
+// Records result_log_sync() reads at a time (on the caller's stack)
+#define RESULT_LOG_SYNC_CHUNK           8
+
+#define RESULT_LOG_RECORD_SIZE(scores)  (9 + (scores))
+
+/**
+ * One record read back from the log
+ */
+typedef struct {
+    uint32_t sequence;
+    uint32_t timestamp_ms;
+    uint8_t class_id;
+    uint8_t scores[RESULT_PROTOCOL_MAX_SCORES];
+} result_log_record_t;
+
+typedef struct {
+    uint32_t appended;          // records
+    uint32_t blocks_written;    // block writes, including partial blocks
+    uint32_t cursor_writes;
+    uint32_t bytes_written;     // to the storage, blocks and cursor
+    uint32_t overwritten;       // records lost before they were delivered
+    uint32_t corrupt_blocks;    // blocks skipped on a bad CRC
+    uint32_t write_errors;
+} result_log_stats_t;
+
+/**
+ * @brief      CRC-32 (IEEE 802.3), 4 bits at a time
+ */
+static inline uint32_t result_log_crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    crc = ~crc;
+    for (size_t ix = 0; ix < size; ix++) {
+        crc = table[(crc ^ data[ix]) & 0x0f] ^ (crc >> 4);
+        crc = table[(crc ^ (data[ix] >> 4)) & 0x0f] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+/**
+ * @brief      Circular, block buffered result log
+ *
+ * @tparam     Storage  See above
+ * @tparam     SCORES   Scores per record
+ * @tparam     BLOCKS   Blocks in the log (at least 2)
+ */
+template <typename Storage, size_t SCORES, size_t BLOCKS>
+class ResultLog {
+    static_assert(SCORES <= RESULT_PROTOCOL_MAX_SCORES, "too many scores per record");
+    static_assert(BLOCKS >= 2, "the log needs at least 2 blocks");
+
+public:
+    static const size_t RECORD_SIZE = RESULT_LOG_RECORD_SIZE(SCORES);
+    static const size_t RECORDS_PER_BLOCK = (RESULT_LOG_BLOCK_SIZE - RESULT_LOG_HEADER_SIZE) / RECORD_SIZE;
+    static const size_t STORAGE_SIZE = BLOCKS * RESULT_LOG_BLOCK_SIZE + RESULT_LOG_CURSOR_SIZE;
+
+    explicit ResultLog(Storage *storage)
+        : _storage(storage),
+          _block_first(0),
+          _block_count(0),
+          _cached_first(NO_BLOCK),
+          _next(0),
+          _read(0),
+          _synced(0),
+          _committed(0),
+          _stats()
+    {
+    }
+
+    /**
+     * @brief      Find the newest block and the cursor in the storage. A storage
+     *             without valid blocks starts an empty log.
+     */
+    void begin() {
+        bool found = false;
+        uint32_t newest = 0;
+        uint32_t oldest = 0;
+        for (size_t slot = 0; slot < BLOCKS; slot++) {
+            uint32_t first;
+            uint16_t count;
+            if (!load_block(slot, &first, &count)) {
+                continue;
+            }
+            if (!found || first > newest) {
+                newest = first;
+                memcpy(_block, _cache, RESULT_LOG_BLOCK_SIZE);
+                _block_count = count;
+            }
+            if (!found || first < oldest) {
+                oldest = first;
+            }
+            found = true;
+        }
+        _cached_first = NO_BLOCK;
+
+        uint32_t cursor = 0;
+        const bool cursor_valid = load_cursor(&cursor);
+        if (found && (!cursor_valid || get32(&_block[8]) > cursor)) {
+            cursor = get32(&_block[8]);
+        }
+        if (found) {
+            // keep filling the newest block unless it is full
+            _block_first = newest;
+            if (_block_count == RECORDS_PER_BLOCK) {
+                _block_first += RECORDS_PER_BLOCK;
+                _block_count = 0;
+            }
+        }
+        else {
+            // nothing left to send, go on numbering after the cursor
+            _block_first = cursor_valid ? round_up(cursor) : 0;
+            _block_count = 0;
+            oldest = _block_first;
+        }
+        _next = _block_first + _block_count;
+        _synced = found || cursor_valid ? cursor : oldest;
+        if (_synced < oldest) {
+            _synced = oldest;
+        }
+        if (_synced > _next) {
+            _synced = _next;
+        }
+        _read = _synced;
+        _committed = _synced;
+    }
+
+    /**
+     * @brief      Append a result, writes the block when it is full
+     *
+     * @return     false if the block could not be written; it is given up,
+     *             records of it that were not delivered yet are skipped later
+     */
+    bool append(uint32_t timestamp_ms, uint8_t class_id, const float *scores) {
+        // a full block stays in RAM until here, so reading it back is free
+        if (_block_count == RECORDS_PER_BLOCK) {
+            _block_first += RECORDS_PER_BLOCK;
+            _block_count = 0;
+        }
+
+        uint8_t *out = &_block[RESULT_LOG_HEADER_SIZE + _block_count * RECORD_SIZE];
+        put32(&out[0], _next);
+        put32(&out[4], timestamp_ms);
+        out[8] = class_id;
+        for (size_t ix = 0; ix < SCORES; ix++) {
+            out[9 + ix] = result_protocol_quantize(scores[ix]);
+        }
+        _block_count++;
+        _next++;
+        _stats.appended++;
+
+        if (_block_count == RECORDS_PER_BLOCK) {
+            return write_block();
+        }
+        return true;
+    }
+
+    /**
+     * @brief      Write the partial block now (it is written again when full)
+     */
+    bool flush() {
+        if (_block_count == 0) {
+            return true;
+        }
+        return write_block();
+    }
+
+    /**
+     * @brief      Hand out records from the oldest one not handed out yet
+     *
+     * @return     Records read (0 if none are pending or the storage failed)
+     */
+    size_t read(result_log_record_t *records, size_t max_records) {
+        size_t count = 0;
+        while (count < max_records && _read < _next) {
+            const uint32_t first = _read - _read % RECORDS_PER_BLOCK;
+            const uint8_t *block;
+            uint16_t block_count;
+            if (first == _block_first) {
+                block = _block;
+                block_count = _block_count;
+            }
+            else {
+                if (_cached_first != first) {
+                    uint32_t stored_first;
+                    if (!load_block((first / RECORDS_PER_BLOCK) % BLOCKS, &stored_first, &block_count)
+                        || stored_first != first || block_count != RECORDS_PER_BLOCK) {
+                        // lost to a bad write or a reset, skip the block
+                        _stats.corrupt_blocks++;
+                        skip_to(first + RECORDS_PER_BLOCK);
+                        continue;
+                    }
+                    _cached_first = first;
+                }
+                block = _cache;
+                block_count = RECORDS_PER_BLOCK;
+            }
+
+            for (size_t ix = _read - first; ix < block_count && count < max_records; ix++) {
+                const uint8_t *in = &block[RESULT_LOG_HEADER_SIZE + ix * RECORD_SIZE];
+                result_log_record_t *record = &records[count++];
+                record->sequence = get32(&in[0]);
+                record->timestamp_ms = get32(&in[4]);
+                record->class_id = in[8];
+                memcpy(record->scores, &in[9], SCORES);
+                _read++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief      Records were delivered
+     *
+     * @param      sequence  Low 16 bits of the first delivered sequence number
+     *                       (as in a result packet)
+     * @param      count     Records delivered from there on
+     */
+    void acknowledge(uint16_t sequence, size_t count) {
+        const uint32_t first = _synced + (int16_t)(uint16_t)(sequence - (uint16_t)_synced);
+        const uint32_t end = first + (uint32_t)count;
+        if (first <= _synced && end > _synced && end <= _read) {
+            _synced = end;
+        }
+    }
+
+    /**
+     * @brief      Hand out the records that were not acknowledged again
+     */
+    void rewind() {
+        _read = _synced;
+    }
+
+    /**
+     * @brief      Persist the delivered position, e.g. after a sync
+     */
+    bool commit() {
+        if (_committed == _synced) {
+            return true;
+        }
+        uint8_t cursor[RESULT_LOG_CURSOR_SIZE];
+        put32(&cursor[0], RESULT_LOG_MAGIC);
+        put32(&cursor[4], _synced);
+        put32(&cursor[8], result_log_crc32(cursor, 8));
+        if (!_storage->write(BLOCKS * RESULT_LOG_BLOCK_SIZE, cursor, sizeof(cursor))) {
+            _stats.write_errors++;
+            return false;
+        }
+        _stats.cursor_writes++;
+        _stats.bytes_written += sizeof(cursor);
+        _committed = _synced;
+        return true;
+    }
+
+    /**
+     * @brief      Records not handed out yet
+     */
+    size_t pending() const {
+        return _next - _read;
+    }
+
+    /**
+     * @brief      Records not delivered yet
+     */
+    size_t unsynced() const {
+        return _next - _synced;
+    }
+
+    /**
+     * @brief      Sequence number of the next record read() hands out
+     */
+    uint32_t read_position() const {
+        return _read;
+    }
+
+    /**
+     * @brief      Sequence number of the next appended record
+     */
+    uint32_t next_sequence() const {
+        return _next;
+    }
+
+    void get_stats(result_log_stats_t *stats) const {
+        *stats = _stats;
+    }
+
+private:
+    static const uint32_t NO_BLOCK = 0xffffffff;
+
+    static void put32(uint8_t *out, uint32_t v) {
+        result_protocol_put32(out, v);
+    }
+
+    static uint32_t get32(const uint8_t *in) {
+        return result_protocol_get32(in);
+    }
+
+    static uint32_t round_up(uint32_t sequence) {
+        return (sequence + RECORDS_PER_BLOCK - 1) / RECORDS_PER_BLOCK * RECORDS_PER_BLOCK;
+    }
+
+    void skip_to(uint32_t sequence) {
+        if (_read < sequence) {
+            _read = sequence;
+        }
+        if (_synced < sequence) {
+            _synced = sequence;
+        }
+    }
+
+    /**
+     * Read and check the block in a slot into _cache
+     */
+    bool load_block(size_t slot, uint32_t *first, uint16_t *count) {
+        if (!_storage->read(slot * RESULT_LOG_BLOCK_SIZE, _cache, RESULT_LOG_BLOCK_SIZE)) {
+            return false;
+        }
+        _cached_first = NO_BLOCK;
+        *first = get32(&_cache[4]);
+        *count = result_protocol_get16(&_cache[12]);
+        if (get32(&_cache[0]) != RESULT_LOG_MAGIC || *count == 0 || *count > RECORDS_PER_BLOCK
+            || *first % RECORDS_PER_BLOCK != 0) {
+            return false;
+        }
+        return get32(&_cache[16]) == block_crc(_cache, *count);
+    }
+
+    bool load_cursor(uint32_t *sequence) {
+        uint8_t cursor[RESULT_LOG_CURSOR_SIZE];
+        if (!_storage->read(BLOCKS * RESULT_LOG_BLOCK_SIZE, cursor, sizeof(cursor))
+            || get32(&cursor[0]) != RESULT_LOG_MAGIC || get32(&cursor[8]) != result_log_crc32(cursor, 8)) {
+            return false;
+        }
+        *sequence = get32(&cursor[4]);
+        return true;
+    }
+
+    bool write_block() {
+        // the slot's previous block is gone from here on
+        const uint32_t span = (uint32_t)((BLOCKS - 1) * RECORDS_PER_BLOCK);
+        const uint32_t oldest = _block_first > span ? _block_first - span : 0;
+        if (_synced < oldest) {
+            _stats.overwritten += oldest - _synced;
+            skip_to(oldest);
+        }
+        if (_cached_first != NO_BLOCK && _cached_first < oldest) {
+            _cached_first = NO_BLOCK;
+        }
+
+        put32(&_block[0], RESULT_LOG_MAGIC);
+        put32(&_block[4], _block_first);
+        put32(&_block[8], _synced);
+        result_protocol_put16(&_block[12], (uint16_t)_block_count);
+        result_protocol_put16(&_block[14], 0);
+        put32(&_block[16], block_crc(_block, _block_count));
+        const size_t slot = (_block_first / RECORDS_PER_BLOCK) % BLOCKS;
+        if (!_storage->write(slot * RESULT_LOG_BLOCK_SIZE, _block, RESULT_LOG_BLOCK_SIZE)) {
+            _stats.write_errors++;
+            return false;
+        }
+        _stats.blocks_written++;
+        _stats.bytes_written += RESULT_LOG_BLOCK_SIZE;
+        _committed = _synced;
+        return true;
+    }
+
+    static uint32_t block_crc(const uint8_t *block, size_t count) {
+        const uint32_t crc = result_log_crc32(block, 16);
+        return result_log_crc32(&block[RESULT_LOG_HEADER_SIZE], count * RECORD_SIZE, crc);
+    }
+
+    Storage *_storage;
+    uint8_t _block[RESULT_LOG_BLOCK_SIZE];  // block being filled
+    uint32_t _block_first;
+    size_t _block_count;
+    uint8_t _cache[RESULT_LOG_BLOCK_SIZE];  // last block read back
+    uint32_t _cached_first;
+    uint32_t _next;         // sequence of the next record
+    uint32_t _read;         // next record to hand out
+    uint32_t _synced;       // oldest record not delivered
+    uint32_t _committed;    // _synced as in the storage
+    result_log_stats_t _stats;
+};
+
+/**
+ * @brief      Move records from the log into a batcher. While a backlog is
+ *             waiting, packets are filled regardless of class changes and the
+ *             last one is sent right away instead of after the timeout. The
+ *             batcher's send callback should acknowledge() delivered packets
+ *             and rewind() the log if a packet could not be sent.
+ *
+ * @param      max_packets  Stop once this many packets were sent (the rest
+ *                          goes with the next call)
+ *
+ * @return     Packets sent
+ */
+template <typename Log, size_t SCORES>
+size_t result_log_sync(Log *log, ResultBatcher<SCORES> *batcher, size_t max_packets) {
+    result_log_record_t records[RESULT_LOG_SYNC_CHUNK];
+    result_batcher_stats_t stats;
+    batcher->get_stats(&stats);
+    const uint32_t packets = stats.packets;
+    const bool backlog = log->pending() > 1;
+
+    batcher->set_flush_on_class_change(!backlog);
+    size_t count;
+    while (stats.packets - packets < max_packets
+           && (count = log->read(records, sizeof(records) / sizeof(records[0]))) > 0) {
+        for (size_t ix = 0; ix < count; ix++) {
+            if (records[ix].sequence >= log->read_position()) {
+                // a packet failed and the log was rewound, these go out again later
+                batcher->discard();
+                batcher->set_flush_on_class_change(true);
+                batcher->get_stats(&stats);
+                return stats.packets - packets;
+            }
+            float scores[SCORES];
+            for (size_t score = 0; score < SCORES; score++) {
+                scores[score] = result_protocol_dequantize(records[ix].scores[score]);
+            }
+            batcher->set_sequence((uint16_t)records[ix].sequence);
+            batcher->add(records[ix].timestamp_ms, records[ix].class_id, scores);
+        }
+        batcher->get_stats(&stats);
+    }
+    if (backlog && log->pending() == 0) {
+        batcher->flush();
+        batcher->get_stats(&stats);
+    }
+    batcher->set_flush_on_class_change(true);
+    return stats.packets - packets;
+}
+
+#endif // _RESULT_LOG_H_
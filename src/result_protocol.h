@@ -0,0 +1,362 @@
+/* Activity recognition - binary result protocol
+ *
+ * Results go to the phone as packed binary packets instead of one text
+ * notification ("walk=0.9123") per window. A packet fills one notification
+ * and holds consecutive results. All fields are little endian:
+ *
+ *   header   uint8   version (RESULT_PROTOCOL_VERSION)
+ *            uint8   scores per record (n)
+ *            uint16  sequence number of the first record; records are
+ *                    numbered consecutively, so gaps show lost results
+ *            uint32  timestamp of the first record, ms
+ *   record   uint16  ms since the previous record (0 for the first)
+ *            uint8   class id (RESULT_CLASS_NONE: not decided)
+ *            uint8   n scores, score * 255 rounded
+ *
+ * With 3 labels a record is 6 bytes. ResultBatcher collects records and
+ * sends a packet when the next record would not fit the notification, when
+ * the class changes (so the phone sees it right away) or when the oldest
+ * record has waited for the timeout. result_protocol_decode() is the
+ * receiving side (host/ble_loopback_bench.cpp, the phone app).
+ */
+
+#ifndef _RESULT_PROTOCOL_H_
+#define _RESULT_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESULT_PROTOCOL_VERSION         1
+#define RESULT_PROTOCOL_HEADER_SIZE     8
+// ATT payload of the default MTU (23) and of the largest MTU a single
+// data length extended link layer packet carries (247)
+#define RESULT_PROTOCOL_MIN_PAYLOAD     20
+#define RESULT_PROTOCOL_MAX_PAYLOAD     244
+#define RESULT_PROTOCOL_MAX_SCORES      16
+#define RESULT_CLASS_NONE               0xff
+
+#define RESULT_PROTOCOL_RECORD_SIZE(scores)     (3 + (scores))
+
+/**
+ * One decoded result
+ */
+typedef struct {
+    uint16_t sequence;
+    uint32_t timestamp_ms;
+    uint8_t class_id;
+    uint8_t scores[RESULT_PROTOCOL_MAX_SCORES];
+} result_record_t;
+
+/**
+ * Header of a decoded packet
+ */
+typedef struct {
+    uint8_t version;
+    uint8_t score_count;
+    uint16_t sequence;
+    uint32_t timestamp_ms;
+    size_t record_count;
+} result_packet_info_t;
+
+static inline uint8_t result_protocol_quantize(float score) {
+    if (score <= 0.0f) {
+        return 0;
+    }
+    if (score >= 1.0f) {
+        return 255;
+    }
+    return (uint8_t)(score * 255.0f + 0.5f);
+}
+
+static inline float result_protocol_dequantize(uint8_t score) {
+    return score / 255.0f;
+}
+
+static inline void result_protocol_put16(uint8_t *out, uint16_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+}
+
+static inline void result_protocol_put32(uint8_t *out, uint32_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t result_protocol_get16(const uint8_t *in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static inline uint32_t result_protocol_get32(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/**
+ * @brief      Decode a packet
+ *
+ * @param      packet       Packet as received
+ * @param      size         Size of the packet
+ * @param      info         Header of the packet (output)
+ * @param      records      Decoded records (output), or NULL to only read the header
+ * @param      max_records  Capacity of records
+ *
+ * @return     Number of records, -1 if the packet is malformed or has a
+ *             different version (or more than RESULT_PROTOCOL_MAX_SCORES
+ *             scores), -2 if it holds more than max_records
+ */
+static inline int result_protocol_decode(const uint8_t *packet, size_t size,
+                                         result_packet_info_t *info,
+                                         result_record_t *records, size_t max_records)
+{
+    if (size < RESULT_PROTOCOL_HEADER_SIZE || packet[0] != RESULT_PROTOCOL_VERSION) {
+        return -1;
+    }
+    info->version = packet[0];
+    info->score_count = packet[1];
+    info->sequence = result_protocol_get16(&packet[2]);
+    info->timestamp_ms = result_protocol_get32(&packet[4]);
+    if (info->score_count > RESULT_PROTOCOL_MAX_SCORES) {
+        return -1;
+    }
+
+    const size_t record_size = RESULT_PROTOCOL_RECORD_SIZE(info->score_count);
+    const size_t body = size - RESULT_PROTOCOL_HEADER_SIZE;
+    if (body == 0 || body % record_size != 0) {
+        return -1;
+    }
+    info->record_count = body / record_size;
+    if (!records) {
+        return (int)info->record_count;
+    }
+    if (info->record_count > max_records) {
+        return -2;
+    }
+
+    const uint8_t *in = &packet[RESULT_PROTOCOL_HEADER_SIZE];
+    uint32_t timestamp_ms = info->timestamp_ms;
+    for (size_t ix = 0; ix < info->record_count; ix++) {
+        timestamp_ms += result_protocol_get16(in);
+        records[ix].sequence = (uint16_t)(info->sequence + ix);
+        records[ix].timestamp_ms = timestamp_ms;
+        records[ix].class_id = in[2];
+        for (size_t score = 0; score < info->score_count; score++) {
+            records[ix].scores[score] = in[3 + score];
+        }
+        in += record_size;
+    }
+    return (int)info->record_count;
+}
+
+/**
+ * Sends one packet (a notification)
+ */
+typedef void (*result_send_fn)(const uint8_t *packet, size_t size, void *ctx);
+
+/**
+ * Packets sent by a ResultBatcher, by flush reason
+ */
+typedef struct {
+    uint32_t records;
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t full;          // next record would not fit
+    uint32_t class_change;
+    uint32_t timeout;
+    uint32_t other;         // flush(), payload size change, timestamp gap
+} result_batcher_stats_t;
+
+/**
+ * @brief      Collects results into packets. Not thread safe: add(), poll()
+ *             and flush() belong to one task (the pipeline's transport task).
+ *
+ * @tparam     SCORES  Scores per record
+ */
+template <size_t SCORES>
+class ResultBatcher {
+    static_assert(SCORES <= RESULT_PROTOCOL_MAX_SCORES, "too many scores per record");
+    static_assert(RESULT_PROTOCOL_HEADER_SIZE + RESULT_PROTOCOL_RECORD_SIZE(SCORES) <= RESULT_PROTOCOL_MIN_PAYLOAD,
+                  "a record has to fit a notification of the default MTU");
+
+public:
+    /**
+     * @param      send          Called with every complete packet
+     * @param      ctx           Passed to send
+     * @param      payload_size  Notification payload, ATT MTU - 3
+     * @param      timeout_ms    Longest a record waits in a partial packet
+     */
+    ResultBatcher(result_send_fn send, void *ctx,
+                  size_t payload_size = RESULT_PROTOCOL_MIN_PAYLOAD,
+                  uint32_t timeout_ms = 10000)
+        : _send(send),
+          _ctx(ctx),
+          _payload_size(RESULT_PROTOCOL_MIN_PAYLOAD),
+          _timeout_ms(timeout_ms),
+          _size(0),
+          _count(0),
+          _sequence(0),
+          _first_ms(0),
+          _last_ms(0),
+          _last_class(RESULT_CLASS_NONE),
+          _flush_on_class_change(true),
+          _stats()
+    {
+        set_payload_size(payload_size);
+    }
+
+    /**
+     * @brief      Change the notification payload, e.g. after the MTU exchange.
+     *             Pending records are sent first if the next one would no longer fit.
+     */
+    void set_payload_size(size_t payload_size) {
+        if (payload_size < RESULT_PROTOCOL_MIN_PAYLOAD) {
+            payload_size = RESULT_PROTOCOL_MIN_PAYLOAD;
+        }
+        if (payload_size > RESULT_PROTOCOL_MAX_PAYLOAD) {
+            payload_size = RESULT_PROTOCOL_MAX_PAYLOAD;
+        }
+        if (_count > 0 && _size + RESULT_PROTOCOL_RECORD_SIZE(SCORES) > payload_size) {
+            send(&_stats.other);
+        }
+        _payload_size = payload_size;
+    }
+
+    void set_timeout(uint32_t timeout_ms) {
+        _timeout_ms = timeout_ms;
+    }
+
+    /**
+     * @brief      Off while sending a backlog, so packets stay full
+     */
+    void set_flush_on_class_change(bool flush) {
+        _flush_on_class_change = flush;
+    }
+
+    /**
+     * @brief      Number the next record with sequence. Pending records are
+     *             sent first if it does not follow them (records were lost).
+     */
+    void set_sequence(uint16_t sequence) {
+        if (sequence != _sequence) {
+            send(&_stats.other);
+            _sequence = sequence;
+        }
+    }
+
+    /**
+     * @brief      Add a result
+     *
+     * @param      timestamp_ms  Time of the result, ms (wraps)
+     * @param      class_id      Class, RESULT_CLASS_NONE if not decided
+     * @param      scores        SCORES scores in [0, 1]
+     */
+    void add(uint32_t timestamp_ms, uint8_t class_id, const float *scores) {
+        // deltas are 16 bit, a longer gap starts a new packet
+        if (_count > 0 && (uint32_t)(timestamp_ms - _last_ms) > 0xffff) {
+            send(&_stats.other);
+        }
+
+        if (_count == 0) {
+            _buffer[0] = RESULT_PROTOCOL_VERSION;
+            _buffer[1] = (uint8_t)SCORES;
+            result_protocol_put16(&_buffer[2], _sequence);
+            result_protocol_put32(&_buffer[4], timestamp_ms);
+            _size = RESULT_PROTOCOL_HEADER_SIZE;
+            _first_ms = timestamp_ms;
+            _last_ms = timestamp_ms;
+        }
+
+        uint8_t *out = &_buffer[_size];
+        result_protocol_put16(out, (uint16_t)(timestamp_ms - _last_ms));
+        out[2] = class_id;
+        for (size_t ix = 0; ix < SCORES; ix++) {
+            out[3 + ix] = result_protocol_quantize(scores[ix]);
+        }
+        _size += RESULT_PROTOCOL_RECORD_SIZE(SCORES);
+        _count++;
+        _sequence++;
+        _last_ms = timestamp_ms;
+        _stats.records++;
+
+        const bool changed = class_id != _last_class;
+        _last_class = class_id;
+        if (_size + RESULT_PROTOCOL_RECORD_SIZE(SCORES) > _payload_size) {
+            send(&_stats.full);
+        }
+        else if (changed && _flush_on_class_change) {
+            send(&_stats.class_change);
+        }
+    }
+
+    /**
+     * @brief      Send the pending records if the oldest one waited for the timeout
+     */
+    void poll(uint32_t now_ms) {
+        // signed, a clock behind the first record is not a timeout
+        if (_count > 0 && (int32_t)(now_ms - _first_ms) >= (int32_t)_timeout_ms) {
+            send(&_stats.timeout);
+        }
+    }
+
+    /**
+     * @brief      Send the pending records now
+     */
+    void flush() {
+        send(&_stats.other);
+    }
+
+    /**
+     * @brief      Drop the pending records without sending them
+     */
+    void discard() {
+        _size = 0;
+        _count = 0;
+    }
+
+    /**
+     * @brief      Records waiting in the partial packet
+     */
+    size_t pending() const {
+        return _count;
+    }
+
+    /**
+     * @brief      Sequence number the next record gets
+     */
+    uint16_t sequence() const {
+        return _sequence;
+    }
+
+    void get_stats(result_batcher_stats_t *stats) const {
+        *stats = _stats;
+    }
+
+private:
+    void send(uint32_t *reason) {
+        if (_count == 0) {
+            return;
+        }
+        _send(_buffer, _size, _ctx);
+        _stats.packets++;
+        _stats.bytes += (uint32_t)_size;
+        (*reason)++;
+        _size = 0;
+        _count = 0;
+    }
+
+    result_send_fn _send;
+    void *_ctx;
+    size_t _payload_size;
+    uint32_t _timeout_ms;
+    uint8_t _buffer[RESULT_PROTOCOL_MAX_PAYLOAD];
+    size_t _size;
+    size_t _count;
+    uint16_t _sequence;
+    uint32_t _first_ms;
+    uint32_t _last_ms;
+    uint8_t _last_class;
+    bool _flush_on_class_change;
+    result_batcher_stats_t _stats;
+};
+
+#endif // _RESULT_PROTOCOL_H_
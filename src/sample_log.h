@@ -0,0 +1,345 @@
+/* Activity recognition - raw sample log
+ *
+ * Records the accelerometer frames the classifier consumes (after
+ * decimation, see AccelAcquisition) to flash, e.g. to collect training data
+ * or to replay a day on the host. The frames come from the pipeline's
+ * acquisition task, so logging reads nothing more from the sensor. Frames
+ * are delta encoded into fixed size blocks, a block is written once, when it
+ * is full. All fields are little endian:
+ *
+ *   header   uint32  SAMPLE_LOG_MAGIC
+ *            uint32  block sequence number, consecutive over resets
+ *            uint32  nominal frame period, us
+ *            uint32  timestamp of the first frame, us
+ *            int16   x, y, z of the first frame, mg
+ *            uint16  frames in the block
+ *            uint16  bytes of encoded frames after the header
+ *            uint16  0
+ *            uint32  CRC-32 of the header fields above and the encoded frames
+ *   frames   every further frame as 4 zigzag LEB128 varints: timestamp
+ *            delta minus the period, x, y and z delta
+ *
+ * A frame with small deltas takes 4 bytes instead of the ~24 of a text line
+ * ("123456, -123, 456, 987"). Block n goes to slot n % BLOCKS, a full log
+ * overwrites its oldest block. Blocks are SAMPLE_LOG_BLOCK_SIZE (4 KB, one
+ * flash sector) and start on a multiple of it in the storage.
+ *
+ * The acquisition task add()s frames into one of two RAM blocks and hands
+ * the full one over; the task that owns the storage (the transport task in
+ * the sketch) write()s it. If the previous block was not written yet when
+ * the next one fills, the new block is dropped and counted. The storage is
+ * a template parameter as for ResultLog (src/result_log.h).
+ * sample_log_decode() is the reading side (host/sample_log_decode.cpp).
+ */
+
+#ifndef _SAMPLE_LOG_H_
+#define _SAMPLE_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "accel_acquisition.h"
+#include "result_log.h"
+
+#define SAMPLE_LOG_MAGIC                0x31575253  // "SRW1"
+#define SAMPLE_LOG_BLOCK_SIZE           4096
+#define SAMPLE_LOG_HEADER_SIZE          32
+// Timestamp varint (5 bytes) and 3 axis varints (an int16 delta zigzags to 17 bits)
+#define SAMPLE_LOG_MAX_FRAME_SIZE       14
+// Blocks of the sketch's log, 64 blocks hold about 1.5 hours at 10 Hz
+#ifndef SAMPLE_LOG_BLOCKS
+#define SAMPLE_LOG_BLOCKS               64
+#endif
+
+/**
+ * Header of a decoded block
+ */
+typedef struct {
+    uint32_t sequence;
+    uint32_t period_us;
+    size_t frame_count;
+} sample_log_block_t;
+
+typedef struct {
+    uint32_t frames;            // added
+    uint32_t dropped_frames;    // in blocks dropped because the writer was behind
+    uint32_t blocks_written;
+    uint32_t bytes_written;
+    uint32_t encoded_bytes;     // frames in the written blocks, without headers and padding
+    uint32_t write_errors;
+} sample_log_stats_t;
+
+static inline size_t sample_log_put_varint(uint8_t *out, int32_t value) {
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t size = 0;
+    while (zigzag >= 0x80) {
+        out[size++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    out[size++] = (uint8_t)zigzag;
+    return size;
+}
+
+/**
+ * @return     false if the varint runs past end or over 5 bytes
+ */
+static inline bool sample_log_get_varint(const uint8_t **in, const uint8_t *end, int32_t *value) {
+    uint32_t zigzag = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*in == end) {
+            return false;
+        }
+        const uint8_t byte = *(*in)++;
+        zigzag |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint32_t sample_log_block_crc(const uint8_t *block, size_t encoded) {
+    const uint32_t crc = result_log_crc32(block, SAMPLE_LOG_HEADER_SIZE - 4);
+    return result_log_crc32(&block[SAMPLE_LOG_HEADER_SIZE], encoded, crc);
+}
+
+/**
+ * @brief      Decode a block
+ *
+ * @param      block       SAMPLE_LOG_BLOCK_SIZE bytes as stored
+ * @param      info        Header of the block (output)
+ * @param      frames      Decoded frames (output), or NULL to only check the block
+ * @param      max_frames  Capacity of frames
+ *
+ * @return     Number of frames, -1 if the slot holds no valid block (never
+ *             written, torn write, bad CRC), -2 if it holds more than max_frames
+ */
+static inline int sample_log_decode(const uint8_t *block, sample_log_block_t *info,
+                                    accel_frame_t *frames, size_t max_frames)
+{
+    const size_t encoded = result_protocol_get16(&block[24]);
+    const size_t count = result_protocol_get16(&block[22]);
+    if (result_protocol_get32(&block[0]) != SAMPLE_LOG_MAGIC || count == 0
+        || encoded > SAMPLE_LOG_BLOCK_SIZE - SAMPLE_LOG_HEADER_SIZE
+        || result_protocol_get32(&block[28]) != sample_log_block_crc(block, encoded)) {
+        return -1;
+    }
+    info->sequence = result_protocol_get32(&block[4]);
+    info->period_us = result_protocol_get32(&block[8]);
+    info->frame_count = count;
+    if (!frames) {
+        return (int)count;
+    }
+    if (count > max_frames) {
+        return -2;
+    }
+
+    frames[0].timestamp_us = result_protocol_get32(&block[12]);
+    for (size_t axis = 0; axis < ACCEL_AXES; axis++) {
+        frames[0].xyz[axis] = (int16_t)result_protocol_get16(&block[16 + axis * 2]);
+    }
+    const uint8_t *in = &block[SAMPLE_LOG_HEADER_SIZE];
+    const uint8_t *end = in + encoded;
+    for (size_t ix = 1; ix < count; ix++) {
+        int32_t delta;
+        if (!sample_log_get_varint(&in, end, &delta)) {
+            return -1;
+        }
+        frames[ix].timestamp_us = frames[ix - 1].timestamp_us + info->period_us + (uint32_t)delta;
+        for (size_t axis = 0; axis < ACCEL_AXES; axis++) {
+            if (!sample_log_get_varint(&in, end, &delta)) {
+                return -1;
+            }
+            frames[ix].xyz[axis] = (int16_t)(frames[ix - 1].xyz[axis] + delta);
+        }
+    }
+    return in == end ? (int)count : -1;
+}
+
+/**
+ * @brief      Double buffered, delta encoded sample log. add() and close()
+ *             belong to the producer (the acquisition task), begin(), write()
+ *             and the storage to one consumer task.
+ *
+ * @tparam     Storage  See above
+ * @tparam     BLOCKS   Blocks in the log
+ */
+template <typename Storage, size_t BLOCKS>
+class SampleLog {
+    static_assert(BLOCKS >= 1, "the log needs at least 1 block");
+
+public:
+    static const size_t STORAGE_SIZE = BLOCKS * SAMPLE_LOG_BLOCK_SIZE;
+
+    /**
+     * @param      period_us  Nominal time between two frames, timestamps are
+     *                        stored as the difference to it
+     */
+    SampleLog(Storage *storage, uint32_t period_us)
+        : _storage(storage),
+          _period_us(period_us),
+          _active(0),
+          _used(0),
+          _count(0),
+          _sequence(0),
+          _full(-1),
+          _frames(0),
+          _dropped_frames(0),
+          _blocks_written(0),
+          _bytes_written(0),
+          _encoded_bytes(0),
+          _write_errors(0)
+    {
+    }
+
+    /**
+     * @brief      Continue numbering after the newest valid block in the
+     *             storage. Call before the producer starts.
+     */
+    void begin() {
+        uint32_t next = 0;
+        for (size_t slot = 0; slot < BLOCKS; slot++) {
+            sample_log_block_t info;
+            // the second block is free until the producer starts
+            if (_storage->read(slot * SAMPLE_LOG_BLOCK_SIZE, _blocks[1], SAMPLE_LOG_BLOCK_SIZE)
+                && sample_log_decode(_blocks[1], &info, NULL, 0) > 0 && info.sequence + 1 > next) {
+                next = info.sequence + 1;
+            }
+        }
+        _sequence = next;
+    }
+
+    /**
+     * @brief      Producer: add a frame, hands the block over when it is full
+     *
+     * @return     false if a full block had to be dropped (the writer is behind)
+     */
+    bool add(const accel_frame_t *frame) {
+        uint8_t *block = _blocks[_active];
+        if (_count == 0) {
+            result_protocol_put32(&block[12], frame->timestamp_us);
+            for (size_t axis = 0; axis < ACCEL_AXES; axis++) {
+                result_protocol_put16(&block[16 + axis * 2], (uint16_t)frame->xyz[axis]);
+            }
+            _used = SAMPLE_LOG_HEADER_SIZE;
+        }
+        else {
+            uint8_t *out = &block[_used];
+            out += sample_log_put_varint(out, (int32_t)(frame->timestamp_us - _last.timestamp_us - _period_us));
+            for (size_t axis = 0; axis < ACCEL_AXES; axis++) {
+                out += sample_log_put_varint(out, (int32_t)frame->xyz[axis] - _last.xyz[axis]);
+            }
+            _used = (size_t)(out - block);
+        }
+        _last = *frame;
+        _count++;
+        _frames.fetch_add(1, std::memory_order_relaxed);
+
+        if (_used + SAMPLE_LOG_MAX_FRAME_SIZE > SAMPLE_LOG_BLOCK_SIZE) {
+            return close();
+        }
+        return true;
+    }
+
+    /**
+     * @brief      Producer: hand the partial block over, e.g. before stopping
+     *
+     * @return     false if it had to be dropped (the writer is behind)
+     */
+    bool close() {
+        if (_count == 0) {
+            return true;
+        }
+        if (_full.load(std::memory_order_acquire) >= 0) {
+            _dropped_frames.fetch_add((uint32_t)_count, std::memory_order_relaxed);
+            _count = 0;
+            return false;
+        }
+
+        uint8_t *block = _blocks[_active];
+        const size_t encoded = _used - SAMPLE_LOG_HEADER_SIZE;
+        result_protocol_put32(&block[0], SAMPLE_LOG_MAGIC);
+        result_protocol_put32(&block[4], _sequence++);
+        result_protocol_put32(&block[8], _period_us);
+        result_protocol_put16(&block[22], (uint16_t)_count);
+        result_protocol_put16(&block[24], (uint16_t)encoded);
+        result_protocol_put16(&block[26], 0);
+        // the unused tail is written too, keep it deterministic
+        memset(&block[_used], 0, SAMPLE_LOG_BLOCK_SIZE - _used);
+        result_protocol_put32(&block[28], sample_log_block_crc(block, encoded));
+
+        _full.store(_active, std::memory_order_release);
+        _active ^= 1;
+        _count = 0;
+        return true;
+    }
+
+    /**
+     * @brief      Consumer: write the block that was handed over, if any
+     *
+     * @return     true if a block was written
+     */
+    bool write() {
+        const int full = _full.load(std::memory_order_acquire);
+        if (full < 0) {
+            return false;
+        }
+        const uint8_t *block = _blocks[full];
+        const size_t slot = result_protocol_get32(&block[4]) % BLOCKS;
+        const bool written = _storage->write(slot * SAMPLE_LOG_BLOCK_SIZE, block, SAMPLE_LOG_BLOCK_SIZE);
+        if (written) {
+            _blocks_written.fetch_add(1, std::memory_order_relaxed);
+            _bytes_written.fetch_add(SAMPLE_LOG_BLOCK_SIZE, std::memory_order_relaxed);
+            _encoded_bytes.fetch_add(result_protocol_get16(&block[24]), std::memory_order_relaxed);
+        }
+        else {
+            _write_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        _full.store(-1, std::memory_order_release);
+        return written;
+    }
+
+    /**
+     * @brief      Sequence number of the next block handed over
+     */
+    uint32_t next_sequence() const {
+        return _sequence;
+    }
+
+    /**
+     * @brief      Any task, e.g. while the producer and consumer run
+     */
+    void get_stats(sample_log_stats_t *stats) const {
+        stats->frames = _frames.load(std::memory_order_relaxed);
+        stats->dropped_frames = _dropped_frames.load(std::memory_order_relaxed);
+        stats->blocks_written = _blocks_written.load(std::memory_order_relaxed);
+        stats->bytes_written = _bytes_written.load(std::memory_order_relaxed);
+        stats->encoded_bytes = _encoded_bytes.load(std::memory_order_relaxed);
+        stats->write_errors = _write_errors.load(std::memory_order_relaxed);
+    }
+
+private:
+    Storage *_storage;
+    uint32_t _period_us;
+    uint8_t _blocks[2][SAMPLE_LOG_BLOCK_SIZE];
+    // producer only
+    int _active;            // block being filled
+    size_t _used;
+    size_t _count;
+    accel_frame_t _last;
+    uint32_t _sequence;
+    // handed over block, -1 if none
+    std::atomic<int> _full;
+    // sample_log_stats_t, written by the producer
+    std::atomic<uint32_t> _frames;
+    std::atomic<uint32_t> _dropped_frames;
+    // and by the consumer
+    std::atomic<uint32_t> _blocks_written;
+    std::atomic<uint32_t> _bytes_written;
+    std::atomic<uint32_t> _encoded_bytes;
+    std::atomic<uint32_t> _write_errors;
+};
+
+#endif // _SAMPLE_LOG_H_
@@ -0,0 +1,107 @@
+/* Activity recognition - wait-free sample ring
+ *
+ * Single-producer / single-consumer ring buffer used to hand accelerometer
+ * frames from the acquisition side (interrupt or producer task) to the
+ * inference side without locks.
+ */
+
+#ifndef _SAMPLE_RING_H_
+#define _SAMPLE_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief      Wait-free SPSC ring buffer.
+ *
+ *             Exactly one thread/ISR may call the producer side (push, dropped)
+ *             and exactly one the consumer side (peek, pop, advance). Indices are
+ *             free-running counters, so N must be a power of two. When the ring is
+ *             full new items are dropped (and counted) instead of overwriting data
+ *             the consumer may still be reading.
+ *
+ * @tparam     T     Item type, must be trivially copyable
+ * @tparam     N     Capacity, power of two
+ */
+template <typename T, size_t N>
+class SampleRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleRing capacity must be a power of two");
+
+public:
+    SampleRing() : _head(0), _tail(0), _dropped(0) { }
+
+    /**
+     * @brief      Producer: append one item
+     * @return     false if the ring was full and the item was dropped
+     */
+    bool push(const T &item) {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= N) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        _items[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief      Consumer: number of items available
+     */
+    size_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief      Consumer: access the ix'th oldest item without removing it.
+     *             ix must be smaller than size().
+     */
+    const T &peek(size_t ix) const {
+        return _items[(_tail.load(std::memory_order_relaxed) + ix) & (N - 1)];
+    }
+
+    /**
+     * @brief      Consumer: remove the oldest item
+     * @return     false if the ring was empty
+     */
+    bool pop(T *item) {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail) {
+            return false;
+        }
+        *item = _items[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief      Consumer: release the count oldest items (after they were peeked)
+     */
+    void advance(size_t count) {
+        const size_t available = size();
+        if (count > available) {
+            count = available;
+        }
+        _tail.store(_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @brief      Number of items dropped because the consumer fell behind
+     */
+    uint32_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+    T _items[N];
+    std::atomic<size_t> _head;
+    std::atomic<size_t> _tail;
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif // _SAMPLE_RING_H_
@@ -0,0 +1,159 @@
+/* Activity recognition - triple-buffered window capture
+ *
+ * The producer fills one window while the consumer works on the last
+ * completed one; a third slot holds the newest completed window in between,
+ * so neither side ever waits for the other. Consecutive windows overlap by
+ * (window - hop) frames, which are copied into the next window as soon as
+ * one completes, so with a 50% hop a new window is ready every half window.
+ */
+
+#ifndef _WINDOW_BUFFER_H_
+#define _WINDOW_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+/**
+ * Capture counters
+ */
+typedef struct {
+    uint32_t completed;     // windows completed by the producer
+    uint32_t dropped;       // completed windows replaced before the consumer took them
+    uint32_t consumed;      // windows handed to the consumer
+} window_buffer_stats_t;
+
+/**
+ * @brief      Lock-free SPSC triple buffer of sample windows.
+ *
+ *             One thread/task writes frames (write, frames_until_window), one
+ *             reads windows (acquire). A window returned by acquire() is not
+ *             touched by the producer until the next acquire().
+ *
+ * @tparam     FRAMES  Frames per window
+ * @tparam     AXES    Values per frame
+ */
+template <size_t FRAMES, size_t AXES>
+class WindowBuffer {
+public:
+    typedef struct {
+        float data[FRAMES * AXES];  // interleaved, oldest frame first
+        uint32_t timestamp_us;      // newest frame
+        uint32_t sequence;          // 1 for the first window, +1 per completed window
+    } window_t;
+
+    /**
+     * @param      hop_frames  Frames between the starts of two windows (1 .. FRAMES)
+     */
+    explicit WindowBuffer(size_t hop_frames)
+        : _hop(hop_frames == 0 || hop_frames > FRAMES ? FRAMES : hop_frames),
+          _back(0),
+          _filled(0),
+          _sequence(0),
+          _front(1),
+          _middle(2),
+          _completed(0),
+          _dropped(0),
+          _consumed(0)
+    {
+    }
+
+    size_t hop_frames() const {
+        return _hop;
+    }
+
+    /**
+     * @brief      Producer: frames still missing for the window being filled
+     */
+    size_t frames_until_window() const {
+        return FRAMES - _filled;
+    }
+
+    /**
+     * @brief      Whether the newest completed window was not taken by the consumer yet
+     *             (completing another one now would replace it)
+     */
+    bool pending() const {
+        return (_middle.load(std::memory_order_acquire) & SLOT_FRESH) != 0;
+    }
+
+    /**
+     * @brief      Producer: append frames to the window being filled.
+     *             At most frames_until_window() frames are taken.
+     *
+     * @param      data          Interleaved values, frames * AXES
+     * @param      frames        Number of frames
+     * @param      timestamp_us  Timestamp of the last frame
+     *
+     * @return     true if this completed a window
+     */
+    bool write(const float *data, size_t frames, uint32_t timestamp_us) {
+        if (frames > FRAMES - _filled) {
+            frames = FRAMES - _filled;
+        }
+        memcpy(_slots[_back].data + _filled * AXES, data, frames * AXES * sizeof(float));
+        _filled += frames;
+        if (_filled < FRAMES) {
+            return false;
+        }
+
+        window_t *done = &_slots[_back];
+        done->timestamp_us = timestamp_us;
+        done->sequence = ++_sequence;
+
+        // publish, the slot we get back is free (either stale or already read)
+        const uint32_t previous = _middle.exchange(_back | SLOT_FRESH, std::memory_order_acq_rel);
+        if (previous & SLOT_FRESH) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        _completed.fetch_add(1, std::memory_order_relaxed);
+        _back = previous & SLOT_MASK;
+
+        // the completed window stays readable, seed the next one with the overlap
+        const size_t overlap = FRAMES - _hop;
+        memcpy(_slots[_back].data, done->data + _hop * AXES, overlap * AXES * sizeof(float));
+        _filled = overlap;
+        return true;
+    }
+
+    /**
+     * @brief      Consumer: take the newest completed window
+     * @return     The window, or nullptr if none completed since the last call
+     */
+    const window_t *acquire() {
+        if (!(_middle.load(std::memory_order_acquire) & SLOT_FRESH)) {
+            return nullptr;
+        }
+        const uint32_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & SLOT_MASK;
+        _consumed.fetch_add(1, std::memory_order_relaxed);
+        return &_slots[_front];
+    }
+
+    void get_stats(window_buffer_stats_t *stats) const {
+        stats->completed = _completed.load(std::memory_order_relaxed);
+        stats->dropped = _dropped.load(std::memory_order_relaxed);
+        stats->consumed = _consumed.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const uint32_t SLOT_FRESH = 0x4;
+    static const uint32_t SLOT_MASK = 0x3;
+
+    window_t _slots[3];
+    const size_t _hop;
+    // producer only
+    uint32_t _back;
+    size_t _filled;
+    uint32_t _sequence;
+    // consumer only
+    uint32_t _front;
+    // slot index of the newest completed window, SLOT_FRESH until the consumer takes it
+    std::atomic<uint32_t> _middle;
+    std::atomic<uint32_t> _completed;
+    std::atomic<uint32_t> _dropped;
+    std::atomic<uint32_t> _consumed;
+};
+
+#endif // _WINDOW_BUFFER_H_
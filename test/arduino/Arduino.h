@@ -0,0 +1,29 @@
+/* Host stand-in for the Arduino core, just enough to compile the sensor
+ * drivers against a simulated register bus (see test/lis2dw12_fifo_test.cpp).
+ * Pin and delay calls do nothing.
+ */
+
+#ifndef _TEST_ARDUINO_H_
+#define _TEST_ARDUINO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define OUTPUT 1
+#define INPUT  0
+
+static inline void pinMode(uint8_t, uint8_t) { }
+static inline void digitalWrite(uint8_t, uint8_t) { }
+static inline void delay(unsigned long) { }
+
+class HardwareSerial {
+public:
+    template <typename T> void print(const T &) { }
+    template <typename T> void println(const T &) { }
+    void println() { }
+};
+
+extern HardwareSerial Serial;
+
+#endif // _TEST_ARDUINO_H_
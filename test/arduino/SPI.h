@@ -0,0 +1,28 @@
+/* Host stand-in for the Arduino SPI library, see Wire.h
+ */
+
+#ifndef _TEST_SPI_H_
+#define _TEST_SPI_H_
+
+#include "Arduino.h"
+
+#define MSBFIRST  1
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+
+class SPISettings {
+public:
+    SPISettings(uint32_t, uint8_t, uint8_t) { }
+};
+
+class SPIClass {
+public:
+    void begin() { }
+    void beginTransaction(const SPISettings &) { }
+    void endTransaction() { }
+    uint8_t transfer(uint8_t) { return 0; }
+};
+
+extern SPIClass SPI;
+
+#endif // _TEST_SPI_H_
@@ -0,0 +1,26 @@
+/* Host stand-in for the Arduino Wire library. Transfers go nowhere; tests
+ * override the driver's readReg/writeReg instead.
+ */
+
+#ifndef _TEST_WIRE_H_
+#define _TEST_WIRE_H_
+
+#include "Arduino.h"
+
+// as on the ESP32 core, so the burst length is capped like on the device
+#define I2C_BUFFER_LENGTH 128
+
+class TwoWire {
+public:
+    void begin() { }
+    void beginTransmission(uint8_t) { }
+    size_t write(uint8_t) { return 1; }
+    size_t write(const uint8_t *, size_t size) { return size; }
+    uint8_t endTransmission() { return 0; }
+    uint8_t requestFrom(uint8_t, uint8_t size) { return size; }
+    int read() { return 0; }
+};
+
+extern TwoWire Wire;
+
+#endif // _TEST_WIRE_H_
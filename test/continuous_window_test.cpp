@@ -0,0 +1,333 @@
+/* Activity recognition - continuous window test
+ *
+ * Feeds a synthetic 3-axis trace (walking, resting, running, with a drifting
+ * gravity offset) through run_classifier_continuous in slices of
+ * EI_CLASSIFIER_SLICE_SIZE frames and checks the state it keeps for the
+ * spectral analysis block against the batch path at every window:
+ *
+ *  - running moments: the mean, RMS, skewness and kurtosis of every axis
+ *    (classifier_continuous_moments, see dsp/spectral/moments.hpp) against
+ *    numpy::mean / stdev / skew / kurtosis over the same frames of the trace.
+ *    The batch path sums in float, which loses precision when the spread of
+ *    an axis is small against its offset (gravity while resting), so the
+ *    tolerance grows with |mean| / stddev. Both are also checked against a
+ *    double precision reference, where the running moments have to be
+ *    within 1e-5. The trace is long enough for the moments to be rebased
+ *    (EIDSP_MOMENTS_REBASE_INTERVAL) several times. Halfway through, one
+ *    slice fails to read: it has to return EI_IMPULSE_DSP_ERROR and make the
+ *    window fill up again, after which the moments have to match as before.
+ *  - sliding DFT: the Welch max-hold spectrum of every axis
+ *    (classifier_continuous_welch, see dsp/spectral/sliding_dft.hpp) against
+ *    numpy::welch_max_hold (FFT power_spectrum per segment) over the mean
+ *    subtracted window, within 1e-6 of the largest bin. Before that, the
+ *    allocation of the engines is made to fail once: the slice has to fail
+ *    with EI_IMPULSE_ALLOC_FAILED, and the next one has to set everything
+ *    up again instead of pushing into engines that were never initialized.
+ *
+ * The classifier state lives in ei_run_classifier.h, which this file
+ * includes, so it is read directly after every slice.
+ *
+ * Usage: continuous_window_test
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+#define TRACE_FRAMES    (EI_CLASSIFIER_SLICE_SIZE * 2000)
+#define AXES            EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME
+#define WINDOW_FRAMES   EI_CLASSIFIER_RAW_SAMPLE_COUNT
+
+static int failures = 0;
+
+/* Allocation failure injection -------------------------------------------- */
+
+// the POSIX porting layer defines ei_calloc weak, so this one takes over
+static bool fail_sliding_dft_alloc = false;
+
+void *ei_calloc(size_t nitems, size_t size) {
+    // sliding_welch::init allocates its twiddle table first, fft_points complex doubles
+    const ei_dsp_config_spectral_analysis_t *config = (const ei_dsp_config_spectral_analysis_t *)ei_dsp_blocks[0].config;
+    if (fail_sliding_dft_alloc && nitems == (size_t)config->fft_length * 2 && size == sizeof(double)) {
+        return NULL;
+    }
+    return calloc(nitems, size);
+}
+
+/**
+ * @brief      Interleaved x,y,z in mg
+ */
+static void make_trace(std::vector<float> *values) {
+    uint32_t seed = 7;
+    for (size_t ix = 0; ix < TRACE_FRAMES; ix++) {
+        const float t = (float)ix / EI_CLASSIFIER_FREQUENCY;
+        // walk, rest, run, walk, ...
+        const size_t segment = (ix / 1500) % 4;
+        const float amplitude = segment == 1 ? 0.0f : segment == 2 ? 900.0f : 350.0f;
+        const float step_hz = segment == 2 ? 2.8f : 1.8f;
+        for (size_t axis = 0; axis < AXES; axis++) {
+            seed = seed * 1103515245 + 12345;
+            const float noise = ((float)((seed >> 16) & 0xff) - 128.0f) / (segment == 1 ? 32.0f : 4.0f);
+            const float gravity = (axis == 2 ? 1000.0f : 150.0f) + 80.0f * sinf(2.0f * (float)M_PI * t / 600.0f);
+            const float swing = amplitude * sinf(2.0f * (float)M_PI * step_hz * t + axis)
+                + 0.3f * amplitude * sinf(4.0f * (float)M_PI * step_hz * t);
+            values->push_back(gravity + swing + noise);
+        }
+    }
+}
+
+static float relative_error(float actual, float expected) {
+    return fabsf(actual - expected) / (1.0f + fabsf(expected));
+}
+
+/**
+ * @brief      Mean, population stddev, skewness and Fisher kurtosis of one row in double
+ */
+static void reference_moments(const float *row, size_t count, float *out) {
+    double sum = 0.0;
+    for (size_t ix = 0; ix < count; ix++) {
+        sum += row[ix];
+    }
+    const double mean = sum / count;
+    double m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    for (size_t ix = 0; ix < count; ix++) {
+        const double d = row[ix] - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+    }
+    m2 /= count;
+    m3 /= count;
+    m4 /= count;
+    out[0] = (float)mean;
+    out[1] = (float)sqrt(m2);
+    out[2] = (float)(m3 / pow(m2, 1.5));
+    out[3] = (float)(m4 / (m2 * m2) - 3.0);
+}
+
+/**
+ * @brief      The window ending at frame end, one row per axis
+ */
+static void window_rows(const std::vector<float> &values, size_t end, ei::matrix_t *rows) {
+    const size_t first = end - WINDOW_FRAMES;
+    for (size_t axis = 0; axis < AXES; axis++) {
+        for (size_t frame = 0; frame < WINDOW_FRAMES; frame++) {
+            rows->buffer[axis * WINDOW_FRAMES + frame] = values[(first + frame) * AXES + axis];
+        }
+    }
+}
+
+/**
+ * @brief      Subtract the mean of every row, computed and applied in double
+ *             (in float, rounding the 1 g offset swamps the DC bin)
+ */
+static void subtract_reference_mean(ei::matrix_t *rows) {
+    for (size_t row = 0; row < rows->rows; row++) {
+        float *values = &rows->buffer[row * rows->cols];
+        double sum = 0.0;
+        for (size_t ix = 0; ix < rows->cols; ix++) {
+            sum += values[ix];
+        }
+        const double mean = sum / rows->cols;
+        for (size_t ix = 0; ix < rows->cols; ix++) {
+            values[ix] = (float)((double)values[ix] - mean);
+        }
+    }
+}
+
+static int failing_get_data(size_t offset, size_t length, float *out_ptr) {
+    (void)offset;
+    (void)length;
+    (void)out_ptr;
+    return -1;
+}
+
+static void test_running_moments(const std::vector<float> &values) {
+    run_classifier_init();
+
+    ei::matrix_t rows(AXES, WINDOW_FRAMES);
+    ei::matrix_t mean(AXES, 1);
+    ei::matrix_t stdev(AXES, 1);
+    ei::matrix_t skew(AXES, 1);
+    ei::matrix_t kurtosis(AXES, 1);
+
+    // mirrors push_continuous_window: one add per frame, one evict per frame leaving
+    size_t filled = 0;
+    uint32_t updates = 0;
+    size_t rebases = 0;
+    size_t windows = 0;
+    float max_error[4] = { 0 };
+
+    for (size_t frame = 0; frame + EI_CLASSIFIER_SLICE_SIZE <= TRACE_FRAMES; frame += EI_CLASSIFIER_SLICE_SIZE) {
+        ei::signal_t signal;
+        ei_impulse_result_t result = { 0 };
+
+        if (frame == EI_CLASSIFIER_SLICE_SIZE * 1000) {
+            signal.total_length = EI_CLASSIFIER_SLICE_SIZE * AXES;
+            signal.get_data = &failing_get_data;
+            const EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result, false, false);
+            if (res != EI_IMPULSE_DSP_ERROR || classifier_continuous_window_filled != 0) {
+                printf("running moments FAILED: a failed read returned %d and kept %zu samples\n",
+                    res, classifier_continuous_window_filled);
+                failures++;
+            }
+            // the moments start over with the next slice
+            filled = 0;
+            updates = 0;
+        }
+
+        ei::numpy::signal_from_buffer(&values[frame * AXES], EI_CLASSIFIER_SLICE_SIZE * AXES, &signal);
+        if (run_classifier_continuous(&signal, &result, false, false) != EI_IMPULSE_OK) {
+            printf("run_classifier_continuous FAILED at frame %zu\n", frame);
+            failures++;
+            return;
+        }
+
+        const size_t end = frame + EI_CLASSIFIER_SLICE_SIZE;
+        const size_t now_filled = filled + EI_CLASSIFIER_SLICE_SIZE < WINDOW_FRAMES ? filled + EI_CLASSIFIER_SLICE_SIZE : WINDOW_FRAMES;
+        updates += EI_CLASSIFIER_SLICE_SIZE + (filled + EI_CLASSIFIER_SLICE_SIZE - now_filled);
+        filled = now_filled;
+        if (filled < WINDOW_FRAMES) {
+            continue;
+        }
+        if (updates >= EIDSP_MOMENTS_REBASE_INTERVAL) {
+            updates = 0;
+            rebases++;
+        }
+        windows++;
+
+        window_rows(values, end, &rows);
+        ei::numpy::mean(&rows, &mean);
+        ei::numpy::stdev(&rows, &stdev);
+        ei::numpy::skew(&rows, &skew);
+        ei::numpy::kurtosis(&rows, &kurtosis);
+
+        for (size_t axis = 0; axis < AXES; axis++) {
+            const ei::spectral::running_moments *moments = &classifier_continuous_moments[axis];
+            const float actual[4] = { moments->mean(), moments->rms(), moments->skew(), moments->kurtosis() };
+            const float batch[4] = { mean.buffer[axis], stdev.buffer[axis], skew.buffer[axis], kurtosis.buffer[axis] };
+            float reference[4];
+            reference_moments(&rows.buffer[axis * WINDOW_FRAMES], WINDOW_FRAMES, reference);
+            // float rounding of x - mean, relative to the spread, as the batch path sums
+            const float conditioning = 8.0f * FLT_EPSILON * fabsf(reference[0]) / reference[1];
+            static const char *names[4] = { "mean", "rms", "skew", "kurtosis" };
+            for (size_t ix = 0; ix < 4; ix++) {
+                const float error = relative_error(actual[ix], batch[ix]);
+                if (error > max_error[ix]) {
+                    max_error[ix] = error;
+                }
+                if (error > 1e-4f + conditioning || relative_error(actual[ix], reference[ix]) > 1e-5f) {
+                    if (failures < 10) {
+                        printf("running moments FAILED: window ending at frame %zu, axis %zu: %s %f, batch %f, reference %f\n",
+                            end, axis, names[ix], actual[ix], batch[ix], reference[ix]);
+                    }
+                    failures++;
+                }
+            }
+        }
+    }
+
+    if (rebases < 2) {
+        printf("running moments FAILED: only %zu rebases in %zu windows\n", rebases, windows);
+        failures++;
+    }
+    printf("running moments: %zu windows, %zu rebases, max relative difference to batch mean %.2g rms %.2g skew %.2g kurtosis %.2g\n",
+        windows, rebases, max_error[0], max_error[1], max_error[2], max_error[3]);
+}
+
+static void test_sliding_welch(const std::vector<float> &values) {
+    const ei_dsp_config_spectral_analysis_t *config = (const ei_dsp_config_spectral_analysis_t *)ei_dsp_blocks[0].config;
+    const size_t bins = config->fft_length / 2 + 1;
+    if (EIDSP_SPECTRAL_SLIDING_DFT != 1 || strcmp(config->analysis_type, "FFT") != 0) {
+        printf("sliding welch FAILED: the spectral block does not use the sliding DFT\n");
+        failures++;
+        return;
+    }
+
+    // drop the window left over from the moments test, so the engines get set up again
+    run_classifier_deinit();
+    run_classifier_init();
+    ei::signal_t signal;
+    ei_impulse_result_t result = { 0 };
+
+    fail_sliding_dft_alloc = true;
+    ei::numpy::signal_from_buffer(&values[0], EI_CLASSIFIER_SLICE_SIZE * AXES, &signal);
+    const EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result, false, false);
+    fail_sliding_dft_alloc = false;
+    if (res != EI_IMPULSE_ALLOC_FAILED || classifier_continuous_window || classifier_continuous_moments
+        || classifier_continuous_welch) {
+        printf("sliding welch FAILED: a failed engine allocation returned %d and kept the window state\n", res);
+        failures++;
+    }
+
+    ei::matrix_t rows(AXES, WINDOW_FRAMES);
+    std::vector<float> batch(bins);
+    std::vector<float> sliding(bins);
+    size_t windows = 0;
+    float max_error = 0.0f;
+
+    for (size_t frame = 0; frame + EI_CLASSIFIER_SLICE_SIZE <= TRACE_FRAMES; frame += EI_CLASSIFIER_SLICE_SIZE) {
+        ei::numpy::signal_from_buffer(&values[frame * AXES], EI_CLASSIFIER_SLICE_SIZE * AXES, &signal);
+        if (run_classifier_continuous(&signal, &result, false, false) != EI_IMPULSE_OK) {
+            printf("run_classifier_continuous FAILED at frame %zu\n", frame);
+            failures++;
+            return;
+        }
+        const size_t end = frame + EI_CLASSIFIER_SLICE_SIZE;
+        if (end < WINDOW_FRAMES) {
+            continue;
+        }
+        windows++;
+
+        window_rows(values, end, &rows);
+        subtract_reference_mean(&rows);
+        for (size_t axis = 0; axis < AXES; axis++) {
+            const ei::spectral::sliding_welch *welch = &classifier_continuous_welch[axis];
+            if (!welch->ready() || !welch->matches(WINDOW_FRAMES, config->fft_length, config->do_fft_overlap)) {
+                printf("sliding welch FAILED: axis %zu not set up at frame %zu\n", axis, end);
+                failures++;
+                return;
+            }
+            ei::numpy::welch_max_hold(&rows.buffer[axis * WINDOW_FRAMES], WINDOW_FRAMES, batch.data(),
+                                      0, bins, config->fft_length, config->do_fft_overlap);
+            welch->max_hold(classifier_continuous_moments[axis].mean_double(), 1.0f, sliding.data(), 0, bins);
+
+            float largest = 0.0f;
+            for (size_t k = 0; k < bins; k++) {
+                largest = batch[k] > largest ? batch[k] : largest;
+            }
+            largest = largest > 0.0f ? largest : 1.0f;
+            for (size_t k = 0; k < bins; k++) {
+                const float error = fabsf(sliding[k] - batch[k]) / largest;
+                if (error > max_error) {
+                    max_error = error;
+                }
+                if (error > 1e-6f) {
+                    if (failures < 10) {
+                        printf("sliding welch FAILED: window ending at frame %zu, axis %zu, bin %zu: %f, batch %f\n",
+                            end, axis, k, sliding[k], batch[k]);
+                    }
+                    failures++;
+                }
+            }
+        }
+    }
+
+    printf("sliding welch: %zu windows, max difference to batch %.2g of the largest bin\n", windows, max_error);
+}
+
+int main() {
+    std::vector<float> values;
+    make_trace(&values);
+
+    test_running_moments(values);
+    test_sliding_welch(values);
+
+    if (failures) {
+        printf("%d checks FAILED\n", failures);
+        return 1;
+    }
+    return 0;
+}
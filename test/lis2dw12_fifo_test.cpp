@@ -0,0 +1,228 @@
+/* Activity recognition - LIS2DW12 FIFO driver test
+ *
+ * Runs the FIFO part of DFRobot_LIS2DW12 against a simulated register bus:
+ * the driver's readReg/writeReg are overridden by a register file with a
+ * 32 level FIFO behind OUT_X_L..OUT_Z_H (the output pointer rolls back to
+ * OUT_X_L while the FIFO is enabled, as on the chip) and FIFO_SAMPLES
+ * computed from it. The Arduino core is replaced by the stubs in
+ * test/arduino, Wire.h sets I2C_BUFFER_LENGTH as the ESP32 core does, so a
+ * burst is capped at 21 levels as on the device.
+ *
+ * Checks the FIFO_CTRL bit packing, the level / watermark / overrun
+ * decoding, splitting a drain into bursts, clamping to the FIFO level and
+ * the early exit after a short read.
+ *
+ * Usage: lis2dw12_fifo_test
+ */
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include "DFRobot_LIS2DW12.h"
+
+HardwareSerial Serial;
+TwoWire Wire;
+SPIClass SPI;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d FAILED: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * @brief      DFRobot_LIS2DW12 on a simulated register file
+ */
+class FakeLIS2DW12 : public DFRobot_LIS2DW12 {
+public:
+    struct level_t {
+        int16_t xyz[3];
+    };
+
+    FakeLIS2DW12() : overrun(false), short_burst(-1) {
+        memset(regs, 0, sizeof(regs));
+    }
+
+    /**
+     * @brief      Store levels, the next one counts up from first
+     */
+    void fill(size_t levels, int16_t first) {
+        for (size_t ix = 0; ix < levels; ix++) {
+            level_t level;
+            for (size_t axis = 0; axis < 3; axis++) {
+                level.xyz[axis] = (int16_t)(first + (int16_t)(ix * 3 + axis) * 16);
+            }
+            if (fifo.size() == LIS2DW12_FIFO_DEPTH) {
+                fifo.pop_front();
+                overrun = true;
+            }
+            fifo.push_back(level);
+        }
+    }
+
+    uint8_t regs[256];
+    std::deque<level_t> fifo;
+    bool overrun;
+    std::vector<size_t> bursts;     // bytes requested by every OUT_X_L read
+    int short_burst;                // this burst returns one byte less
+
+protected:
+    uint8_t readReg(uint8_t reg, uint8_t *pBuf, size_t size) {
+        if (reg == REG_FIFO_SAMPLES && size == 1) {
+            const uint8_t fth = regs[REG_FIFO_CTRL] & 0x1F;
+            *pBuf = (uint8_t)fifo.size() | (fifo.size() >= fth ? 0x80 : 0) | (overrun ? 0x40 : 0);
+            return 1;
+        }
+        if (reg == REG_OUT_X_L && (regs[REG_FIFO_CTRL] & 0xE0) != 0) {
+            const bool short_read = (int)bursts.size() == short_burst;
+            bursts.push_back(size);
+            if (short_read) {
+                size--;
+            }
+            for (size_t ix = 0; ix < size; ix++) {
+                const size_t byte = ix % LIS2DW12_FIFO_FRAME_BYTES;
+                const int16_t value = fifo.empty() ? 0 : fifo.front().xyz[byte / 2];
+                pBuf[ix] = byte % 2 ? (uint8_t)((uint16_t)value >> 8) : (uint8_t)value;
+                // the level is consumed once OUT_Z_H was read
+                if (byte == LIS2DW12_FIFO_FRAME_BYTES - 1 && !fifo.empty()) {
+                    fifo.pop_front();
+                    overrun = false;
+                }
+            }
+            return (uint8_t)size;
+        }
+        memcpy(pBuf, &regs[reg], size);
+        return (uint8_t)size;
+    }
+
+    uint8_t writeReg(uint8_t reg, const void *pBuf, size_t size) {
+        memcpy(&regs[reg], pBuf, size);
+        return (uint8_t)size;
+    }
+};
+
+static int16_t to_mg(int16_t raw) {
+    // as readFifo() scales at +-2 g
+    return raw * 0.061f;
+}
+
+static void test_fifo_ctrl() {
+    FakeLIS2DW12 sensor;
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+    CHECK(sensor.regs[0x2E] == 0xC0);
+    sensor.setFifoWatermark(20);
+    CHECK(sensor.regs[0x2E] == 0xD4);
+    // the watermark is 5 bits, it must not spill into the mode
+    sensor.setFifoWatermark(0x3F);
+    CHECK(sensor.regs[0x2E] == 0xDF);
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoBypass);
+    CHECK(sensor.regs[0x2E] == 0x1F);
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoBypassToCont);
+    CHECK(sensor.regs[0x2E] == 0x9F);
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoStopWhenFull);
+    CHECK(sensor.regs[0x2E] == 0x3F);
+}
+
+static void test_fifo_samples() {
+    FakeLIS2DW12 sensor;
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+    sensor.setFifoWatermark(20);
+
+    sensor.fill(10, 0);
+    CHECK(sensor.getFifoLevel() == 10);
+    CHECK(!sensor.fifoWatermarkReached());
+    CHECK(!sensor.fifoOverrun());
+
+    sensor.fill(10, 0);
+    CHECK(sensor.getFifoLevel() == 20);
+    CHECK(sensor.fifoWatermarkReached());
+    CHECK(!sensor.fifoOverrun());
+
+    // a full FIFO reads 32 (0x20), which must not be masked away
+    sensor.fill(20, 0);
+    CHECK(sensor.getFifoLevel() == 32);
+    CHECK(sensor.fifoWatermarkReached());
+    CHECK(sensor.fifoOverrun());
+}
+
+static void test_burst_split() {
+    CHECK(LIS2DW12_FIFO_BURST_FRAMES == 21);
+
+    FakeLIS2DW12 sensor;
+    sensor.setRange(DFRobot_LIS2DW12::e2_g);
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+    sensor.fill(LIS2DW12_FIFO_DEPTH, -1000);
+
+    int16_t xyz[LIS2DW12_FIFO_DEPTH * 3];
+    CHECK(sensor.readFifo(xyz, LIS2DW12_FIFO_DEPTH) == LIS2DW12_FIFO_DEPTH);
+    CHECK(sensor.bursts.size() == 2 && sensor.bursts[0] == 21 * 6 && sensor.bursts[1] == 11 * 6);
+    CHECK(sensor.fifo.empty());
+    bool values_ok = true;
+    for (size_t ix = 0; ix < LIS2DW12_FIFO_DEPTH * 3; ix++) {
+        values_ok &= xyz[ix] == to_mg((int16_t)(-1000 + (int16_t)ix * 16));
+    }
+    CHECK(values_ok);
+}
+
+static void test_clamp() {
+    FakeLIS2DW12 sensor;
+    sensor.setRange(DFRobot_LIS2DW12::e2_g);
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+    int16_t xyz[LIS2DW12_FIFO_DEPTH * 3];
+
+    // asking for more than is stored reads what is stored, in one burst
+    sensor.fill(5, 100);
+    CHECK(sensor.readFifo(xyz, LIS2DW12_FIFO_DEPTH) == 5);
+    CHECK(sensor.bursts.size() == 1 && sensor.bursts[0] == 5 * 6);
+    CHECK(xyz[0] == to_mg(100) && xyz[14] == to_mg(100 + 14 * 16));
+
+    // asking for less leaves the rest in the FIFO
+    sensor.bursts.clear();
+    sensor.fill(10, 0);
+    CHECK(sensor.readFifo(xyz, 3) == 3);
+    CHECK(sensor.bursts.size() == 1 && sensor.bursts[0] == 3 * 6);
+    CHECK(sensor.getFifoLevel() == 7);
+
+    sensor.bursts.clear();
+    sensor.fifo.clear();
+    CHECK(sensor.readFifo(xyz, LIS2DW12_FIFO_DEPTH) == 0);
+    CHECK(sensor.bursts.empty());
+    CHECK(sensor.readFifo(NULL, LIS2DW12_FIFO_DEPTH) == 0);
+}
+
+static void test_short_read() {
+    FakeLIS2DW12 sensor;
+    sensor.setRange(DFRobot_LIS2DW12::e2_g);
+    sensor.setFifoMode(DFRobot_LIS2DW12::eFifoContinuous);
+    sensor.fill(LIS2DW12_FIFO_DEPTH, 0);
+    sensor.short_burst = 1;
+
+    int16_t xyz[LIS2DW12_FIFO_DEPTH * 3];
+    // the second burst comes back short: only the first one counts and no further burst is tried
+    CHECK(sensor.readFifo(xyz, LIS2DW12_FIFO_DEPTH) == 21);
+    CHECK(sensor.bursts.size() == 2);
+
+    sensor.bursts.clear();
+    sensor.fill(4, 0);
+    sensor.short_burst = 0;
+    CHECK(sensor.readFifo(xyz, LIS2DW12_FIFO_DEPTH) == 0);
+    CHECK(sensor.bursts.size() == 1);
+}
+
+int main() {
+    test_fifo_ctrl();
+    test_fifo_samples();
+    test_burst_split();
+    test_clamp();
+    test_short_read();
+
+    if (failures) {
+        printf("%d checks FAILED\n", failures);
+        return 1;
+    }
+    printf("lis2dw12 fifo: all checks passed\n");
+    return 0;
+}
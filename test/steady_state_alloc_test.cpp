@@ -0,0 +1,183 @@
+/* Activity recognition - steady-state allocation test
+ *
+ * With EIDSP_STATIC_WORKSPACE (and with it EI_CLASSIFIER_PERSISTENT_MODEL),
+ * as the sketch builds, only the first window may allocate: DSP scratch
+ * memory comes from the static workspace, the model stays initialized and
+ * the feature buffers are reused. Runs run_classifier and
+ * run_classifier_continuous over a synthetic recording and counts every
+ * ei_malloc / ei_calloc (the POSIX porting layer defines them weak) and
+ * every operator new after the first window of each; any allocation fails
+ * the test. Also fails if the workspace had to fall back to the heap.
+ *
+ * Usage: steady_state_alloc_test
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+#if EIDSP_STATIC_WORKSPACE != 1
+#error "build with EIDSP_STATIC_WORKSPACE=1 (the ei_impulse_sketch library)"
+#endif
+
+#define WINDOWS 12
+
+/* Allocation counting ----------------------------------------------------- */
+
+static bool counting = false;
+static uint64_t alloc_count = 0;
+
+static void *count_alloc(void *ptr) {
+    if (counting) {
+        alloc_count++;
+    }
+    return ptr;
+}
+
+void *ei_malloc(size_t size) {
+    return count_alloc(malloc(size));
+}
+
+void *ei_calloc(size_t nitems, size_t size) {
+    return count_alloc(calloc(nitems, size));
+}
+
+void ei_free(void *ptr) {
+    free(ptr);
+}
+
+// every operator new / delete goes through this pair (new is counted), so the
+// compiler never pairs a new expression with a bare free() (-Wmismatched-new-delete)
+static void *heap_new(size_t size) {
+    void *ptr = count_alloc(malloc(size ? size : 1));
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+static void heap_delete(void *ptr) {
+    free(ptr);
+}
+
+void *operator new(size_t size) {
+    return heap_new(size);
+}
+
+void *operator new[](size_t size) {
+    return heap_new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    heap_delete(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    heap_delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    heap_delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    heap_delete(ptr);
+}
+
+/* Tests ------------------------------------------------------------------- */
+
+/**
+ * @brief      Interleaved x,y,z in mg, a walking-like swing with some noise
+ */
+static void make_recording(size_t frames, std::vector<float> *values) {
+    uint32_t seed = 1;
+    for (size_t ix = 0; ix < frames; ix++) {
+        const float t = (float)ix / EI_CLASSIFIER_FREQUENCY;
+        for (size_t axis = 0; axis < EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME; axis++) {
+            seed = seed * 1103515245 + 12345;
+            const float noise = (float)((seed >> 16) & 0xff) - 128.0f;
+            values->push_back(400.0f * sinf(2.0f * (float)M_PI * 1.8f * t + axis) + (axis == 2 ? 1000.0f : 0.0f) + noise);
+        }
+    }
+}
+
+static bool test_run_classifier(const std::vector<float> &values) {
+    run_classifier_init();
+    uint64_t allocs = 0;
+    for (size_t window = 0; window < WINDOWS; window++) {
+        ei::signal_t signal;
+        ei::numpy::signal_from_buffer(&values[window * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE],
+                                      EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        ei_impulse_result_t result = { 0 };
+        counting = window > 0;
+        alloc_count = 0;
+        const EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+        counting = false;
+        if (res != EI_IMPULSE_OK) {
+            printf("run_classifier FAILED: error %d in window %zu\n", res, window);
+            return false;
+        }
+        if (alloc_count && !allocs) {
+            printf("run_classifier window %zu: %llu allocations\n", window, (unsigned long long)alloc_count);
+        }
+        allocs += alloc_count;
+    }
+    if (allocs) {
+        printf("run_classifier FAILED: %llu allocations after the first window\n", (unsigned long long)allocs);
+        return false;
+    }
+    printf("run_classifier: no allocations in windows 2..%d\n", WINDOWS);
+    return true;
+}
+
+static bool test_run_classifier_continuous(const std::vector<float> &values) {
+    run_classifier_init();
+    const size_t slice_values = EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+    const size_t slices = values.size() / slice_values;
+    uint64_t allocs = 0;
+    size_t windows = 0;
+    for (size_t slice = 0; slice < slices; slice++) {
+        ei::signal_t signal;
+        ei::numpy::signal_from_buffer(&values[slice * slice_values], slice_values, &signal);
+        ei_impulse_result_t result = { 0 };
+        // a slice completes a window once a whole window of frames has come in
+        const bool full_window = (slice + 1) * EI_CLASSIFIER_SLICE_SIZE >= EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+        counting = windows > 0;
+        alloc_count = 0;
+        const EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result, false, false);
+        counting = false;
+        if (res != EI_IMPULSE_OK) {
+            printf("run_classifier_continuous FAILED: error %d in slice %zu\n", res, slice);
+            return false;
+        }
+        if (alloc_count && !allocs) {
+            printf("run_classifier_continuous slice %zu: %llu allocations\n", slice, (unsigned long long)alloc_count);
+        }
+        allocs += alloc_count;
+        windows += full_window;
+    }
+    if (allocs) {
+        printf("run_classifier_continuous FAILED: %llu allocations after the first window\n", (unsigned long long)allocs);
+        return false;
+    }
+    printf("run_classifier_continuous: no allocations in windows 2..%zu\n", windows);
+    return true;
+}
+
+int main() {
+    std::vector<float> values;
+    make_recording(WINDOWS * EI_CLASSIFIER_RAW_SAMPLE_COUNT, &values);
+
+    bool ok = test_run_classifier(values);
+    ok &= test_run_classifier_continuous(values);
+
+    if (ei::workspace::heap_fallbacks() != 0) {
+        printf("FAILED: %u workspace heap fallbacks (high water %zu of %zu bytes)\n",
+            (unsigned)ei::workspace::heap_fallbacks(), ei::workspace::high_water(), (size_t)EIDSP_STATIC_WORKSPACE_SIZE);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}